@@ -1 +1,2 @@
 from .nxwrapper import Graph, DiGraph
+from .stream import StreamClient
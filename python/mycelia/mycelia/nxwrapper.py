@@ -1,10 +1,50 @@
 import xmlrpclib
 import os
+import struct
+import time
 
 import networkx as nx
 
 import matplotlib.colors as c
 
+MULTICALL_SIZE = 1000 # calls per system.multicall request
+
+class _Batch:
+    """
+    Attribute updates collected for many elements and sent in a few
+    requests: colors, sizes and weights through the bulk methods, and
+    everything else through system.multicall.
+
+    """
+
+    def __init__(self):
+        self.node_colors = ([], [])
+        self.node_sizes = ([], [])
+        self.edge_colors = ([], [])
+        self.edge_weights = ([], [])
+        self.calls = []
+
+    def call(self, method, *args):
+        self.calls.append((method, args))
+
+    def flush(self, server):
+        if self.node_colors[0]:
+            server.set_node_colors(*self.node_colors)
+        if self.node_sizes[0]:
+            server.set_node_sizes(*self.node_sizes)
+        if self.edge_colors[0]:
+            server.set_edge_colors(*self.edge_colors)
+        if self.edge_weights[0]:
+            server.set_edge_weights(*self.edge_weights)
+
+        for start in range(0, len(self.calls), MULTICALL_SIZE):
+            multicall = xmlrpclib.MultiCall(server)
+            for method, args in self.calls[start:start + MULTICALL_SIZE]:
+                getattr(multicall, method)(*args)
+            multicall()
+
+        self.__init__()
+
 class MyceliaServer:
     # This is designed to be only a partial class.
     # You must use multiple-inheritance.
@@ -16,6 +56,34 @@ class MyceliaServer:
         # implement a file opener in Python.
         self.server.open_file(os.path.abspath(path))
 
+    def save_snapshot(self, path):
+        """
+        Saves the displayed graph, positions and attributes included, as a
+        binary snapshot; returns False if it could not be written.
+
+        """
+        return self.server.save_snapshot(os.path.abspath(path)) == 0
+
+    def load_snapshot(self, path):
+        """
+        Replaces the displayed graph with a snapshot from save_snapshot and
+        returns its node count, or -1 if it could not be read. As with
+        open_file, this Python graph is not updated.
+
+        """
+        return self.server.load_snapshot(os.path.abspath(path))
+
+    def generate(self, model, n, k=4, p=0.1, seed=0):
+        """
+        Replaces the displayed graph with a random one of n nodes and
+        returns its edge count, or -1 for an unknown model: 'erdos' (each
+        ordered pair with probability p), 'watts' (ring of k neighbors,
+        rewired with probability p) or 'barabasi' (k edges per new node).
+        As with open_file, this Python graph is not updated.
+
+        """
+        return self.server.generate(model, int(n), int(k), float(p), int(seed))
+
     def __init__(self, server='http://localhost:9876', label='label'):
         self.server = xmlrpclib.Server(server)
         self.label = label
@@ -23,7 +91,7 @@ class MyceliaServer:
 
         self.node_types = ['shape', 'image', 'imageScale']
         self.texture_modes = ['align', 'rotate']
-        self.layout_types = {'static':0, 'dynamic':1}
+        self.layout_types = {'static':0, 'dynamic':1, 'multilevel':2, 'gpu_static':3, 'gpu_dynamic':4}
 
         self.graph_attrs = [
             'texture_mode',
@@ -43,52 +111,249 @@ class MyceliaServer:
             'image',
         ]
 
-    def _parse_node_attrs(self, myid, attrs):
+    def _parse_node_attrs(self, myid, attrs, batch=None):
+        flush = batch is None
+        if flush:
+            batch = _Batch()
+
         label = attrs.get(self.label, None)
         if label is not None:
-            self.server.set_node_label(myid, str(label))
+            batch.call('set_node_label', myid, str(label))
 
         if 'color' in attrs:
-            r,g,b,a = c.colorConverter.to_rgba(attrs['color'])
-            self.server.set_node_color(myid, r, g, b, a)
+            batch.node_colors[0].append(myid)
+            batch.node_colors[1].extend(float(x) for x in c.colorConverter.to_rgba(attrs['color']))
 
         if 'size' in attrs:
-            self.server.set_node_size(myid, float(attrs['size']))
+            batch.node_sizes[0].append(myid)
+            batch.node_sizes[1].append(float(attrs['size']))
 
         if 'image' in attrs:
             path = attrs['image']
 
             if path:
                 path = os.path.abspath(path)
-                self.server.set_node_type(myid, 'image')
-                self.server.set_node_image_path(myid, path)
+                batch.call('set_node_type', myid, 'image')
+                batch.call('set_node_image_path', myid, path)
 
         if 'imageScale' in attrs:
             scale = attrs['imageScale']
-            self.server.set_node_image_scale(myid, float(scale))
+            batch.call('set_node_image_scale', myid, float(scale))
     
         for attr in self.custom_node_attrs:
             val = attrs.get(attr, None)
             if val is not None:
-                self.server.set_node_attribute(myid, attr, str(val))
+                batch.call('set_node_attribute', myid, attr, str(val))
+
+        if flush:
+            batch.flush(self.server)
+
+    def _parse_edge_attrs(self, myid, attrs, batch=None):
+        flush = batch is None
+        if flush:
+            batch = _Batch()
 
-    def _parse_edge_attrs(self, myid, attrs):
         label = attrs.get(self.label, None)
         if label is not None:
-            self.server.set_edge_label(myid, str(label))
+            batch.call('set_edge_label', myid, str(label))
 
         weight = attrs.get('weight', None)
         if weight is not None:
-            self.server.set_edge_weight(myid, float(weight))
+            batch.edge_weights[0].append(myid)
+            batch.edge_weights[1].append(float(weight))
 
         color = attrs.get('color', None)
         if color is not None:
-            r,g,b,a = c.colorConverter.to_rgba(color)
-            self.server.set_edge_color(myid, r, g, b, a)
+            batch.edge_colors[0].append(myid)
+            batch.edge_colors[1].extend(float(x) for x in c.colorConverter.to_rgba(color))
+
+        if flush:
+            batch.flush(self.server)
+
+    def load_graph(self, G):
+        """
+        Adds every node and edge of the networkx graph G with their
+        attributes, in a few requests however large G is.
+
+        """
+        self.add_nodes_from(G.nodes(data=True))
+        self.add_edges_from(G.edges(data=True))
+
+        mode = G.graph.get('texture_mode', None)
+        if mode is not None:
+            self.set_texture_node_mode(mode)
 
     def center(self):
         self.server.center()
 
+    # Bulk counterparts of the per element calls. Each applies all of its
+    # elements under one lock and one redraw on the server.
+    def set_node_colors(self, myids, colors):
+        rgba = []
+        for color in colors:
+            rgba.extend(c.colorConverter.to_rgba(color))
+        return self.server.set_node_colors(list(myids), [float(x) for x in rgba])
+
+    def set_node_positions(self, myids, positions):
+        xyz = []
+        for pos in positions:
+            xyz.extend(float(x) for x in pos[0:3])
+        return self.server.set_node_positions(list(myids), xyz)
+
+    def set_node_sizes(self, myids, sizes):
+        return self.server.set_node_sizes(list(myids), [float(x) for x in sizes])
+
+    def set_edge_colors(self, myids, colors):
+        rgba = []
+        for color in colors:
+            rgba.extend(c.colorConverter.to_rgba(color))
+        return self.server.set_edge_colors(list(myids), [float(x) for x in rgba])
+
+    def set_edge_weights(self, myids, weights):
+        return self.server.set_edge_weights(list(myids), [float(x) for x in weights])
+
+    def _unpack(self, packed, code, byte_order):
+        data = packed.data
+        size = struct.calcsize(code)
+        order = '<' if byte_order == 'little' else '>'
+        return list(struct.unpack('%s%d%s' % (order, len(data) // size, code), data))
+
+    def get_version(self):
+        """
+        Returns the server's graph version, bumped by every change, and its
+        position version, bumped by every change of node positions.
+
+        """
+        return self.server.get_version()
+
+    def get_stats(self):
+        """
+        Returns the server's hot path statistics: per path, such as frame,
+        layout_step, graph_copy or lock_wait, the count and seconds since
+        startup and the rate and load per second over the last window
+        seconds, and per rpc method the count and seconds of its calls.
+
+        """
+        return self.server.get_stats()
+
+    def get_positions(self, since=None):
+        """
+        Returns ({server id: (x, y, z)}, position version) for every node, or
+        (None, since) if the positions have not changed since that position
+        version.
+
+        """
+        if since is None:
+            result = self.server.get_positions()
+        else:
+            result = self.server.get_positions(int(since))
+        if not result['changed']:
+            return None, result['position_version']
+        return self._unpack_positions(result), result['position_version']
+
+    def _unpack_positions(self, result):
+        myids = self._unpack(result['ids'], 'i', result['byte_order'])
+        xyz = self._unpack(result['xyz'], 'd', result['byte_order'])
+        return dict((myid, tuple(xyz[3 * i:3 * i + 3])) for i, myid in enumerate(myids))
+
+    def get_changes_since(self, version):
+        """
+        Returns the server ids of nodes and edges whose attributes changed
+        since version, and the current version. Nodes and edges are None if
+        the server cannot tell, after structural changes or too many edits,
+        and everything should be read again.
+
+        """
+        result = self.server.get_changes_since(int(version))
+        if result['full']:
+            return None, None, result['version']
+        order = result['byte_order']
+        return (self._unpack(result['nodes'], 'i', order),
+                self._unpack(result['edges'], 'i', order),
+                result['version'])
+
+    def get_nodes(self):
+        """
+        Returns {server id: (degree, component)} for every node.
+
+        """
+        result = self.server.get_nodes()
+        order = result['byte_order']
+        myids = self._unpack(result['ids'], 'i', order)
+        degrees = self._unpack(result['degrees'], 'i', order)
+        components = self._unpack(result['components'], 'i', order)
+        return dict(zip(myids, zip(degrees, components)))
+
+    def compute_centrality(self, samples=0, apply=True):
+        """
+        Starts node betweenness centrality on the server in the background,
+        from samples random sources or every node for 0. With apply, nodes
+        are sized and colored by it when done. Returns False if a run is
+        still in progress.
+
+        """
+        return self.server.compute_centrality(int(samples), bool(apply))
+
+    def get_centrality(self, wait=True, period=0.5):
+        """
+        Returns ({server id: centrality}, bound, version) of the last finished
+        run; every value is within bound of the exact one with 95%
+        confidence, 0 if exact, and version is the graph version it was
+        computed on. With wait, blocks until a run in progress finishes.
+
+        """
+        result = self.server.get_centrality()
+        while wait and result['running']:
+            time.sleep(period)
+            result = self.server.get_centrality()
+        order = result['byte_order']
+        myids = self._unpack(result['ids'], 'i', order)
+        values = self._unpack(result['centrality'], 'd', order)
+        return dict(zip(myids, values)), result['bound'], result['version']
+
+    def set_event_callback(self, url, method):
+        """
+        Has the server call method(type, myid) at the XML-RPC server at url
+        for every event: 'select', 'highlight', 'drag' and 'drop' of a node,
+        and 'layout_converged' with myid -1. Events are sent from their own
+        thread, and rapid events of one type collapse into the latest.
+
+        """
+        self.server.set_event_callback(url, method)
+
+    def subscribe_positions(self, url, method, period=1.0):
+        """
+        Has the server call method at the XML-RPC server at url with the
+        result of get_positions whenever positions changed, checking every
+        period seconds. Unpack it with _unpack_positions. An empty url
+        ends the subscription.
+
+        """
+        self.server.subscribe_positions(url, method, float(period))
+
+    def _node_keys(self, nodes):
+        # like networkx, (node, attr_dict) pairs are told apart by not hashing
+        keys = []
+        for n in nodes:
+            try:
+                hash(n)
+                keys.append(n)
+            except TypeError:
+                keys.append(n[0])
+        return keys
+
+    def _add_server_nodes(self, nodes):
+        """
+        Creates server nodes for those of nodes that have none yet with one
+        call, in order. Attributes are left to the caller.
+
+        """
+        new = [n for n in nodes if self.myid not in self.node[n]]
+        if new:
+            first = self.server.add_nodes(len(new))
+            for i, n in enumerate(new):
+                self.node[n][self.myid] = first + i
+
     def clear_edges(self):
         for u,v in self.edges():
             self.remove_edge(u,v)
@@ -99,6 +364,15 @@ class MyceliaServer:
     def draw(self):
         self.server.draw()
 
+    def get_layout_energy(self):
+        """
+        Returns the dynamic layout's kinetic, spring and total energy after
+        its last step, with the adapted time step, the number of active
+        nodes and whether it is asleep at rest.
+
+        """
+        return self.server.get_layout_energy()
+
     def layout(self, watch=True):
         self.server.layout(watch)
 
@@ -118,11 +392,38 @@ class MyceliaServer:
     def resume_layout(self):
         self.server.resume_layout()
 
-    def set_layout_type(self, layout):
-        if layout not in self.layout_types:
-            raise Exception("Layout should be 'static' or 'dynamic'.")
+    def set_layout_incremental(self, incremental=True, hops=None):
+        """
+        In incremental mode the dynamic layout only moves nodes touched by
+        edits and their neighbors up to hops edges away, freezing them again
+        once they come to rest. None keeps the current radius.
+
+        """
+        if hops is None:
+            self.server.set_layout_incremental(bool(incremental))
         else:
+            self.server.set_layout_incremental(bool(incremental), int(hops))
+
+    def set_layout_threads(self, threads=0):
+        """
+        Sets the number of threads used by the dynamic layout.
+        0 uses one thread per processor. Returns the resulting count.
+
+        """
+        return self.server.set_layout_threads(int(threads))
+
+    def set_layout_type(self, layout, theta=None):
+        """
+        theta is the Barnes-Hut opening angle used by the static layout.
+        A theta of 0 computes repulsion exactly; None keeps the current value.
+
+        """
+        if layout not in self.layout_types:
+            raise Exception("Layout should be 'static', 'dynamic' or 'multilevel'.")
+        elif theta is None:
             self.server.set_layout_type(self.layout_types[layout])
+        else:
+            self.server.set_layout_type(self.layout_types[layout], float(theta))
 
     def add_node_at(self, n, pos, attr_dict=None, **attr):
         nx.Graph.add_node(self,n,attr_dict=attr_dict,**attr)
@@ -180,9 +481,14 @@ class Graph(nx.Graph, MyceliaServer):
         return myid
 
     def add_nodes_from(self, nodes, **attr):
+        nodes = list(nodes)
         self.stop_layout()
-        for n in nodes:
-            self.add_node(n, stop=False, **attr)
+        nx.Graph.add_nodes_from(self, nodes, **attr)
+        self._add_server_nodes(self._node_keys(nodes))
+        batch = _Batch()
+        for n in self._node_keys(nodes):
+            self._parse_node_attrs(self.node[n][self.myid], self.node[n], batch)
+        batch.flush(self.server)
         self.resume_layout()
 
     def remove_node(self,n, stop=True):
@@ -196,10 +502,12 @@ class Graph(nx.Graph, MyceliaServer):
                 self.resume_layout()
 
     def remove_nodes_from(self, nodes):
-        self.stop_layout()
-        for n in nodes:
-            self.remove_node(n, stop=False)
-        self.resume_layout()
+        myids = [self.node[n][self.myid] for n in nodes if n in self]
+        nx.Graph.remove_nodes_from(self, nodes)
+        if myids:
+            self.stop_layout()
+            self.server.delete_nodes(myids)
+            self.resume_layout()
 
     def add_edge(self, u, v, attr_dict=None, stop=True, **attr):
         if self.has_edge(u,v):
@@ -228,30 +536,59 @@ class Graph(nx.Graph, MyceliaServer):
 
 
     def add_edges_from(self, ebunch, attr_dict=None, stop=False, **attr):
+        ebunch = list(ebunch)
         self.stop_layout()
+        new = []
+        seen = set()
         for e in ebunch:
             u,v=e[0:2]
-            self.add_edge(u,v,attr_dict=attr_dict,**attr)
+            if not self.has_edge(u,v) and (u,v) not in seen:
+                new.append((u,v))
+                seen.add((u,v))
+                seen.add((v,u))
+        nx.Graph.add_edges_from(self, ebunch, attr_dict=attr_dict, **attr)
+
+        # bidirectional, both directions of every new edge in one call
+        self._add_server_nodes([n for e in new for n in e])
+        endpoints = []
+        for u,v in new:
+            myid_u = self.node[u][self.myid]
+            myid_v = self.node[v][self.myid]
+            endpoints.extend([myid_u, myid_v, myid_v, myid_u])
+        myids = self.server.add_edges(endpoints) if endpoints else []
+        for i, (u,v) in enumerate(new):
+            self.edge[u][v][self.myid] = (myids[2 * i], myids[2 * i + 1])
+
+        batch = _Batch()
+        for u,v in set((e[0], e[1]) for e in ebunch):
+            (myid1, myid2) = self.edge[u][v][self.myid]
+            self._parse_edge_attrs(myid1, self.edge[u][v], batch)
+            self._parse_edge_attrs(myid2, self.edge[u][v], batch)
+        batch.flush(self.server)
         self.resume_layout()
 
     def remove_edge(self, u, v, stop=True):
-        myid_u = self.node[u][self.myid]
-        myid_v = self.node[v][self.myid]
-        if myid_u is not None and myid_v is not None:
+        myids = self.edge[u][v].get(self.myid, None)
+        if myids is not None:
             nx.Graph.remove_edge(self,u,v)
             if stop:
                 self.stop_layout()
-            self.server.delete_edge(myid_u, myid_v)
-            self.server.delete_edge(myid_v, myid_u)
+            # bidirectional
+            self.server.delete_edges(list(myids))
             if stop:
                 self.resume_layout()
 
     def remove_edges_from(self, ebunch):
-        self.stop_layout()
+        myids = []
         for e in ebunch:
             u,v=e[0:2]
-            self.remove_edge(u,v, stop=False)
-        self.resume_layout()
+            if self.has_edge(u,v):
+                myids.extend(self.edge[u][v][self.myid])
+                nx.Graph.remove_edge(self,u,v)
+        if myids:
+            self.stop_layout()
+            self.server.delete_edges(myids)
+            self.resume_layout()
 
 
 class DiGraph(nx.DiGraph, MyceliaServer):
@@ -289,8 +626,13 @@ class DiGraph(nx.DiGraph, MyceliaServer):
         return myid
 
     def add_nodes_from(self, nodes, **attr):
-        for n in nodes:
-            self.add_node(n, **attr)
+        nodes = list(nodes)
+        nx.DiGraph.add_nodes_from(self, nodes, **attr)
+        self._add_server_nodes(self._node_keys(nodes))
+        batch = _Batch()
+        for n in self._node_keys(nodes):
+            self._parse_node_attrs(self.node[n][self.myid], self.node[n], batch)
+        batch.flush(self.server)
 
     def remove_node(self,n):
         myid = self.node[n].get(self.myid, None)
@@ -299,8 +641,10 @@ class DiGraph(nx.DiGraph, MyceliaServer):
             self.server.delete_node(myid)
 
     def remove_nodes_from(self, nodes):
-        for n in nodes:
-            self.remove_node(n)
+        myids = [self.node[n][self.myid] for n in nodes if n in self]
+        nx.DiGraph.remove_nodes_from(self, nodes)
+        if myids:
+            self.server.delete_nodes(myids)
 
     def add_edge(self, u, v, attr_dict=None, **attr):
         if self.has_edge(u,v):
@@ -321,20 +665,43 @@ class DiGraph(nx.DiGraph, MyceliaServer):
 
 
     def add_edges_from(self, ebunch, attr_dict=None, **attr):
+        ebunch = list(ebunch)
+        new = []
+        seen = set()
         for e in ebunch:
             u,v=e[0:2]
-            self.add_edge(u,v,attr_dict=attr_dict,**attr)
+            if not self.has_edge(u,v) and (u,v) not in seen:
+                new.append((u,v))
+                seen.add((u,v))
+        nx.DiGraph.add_edges_from(self, ebunch, attr_dict=attr_dict, **attr)
+
+        self._add_server_nodes([n for e in new for n in e])
+        endpoints = []
+        for u,v in new:
+            endpoints.extend([self.node[u][self.myid], self.node[v][self.myid]])
+        myids = self.server.add_edges(endpoints) if endpoints else []
+        for i, (u,v) in enumerate(new):
+            self.edge[u][v][self.myid] = myids[i]
+
+        batch = _Batch()
+        for u,v in set((e[0], e[1]) for e in ebunch):
+            self._parse_edge_attrs(self.edge[u][v][self.myid], self.edge[u][v], batch)
+        batch.flush(self.server)
 
     def remove_edge(self, u, v):
-        myid_u = self.node[u][self.myid]
-        myid_v = self.node[v][self.myid]
-        if myid_u is not None and myid_v is not None:
+        myid = self.edge[u][v].get(self.myid, None)
+        if myid is not None:
             nx.DiGraph.remove_edge(self,u,v)
-            self.server.delete_edge(myid_u, myid_v)
+            self.server.delete_edge(myid)
 
     def remove_edges_from(self, ebunch):
+        myids = []
         for e in ebunch:
             u,v=e[0:2]
-            self.remove_edge(u,v)
+            if self.has_edge(u,v):
+                myids.append(self.edge[u][v][self.myid])
+                nx.DiGraph.remove_edge(self,u,v)
+        if myids:
+            self.server.delete_edges(myids)
 
 
@@ -0,0 +1,86 @@
+import socket
+import struct
+
+# see src/streamserver.hpp
+MAGIC = 0x3143594d
+ADD_NODES = 1
+ADD_EDGES = 2
+SET_NODE_POSITIONS = 3
+SET_NODE_COLORS = 4
+SET_NODE_SIZES = 5
+SET_EDGE_COLORS = 6
+SET_EDGE_WEIGHTS = 7
+GET_NODE_POSITIONS = 8
+
+class StreamClient:
+    """
+    Client for the binary stream server, for transfers too large or too
+    frequent for XML-RPC, e.g. pushing every node position many times a
+    second. Ids are those returned by the server, as with XML-RPC.
+
+    """
+
+    def __init__(self, host='localhost', port=9877):
+        self.socket = socket.create_connection((host, port))
+        self.socket.setsockopt(socket.IPPROTO_TCP, socket.TCP_NODELAY, 1)
+        self.socket.sendall(struct.pack('=I', MAGIC))
+
+    def close(self):
+        self.socket.close()
+
+    def _read(self, size):
+        data = b''
+        while len(data) < size:
+            chunk = self.socket.recv(size - len(data))
+            if not chunk:
+                raise IOError('stream server closed the connection')
+            data += chunk
+        return data
+
+    def _call(self, kind, count, payload=b''):
+        self.socket.sendall(struct.pack('=II', kind, count) + payload)
+        return struct.unpack('=II', self._read(8))[1]
+
+    def _set(self, kind, myids, values, width):
+        myids = list(myids)
+        values = [float(x) for x in values]
+        if len(values) != width * len(myids):
+            raise ValueError('expected %d values per id' % width)
+        payload = struct.pack('=%di' % len(myids), *myids) + struct.pack('=%dd' % len(values), *values)
+        return self._call(kind, len(myids), payload)
+
+    def add_nodes(self, count):
+        """Returns the ids of count new nodes."""
+        self._call(ADD_NODES, count)
+        first = struct.unpack('=i', self._read(4))[0]
+        return range(first, first + count)
+
+    def add_edges(self, pairs):
+        """Returns an id per (source, target) pair, -1 for invalid ones."""
+        endpoints = [myid for pair in pairs for myid in pair[0:2]]
+        count = self._call(ADD_EDGES, len(endpoints) // 2, struct.pack('=%di' % len(endpoints), *endpoints))
+        return list(struct.unpack('=%di' % count, self._read(4 * count)))
+
+    def set_node_positions(self, myids, xyz):
+        """xyz is flat, three coordinates per id."""
+        return self._set(SET_NODE_POSITIONS, myids, xyz, 3)
+
+    def set_node_colors(self, myids, rgba):
+        """rgba is flat, four components in [0, 1] per id."""
+        return self._set(SET_NODE_COLORS, myids, rgba, 4)
+
+    def set_node_sizes(self, myids, sizes):
+        return self._set(SET_NODE_SIZES, myids, sizes, 1)
+
+    def set_edge_colors(self, myids, rgba):
+        return self._set(SET_EDGE_COLORS, myids, rgba, 4)
+
+    def set_edge_weights(self, myids, weights):
+        return self._set(SET_EDGE_WEIGHTS, myids, weights, 1)
+
+    def get_node_positions(self):
+        """Returns every node id and a flat list of their coordinates."""
+        count = self._call(GET_NODE_POSITIONS, 0)
+        myids = list(struct.unpack('=%di' % count, self._read(4 * count)))
+        xyz = list(struct.unpack('=%dd' % (3 * count), self._read(24 * count)))
+        return myids, xyz
@@ -1,15 +1,10 @@
-import warnings
-warnings.filterwarnings('ignore')
-
-import numpy
 import pylab
 
-data = numpy.loadtxt('/tmp/input.txt')
-
-pylab.figure(figsize=(6, 6))
-pylab.xlabel('Centrality')
-pylab.ylabel('Number of Nodes')
-pylab.title('Node Betweenness Centrality')
-pylab.hist(data, len(data))
+def plot(view, output):
+    pylab.figure(figsize=(6, 6))
+    pylab.xlabel('Centrality')
+    pylab.ylabel('Number of Nodes')
+    pylab.title('Node Betweenness Centrality')
+    pylab.hist(view.values, min(len(view.values), 100))
 
-pylab.savefig('/tmp/output.png')
+    pylab.savefig(output)
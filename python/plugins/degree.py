@@ -1,15 +1,10 @@
-import warnings
-warnings.filterwarnings('ignore')
-
-import numpy
 import pylab
 
-data = numpy.loadtxt('/tmp/input.txt')
-
-pylab.figure(figsize=(6, 6))
-pylab.xlabel('Degree')
-pylab.ylabel('Number of Nodes')
-pylab.title('Node Degree Distribution')
-pylab.hist(data, len(data))
+def plot(view, output):
+    pylab.figure(figsize=(6, 6))
+    pylab.xlabel('Degree')
+    pylab.ylabel('Number of Nodes')
+    pylab.title('Node Degree Distribution')
+    pylab.hist(view.degrees, max(view.degrees.max() - view.degrees.min(), 1))
 
-pylab.savefig('/tmp/output.png')
+    pylab.savefig(output)
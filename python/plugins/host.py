@@ -0,0 +1,82 @@
+"""
+Runs Mycelia's plot plugins in one long lived process. Mycelia writes a
+binary graph view, see src/pluginhost.hpp, and sends one line per request
+on stdin: the plugin script, the view and the output image, separated by
+tabs. Each is answered on stdout by 'ok' or an 'error: ...' line. Scripts
+define plot(view, output) and are loaded again only when they change.
+
+"""
+import os
+import sys
+import traceback
+import warnings
+warnings.filterwarnings('ignore')
+
+import numpy
+
+import matplotlib
+matplotlib.use('Agg')
+
+VIEW_MAGIC = 0x5657594d
+VIEW_VERSION = 1
+
+class GraphView(object):
+    """
+    The view as numpy arrays mapped from the file, by dense node index:
+    ids, degrees, offsets[nodes + 1] and targets of the out-arcs, and the
+    plugin's values, if any.
+
+    """
+    def __init__(self, path):
+        header = numpy.fromfile(path, dtype=numpy.int32, count=6)
+        if len(header) < 6 or header[0] != VIEW_MAGIC or header[1] != VIEW_VERSION:
+            raise ValueError('%s is not a plugin view' % path)
+        nodes, arcs, values = int(header[2]), int(header[3]), int(header[4])
+        self.offset = 24
+        self.path = path
+        self.ids = self._map(numpy.int32, nodes)
+        self.degrees = self._map(numpy.int32, nodes)
+        self.offsets = self._map(numpy.int32, nodes + 1)
+        self.targets = self._map(numpy.int32, arcs)
+        self.values = self._map(numpy.float64, values)
+
+    def _map(self, dtype, count):
+        if count == 0:
+            return numpy.zeros(0, dtype)
+        array = numpy.memmap(self.path, dtype=dtype, mode='r', offset=self.offset, shape=(count,))
+        size = count * numpy.dtype(dtype).itemsize
+        self.offset += (size + 7) & ~7
+        return array
+
+    def sources(self):
+        """Returns the source of every out-arc, to go with targets."""
+        return numpy.repeat(numpy.arange(len(self.ids), dtype=numpy.int32), numpy.diff(self.offsets))
+
+plugins = {} # path: (modification time, plot function)
+
+def load(path):
+    mtime = os.path.getmtime(path)
+    if path not in plugins or plugins[path][0] != mtime:
+        namespace = {'__file__': path, '__name__': 'mycelia_plugin'}
+        exec(compile(open(path).read(), path, 'exec'), namespace)
+        plugins[path] = (mtime, namespace['plot'])
+    return plugins[path][1]
+
+def main():
+    import pylab
+    while True:
+        line = sys.stdin.readline()
+        if not line:
+            break
+        try:
+            script, view, output = line.rstrip('\n').split('\t')
+            load(script)(GraphView(view), output)
+            pylab.close('all')
+            reply = 'ok'
+        except Exception:
+            reply = 'error: ' + traceback.format_exc().strip().splitlines()[-1]
+        sys.stdout.write(reply + '\n')
+        sys.stdout.flush()
+
+if __name__ == '__main__':
+    main()
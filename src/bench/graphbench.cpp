@@ -0,0 +1,328 @@
+/*
+ * Mycelia immersive 3d network visualization tool.
+ * Copyright (C) 2008-2010 Sean Whalen.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Headless benchmarks of the graph, parsers and layouts, without starting
+ * Vrui. Times parsing of the given files (by extension, as File > Open),
+ * then for synthetic graphs of 1k nodes up to the given maximum, in steps of
+ * ten: generation, edge list parsing, graph copies, snapshots and the node
+ * grid. Each graph is then laid out with FruchtermanReingoldLayout and
+ * ArfLayout steps and bundled by EdgeBundler iterations for as long as
+ * BENCH_SECONDS, at least once, up to the size limits below.
+ *
+ * Results go to stdout as one JSON object per line with the benchmark, the
+ * graph, its node and edge counts, a count of what was timed in the given
+ * unit, the seconds taken and their rate per second.
+ *
+ * Display lists and vertex buffers need a GL context and are not covered.
+ *
+ * usage: graphbench [max nodes] [graph files...]
+ */
+
+#include <graph.hpp>
+#include <mycelia.hpp>
+#include <generators/randomgraph.hpp>
+#include <layout/arflayout.hpp>
+#include <layout/edgebundler.hpp>
+#include <layout/frlayout.hpp>
+#include <parsers/chacoparser.hpp>
+#include <parsers/dotparser.hpp>
+#include <parsers/edgelistparser.hpp>
+#include <parsers/gmlparser.hpp>
+#include <parsers/xmlparser.hpp>
+#include <render/nodegrid.hpp>
+
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <limits>
+#include <new>
+#include <sys/stat.h>
+#include <sys/time.h>
+
+#define BENCH_SECONDS 1.0 // per layout measurement, after the first step
+#define BENCH_ARF_MAX_NODES 20000 // arf repulsion is all pairs
+#define BENCH_BUNDLE_MAX_EDGES 20000
+#define BENCH_EXACT_BUNDLE_MAX_EDGES 2000 // exact bundling is all pairs of edges
+#define BENCH_EDGE_LIST "/tmp/graphbench.edges"
+#define BENCH_SNAPSHOT "/tmp/graphbench" SNAPSHOT_EXTENSION
+
+using namespace std;
+
+/*
+ * The parts of Mycelia and Vrui the graph and layouts call back into. These
+ * stand in for mycelia.o, which is not linked, and for the Vrui kernel, which
+ * is never started.
+ */
+void Mycelia::clearSelections() {}
+int Mycelia::getPreviousNode() const { return -1; }
+const vector<int>* Mycelia::getSelectedComponent(Graph*) const { return 0; }
+int Mycelia::getSelectedNode() const { return -1; }
+void Mycelia::postEvent(const string&, int) const {}
+void Mycelia::resetNavigationCallback(Misc::CallbackData*) {}
+void Mycelia::setSkipLayout(bool) {}
+void Mycelia::stopLayout() const {}
+void Mycelia::wakeLayout() const {}
+
+static double now()
+{
+    timeval tv;
+    gettimeofday(&tv, 0);
+    return tv.tv_sec + tv.tv_usec * 1e-6;
+}
+
+namespace Vrui
+{
+void requestUpdate() {}
+double getApplicationTime() { return now(); }
+}
+
+class GraphBench
+{
+private:
+    Mycelia* application;
+    Graph* g;
+    string graphName;
+
+public:
+    GraphBench(Mycelia* application) : application(application), g(application->g) {}
+
+    void record(const char* bench, double count, const char* unit, double seconds) const
+    {
+        printf("{\"bench\": \"%s\", \"graph\": \"%s\", \"nodes\": %d, \"edges\": %d, "
+               "\"count\": %.0f, \"unit\": \"%s\", \"seconds\": %.6f, \"rate\": %.6g}\n",
+               bench, graphName.c_str(), g->getNodeCount(), g->getEdgeCount(),
+               count, unit, seconds, seconds > 0 ? count / seconds : 0.0);
+        fflush(stdout);
+    }
+
+    void parse(string filename)
+    {
+        size_t slash = filename.rfind('/');
+        graphName = slash == string::npos ? filename : filename.substr(slash + 1);
+        g->clear();
+
+        double start = now();
+
+        if(VruiHelp::endsWith(filename, ".dot"))
+        {
+            DotParser(application).parse(filename);
+        }
+        else if(VruiHelp::endsWith(filename, ".xml"))
+        {
+            XmlParser(application).parse(filename);
+        }
+        else if(VruiHelp::endsWith(filename, ".chaco"))
+        {
+            ChacoParser(application).parse(filename);
+        }
+        else if(VruiHelp::endsWith(filename, ".gml"))
+        {
+            GmlParser(application).parse(filename);
+        }
+        else if(VruiHelp::endsWith(filename, ".edges"))
+        {
+            EdgeListParser(application).parse(filename);
+        }
+        else
+        {
+            fprintf(stderr, "skipping %s\n", filename.c_str());
+            return;
+        }
+
+        record("parse", g->getEdgeCount(), "edges", now() - start);
+        layouts();
+    }
+
+    void synthetic(int nodeCount)
+    {
+        const char* models[] = {"erdos", "watts", "barabasi"};
+        char name[64];
+
+        // about two edges per node for every model, barabasi last and kept
+        for(int i = 0; i < 3; i++)
+        {
+            snprintf(name, sizeof(name), "%s-%d", models[i], nodeCount);
+            graphName = name;
+
+            double start = now();
+            RandomGraph(i).generate(g, models[i], nodeCount, i == 1 ? 4 : 2, 2.0 / nodeCount);
+            record("generate", g->getEdgeCount(), "edges", now() - start);
+        }
+
+        // an edge list of the same graph
+        FILE* file = fopen(BENCH_EDGE_LIST, "w");
+        foreach(int edge, g->getEdges())
+        {
+            const Edge& e = g->getEdge(edge);
+            fprintf(file, "%d %d\n", e.source, e.target);
+        }
+        fclose(file);
+
+        Graph* parsed = new Graph(application);
+        application->g = parsed;
+        double start = now();
+        string path = BENCH_EDGE_LIST;
+        EdgeListParser(application).parse(path);
+        double seconds = now() - start;
+        application->g = g;
+        delete parsed;
+        record("parse_edge_list", g->getEdgeCount(), "edges", seconds);
+        remove(BENCH_EDGE_LIST);
+
+        Graph copy(application);
+        start = now();
+        copy = *g;
+        record("copy", 1, "copies", now() - start);
+
+        start = now();
+        g->writeSnapshot(BENCH_SNAPSHOT);
+        seconds = now() - start;
+        struct stat info;
+        double bytes = stat(BENCH_SNAPSHOT, &info) == 0 ? info.st_size : 0;
+        record("snapshot_write", bytes, "bytes", seconds);
+
+        start = now();
+        g->readSnapshot(BENCH_SNAPSHOT);
+        record("snapshot_read", bytes, "bytes", now() - start);
+        remove(BENCH_SNAPSHOT);
+
+        NodeGrid grid;
+        start = now();
+        grid.update(g->getPositions());
+        record("node_grid", g->getNodeCount(), "nodes", now() - start);
+
+        layouts();
+    }
+
+    void layouts()
+    {
+        int nodeCount = g->getNodeCount();
+
+        if(nodeCount == 0)
+        {
+            return;
+        }
+
+        FruchtermanReingoldLayout fr(application);
+        fr.springForceConstant = FruchtermanReingoldLayout::getSpringForceConstant(nodeCount);
+        fr.remainingIterations = MAX_ITERATIONS;
+        int steps = 0;
+        double start = now();
+
+        for(; fr.remainingIterations > 0 && (steps == 0 || now() - start < BENCH_SECONDS); fr.remainingIterations--)
+        {
+            fr.layoutStep();
+            steps++;
+        }
+
+        record("fr_step", steps, "steps", now() - start);
+
+        if(nodeCount <= BENCH_ARF_MAX_NODES)
+        {
+            ArfLayout arf(application);
+            arf.asleep = false;
+            arf.stepTime = arf.deltaTime;
+            arf.lastEnergy = numeric_limits<double>::max();
+            arf.progress = 0;
+            arf.restSteps = 0;
+            steps = 0;
+            start = now();
+
+            while(steps == 0 || now() - start < BENCH_SECONDS)
+            {
+                arf.layoutStep();
+                steps++;
+            }
+
+            record("arf_step", steps, "steps", now() - start);
+        }
+
+        if(g->getEdgeCount() <= BENCH_BUNDLE_MAX_EDGES)
+        {
+            bundle(true);
+        }
+
+        if(g->getEdgeCount() <= BENCH_EXACT_BUNDLE_MAX_EDGES)
+        {
+            bundle(false);
+        }
+    }
+
+    // the first cycle of EdgeBundler::layout()
+    void bundle(bool accelerated)
+    {
+        EdgeBundler bundler(application);
+        bundler.setAcceleration(accelerated);
+
+        double start = now();
+        bundler.cycle = 0;
+        bundler.segments = SUBDIVISIONS_0;
+        bundler.stepsize = STEPSIZE_0;
+        bundler.iterations = ITERATIONS_0;
+        bundler.allocateSegments();
+
+        int workers = bundler.pool.getThreadCount();
+        bundler.compatibility.assign(workers, vector<float>(bundler.edges.size(), 0));
+        bundler.cells.assign(workers, vector<int>());
+
+        if(accelerated)
+        {
+            bundler.buildCompatibility();
+        }
+
+        record(accelerated ? "bundle_setup" : "bundle_exact_setup", 1, "setups", now() - start);
+
+        int iterations = 0;
+        start = now();
+
+        while(iterations < ITERATIONS_0 && (iterations == 0 || now() - start < BENCH_SECONDS))
+        {
+            bundler.layoutStep();
+            iterations++;
+        }
+
+        record(accelerated ? "bundle_iteration" : "bundle_exact_iteration", iterations, "iterations", now() - start);
+    }
+};
+
+int main(int argc, char** argv)
+{
+    int maxNodes = argc > 1 ? atoi(argv[1]) : 1000000;
+
+    // stdout is for results, progress messages of the parsers go to stderr
+    cout.rdbuf(cerr.rdbuf());
+
+    // only g is used, through the callbacks above
+    Mycelia* application = (Mycelia*)calloc(1, sizeof(Mycelia));
+    new(&application->stats) Stats();
+    application->g = new Graph(application);
+    GraphBench bench(application);
+
+    for(int i = 2; i < argc; i++)
+    {
+        bench.parse(argv[i]);
+    }
+
+    for(int nodeCount = 1000; nodeCount <= maxNodes; nodeCount *= 10)
+    {
+        bench.synthetic(nodeCount);
+    }
+
+    return 0;
+}
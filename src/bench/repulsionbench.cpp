@@ -0,0 +1,165 @@
+/*
+ * Mycelia immersive 3d network visualization tool.
+ * Copyright (C) 2008-2010 Sean Whalen.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Headless microbenchmark for the repulsion kernel. Compares the previous
+ * per-pair path (hash lookups, double math, pow per pair) against the scalar
+ * and vector kernels for the FR and ARF force laws.
+ *
+ * usage: repulsionbench [nodes] [repetitions]
+ */
+
+#include <layout/repulsion.hpp>
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <sys/time.h>
+#include <tr1/unordered_map>
+
+using namespace std;
+
+struct Point
+{
+    double c[3];
+};
+
+static double now()
+{
+    timeval tv;
+    gettimeofday(&tv, 0);
+    return tv.tv_sec + tv.tv_usec * 1e-6;
+}
+
+// the pre-kernel inner loop, one pair at a time through a hash map
+static void referencePath(tr1::unordered_map<int, Point>& nodes, int count, const RepulsionLaw& law, vector<double>& out)
+{
+    for(int i = 0; i < count; i++)
+    {
+        double f[3] = {0, 0, 0};
+
+        for(int j = 0; j < count; j++)
+        {
+            if(i == j) continue;
+
+            const Point& p = nodes[i];
+            const Point& q = nodes[j];
+            double v[3] = {p.c[0] - q.c[0], p.c[1] - q.c[1], p.c[2] - q.c[2]};
+            double d = sqrt(v[0] * v[0] + v[1] * v[1] + v[2] * v[2]);
+
+            if(d == 0) continue;
+
+            double phi = law.constant + law.inverse / d + law.inverseSquare / (d * d) + law.linear * d;
+            if(law.power != 0) phi += law.power * pow(d, (double)law.exponent);
+
+            for(int k = 0; k < 3; k++) f[k] += phi * v[k];
+        }
+
+        for(int k = 0; k < 3; k++) out[3 * i + k] = f[k];
+    }
+}
+
+static void run(const char* name, const RepulsionLaw& law, int count, int repetitions)
+{
+    vector<double> positions(3 * count);
+    vector<bool> included(count, true);
+    tr1::unordered_map<int, Point> nodes;
+
+    srand(1);
+    for(int i = 0; i < count; i++)
+    {
+        Point p;
+        for(int k = 0; k < 3; k++)
+        {
+            p.c[k] = positions[3 * i + k] = 100.0 * rand() / RAND_MAX - 50;
+        }
+        nodes[i] = p;
+    }
+
+    vector<double> reference(3 * count);
+    vector<float> fx(count), fy(count), fz(count);
+    vector<float> vx(count), vy(count), vz(count);
+    RepulsionKernel kernel;
+    kernel.setLaw(law);
+
+    double start = now();
+    for(int r = 0; r < repetitions; r++) referencePath(nodes, count, law, reference);
+    double referenceTime = (now() - start) / repetitions;
+
+    kernel.setVectorized(false);
+    start = now();
+    for(int r = 0; r < repetitions; r++)
+    {
+        kernel.setPoints(count, &positions[0], included, 0);
+        kernel.compute(0, count, 0, &fx[0], &fy[0], &fz[0]);
+    }
+    double scalarTime = (now() - start) / repetitions;
+
+    kernel.setVectorized(true);
+    start = now();
+    for(int r = 0; r < repetitions; r++)
+    {
+        kernel.setPoints(count, &positions[0], included, 0);
+        kernel.compute(0, count, 0, &vx[0], &vy[0], &vz[0]);
+    }
+    double vectorTime = (now() - start) / repetitions;
+
+    // error of both kernels relative to the largest reference force
+    double scale = 0, scalarError = 0, vectorError = 0;
+    for(int i = 0; i < count; i++)
+    {
+        float s[3] = {fx[i], fy[i], fz[i]};
+        float v[3] = {vx[i], vy[i], vz[i]};
+
+        for(int k = 0; k < 3; k++)
+        {
+            scale = max(scale, fabs(reference[3 * i + k]));
+            scalarError = max(scalarError, fabs(s[k] - reference[3 * i + k]));
+            vectorError = max(vectorError, fabs(v[k] - reference[3 * i + k]));
+        }
+    }
+
+    double pairs = (double)count * count;
+    printf("%-4s reference %8.3f ms  scalar %8.3f ms  %s %8.3f ms  (%.2f Gpairs/s)  error scalar %.1e vector %.1e\n",
+           name, referenceTime * 1e3, scalarTime * 1e3, kernel.isVectorized() ? "sse" : "n/a", vectorTime * 1e3,
+           pairs / vectorTime * 1e-9, scalarError / scale, vectorError / scale);
+}
+
+int main(int argc, char** argv)
+{
+    int count = argc > 1 ? atoi(argv[1]) : 4000;
+    int repetitions = argc > 2 ? atoi(argv[2]) : 3;
+
+    printf("%d nodes, %d repetitions\n", count, repetitions);
+
+    // fruchterman-reingold: k^2 (1/d - d^2/R) / d with k = 1, R = 10000
+    RepulsionLaw fr;
+    fr.inverseSquare = 1;
+    fr.linear = -1.0f / 10000;
+    run("fr", fr, count, repetitions);
+
+    // arf: unconnected spring plus r sqrt(n) / d^(1 + beta), beta = -0.45
+    RepulsionLaw arf;
+    arf.constant = -1;
+    arf.inverse = 1;
+    arf.power = 2 * sqrt((double)count);
+    arf.exponent = -0.55f;
+    run("arf", arf, count, repetitions);
+
+    return 0;
+}
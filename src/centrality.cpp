@@ -0,0 +1,397 @@
+/*
+ * Mycelia immersive 3d network visualization tool.
+ * Copyright (C) 2008-2010 Sean Whalen.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <centrality.hpp>
+#include <graph.hpp>
+#include <mycelia.hpp>
+
+#include <cmath>
+#include <cstdlib>
+#include <ctime>
+
+using namespace std;
+
+Centrality::Centrality(Mycelia* application)
+    : application(application), running(false), cancelled(false), applying(false), samples(CENTRALITY_EXACT),
+      finished(0), graphVersion(-1), resultBound(0), resultVersion(-1), resultSamples(0)
+{
+    thread = new Threads::Thread();
+}
+
+Centrality::~Centrality()
+{
+    stop();
+    delete thread;
+}
+
+bool Centrality::start(int newSamples, bool apply)
+{
+    mutex.lock();
+
+    if(running)
+    {
+        mutex.unlock();
+        return false;
+    }
+
+    running = true;
+    cancelled = false;
+    applying = apply;
+    samples = max(newSamples, 0);
+    finished = 0;
+    sources.clear();
+    mutex.unlock();
+
+    if(!thread->isJoined())
+    {
+        thread->join();
+    }
+
+    thread->start(this, &Centrality::compute);
+    return true;
+}
+
+void Centrality::stop()
+{
+    mutex.lock();
+    cancelled = true;
+    mutex.unlock();
+
+    if(!thread->isJoined())
+    {
+        thread->join();
+    }
+}
+
+bool Centrality::isRunning()
+{
+    mutex.lock();
+    bool result = running;
+    mutex.unlock();
+
+    return result;
+}
+
+double Centrality::getProgress()
+{
+    mutex.lock();
+    double result = sources.empty() ? 0 : finished / (double)sources.size();
+    mutex.unlock();
+
+    return result;
+}
+
+bool Centrality::setThreadCount(int threads)
+{
+    mutex.lock();
+    bool idle = !running;
+
+    if(idle)
+    {
+        pool.setThreadCount(threads);
+    }
+
+    mutex.unlock();
+    return idle;
+}
+
+int Centrality::getResult(vector<int>& nodeIds, vector<double>& values, double& bound, int& sampleCount)
+{
+    mutex.lock();
+    nodeIds = resultNodes;
+    values = resultValues;
+    bound = resultBound;
+    sampleCount = resultSamples;
+    int version = resultVersion;
+    mutex.unlock();
+
+    return version;
+}
+
+/*
+ * Copies the edge pairs into a symmetric CSR graph by dense index, which
+ * only matches the node ids while the graph is locked; a topology change
+ * between the copy and the lock, told by the topology version the copy
+ * returns, is retried.
+ */
+bool Centrality::takeSnapshot()
+{
+    Graph* g = application->g;
+
+    while(!cancelled)
+    {
+        // init() restarts topology versions, so a clear is told by the epoch
+        int epoch = g->getEpoch();
+        EdgePairs pairs;
+        int topologyVersion = g->getEdgePairs(pairs);
+
+        g->lock();
+
+        if(epoch != g->getEpoch() || topologyVersion != g->getTopologyVersion())
+        {
+            g->unlock();
+            continue;
+        }
+
+        nodes = g->getIndexNodes();
+        graphVersion = g->getVersion();
+        g->unlock();
+
+        int n = pairs.nodeCount;
+        int pairCount = (int)pairs.sources.size();
+
+        offsets.assign(n + 1, 0);
+
+        for(int i = 0; i < pairCount; i++)
+        {
+            offsets[pairs.sources[i] + 1]++;
+            offsets[pairs.targets[i] + 1]++;
+        }
+
+        for(int i = 0; i < n; i++)
+        {
+            offsets[i + 1] += offsets[i];
+        }
+
+        vector<int> slots(offsets.begin(), offsets.end() - 1);
+        targets.resize(2 * pairCount);
+
+        for(int i = 0; i < pairCount; i++)
+        {
+            targets[slots[pairs.sources[i]]++] = pairs.targets[i];
+            targets[slots[pairs.targets[i]]++] = pairs.sources[i];
+        }
+
+        return true;
+    }
+
+    return false;
+}
+
+void* Centrality::compute()
+{
+    if(takeSnapshot())
+    {
+        int n = (int)nodes.size();
+        int k = samples == CENTRALITY_EXACT ? n : min(samples, n);
+
+        // draw k distinct sources; every source is shuffled, so that the
+        // pool's equal ranges of sources cost about the same
+        vector<int> shuffled(n);
+        unsigned int seed = (unsigned int)time(0);
+
+        for(int i = 0; i < n; i++)
+        {
+            shuffled[i] = i;
+        }
+
+        for(int i = 0; i < k; i++)
+        {
+            swap(shuffled[i], shuffled[i + rand_r(&seed) % (n - i)]);
+        }
+
+        mutex.lock();
+        sources.assign(shuffled.begin(), shuffled.begin() + k);
+        mutex.unlock();
+
+        int workers = pool.getThreadCount();
+        partial.assign(workers, vector<double>());
+        sigma.resize(workers);
+        delta.resize(workers);
+        distance.resize(workers);
+        order.resize(workers);
+
+        pool.run(this, k);
+
+        if(!cancelled)
+        {
+            // every pair is reached from both ends, halve it as for undirected graphs
+            double scale = k > 0 ? 0.5 * n / k : 0;
+            vector<double> values(n, 0);
+
+            for(int w = 0; w < workers; w++)
+            {
+                for(int i = 0; i < (int)partial[w].size(); i++)
+                {
+                    values[i] += partial[w][i];
+                }
+            }
+
+            for(int i = 0; i < n; i++)
+            {
+                values[i] *= scale;
+            }
+
+            double bound = 0;
+
+            if(k < n)
+            {
+                bound = 0.5 * n * (n - 2) * sqrt(log(2 * n / (1 - CENTRALITY_CONFIDENCE)) / (2 * k));
+            }
+
+            mutex.lock();
+            resultNodes = nodes;
+            resultValues.swap(values);
+            resultBound = bound;
+            resultVersion = graphVersion;
+            resultSamples = k;
+            mutex.unlock();
+
+            if(applying)
+            {
+                applyResult();
+            }
+        }
+    }
+
+    // scratch arrays are as large as the graph, do not keep them
+    partial.clear();
+    sigma.clear();
+    delta.clear();
+    distance.clear();
+    order.clear();
+
+    mutex.lock();
+    running = false;
+    mutex.unlock();
+
+    Vrui::requestUpdate();
+    return 0;
+}
+
+void Centrality::run(int worker, int begin, int end)
+{
+    int n = (int)nodes.size();
+
+    partial[worker].assign(n, 0);
+    sigma[worker].assign(n, 0);
+    delta[worker].assign(n, 0);
+    distance[worker].assign(n, -1);
+    order[worker].reserve(n);
+
+    for(int i = begin; i < end && !cancelled; i++)
+    {
+        accumulate(worker, sources[i]);
+
+        mutex.lock();
+        finished++;
+        mutex.unlock();
+    }
+}
+
+/*
+ * One source of Brandes' algorithm: a breadth first search counting
+ * shortest paths, then dependencies accumulated in reverse order. Shortest
+ * path predecessors are the neighbors one hop closer, so none are stored.
+ */
+void Centrality::accumulate(int worker, int source)
+{
+    vector<double>& s = sigma[worker];
+    vector<double>& d = delta[worker];
+    vector<int>& dist = distance[worker];
+    vector<int>& visited = order[worker];
+    vector<double>& bc = partial[worker];
+
+    visited.clear();
+    visited.push_back(source);
+    dist[source] = 0;
+    s[source] = 1;
+
+    // visited doubles as the queue
+    for(int head = 0; head < (int)visited.size(); head++)
+    {
+        int v = visited[head];
+
+        for(int slot = offsets[v]; slot < offsets[v + 1]; slot++)
+        {
+            int w = targets[slot];
+
+            if(dist[w] < 0)
+            {
+                dist[w] = dist[v] + 1;
+                visited.push_back(w);
+            }
+
+            if(dist[w] == dist[v] + 1)
+            {
+                s[w] += s[v];
+            }
+        }
+    }
+
+    for(int i = (int)visited.size() - 1; i > 0; i--)
+    {
+        int w = visited[i];
+        double share = (1 + d[w]) / s[w];
+
+        for(int slot = offsets[w]; slot < offsets[w + 1]; slot++)
+        {
+            int v = targets[slot];
+
+            if(dist[v] == dist[w] - 1)
+            {
+                d[v] += s[v] * share;
+            }
+        }
+
+        bc[w] += d[w];
+    }
+
+    // reset only what this source touched
+    for(int i = 0; i < (int)visited.size(); i++)
+    {
+        int v = visited[i];
+        dist[v] = -1;
+        s[v] = 0;
+        d[v] = 0;
+    }
+}
+
+/*
+ * Sizes nodes from 1 up to CENTRALITY_MAX_SIZE and colors them from blue
+ * to red by their centrality over the largest. Colors are quantized, since
+ * every distinct color becomes a material.
+ */
+void Centrality::applyResult()
+{
+    double maxValue = 0;
+
+    for(int i = 0; i < (int)resultValues.size(); i++)
+    {
+        maxValue = max(maxValue, resultValues[i]);
+    }
+
+    vector<double> nodeSizes(resultValues.size());
+    vector<double> rgba(4 * resultValues.size());
+
+    for(int i = 0; i < (int)resultValues.size(); i++)
+    {
+        double t = maxValue > 0 ? resultValues[i] / maxValue : 0;
+        double step = floor(t * (CENTRALITY_COLOR_STEPS - 1) + 0.5) / (CENTRALITY_COLOR_STEPS - 1);
+
+        nodeSizes[i] = 1 + (CENTRALITY_MAX_SIZE - 1) * t;
+        rgba[4 * i] = step;
+        rgba[4 * i + 1] = 0;
+        rgba[4 * i + 2] = 1 - step;
+        rgba[4 * i + 3] = 1;
+    }
+
+    // nodes deleted since the snapshot are skipped by the setters
+    application->g->setNodeSizes(resultNodes, nodeSizes);
+    application->g->setNodeColors(resultNodes, rgba);
+}
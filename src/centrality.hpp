@@ -0,0 +1,105 @@
+/*
+ * Mycelia immersive 3d network visualization tool.
+ * Copyright (C) 2008-2010 Sean Whalen.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __CENTRALITY_HPP
+#define __CENTRALITY_HPP
+
+#include <layout/workerpool.hpp>
+
+#include <Threads/Mutex.h>
+#include <Threads/Thread.h>
+#include <vector>
+
+#define CENTRALITY_EXACT 0 // sample count that starts from every node
+#define CENTRALITY_SAMPLES 256 // sources the menu samples, see etc/mycelia.cfg
+#define CENTRALITY_CONFIDENCE 0.95 // of the sampled error bound
+#define CENTRALITY_MAX_SIZE 3.0 // node size of the most central node, the least keeps 1
+#define CENTRALITY_COLOR_STEPS 16 // distinct colors, each becomes a material
+
+class Mycelia;
+
+/*
+ * Node betweenness centrality with Brandes' algorithm, counting shortest
+ * paths by hops, on a background thread. The topology is copied when a run
+ * starts, so the graph stays unlocked while the sources are spread over a
+ * worker pool, each worker accumulating into its own array.
+ *
+ * With k samples, k distinct sources are drawn uniformly and their
+ * dependencies scaled by n / k. Every scaled term lies in [0, n(n - 2) / 2],
+ * so by Hoeffding's inequality and a union bound over the nodes all
+ * estimates are within n(n - 2) / 2 * sqrt(ln(2n / (1 - confidence)) / 2k)
+ * of the exact value with the given confidence.
+ */
+class Centrality : public WorkerTask
+{
+private:
+    Mycelia* application;
+    Threads::Thread* thread;
+    Threads::Mutex mutex; // guards the state and results below
+    WorkerPool pool;
+
+    bool running;
+    bool cancelled;
+    bool applying; // write sizes and colors to the graph when done
+    int samples;
+    int finished; // sources done in this run
+
+    // topology copied when the run started, by dense index
+    std::vector<int> nodes;
+    std::vector<int> offsets;
+    std::vector<int> targets;
+    std::vector<int> sources;
+    int graphVersion;
+
+    // per worker
+    std::vector<std::vector<double> > partial;
+    std::vector<std::vector<double> > sigma;
+    std::vector<std::vector<double> > delta;
+    std::vector<std::vector<int> > distance;
+    std::vector<std::vector<int> > order;
+
+    std::vector<int> resultNodes;
+    std::vector<double> resultValues;
+    double resultBound;
+    int resultVersion;
+    int resultSamples;
+
+    bool takeSnapshot();
+    void accumulate(int, int);
+    void applyResult();
+    void* compute();
+
+public:
+    Centrality(Mycelia*);
+    ~Centrality();
+
+    // false if a run is in progress; samples at or above the node count are exact
+    bool start(int samples=CENTRALITY_EXACT, bool apply=false);
+    void stop();
+    bool isRunning();
+    double getProgress(); // fraction of this run's sources done
+    bool setThreadCount(int); // false while a run is in progress
+
+    // the last finished run, by dense index of its snapshot; returns the
+    // graph version it was computed on, -1 before the first run
+    int getResult(std::vector<int>& nodes, std::vector<double>& values, double& bound, int& samples);
+
+    virtual void run(int, int, int);
+};
+
+#endif
@@ -0,0 +1,396 @@
+/*
+ * Mycelia immersive 3d network visualization tool.
+ * Copyright (C) 2008-2010 Sean Whalen.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <clustersync.hpp>
+#include <commandqueue.hpp>
+
+#include <Comm/MulticastPipe.h>
+
+#include <map>
+
+using namespace std;
+
+ClusterSync::ClusterSync(Comm::MulticastPipe* pipe, bool master)
+    : pipe(pipe),
+      master(master),
+      sentVersion(-1),
+      sentPositionVersion(-1),
+      origin(0, 0, 0),
+      step(0)
+{
+}
+
+/*
+ * Refits the quantization box to positions if they left it or now fill
+ * less than half of it. Returns true if the box changed, so every node has
+ * to be sent again.
+ */
+bool ClusterSync::fitBox(const vector<Vrui::Point>& positions)
+{
+    if(positions.empty())
+    {
+        return false;
+    }
+
+    Vrui::Point min = positions[0];
+    Vrui::Point max = positions[0];
+
+    for(int i = 1; i < (int)positions.size(); i++)
+    {
+        for(int j = 0; j < 3; j++)
+        {
+            if(positions[i][j] < min[j]) min[j] = positions[i][j];
+            if(positions[i][j] > max[j]) max[j] = positions[i][j];
+        }
+    }
+
+    double extent = 0;
+    bool inside = step > 0;
+
+    for(int j = 0; j < 3; j++)
+    {
+        extent = std::max(extent, (double)(max[j] - min[j]));
+        inside = inside && min[j] >= origin[j] && max[j] <= origin[j] + CLUSTER_LEVELS * step;
+    }
+
+    if(extent == 0)
+    {
+        extent = 1;
+    }
+
+    double side = extent * (1 + 2 * CLUSTER_MARGIN);
+
+    if(inside && CLUSTER_LEVELS * step <= 2 * side)
+    {
+        return false;
+    }
+
+    for(int j = 0; j < 3; j++)
+    {
+        origin[j] = min[j] - CLUSTER_MARGIN * extent;
+    }
+
+    step = side / CLUSTER_LEVELS;
+
+    return true;
+}
+
+void ClusterSync::quantize(const Vrui::Point& p, uint16_t* q) const
+{
+    for(int j = 0; j < 3; j++)
+    {
+        double level = (p[j] - origin[j]) / step + 0.5;
+        q[j] = level <= 0 ? 0 : level >= CLUSTER_LEVELS ? CLUSTER_LEVELS : (uint16_t)level;
+    }
+}
+
+/*
+ * Sends one record per node or edge the change log names: ids, flags, rgba,
+ * sizes or weights and labels, each as one array. Repeated changes to an
+ * element are merged, the record carries its current values.
+ */
+void ClusterSync::sendAttributes(Graph* graph, const vector<GraphChange>& changes)
+{
+    map<pair<bool, int>, int> records; // (edge, id) -> record
+    vector<int32_t> ids;
+    vector<uint32_t> kinds;
+
+    foreach(const GraphChange& change, changes)
+    {
+        if(change.edge ? !graph->isValidEdge(change.id) : !graph->isValidNode(change.id))
+        {
+            continue;
+        }
+
+        pair<map<pair<bool, int>, int>::iterator, bool> inserted =
+            records.insert(make_pair(make_pair(change.edge, change.id), (int)ids.size()));
+
+        if(inserted.second)
+        {
+            ids.push_back(change.id);
+            kinds.push_back(change.edge ? CLUSTER_RECORD_EDGE : 0);
+        }
+
+        kinds[inserted.first->second] |= change.flags;
+    }
+
+    uint32_t count = ids.size();
+    vector<float> rgba(4 * count);
+    vector<float> sizes(count);
+    vector<uint32_t> labelOffsets(count + 1, 0);
+    string labels;
+
+    for(uint32_t i = 0; i < count; i++)
+    {
+        bool edge = kinds[i] & CLUSTER_RECORD_EDGE;
+        const GLMaterial* material = edge ? graph->getEdgeMaterial(ids[i]) : graph->getNodeMaterial(ids[i]);
+
+        for(int j = 0; j < 4; j++)
+        {
+            rgba[4 * i + j] = material->ambient[j];
+        }
+
+        sizes[i] = edge ? graph->getEdgeWeight(ids[i]) : graph->getNodeSize(ids[i]);
+        labels += edge ? graph->getEdgeLabel(ids[i]) : graph->getNodeLabel(ids[i]);
+        labelOffsets[i + 1] = labels.size();
+    }
+
+    pipe->write<uint32_t>(count);
+
+    if(count > 0)
+    {
+        pipe->write<int32_t>(&ids[0], count);
+        pipe->write<uint32_t>(&kinds[0], count);
+        pipe->write<float>(&rgba[0], rgba.size());
+        pipe->write<float>(&sizes[0], count);
+        pipe->write<uint32_t>(&labelOffsets[0], count + 1);
+        if(!labels.empty()) pipe->write<char>(labels.data(), labels.size());
+    }
+}
+
+/*
+ * Sends the changes to graph since the last frame, an empty message if
+ * there are none, since slaves read one message every frame. Attribute
+ * records and positions can share a message, a snapshot has both.
+ */
+void ClusterSync::send(Graph* graph)
+{
+    uint32_t flags = 0;
+    vector<GraphChange> changes;
+
+    if(graph->getVersion() != sentVersion)
+    {
+        flags = graph->getChanges(sentVersion, changes) ? CLUSTER_ATTRIBUTES : CLUSTER_SNAPSHOT;
+    }
+
+    if(flags != CLUSTER_SNAPSHOT && graph->getPositionVersion() != sentPositionVersion)
+    {
+        flags |= CLUSTER_POSITIONS;
+    }
+
+    pipe->write<uint32_t>(flags);
+
+    if(flags & CLUSTER_ATTRIBUTES)
+    {
+        sendAttributes(graph, changes);
+    }
+
+    const vector<Vrui::Point>& positions = graph->getPositions();
+    uint32_t n = positions.size();
+
+    if(flags == CLUSTER_SNAPSHOT)
+    {
+        vector<char> data;
+        graph->writeSnapshot(data);
+
+        pipe->write<uint32_t>(data.size());
+        if(!data.empty()) pipe->write<char>(&data[0], data.size());
+
+        // slaves have exact positions now, later deltas start from these
+        fitBox(positions);
+        sent.resize(3 * n);
+
+        for(uint32_t i = 0; i < n; i++)
+        {
+            quantize(positions[i], &sent[3 * i]);
+        }
+    }
+
+    if(flags & CLUSTER_POSITIONS)
+    {
+        bool all = fitBox(positions) || sent.size() != 3 * n;
+        sent.resize(3 * n);
+
+        vector<uint32_t> indices;
+        vector<uint16_t> values;
+
+        for(uint32_t i = 0; i < n; i++)
+        {
+            uint16_t q[3];
+            quantize(positions[i], q);
+
+            if(all || q[0] != sent[3 * i] || q[1] != sent[3 * i + 1] || q[2] != sent[3 * i + 2])
+            {
+                indices.push_back(i);
+
+                for(int j = 0; j < 3; j++)
+                {
+                    values.push_back(q[j]);
+                    sent[3 * i + j] = q[j];
+                }
+            }
+        }
+
+        // indices are left out when every node changed
+        uint32_t count = indices.size();
+
+        for(int j = 0; j < 3; j++)
+        {
+            pipe->write<double>(origin[j]);
+        }
+
+        pipe->write<double>(step);
+        pipe->write<uint32_t>(n);
+        pipe->write<uint32_t>(count);
+
+        if(count > 0 && count < n) pipe->write<uint32_t>(&indices[0], count);
+        if(count > 0) pipe->write<uint16_t>(&values[0], values.size());
+    }
+
+    sentVersion = graph->getVersion();
+    sentPositionVersion = graph->getPositionVersion();
+
+    pipe->flush();
+}
+
+/*
+ * Applies the records sendAttributes wrote as one batch of commands, so
+ * they are logged as single element changes again and the render copy
+ * patches instead of rebuilding. Labels are set only when they differ.
+ */
+void ClusterSync::receiveAttributes(Graph* graph)
+{
+    uint32_t count = pipe->read<uint32_t>();
+
+    if(count == 0)
+    {
+        return;
+    }
+
+    vector<int32_t> ids(count);
+    vector<uint32_t> kinds(count);
+    vector<float> rgba(4 * count);
+    vector<float> sizes(count);
+    vector<uint32_t> labelOffsets(count + 1);
+
+    pipe->read<int32_t>(&ids[0], count);
+    pipe->read<uint32_t>(&kinds[0], count);
+    pipe->read<float>(&rgba[0], rgba.size());
+    pipe->read<float>(&sizes[0], count);
+    pipe->read<uint32_t>(&labelOffsets[0], count + 1);
+
+    string labels(labelOffsets[count], '\0');
+    if(!labels.empty()) pipe->read<char>(&labels[0], labels.size());
+
+    vector<GraphCommand*> batch;
+
+    for(uint32_t i = 0; i < count; i++)
+    {
+        bool edge = kinds[i] & CLUSTER_RECORD_EDGE;
+        string label = labelOffsets[i] <= labelOffsets[i + 1] && labelOffsets[i + 1] <= labels.size()
+            ? labels.substr(labelOffsets[i], labelOffsets[i + 1] - labelOffsets[i]) : string();
+
+        if(kinds[i] & CHANGE_MATERIAL)
+        {
+            GraphCommand* command = new GraphCommand(edge ? COMMAND_EDGE_COLOR : COMMAND_NODE_COLOR, ids[i]);
+            for(int j = 0; j < 4; j++) command->values[j] = rgba[4 * i + j];
+            batch.push_back(command);
+        }
+
+        if(kinds[i] & CHANGE_GEOMETRY)
+        {
+            GraphCommand* command = new GraphCommand(edge ? COMMAND_EDGE_WEIGHT : COMMAND_NODE_SIZE, ids[i]);
+            command->values[0] = sizes[i];
+            batch.push_back(command);
+        }
+
+        bool valid = edge ? graph->isValidEdge(ids[i]) : graph->isValidNode(ids[i]);
+
+        if(valid && label != (edge ? graph->getEdgeLabel(ids[i]) : graph->getNodeLabel(ids[i])))
+        {
+            GraphCommand* command = new GraphCommand(edge ? COMMAND_EDGE_LABEL : COMMAND_NODE_LABEL, ids[i]);
+            command->text = label;
+            batch.push_back(command);
+        }
+    }
+
+    graph->apply(batch);
+
+    foreach(GraphCommand* command, batch)
+    {
+        delete command;
+    }
+}
+
+/*
+ * Applies the master's message for this frame to graph. Positions for
+ * another node count, which only a lost snapshot could cause, are read
+ * and dropped.
+ */
+void ClusterSync::receive(Graph* graph)
+{
+    uint32_t flags = pipe->read<uint32_t>();
+
+    if(flags == CLUSTER_SNAPSHOT)
+    {
+        uint32_t size = pipe->read<uint32_t>();
+        vector<char> data(size);
+        if(size > 0) pipe->read<char>(&data[0], size);
+
+        graph->readSnapshot(data);
+    }
+
+    if(flags & CLUSTER_ATTRIBUTES)
+    {
+        receiveAttributes(graph);
+    }
+
+    if(flags & CLUSTER_POSITIONS)
+    {
+        for(int j = 0; j < 3; j++)
+        {
+            origin[j] = pipe->read<double>();
+        }
+
+        step = pipe->read<double>();
+        uint32_t n = pipe->read<uint32_t>();
+        uint32_t count = pipe->read<uint32_t>();
+
+        vector<uint32_t> indices;
+        vector<uint16_t> values(3 * count);
+
+        if(count > 0 && count < n)
+        {
+            indices.resize(count);
+            pipe->read<uint32_t>(&indices[0], count);
+        }
+
+        if(count > 0) pipe->read<uint16_t>(&values[0], values.size());
+
+        vector<Vrui::Point> positions = graph->getPositions();
+
+        if(positions.size() != n || count == 0)
+        {
+            return;
+        }
+
+        for(uint32_t k = 0; k < count; k++)
+        {
+            uint32_t i = indices.empty() ? k : indices[k];
+
+            if(i >= n) continue;
+
+            for(int j = 0; j < 3; j++)
+            {
+                positions[i][j] = origin[j] + values[3 * k + j] * step;
+            }
+        }
+
+        graph->setNodePositions(positions);
+    }
+}
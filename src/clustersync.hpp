@@ -0,0 +1,79 @@
+/*
+ * Mycelia immersive 3d network visualization tool.
+ * Copyright (C) 2008-2010 Sean Whalen.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __CLUSTERSYNC_HPP
+#define __CLUSTERSYNC_HPP
+
+#include <graph.hpp>
+
+#include <stdint.h>
+#include <vector>
+
+#define CLUSTER_SNAPSHOT 1 // message flags: whole graph follows
+#define CLUSTER_POSITIONS 2 // changed quantized positions follow
+#define CLUSTER_ATTRIBUTES 4 // changed node and edge attributes follow
+#define CLUSTER_RECORD_EDGE 4 // attribute record flag next to the CHANGE_* bits
+#define CLUSTER_LEVELS 65535 // quantization steps along the box's side
+#define CLUSTER_MARGIN 0.25 // box grows past the positions by this fraction of their extent
+
+namespace Comm
+{
+class MulticastPipe;
+}
+
+/*
+ * Keeps the render nodes of a Vrui cluster on the master's graph. Only the
+ * master lays out and serves RPC; once per frame it sends what changed in
+ * its render copy. Edits the change log describes, such as a recolor or a
+ * hover, go out as one record per changed node or edge: its color, size or
+ * weight, and label. Anything else, topology edits and batch setters, goes
+ * out as one snapshot. Position-only changes are sent as 16 bit
+ * coordinates in a cube around the graph, for just the nodes whose
+ * coordinates changed.
+ * The cube is re-sent, with every node, only once positions leave it or
+ * shrink well inside it. In every frame the master calls send(), after
+ * updating its render copy, and each slave receive(), before updating its
+ * own from the graph it received into.
+ */
+class ClusterSync
+{
+private:
+    Comm::MulticastPipe* pipe;
+    bool master;
+
+    // master: the state slaves were last sent
+    int sentVersion;
+    int sentPositionVersion;
+    Vrui::Point origin;
+    double step; // box side over CLUSTER_LEVELS
+    std::vector<uint16_t> sent; // xyz per dense index
+
+    bool fitBox(const std::vector<Vrui::Point>&);
+    void quantize(const Vrui::Point&, uint16_t*) const;
+    void sendAttributes(Graph*, const std::vector<GraphChange>&);
+    void receiveAttributes(Graph*);
+
+public:
+    ClusterSync(Comm::MulticastPipe*, bool);
+
+    bool isMaster() const { return master; }
+    void send(Graph*);
+    void receive(Graph*);
+};
+
+#endif
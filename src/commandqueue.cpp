@@ -0,0 +1,156 @@
+/*
+ * Mycelia immersive 3d network visualization tool.
+ * Copyright (C) 2008-2010 Sean Whalen.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <commandqueue.hpp>
+
+using namespace std;
+
+GraphCommand::GraphCommand(int kind, int id) : next(0), kind(kind), id(id), epoch(-1)
+{
+    values[0] = values[1] = values[2] = values[3] = 0;
+}
+
+// caller holds the graph's mutex, see Graph::apply
+bool GraphCommand::apply(Graph* g)
+{
+    switch(kind)
+    {
+    case COMMAND_EDGE_COLOR:
+        return g->assignEdgeColor(id, GLMaterial::Color(values[0], values[1], values[2], values[3]));
+    case COMMAND_EDGE_LABEL:
+        return g->assignEdgeLabel(id, text);
+    case COMMAND_EDGE_WEIGHT:
+        return g->assignEdgeWeight(id, values[0]);
+    case COMMAND_NODE_ATTRIBUTE:
+        return g->assignNodeAttribute(id, key, text);
+    case COMMAND_NODE_COLOR:
+        return g->assignNodeColor(id, GLMaterial::Color(values[0], values[1], values[2], values[3]));
+    case COMMAND_NODE_IMAGE_PATH:
+        return g->assignNodeImagePath(id, text);
+    case COMMAND_NODE_IMAGE_SCALE:
+        return g->assignNodeImageScale(id, values[0]);
+    case COMMAND_NODE_LABEL:
+        return g->assignNodeLabel(id, text);
+    case COMMAND_NODE_SIZE:
+        return g->assignNodeSize(id, values[0]);
+    case COMMAND_NODE_TYPE:
+        return g->assignNodeType(id, text);
+    case COMMAND_TEXTURE_NODE_MODE:
+        g->assignTextureNodeMode(text);
+        return true;
+    }
+
+    return false;
+}
+
+CommandQueue::CommandQueue() : head(&stub), tail(&stub)
+{
+}
+
+CommandQueue::~CommandQueue()
+{
+    GraphCommand* command;
+    while((command = pop()) != 0)
+    {
+        delete command;
+    }
+}
+
+// safe from any thread
+void CommandQueue::push(GraphCommand* command)
+{
+    command->next = 0;
+
+    // publish the command's contents before linking it
+    __sync_synchronize();
+    GraphCommand* previous = __sync_lock_test_and_set(&head, command);
+    previous->next = command;
+}
+
+// consumer only, under consumerMutex; 0 if empty or if a push is halfway through
+GraphCommand* CommandQueue::pop()
+{
+    GraphCommand* first = tail;
+    GraphCommand* next = first->next;
+
+    if(first == &stub)
+    {
+        if(next == 0)
+        {
+            return 0;
+        }
+
+        tail = next;
+        first = next;
+        next = next->next;
+    }
+
+    if(next != 0)
+    {
+        tail = next;
+        __sync_synchronize();
+        return first;
+    }
+
+    if(first != head)
+    {
+        return 0;
+    }
+
+    // first is the last command; put the stub behind it to unlink it
+    push(&stub);
+    next = first->next;
+
+    if(next != 0)
+    {
+        tail = next;
+        __sync_synchronize();
+        return first;
+    }
+
+    return 0;
+}
+
+/*
+ * Applies and deletes every command pushed so far, in order and under one
+ * graph lock. Safe from any thread, consumers take turns. Returns the
+ * number applied.
+ */
+int CommandQueue::apply(Graph* g)
+{
+    vector<GraphCommand*> batch;
+    GraphCommand* command;
+
+    consumerMutex.lock();
+
+    while((command = pop()) != 0)
+    {
+        batch.push_back(command);
+    }
+
+    int count = g->apply(batch);
+
+    consumerMutex.unlock();
+
+    foreach(GraphCommand* applied, batch)
+    {
+        delete applied;
+    }
+
+    return count;
+}
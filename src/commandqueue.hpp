@@ -0,0 +1,87 @@
+/*
+ * Mycelia immersive 3d network visualization tool.
+ * Copyright (C) 2008-2010 Sean Whalen.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __COMMANDQUEUE_HPP
+#define __COMMANDQUEUE_HPP
+
+#include <graph.hpp>
+
+#include <string>
+
+#define COMMAND_NONE 0
+#define COMMAND_EDGE_COLOR 1
+#define COMMAND_EDGE_LABEL 2
+#define COMMAND_EDGE_WEIGHT 3
+#define COMMAND_NODE_ATTRIBUTE 4
+#define COMMAND_NODE_COLOR 5
+#define COMMAND_NODE_IMAGE_PATH 6
+#define COMMAND_NODE_IMAGE_SCALE 7
+#define COMMAND_NODE_LABEL 8
+#define COMMAND_NODE_SIZE 9
+#define COMMAND_NODE_TYPE 10
+#define COMMAND_TEXTURE_NODE_MODE 11
+
+/*
+ * A single element setter call, recorded by an RPC thread to be applied
+ * later. Commands for elements deleted in between are dropped, as are
+ * commands posted before the graph was cleared or reloaded, whose ids may
+ * have been reused since.
+ */
+class GraphCommand
+{
+public:
+    GraphCommand* volatile next; // owned by the queue
+
+    int kind;
+    int id; // node or edge
+    int epoch; // Graph::getEpoch() when posted, -1 applies to any
+    double values[4];
+    std::string text;
+    std::string key; // of an attribute, whose value is text
+
+    GraphCommand(int kind = COMMAND_NONE, int id = -1);
+
+    bool apply(Graph*);
+};
+
+/*
+ * Lock-free queue of graph commands from any number of RPC threads to the
+ * thread applying them, after Vyukov's intrusive MPSC queue: pushing is
+ * one atomic exchange, and only the consumer follows the links. Any thread
+ * may apply, one at a time; an RPC doing more than set a single element
+ * applies the queue first, so clients see their calls in the order sent.
+ */
+class CommandQueue
+{
+private:
+    GraphCommand stub;
+    GraphCommand* volatile head; // last pushed
+    GraphCommand* tail; // next to pop, consumer only
+    Threads::Mutex consumerMutex; // held by the one consumer
+
+    GraphCommand* pop();
+
+public:
+    CommandQueue();
+    ~CommandQueue();
+
+    void push(GraphCommand*); // takes ownership
+    int apply(Graph*);
+};
+
+#endif
@@ -20,10 +20,27 @@
 #define __DATAITEM_HPP
 
 #include <mycelia.hpp>
+#include <render/instancedrenderer.hpp>
+#include <render/labelrenderer.hpp>
+#include <render/texturecache.hpp>
 
-#include <map>
 #include <vector>
 
+/*
+ * Where one node grid cell's instances start in each buffer; they run up to
+ * the next cell's starts. Edge pairs go with the cell of their source node.
+ */
+class InstanceCell
+{
+public:
+    int nodes[RENDER_MESH_LEVELS];
+    int segments[RENDER_MESH_LEVELS];
+    int points;
+    int lines;
+    GridBox nodeBounds;
+    GridBox edgeBounds;
+};
+
 class MyceliaDataItem : public GLObject::DataItem
 {
 public:
@@ -33,21 +50,47 @@ public:
     GLMaterial* selectedMaterial;*/
     GLUquadric* quadric;
     GLuint arrowList;
+    GLuint arrowLowList;
     GLuint graphList;
     GLuint nodeList;
+    GLuint nodeLowList;
 
-    // cached images
-    std::map<std::string, size_t> textureIndexMap;
-    std::map<std::string, std::pair<int, int> > textureSizeMap;
-    std::vector<GLuint> textureIds;
-
-    typedef std::pair<int,int> SizePair;
-    typedef std::pair< GLuint, SizePair > TexturePair;
+    // image node textures, streamed in by a worker
+    TextureCache* textures;
 
     int graphListVersion;
+    int graphListPositionVersion;
+    int graphListBundleVersion; // edge bundler points the list was built from
+
+    // viewer position in navigation coordinates the detail levels were chosen for
+    Vrui::Point detailViewer;
+
+    // instanced drawing, null without the required extensions
+    InstancedRenderer* renderer;
+    int instanceVersion;
+    int instancePositionVersion;
+
+    // instances as uploaded, so single changes can be patched in place; levels
+    // and slots are by dense node index and by edge pair, -1 when not instanced
+    std::vector<InstancedRenderer::NodeInstance> nodeInstances[RENDER_MESH_LEVELS];
+    std::vector<InstancedRenderer::SegmentInstance> segmentInstances[RENDER_MESH_LEVELS];
+    std::vector<InstancedRenderer::PointVertex> pointVertices;
+    std::vector<InstancedRenderer::PointVertex> lineVertices;
+    std::vector<int> nodeLevels;
+    std::vector<int> nodeSlots;
+    std::vector<int> pairLevels;
+    std::vector<int> pairSlots;
+    std::tr1::unordered_map<int, int> pairEdges; // drawn edge id -> pair
+
+    // instances in node grid cell order, with one trailing cell holding the
+    // totals; nodeCells is by dense node index
+    std::vector<InstanceCell> instanceCells;
+    std::vector<int> nodeCells;
+    InstancedRenderer::Ranges visibleRanges;
 
     // fonts
     FTFont* font;
+    LabelRenderer* labels;
 
     MyceliaDataItem()
     {
@@ -57,13 +100,22 @@ public:
         selectedMaterial = new GLMaterial(GLMaterial::Color(1.0, 0.0, 1.0));*/
         quadric = gluNewQuadric();
         arrowList = glGenLists(1);
+        arrowLowList = glGenLists(1);
         graphList = glGenLists(1);
         nodeList = glGenLists(1);
-
-        textureIds.resize(1000); // reserve 1000 textures
-        glGenTextures(1000, &textureIds[0]);
+        nodeLowList = glGenLists(1);
 
         graphListVersion = 0;
+        graphListPositionVersion = 0;
+        graphListBundleVersion = -1;
+        detailViewer = Vrui::Point::origin;
+
+        renderer = 0;
+        instanceVersion = 0;
+        instancePositionVersion = 0;
+
+        labels = 0;
+        textures = 0;
     }
 
     ~MyceliaDataItem()
@@ -74,66 +126,13 @@ public:
         delete selectedMaterial;*/
         gluDeleteQuadric(quadric);
         glDeleteLists(arrowList, 1);
+        glDeleteLists(arrowLowList, 1);
         glDeleteLists(graphList, 1);
         glDeleteLists(nodeList, 1);
-        glDeleteTextures(textureIds.size(), &textureIds[0]);
-    }
-
-    TexturePair getTextureId(std::string imagePath)
-    {
-        if (imagePath == "")
-        {
-            return TexturePair(0, SizePair(0,0) );
-        }
-
-        // Search for the path in the cache.
-        std::map<std::string, size_t>::iterator it;
-        it = textureIndexMap.find(imagePath);
-
-        if ( it != textureIndexMap.end() )
-        {
-            // Exists.
-            return TexturePair( textureIds[it->second], textureSizeMap[imagePath] );
-        }
-
-        // open a new image file
-        //
-        Images::RGBAImage image;
-        try
-        {
-            image = Images::readTransparentImageFile(imagePath.c_str());
-        }
-        catch (...)
-        {
-            std::cerr << "Failed to load image: " << imagePath << std::endl;
-            return TexturePair(0, SizePair(0,0));
-        }
-        SizePair size(image.getWidth(), image.getHeight());
-
-        // grab a pregenerated texture id or generate a new one
-        //
-        unsigned int numCachedTextures = textureIndexMap.size();
-        unsigned int imageIdIndex;
-        if ( numCachedTextures < textureIds.size() )
-        {
-        }
-        else
-        {
-            // make room for another texture id
-            textureIds.push_back(0);
-            glGenTextures(1, &(textureIds[0]) + numCachedTextures);
-        }
-        imageIdIndex = numCachedTextures;
-        textureIndexMap[imagePath] = imageIdIndex;
-        textureSizeMap[imagePath] = size;
-        GLuint imageId = textureIds[imageIdIndex];
-
-        // finally, load the image onto the graphics pipeline
-        glBindTexture(GL_TEXTURE_2D, imageId);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-        image.glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA);
-        return TexturePair( imageId, size );
+        glDeleteLists(nodeLowList, 1);
+        delete renderer;
+        delete labels;
+        delete textures;
     }
 };
 
@@ -17,6 +17,9 @@
  */
 
 #include <generators/barabasigenerator.hpp>
+#include <generators/randomgraph.hpp>
+
+using namespace std;
 
 BarabasiGenerator::BarabasiGenerator(Mycelia* application)
     : GraphGenerator(application)
@@ -27,41 +30,22 @@ BarabasiGenerator::BarabasiGenerator(Mycelia* application)
 void BarabasiGenerator::generate() const
 {
     generateNodes(INITIAL_N);
-    generateEdges(INITIAL_M0, INITIAL_N);
+    generateEdges(INITIAL_M0, INITIAL_M, INITIAL_N);
     parameterWindow->show();
 }
 
 void BarabasiGenerator::generateNodes(int nodeCount) const
 {
     application->g->clear();
-    
-    for(int i = 0; i < nodeCount; i++)
-    {
-        application->g->addNode();
-    }
+    application->g->reserve(nodeCount, 0);
+    application->g->addNodes(nodeCount);
 }
 
-void BarabasiGenerator::generateEdges(int initialNodeCount, int maxNodeCount) const
+void BarabasiGenerator::generateEdges(int initialNodeCount, int edgesPerNode, int maxNodeCount) const
 {
     application->g->clearEdges();
     
-    for(int i = 0; i < initialNodeCount; i++)
-    {
-        application->g->addEdge(i, (i + 1) % initialNodeCount);
-    }
-    
-    for(int sourceNode = initialNodeCount; sourceNode < maxNodeCount; sourceNode++)
-    {
-        for(int candidateNode = 0; candidateNode < maxNodeCount; candidateNode++)
-        {
-            if(sourceNode == candidateNode) continue;
-            
-            float p_i = (float)application->g->getNodeDegree(candidateNode) / application->g->getEdgeCount();
-            
-            if(VruiHelp::randomFloat() < p_i)
-            {
-                application->g->addEdge(sourceNode, candidateNode);
-            }
-        }
-    }
-}
\ No newline at end of file
+    vector<int> endpoints;
+    RandomGraph(rand()).barabasi(maxNodeCount, initialNodeCount, edgesPerNode, endpoints);
+    addIndexEdges(endpoints);
+}
@@ -25,6 +25,7 @@
 #include <generators/graphgenerator.hpp>
 
 #define INITIAL_M0 5
+#define INITIAL_M 2
 #define INITIAL_N 20
 
 class BarabasiGenerator : public GraphGenerator
@@ -33,9 +34,11 @@ class BarabasiGenerator : public GraphGenerator
     {
     private:
         GLMotif::Slider* initialNodesSlider;
+        GLMotif::Slider* edgesPerNodeSlider;
         GLMotif::Slider* maximumNodesSlider;
         
         GLMotif::TextField* initialNodesField;
+        GLMotif::TextField* edgesPerNodeField;
         GLMotif::TextField* maximumNodesField;
         
         BarabasiGenerator* generator;
@@ -53,6 +56,11 @@ class BarabasiGenerator : public GraphGenerator
             initialNodesSlider = p.second;
             initialNodesSlider->getValueChangedCallbacks().add(this, &BarabasiGenerator::BarabasiWindow::sliderCallback);
             
+            p = VruiHelp::createParameter("Edges Per Node", 1, 20, INITIAL_M, dialog);
+            edgesPerNodeField = p.first;
+            edgesPerNodeSlider = p.second;
+            edgesPerNodeSlider->getValueChangedCallbacks().add(this, &BarabasiGenerator::BarabasiWindow::sliderCallback);
+            
             p = VruiHelp::createParameter("Maximum Nodes", 20, 50, INITIAL_N, dialog);
             maximumNodesField = p.first;
             maximumNodesSlider = p.second;
@@ -64,13 +72,15 @@ class BarabasiGenerator : public GraphGenerator
         void sliderCallback(GLMotif::Slider::ValueChangedCallbackData* cbData)
         {
             int initialNodeCount = initialNodesSlider->getValue();
+            int edgesPerNode = edgesPerNodeSlider->getValue();
             int maximumNodeCount = maximumNodesSlider->getValue();
             application->stopLayout();
             
             initialNodesField->setValue(initialNodeCount);
+            edgesPerNodeField->setValue(edgesPerNode);
             maximumNodesField->setValue(maximumNodeCount);
             generator->generateNodes(maximumNodeCount);
-            generator->generateEdges(initialNodeCount, maximumNodeCount);
+            generator->generateEdges(initialNodeCount, edgesPerNode, maximumNodeCount);
             
             application->resumeLayout();
         }
@@ -82,7 +92,7 @@ public:
     void hide() const;
     void generate() const;
     void generateNodes(int) const;
-    void generateEdges(int, int) const;
+    void generateEdges(int, int, int) const;
 };
 
 #endif
\ No newline at end of file
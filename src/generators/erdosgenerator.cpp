@@ -17,6 +17,7 @@
  */
 
 #include <generators/erdosgenerator.hpp>
+#include <generators/randomgraph.hpp>
 
 using namespace std;
 
@@ -36,27 +37,15 @@ void ErdosGenerator::generate() const
 void ErdosGenerator::generateNodes(int nodeCount) const
 {
     application->g->clear();
-    
-    for(int i = 0; i < nodeCount; i++)
-    {
-        application->g->addNode();
-    }
+    application->g->reserve(nodeCount, 0);
+    application->g->addNodes(nodeCount);
 }
 
 void ErdosGenerator::generateEdges(float p) const
 {
     application->g->clearEdges();
     
-    foreach(int sourceNode, application->g->getNodes())
-    {
-        foreach(int candidateNode, application->g->getNodes())
-        {
-            if(sourceNode == candidateNode) continue;
-            
-            if(VruiHelp::randomFloat() < p)
-            {
-                application->g->addEdge(sourceNode, candidateNode);
-            }
-        }
-    }
-}
\ No newline at end of file
+    vector<int> endpoints;
+    RandomGraph(rand()).erdos(application->g->getNodeCount(), p, endpoints);
+    addIndexEdges(endpoints);
+}
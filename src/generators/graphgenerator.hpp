@@ -19,6 +19,7 @@
 #ifndef __GRAPHGENERATOR_HPP
 #define __GRAPHGENERATOR_HPP
 
+#include <graph.hpp>
 #include <mycelia.hpp>
 #include <windows/window.hpp>
 
@@ -28,6 +29,21 @@ protected:
     Mycelia* application;
     Window* parameterWindow;
     
+    // adds edges given as pairs of dense node indices
+    void addIndexEdges(std::vector<int>& endpoints) const
+    {
+        const std::vector<int>& indexNodes = application->g->getIndexNodes();
+        
+        for(size_t i = 0; i < endpoints.size(); i++)
+        {
+            endpoints[i] = indexNodes[endpoints[i]];
+        }
+        
+        std::vector<int> edges;
+        application->g->reserve(0, endpoints.size() / 2);
+        application->g->addEdges(endpoints, edges);
+    }
+    
 public:
     GraphGenerator(Mycelia* application) : application(application) { parameterWindow = NULL; }
     
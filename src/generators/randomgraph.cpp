@@ -0,0 +1,238 @@
+/*
+ * Mycelia immersive 3d network visualization tool.
+ * Copyright (C) 2008-2010 Sean Whalen.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <generators/randomgraph.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <tr1/unordered_set>
+
+using namespace std;
+
+RandomGraph::RandomGraph(uint64_t seed)
+    : seed(seed),
+      nodeCount(0),
+      probability(0)
+{
+}
+
+void RandomGraph::run(int worker, int begin, int end)
+{
+    int n = nodeCount;
+    double logq = log(1 - probability);
+
+    for(int block = begin; block < end; block++)
+    {
+        RandomStream random(seed, block);
+        int first = block * RANDOMGRAPH_BLOCK_ROWS;
+        int last = min(first + RANDOMGRAPH_BLOCK_ROWS, n);
+        vector<int>& endpoints = blocks[block];
+        endpoints.reserve(2 * (size_t)((last - first) * (n - 1.0) * probability * 1.1 + 16));
+
+        for(int source = first; source < last; source++)
+        {
+            // candidates 0 .. n - 2 are the other nodes; jump over the run
+            // of left out candidates before each kept one
+            int candidate = -1;
+
+            while(true)
+            {
+                double skip = floor(log(random.uniform()) / logq);
+
+                if(!(skip < n - 2 - candidate))
+                {
+                    break;
+                }
+
+                candidate += 1 + (int)skip;
+                endpoints.push_back(source);
+                endpoints.push_back(candidate < source ? candidate : candidate + 1);
+            }
+        }
+    }
+}
+
+void RandomGraph::erdos(int n, double p, vector<int>& endpoints)
+{
+    endpoints.clear();
+
+    if(n < 2 || p <= 0)
+    {
+        return;
+    }
+
+    nodeCount = n;
+    probability = min(p, 1.0);
+    int blockCount = (n + RANDOMGRAPH_BLOCK_ROWS - 1) / RANDOMGRAPH_BLOCK_ROWS;
+    blocks.assign(blockCount, vector<int>());
+
+    WorkerPool pool;
+    pool.run(this, blockCount);
+
+    size_t size = 0;
+    for(int block = 0; block < blockCount; block++)
+    {
+        size += blocks[block].size();
+    }
+
+    endpoints.reserve(size);
+    for(int block = 0; block < blockCount; block++)
+    {
+        endpoints.insert(endpoints.end(), blocks[block].begin(), blocks[block].end());
+        vector<int>().swap(blocks[block]);
+    }
+}
+
+void RandomGraph::watts(int n, int k, double beta, vector<int>& endpoints)
+{
+    endpoints.clear();
+    int half = min(k / 2, (n - 1) / 2);
+
+    if(half < 1)
+    {
+        return;
+    }
+
+    RandomStream random(seed);
+    tr1::unordered_set<uint64_t> joined;
+    vector<int> degrees(n, 2 * half);
+    endpoints.resize(2 * (size_t)n * half);
+    joined.rehash(n * (size_t)half);
+
+    // edge e = (j - 1) * n + u joins u to u + j
+    for(int j = 1; j <= half; j++)
+    {
+        for(int u = 0; u < n; u++)
+        {
+            size_t e = (j - 1) * (size_t)n + u;
+            int v = (u + j) % n;
+            endpoints[2 * e] = u;
+            endpoints[2 * e + 1] = v;
+            joined.insert((uint64_t)min(u, v) * n + max(u, v));
+        }
+    }
+
+    for(size_t e = 0; e < endpoints.size() / 2; e++)
+    {
+        int u = endpoints[2 * e];
+        int v = endpoints[2 * e + 1];
+
+        if(random.uniform() > beta || degrees[u] >= n - 1)
+        {
+            continue;
+        }
+
+        int w;
+        do
+        {
+            w = random.below(n);
+        }
+        while(w == u || joined.count((uint64_t)min(u, w) * n + max(u, w)));
+
+        joined.erase((uint64_t)min(u, v) * n + max(u, v));
+        joined.insert((uint64_t)min(u, w) * n + max(u, w));
+        degrees[v]--;
+        degrees[w]++;
+        endpoints[2 * e + 1] = w;
+    }
+}
+
+void RandomGraph::barabasi(int n, int m0, int m, vector<int>& endpoints)
+{
+    endpoints.clear();
+    m0 = max(1, min(m0, n));
+    m = max(1, min(m, m0));
+
+    if(n < 2)
+    {
+        return;
+    }
+
+    RandomStream random(seed);
+    endpoints.reserve(2 * ((size_t)m0 + (size_t)(n - m0) * m));
+
+    // the seed ring, a single edge for two nodes
+    for(int i = 0; m0 > 1 && i < (m0 == 2 ? 1 : m0); i++)
+    {
+        endpoints.push_back(i);
+        endpoints.push_back((i + 1) % m0);
+    }
+
+    // endpoints doubles as the list of every edge end, so a uniform entry
+    // is a node picked in proportion to its degree
+    vector<int> targets;
+
+    for(int source = m0; source < n; source++)
+    {
+        size_t ends = endpoints.size();
+        targets.clear();
+
+        while((int)targets.size() < m)
+        {
+            int target = ends > 0 ? endpoints[random.below(ends)] : random.below(source);
+
+            if(find(targets.begin(), targets.end(), target) == targets.end())
+            {
+                targets.push_back(target);
+                endpoints.push_back(source);
+                endpoints.push_back(target);
+            }
+        }
+    }
+}
+
+int RandomGraph::generate(Graph* g, const string& model, int n, int k, double p)
+{
+    vector<int> endpoints;
+    n = max(n, 0);
+
+    if(model == "erdos")
+    {
+        erdos(n, p, endpoints);
+    }
+    else if(model == "watts")
+    {
+        watts(n, k, p, endpoints);
+    }
+    else if(model == "barabasi")
+    {
+        barabasi(n, k, k, endpoints);
+    }
+    else
+    {
+        return -1;
+    }
+
+    g->clear();
+
+    if(n == 0)
+    {
+        return 0;
+    }
+
+    g->reserve(n, endpoints.size() / 2);
+    int first = g->addNodes(n);
+
+    for(size_t i = 0; i < endpoints.size(); i++)
+    {
+        endpoints[i] += first;
+    }
+
+    vector<int> edges;
+    return g->addEdges(endpoints, edges);
+}
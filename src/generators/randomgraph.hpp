@@ -0,0 +1,111 @@
+/*
+ * Mycelia immersive 3d network visualization tool.
+ * Copyright (C) 2008-2010 Sean Whalen.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __RANDOMGRAPH_HPP
+#define __RANDOMGRAPH_HPP
+
+#include <graph.hpp>
+#include <layout/workerpool.hpp>
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+// G(n,p) rows per independently seeded block, so results do not depend on
+// the thread count
+#define RANDOMGRAPH_BLOCK_ROWS 1024
+
+/*
+ * A small seeded generator (xorshift64*) with streams split off by number,
+ * for sampling in parallel reproducibly.
+ */
+class RandomStream
+{
+private:
+    uint64_t state;
+
+public:
+    RandomStream(uint64_t seed, uint64_t stream = 0)
+    {
+        // splitmix64 scrambles nearby seeds into unrelated states
+        uint64_t z = seed + (stream + 1) * 0x9e3779b97f4a7c15ULL;
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+        state = (z ^ (z >> 31)) | 1;
+    }
+
+    uint64_t next()
+    {
+        state ^= state >> 12;
+        state ^= state << 25;
+        state ^= state >> 27;
+        return state * 0x2545f4914f6cdd1dULL;
+    }
+
+    // uniform in (0, 1]
+    double uniform()
+    {
+        return ((next() >> 11) + 1) * (1.0 / 9007199254740992.0);
+    }
+
+    // uniform in [0, n)
+    int below(int n)
+    {
+        return (int)((next() >> 33) * (uint64_t)n >> 31);
+    }
+};
+
+/*
+ * Samples random graph models in time linear in nodes plus edges. Edges are
+ * source, target pairs of node numbers 0 .. n - 1, ready for Graph::addEdges.
+ *
+ * erdos: each ordered pair of distinct nodes with probability p, skipping
+ *     over the pairs left out by geometric jumps, in parallel by row block
+ * watts: ring lattice joining every node to its k / 2 following neighbors,
+ *     each edge's far end rewired with probability beta to a node that is
+ *     neither the near end nor already joined to it
+ * barabasi: a ring of m0 seed nodes, then nodes attaching m edges each to
+ *     distinct targets drawn from the list of all edge endpoints so far,
+ *     which is preferential attachment by degree
+ */
+class RandomGraph : public WorkerTask
+{
+private:
+    uint64_t seed;
+
+    // erdos state shared with the workers
+    int nodeCount;
+    double probability;
+    std::vector<std::vector<int> > blocks;
+
+public:
+    RandomGraph(uint64_t seed);
+
+    void erdos(int, double, std::vector<int>&);
+    void watts(int, int, double, std::vector<int>&);
+    void barabasi(int, int, int, std::vector<int>&);
+
+    // replaces the graph with a "erdos", "watts" or "barabasi" graph of n
+    // nodes: k is watts' k and barabasi's m and m0, p is erdos' p and watts'
+    // beta. Returns the number of edges added, -1 for an unknown model.
+    int generate(Graph*, const std::string&, int, int, double);
+
+    void run(int, int, int);
+};
+
+#endif
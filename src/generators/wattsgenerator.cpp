@@ -16,8 +16,11 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <generators/randomgraph.hpp>
 #include <generators/wattsgenerator.hpp>
 
+using namespace std;
+
 WattsGenerator::WattsGenerator(Mycelia* application)
     : GraphGenerator(application)
 {
@@ -27,49 +30,22 @@ WattsGenerator::WattsGenerator(Mycelia* application)
 void WattsGenerator::generate() const
 {
     generateNodes(INITIAL_N);
-    generateEdges(INITIAL_N, INITIAL_BETA);
+    generateEdges(INITIAL_N, INITIAL_K, INITIAL_BETA);
     parameterWindow->show();
 }
 
 void WattsGenerator::generateNodes(int nodeCount) const
 {
     application->g->clear();
-    
-    for(int i = 0; i < nodeCount; i++)
-    {
-        application->g->addNode();
-    }
+    application->g->reserve(nodeCount, 0);
+    application->g->addNodes(nodeCount);
 }
 
-void WattsGenerator::generateEdges(int nodeCount, float beta) const
+void WattsGenerator::generateEdges(int nodeCount, int k, float beta) const
 {
     application->g->clearEdges();
     
-    for(int i = 0; i < nodeCount; i++)
-    {
-        application->g->addEdge(i, (i + 1) % nodeCount);
-    }
-    
-    set<int> edgesCopy = application->g->getEdges();
-    
-    // this is probably not correct
-    foreach(int edge, edgesCopy)
-    {
-        const Edge& e = application->g->getEdge(edge);
-        int node = e.source;
-        
-        if(VruiHelp::randomFloat() < beta)
-        {
-            application->g->deleteEdge(edge);
-            int candidateNode;
-            
-            do
-            {
-                candidateNode = VruiHelp::randomFloat() * nodeCount;
-            }
-            while(node == candidateNode);
-            
-            application->g->addEdge(node, candidateNode);
-        }
-    }
-}
\ No newline at end of file
+    vector<int> endpoints;
+    RandomGraph(rand()).watts(nodeCount, k, beta, endpoints);
+    addIndexEdges(endpoints);
+}
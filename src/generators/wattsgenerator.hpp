@@ -25,6 +25,7 @@
 #include <generators/graphgenerator.hpp>
 
 #define INITIAL_N 20
+#define INITIAL_K 4
 #define INITIAL_BETA 0.2
 
 class WattsGenerator : public GraphGenerator
@@ -33,9 +34,11 @@ class WattsGenerator : public GraphGenerator
     {
     private:
         GLMotif::Slider* nodeCountSlider;
+        GLMotif::Slider* neighborSlider;
         GLMotif::Slider* betaSlider;
         
         GLMotif::TextField* nodeCountField;
+        GLMotif::TextField* neighborField;
         GLMotif::TextField* betaField;
         
         WattsGenerator* generator;
@@ -53,6 +56,11 @@ class WattsGenerator : public GraphGenerator
             nodeCountSlider = p.second;
             nodeCountSlider->getValueChangedCallbacks().add(this, &WattsGenerator::WattsWindow::sliderCallback);
             
+            p = VruiHelp::createParameter("Neighbors", 2, 10, INITIAL_K, dialog);
+            neighborField = p.first;
+            neighborSlider = p.second;
+            neighborSlider->getValueChangedCallbacks().add(this, &WattsGenerator::WattsWindow::sliderCallback);
+            
             p = VruiHelp::createParameter("Replacement Probability", 0.0, 1.0, INITIAL_BETA, dialog);
             betaField = p.first;
             betaSlider = p.second;
@@ -64,19 +72,21 @@ class WattsGenerator : public GraphGenerator
         void sliderCallback(GLMotif::Slider::ValueChangedCallbackData* cbData)
         {
             int nodeCount = nodeCountSlider->getValue();
+            int k = neighborSlider->getValue();
             float beta = betaSlider->getValue();
             application->stopLayout();
             
-            if(cbData->slider == betaSlider)
+            if(cbData->slider == betaSlider || cbData->slider == neighborSlider)
             {
                 betaField->setValue(beta);
-                generator->generateEdges(nodeCount, beta);
+                neighborField->setValue(k);
+                generator->generateEdges(nodeCount, k, beta);
             }
             else if(cbData->slider == nodeCountSlider)
             {
                 nodeCountField->setValue(nodeCount);
                 generator->generateNodes(nodeCount);
-                generator->generateEdges(nodeCount, beta);
+                generator->generateEdges(nodeCount, k, beta);
             }
             
             application->resumeLayout();
@@ -88,7 +98,7 @@ public:
     
     void generate() const;
     void generateNodes(int) const;
-    void generateEdges(int, float) const;
+    void generateEdges(int, int, float) const;
 };
 
 #endif
\ No newline at end of file
@@ -16,11 +16,57 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <commandqueue.hpp>
 #include <graph.hpp>
 
+#include <stdint.h>
+
 using namespace std;
 
-Graph::Graph(Mycelia* application): application(application)
+StringPool Graph::stringPool;
+
+StringPool::StringPool()
+{
+    intern("");
+}
+
+int StringPool::intern(const string& s)
+{
+    mutex.lock();
+
+    tr1::unordered_map<string, int>::iterator it = ids.find(s);
+    int id;
+
+    if(it != ids.end())
+    {
+        id = it->second;
+    }
+    else
+    {
+        id = strings.size();
+        strings.push_back(s);
+        ids[s] = id;
+    }
+
+    mutex.unlock();
+
+    return id;
+}
+
+const string& StringPool::get(int id)
+{
+    mutex.lock();
+    const string& s = strings[id];
+    mutex.unlock();
+
+    return s;
+}
+
+Graph::Graph(Mycelia* application)
+    : application(application),
+      epoch(0),
+      publishInterval(1.0 / GRAPH_PUBLISH_RATE),
+      lastPublishTime(0)
 {
     init();
 }
@@ -29,12 +75,35 @@ Graph& Graph::operator=(const Graph& g)
 {
     application = g.application;
     version = g.version;
+    positionVersion = g.positionVersion;
+    changes = g.changes;
+    changeLogVersion = g.changeLogVersion;
+    rebuildVersion = g.rebuildVersion;
 
     nodes = g.nodes;
     nodeMap = g.nodeMap;
 
+    indexNodes = g.indexNodes;
+    positions = g.positions;
+    velocities = g.velocities;
+    sizes = g.sizes;
+
+    topologyVersion = g.topologyVersion;
+    adjacency = g.adjacency;
+    adjacencyVersion = g.adjacencyVersion;
+    edgePairs = g.edgePairs;
+    edgePairsVersion = g.edgePairsVersion;
+    boostView = g.boostView;
+    boostViewVersion = g.boostViewVersion;
+    components = g.components;
+    componentsVersion = g.componentsVersion;
+    bounds = g.bounds;
+    boundsPositionVersion = g.boundsPositionVersion;
+    boundsTopologyVersion = g.boundsTopologyVersion;
+
     edges = g.edges;
     edgeMap = g.edgeMap;
+    attributeStore = g.attributeStore; // shared until either side edits
 
     materialVector = g.materialVector;
     textureNodeMode = g.textureNodeMode;
@@ -60,16 +129,15 @@ void Graph::clearVelocities()
 {
     mutex.lock();
 
-    foreach(int node, nodes)
-    {
-        nodeMap[node].velocity = Vrui::Vector(0, 0, 0);
-    }
+    velocities.assign(velocities.size(), Vrui::Vector(0, 0, 0));
 
     mutex.unlock();
 }
 
 void Graph::init()
 {
+    __sync_add_and_fetch(&epoch, 1);
+
     nodes.clear();
     nodeMap.clear();
     nodeMap.rehash(1000);
@@ -77,6 +145,16 @@ void Graph::init()
     edges.clear();
     edgeMap.clear();
     edgeMap.rehash(1000);
+    attributeStore.reset(new AttributeStore());
+
+    indexNodes.clear();
+    positions.clear();
+    velocities.clear();
+    sizes.clear();
+    adjacency.clear();
+    edgePairs.clear();
+    touchedNodes.clear();
+    allTouched = true;
 
     // TODO: Move back to dataitem.cpp
     materialVector.clear();
@@ -90,6 +168,22 @@ void Graph::init()
     textureNodeMode = "align";
 
     version = -1;
+    changes.clear();
+    changeLogVersion = version;
+    rebuildVersion = version;
+    positionVersion = 0;
+    topologyVersion = 0;
+    positionsReady = false;
+    deferredPositionVersion = -1;
+    adjacencyVersion = 0;
+    edgePairsVersion = 0;
+    boostView.clear();
+    boostViewVersion = 0;
+    components.clear();
+    componentsVersion = 0;
+    bounds.clear();
+    boundsPositionVersion = 0;
+    boundsTopologyVersion = 0;
     nodeId = -1;
     edgeId = -1;
 
@@ -111,45 +205,122 @@ void Graph::init()
     }
 }
 
+/*
+ * Center and diameter of the bounding sphere of the selected component, or
+ * of all nodes. The whole graph's is kept by the layout as it publishes
+ * steps, so this is usually a lookup; a component takes one pass over it.
+ */
 const pair<Vrui::Point, Vrui::Scalar> Graph::locate()
 {
-    Vrui::Point center(0, 0, 0);
-    Vrui::Scalar maxDistance = 0;
-    int counted = 1;
+    Bounds located;
 
     mutex.lock();
 
-    foreach(int source, nodes)
+    const vector<int>* component = application->getSelectedComponent(this);
+
+    if(component)
     {
-        if(!application->isSelectedComponent(source))
-        {
-            continue;
-        }
+        located.compute(positions, component);
+    }
+    else
+    {
+        refreshBounds();
+        located = bounds;
+    }
+
+    mutex.unlock();
+
+    Vrui::Point center = located.center;
+    Vrui::Scalar maxDistance = 2 * located.radius;
+
+    if(maxDistance == 0) maxDistance = 30;
+
+    lastCenter = center;
+    lastMaxDistance = maxDistance;
+
+    return pair<Vrui::Point, Vrui::Scalar>(center, maxDistance);
+}
+
+void Graph::refreshBounds()
+{
+    if(boundsPositionVersion != positionVersion || boundsTopologyVersion != topologyVersion)
+    {
+        bounds.compute(positions);
+        boundsPositionVersion = positionVersion;
+        boundsTopologyVersion = topologyVersion;
+    }
+}
+
+/*
+ * Ritter's sphere: the first pass finds the box and the extreme points on
+ * each axis, the pair farthest apart seeds the sphere, and the second pass
+ * grows it over the points still outside.
+ */
+void Bounds::compute(const vector<Vrui::Point>& positions, const vector<int>* indices)
+{
+    clear();
+
+    int count = indices ? (int)indices->size() : (int)positions.size();
+
+    if(count == 0)
+    {
+        return;
+    }
 
-        foreach(int target, nodes)
+    int lowest[3] = {0, 0, 0};
+    int highest[3] = {0, 0, 0};
+    const Vrui::Point& first = positions[indices ? (*indices)[0] : 0];
+    min = max = first;
+
+    for(int i = 0; i < count; i++)
+    {
+        const Vrui::Point& p = positions[indices ? (*indices)[i] : i];
+
+        for(int axis = 0; axis < 3; axis++)
         {
-            if(!application->isSelectedComponent(target))
+            if(p[axis] < min[axis])
             {
-                continue;
+                min[axis] = p[axis];
+                lowest[axis] = i;
             }
 
-            Vrui::Scalar d = Geometry::mag(nodeMap[source].position - nodeMap[target].position);
-            if(d > maxDistance) maxDistance = d;
+            if(p[axis] > max[axis])
+            {
+                max[axis] = p[axis];
+                highest[axis] = i;
+            }
         }
+    }
 
-        center += (nodeMap[source].position - center) * (1.0 / counted);
+    Vrui::Scalar widest = -1;
+
+    for(int axis = 0; axis < 3; axis++)
+    {
+        const Vrui::Point& a = positions[indices ? (*indices)[lowest[axis]] : lowest[axis]];
+        const Vrui::Point& b = positions[indices ? (*indices)[highest[axis]] : highest[axis]];
+        Vrui::Scalar d = Geometry::sqrDist(a, b);
 
-        counted++;
+        if(d > widest)
+        {
+            widest = d;
+            center = Geometry::mid(a, b);
+            radius = Math::sqrt(d) / 2;
+        }
     }
 
-    mutex.unlock();
+    empty = false;
 
-    if(maxDistance == 0) maxDistance = 30;
+    Vrui::Point boxMin = min;
+    Vrui::Point boxMax = max;
 
-    lastCenter = center;
-    lastMaxDistance = maxDistance;
+    for(int i = 0; i < count; i++)
+    {
+        add(positions[indices ? (*indices)[i] : i]);
+    }
 
-    return pair<Vrui::Point, Vrui::Scalar>(center, maxDistance);
+    // the box is already exact, add() only needed to grow the sphere
+    min = boxMin;
+    max = boxMax;
 }
 
 const GLMaterial* Graph::getNodeMaterialFromId(int materialId)
@@ -172,6 +343,21 @@ const GLMaterial* Graph::getEdgeMaterialFromId(int materialId)
     return materialVector[materialId];
 }
 
+// index of the material with color c, added if no material has it yet
+int Graph::getMaterial(const GLMaterial::Color& c)
+{
+    for(int i = 0; i < (int)materialVector.size(); i++)
+    {
+        if(materialVector[i]->ambient == c)
+        {
+            return i;
+        }
+    }
+
+    materialVector.push_back(new GLMaterial(c));
+    return (int)materialVector.size() - 1;
+}
+
 const std::string& Graph::getTextureNodeMode() const
 {
     return textureNodeMode;
@@ -182,6 +368,40 @@ const int Graph::getVersion() const
     return version;
 }
 
+const int Graph::getPositionVersion() const
+{
+    return positionVersion;
+}
+
+const int Graph::getTopologyVersion() const
+{
+    return topologyVersion;
+}
+
+const int Graph::getEpoch() const
+{
+    return __sync_fetch_and_add(const_cast<int*>(&epoch), 0);
+}
+
+/*
+ * Appends the node and edge changes published after version since and
+ * returns true, or returns false when they do not cover everything that
+ * changed and the caller must rebuild from scratch.
+ */
+bool Graph::getChanges(int since, vector<GraphChange>& result) const
+{
+    if(since < rebuildVersion || since < changeLogVersion || since > version)
+    {
+        return false;
+    }
+
+    int first = (int)changes.size();
+    while(first > 0 && changes[first - 1].version > since) first--;
+
+    result.insert(result.end(), changes.begin() + first, changes.end());
+    return true;
+}
+
 void Graph::randomizePositions(Vrui::Scalar radius)
 {
     if (radius < 0)
@@ -197,525 +417,2355 @@ void Graph::randomizePositions(Vrui::Scalar radius)
         x = radius * (2 * VruiHelp::randomFloat() - 1);
         y = radius * (2 * VruiHelp::randomFloat() - 1);
         z = radius * (2 * VruiHelp::randomFloat() - 1);
-        nodeMap[node].position = Vrui::Point(x, y, z);
+        positions[nodeMap[node].index] = Vrui::Point(x, y, z);
     }
 
     mutex.unlock();
-    update();
+    updatePositions();
 }
 
 void Graph::setTextureNodeMode(std::string& mode)
 {
     mutex.lock();
+    assignTextureNodeMode(mode);
+    mutex.unlock();
+
+    notifyChange();
+}
 
+void Graph::assignTextureNodeMode(const string& mode)
+{
     textureNodeMode = mode;
+    markRebuild();
+}
 
+void Graph::update()
+{
+    mutex.lock();
+    markRebuild();
     mutex.unlock();
-    update();
+
+    notifyChange();
 }
 
-void Graph::update()
+void Graph::markRebuild()
 {
     version++;
+    rebuildVersion = version;
+}
+
+void Graph::notifyChange()
+{
     Vrui::requestUpdate();
+    application->wakeLayout();
 }
 
-void Graph::write(const char* filename)
+/*
+ * Applies queued setter calls in order under one lock, so RPC threads
+ * editing the topology see either none or all of them. Commands for
+ * elements deleted in between are dropped. Returns the number applied.
+ */
+const int Graph::apply(const vector<GraphCommand*>& commands)
 {
-    mutex.lock();
+    int applied = 0;
 
-    ofstream out(filename);
-    out << "digraph G {" << endl;
+    if(commands.empty())
+    {
+        return 0;
+    }
 
-    foreach(int node, nodes)
+    lock();
+
+    foreach(GraphCommand* command, commands)
     {
-        out << "  n" << node << "[ pos=\""
-            << nodeMap[node].position[0] << ","
-            << nodeMap[node].position[1] << ","
-            << nodeMap[node].position[2] << "\" ];\n";
+        if(command->epoch == -1 || command->epoch == epoch)
+        {
+            applied += command->apply(this);
+        }
     }
 
-    foreach(int edge, edges)
+    unlock();
+
+    if(applied > 0)
     {
-        out << "  n" << edgeMap[edge].source << " -> n" << edgeMap[edge].target << ";\n";
+        notifyChange();
     }
 
-    out << "}\n";
-    cout << "wrote " << filename << endl;
+    return applied;
+}
 
+void Graph::logChange(int id, bool edge, int flags)
+{
+    mutex.lock();
+    recordChange(id, edge, flags);
     mutex.unlock();
+
+    notifyChange();
 }
 
-/*
- * edges
- */
-const int Graph::addEdge(int source, int target)
+void Graph::recordChange(int id, bool edge, int flags)
 {
-    mutex.lock();
+    version++;
 
-    if(!isValidNode(source) || !isValidNode(target))
+    // older consumers rebuild once the log is full
+    if((int)changes.size() >= CHANGE_LOG_SIZE)
     {
-        cout << "invalid node(s): " << source << " " << target << endl;
-        mutex.unlock();
-        return -1;
+        changes.clear();
+        changeLogVersion = version - 1;
     }
 
-    edgeId++;
-    edges.insert(edgeId);
-    edgeMap[edgeId] = Edge(source, target);
-
-    nodeMap[source].outDegree++;
-    nodeMap[target].inDegree++;
-    nodeMap[source].adjacent[target].push_back(edgeId);
+    GraphChange change;
+    change.version = version;
+    change.id = id;
+    change.edge = edge;
+    change.flags = flags;
+    changes.push_back(change);
+}
 
-    mutex.unlock();
-    update();
+void Graph::updateEdge(int edge, int flags)
+{
+    logChange(edge, true, flags);
+}
 
-    return edgeId;
+void Graph::updateNode(int node, int flags)
+{
+    logChange(node, false, flags);
 }
 
-void Graph::clearEdges()
+// positions changed but structure and attributes did not, e.g. a node drag;
+// caller does not hold the mutex
+void Graph::updatePositions()
 {
     mutex.lock();
+    positionVersion++;
+    mutex.unlock();
 
-    foreach(int node, nodes)
+    Vrui::requestUpdate();
+    application->wakeLayout();
+}
+
+// the wait is timed only when another thread holds the lock
+void Graph::lock()
+{
+    if(mutex.tryLock())
     {
-        nodeMap[node].adjacent.clear();
+        return;
     }
 
-    edges.clear();
-    edgeMap.clear();
-
-    mutex.unlock();
-    update();
+    StatTimer timer(application->stats, STAT_LOCK_WAIT);
+    mutex.lock();
 }
 
-const int Graph::deleteEdge(int edge)
+void Graph::write(const char* filename)
 {
     mutex.lock();
 
-    if(!isValidEdge(edge))
+    ofstream out(filename);
+    out << "digraph G {" << endl;
+
+    foreach(int node, nodes)
     {
-        mutex.unlock();
-        return -1;
+        const Vrui::Point& p = positions[nodeMap[node].index];
+        out << "  n" << node << "[ pos=\""
+            << p[0] << ","
+            << p[1] << ","
+            << p[2] << "\" ];\n";
     }
 
-    Edge& e = edgeMap[edge];
-    list<int>& neighbors = nodeMap[e.source].adjacent[e.target];
-    neighbors.erase(find(neighbors.begin(), neighbors.end(), edge));
+    foreach(int edge, edges)
+    {
+        out << "  n" << edgeMap[edge].source << " -> n" << edgeMap[edge].target << ";\n";
+    }
 
-    edges.erase(edge);
-    edgeMap.erase(edge);
+    out << "}\n";
+    cout << "wrote " << filename << endl;
 
     mutex.unlock();
-    update();
-
-    return edge;
 }
 
-const Edge& Graph::getEdge(int edge)
+/*
+ * snapshots
+ */
+namespace
 {
-    return edgeMap[edge];
-}
-
-const list<int>& Graph::getEdges(int source, int target)
+class SnapshotSection
 {
-    if(hasEdge(source, target))
-        return nodeMap[source].adjacent[target];
-
-    return empty;
-}
+public:
+    uint32_t type;
+    uint32_t reserved;
+    uint64_t offset;
+    uint64_t size;
+};
 
-const std::string& Graph::getEdgeLabel(int edge)
+// appends count values, padded to 8 bytes to keep the next array aligned
+template<class T> void appendArray(vector<char>& out, const T* values, size_t count)
 {
-    return edgeMap[edge].label;
+    const char* bytes = (const char*)values;
+    out.insert(out.end(), bytes, bytes + count * sizeof(T));
+    out.resize((out.size() + 7) & ~(size_t)7, 0);
 }
 
-const GLMaterial* Graph::getEdgeMaterial(int edge)
+template<class T> void appendArray(vector<char>& out, const vector<T>& values)
 {
-    return getEdgeMaterialFromId(edgeMap[edge].material);
+    appendArray(out, values.empty() ? 0 : &values[0], values.size());
 }
 
-const float Graph::getEdgeWeight(int edge)
+template<class T> void appendValue(vector<char>& out, T value)
 {
-    return edgeMap[edge].weight;
+    appendArray(out, &value, 1);
 }
 
-const set<int>& Graph::getEdges() const
+class StringTable
 {
-    return edges;
-}
+public:
+    tr1::unordered_map<string, uint32_t> ids;
+    vector<uint32_t> offsets;
+    vector<char> characters;
 
-const int Graph::getEdgeCount() const
-{
-    return (int)edges.size();
-}
+    tr1::unordered_map<int, uint32_t> pooled; // StringPool id -> id
 
-const bool Graph::hasEdge(int source, int target)
-{
-    return nodeMap[source].adjacent.find(target) != nodeMap[source].adjacent.end();
-}
+    StringTable() : offsets(1, 0) {}
 
-const bool Graph::isBidirectional(int edge)
-{
-    return isBidirectional(edgeMap[edge].source, edgeMap[edge].target);
-}
+    uint32_t add(int id, StringPool& pool)
+    {
+        tr1::unordered_map<int, uint32_t>::iterator it = pooled.find(id);
 
-const bool Graph::isBidirectional(int source, int target)
-{
-    return hasEdge(source, target) && hasEdge(target, source);
-}
+        if(it != pooled.end())
+        {
+            return it->second;
+        }
 
-const bool Graph::isValidEdge(int edge) const
-{
-    return edgeMap.find(edge) != edgeMap.end();
-}
+        return pooled[id] = add(pool.get(id));
+    }
 
-void Graph::setEdgeColor(int edge, int r, int g, int b, int a)
-{
-    setEdgeColor(edge, r / 255.0, g / 255.0, b / 255.0, a / 255.0);
-}
+    uint32_t add(const string& s)
+    {
+        tr1::unordered_map<string, uint32_t>::iterator it = ids.find(s);
 
-void Graph::setEdgeColor(int edge, double r, double g, double b, double a)
-{
-    GLMaterial::Color c(r, g, b, a);
-    int materialId = -1;
+        if(it != ids.end())
+        {
+            return it->second;
+        }
 
-    // look for color in the cache
-    for(int i = 0; i < (int)materialVector.size(); i++)
+        uint32_t id = offsets.size() - 1;
+        ids[s] = id;
+        characters.insert(characters.end(), s.begin(), s.end());
+        offsets.push_back(characters.size());
+
+        return id;
+    }
+};
+
+// reads arrays from a mapped section; a short read invalidates the reader
+class SnapshotReader
+{
+private:
+    const char* p;
+    const char* end;
+
+public:
+    SnapshotReader(const char* begin, const char* end) : p(begin), end(end) {}
+
+    template<class T> const T* array(uint64_t count)
     {
-        if(materialVector[i]->ambient == c)
+        if(p == 0 || count > (uint64_t)(end - p) / sizeof(T))
         {
-            materialId = i;
-            break;
+            p = 0;
+            return 0;
         }
+
+        const T* values = (const T*)p;
+        p += min((size_t)(end - p), (count * sizeof(T) + 7) & ~(size_t)7);
+
+        return values;
     }
 
-    // if not found, add it
-    if(materialId == -1)
+    template<class T> T value()
     {
-        materialVector.push_back(new GLMaterial(c));
-        materialId = materialVector.size() - 1;
+        const T* v = array<T>(1);
+        return v ? *v : T();
     }
 
-    edgeMap[edge].material = materialId;
+    bool isValid() const { return p != 0; }
+};
 
-    update();
+// true if all count values are below limit
+template<class T> bool inRange(const T* values, uint64_t count, uint64_t limit)
+{
+    for(uint64_t i = 0; i < count; i++)
+    {
+        if((uint64_t)values[i] >= limit) return false;
+    }
+
+    return true;
+}
 }
 
-void Graph::setEdgeLabel(int edge, const std::string& label)
+/*
+ * Writes the graph to filename, through a temporary file so a failed save
+ * leaves an earlier snapshot intact. Returns false if it cannot be written.
+ */
+bool Graph::writeSnapshot(const string& filename)
 {
-    edgeMap[edge].label = string(label);
+    vector<char> data;
+    writeSnapshot(data);
 
-    update();
+    string temporary = filename + ".tmp";
+    ofstream out(temporary.c_str(), ios::binary);
+    out.write(&data[0], data.size());
+    out.close();
+
+    if(!out || rename(temporary.c_str(), filename.c_str()) != 0)
+    {
+        cout << "could not write snapshot " << filename << endl;
+        remove(temporary.c_str());
+        return false;
+    }
+
+    cout << "wrote " << filename << endl;
+    return true;
 }
 
-void Graph::setEdgeWeight(int edge, float weight)
+// the snapshot file's contents, e.g. for broadcasting to cluster nodes
+void Graph::writeSnapshot(vector<char>& data)
 {
-    edgeMap[edge].weight = weight;
+    StringTable strings;
+    strings.add("");
 
-    update();
+    vector<char> nodeSection;
+    vector<char> topologySection;
+    vector<char> attributeSection;
+    vector<char> materialSection;
+    vector<char> stringSection;
+
+    mutex.lock();
+
+    uint32_t n = indexNodes.size();
+    vector<double> xyz(3 * n);
+    vector<int32_t> materials(n);
+    vector<uint32_t> labels(n);
+    vector<uint32_t> types(n);
+    vector<uint32_t> imagePaths(n);
+    vector<double> imageScales(n);
+    vector<int32_t> nodeComponents(n);
+    vector<uint32_t> attributeOffsets(1, 0);
+    vector<uint32_t> attributes;
+    const AttributeStore& store = *attributeStore;
+
+    for(uint32_t i = 0; i < n; i++)
+    {
+        const Node& node = nodeMap[indexNodes[i]];
+
+        for(int j = 0; j < 3; j++) xyz[3 * i + j] = positions[i][j];
+        materials[i] = node.material;
+        labels[i] = strings.add(node.label, stringPool);
+        types[i] = strings.add(node.type == NODE_IMAGE ? "image" : "shape");
+        imagePaths[i] = strings.add(node.imagePath, stringPool);
+        imageScales[i] = node.imageScale;
+        nodeComponents[i] = getNodeComponent(indexNodes[i]);
+
+        for(int j = 0; j < (int)store.keys.size(); j++)
+        {
+            tr1::unordered_map<int, int>::const_iterator value = store.columns[j].find(indexNodes[i]);
+
+            if(value != store.columns[j].end())
+            {
+                attributes.push_back(strings.add(store.keys[j], stringPool));
+                attributes.push_back(strings.add(value->second, stringPool));
+            }
+        }
+
+        attributeOffsets.push_back(attributes.size() / 2);
+    }
+
+    appendValue<uint32_t>(nodeSection, n);
+    appendValue<int32_t>(nodeSection, nodeId);
+    appendValue<uint32_t>(nodeSection, strings.add(textureNodeMode));
+    appendArray(nodeSection, indexNodes);
+    appendArray(nodeSection, xyz);
+    appendArray(nodeSection, sizes);
+    appendArray(nodeSection, materials);
+    appendArray(nodeSection, labels);
+    appendArray(nodeSection, types);
+    appendArray(nodeSection, imagePaths);
+    appendArray(nodeSection, imageScales);
+    appendArray(nodeSection, nodeComponents);
+
+    appendArray(attributeSection, attributeOffsets);
+    appendArray(attributeSection, attributes);
+
+    // out-edges bucketed by source index, each bucket in edge id order
+    uint32_t m = edges.size();
+    vector<uint32_t> offsets(n + 1, 0);
+    vector<int32_t> targets(m);
+    vector<int32_t> edgeIds(m);
+    vector<float> weights(m);
+    vector<int32_t> edgeMaterials(m);
+    vector<uint32_t> edgeLabels(m);
+
+    foreach(int edge, edges)
+    {
+        offsets[nodeMap[edgeMap[edge].source].index + 1]++;
+    }
+
+    for(uint32_t i = 0; i < n; i++)
+    {
+        offsets[i + 1] += offsets[i];
+    }
+
+    vector<uint32_t> fill(offsets.begin(), offsets.end() - 1);
+
+    foreach(int edge, edges)
+    {
+        const Edge& e = edgeMap[edge];
+        uint32_t slot = fill[nodeMap[e.source].index]++;
+
+        targets[slot] = nodeMap[e.target].index;
+        edgeIds[slot] = edge;
+        weights[slot] = e.weight;
+        edgeMaterials[slot] = e.material;
+        edgeLabels[slot] = strings.add(e.label, stringPool);
+    }
+
+    appendValue<uint32_t>(topologySection, m);
+    appendValue<int32_t>(topologySection, edgeId);
+    appendArray(topologySection, offsets);
+    appendArray(topologySection, targets);
+    appendArray(topologySection, edgeIds);
+    appendArray(topologySection, weights);
+    appendArray(topologySection, edgeMaterials);
+    appendArray(topologySection, edgeLabels);
+
+    vector<float> rgba;
+
+    for(int i = 0; i < (int)materialVector.size(); i++)
+    {
+        const GLMaterial::Color& c = materialVector[i]->ambient;
+        for(int j = 0; j < 4; j++) rgba.push_back(c[j]);
+    }
+
+    appendValue<uint32_t>(materialSection, materialVector.size());
+    appendArray(materialSection, rgba);
+
+    mutex.unlock();
+
+    appendValue<uint32_t>(stringSection, strings.offsets.size() - 1);
+    appendArray(stringSection, strings.offsets);
+    appendArray(stringSection, strings.characters);
+
+    // header, section table and sections
+    const int count = 5;
+    const vector<char>* sections[count] = {&stringSection, &materialSection, &nodeSection, &topologySection, &attributeSection};
+    const uint32_t sectionTypes[count] = {SNAPSHOT_STRINGS, SNAPSHOT_MATERIALS, SNAPSHOT_NODES, SNAPSHOT_TOPOLOGY, SNAPSHOT_ATTRIBUTES};
+    const uint32_t header[4] = {SNAPSHOT_MAGIC, SNAPSHOT_VERSION, count, 0};
+
+    SnapshotSection table[count];
+    uint64_t offset = sizeof(header) + sizeof(table);
+
+    for(int i = 0; i < count; i++)
+    {
+        table[i].type = sectionTypes[i];
+        table[i].reserved = 0;
+        table[i].offset = offset;
+        table[i].size = sections[i]->size();
+        offset += table[i].size;
+    }
+
+    data.clear();
+    data.reserve(offset);
+    data.insert(data.end(), (const char*)header, (const char*)header + sizeof(header));
+    data.insert(data.end(), (const char*)table, (const char*)table + sizeof(table));
+
+    for(int i = 0; i < count; i++)
+    {
+        data.insert(data.end(), sections[i]->begin(), sections[i]->end());
+    }
 }
 
 /*
- * nodes
+ * Replaces the graph with the snapshot in filename, read from the mapped
+ * file. Everything is checked before the graph is touched; a missing,
+ * truncated or inconsistent snapshot returns false and keeps the graph.
  */
-const int Graph::addNode()
+bool Graph::readSnapshot(const string& filename)
+{
+    VruiHelp::MappedFile file(filename);
+    return readSnapshot(file.begin(), file.end(), filename, true);
+}
+
+/*
+ * Replaces the graph with a snapshot received from the cluster master,
+ * keeping selections and leaving layouts running.
+ */
+bool Graph::readSnapshot(const vector<char>& data)
+{
+    return !data.empty() && readSnapshot(&data[0], &data[0] + data.size(), "broadcast", false);
+}
+
+/*
+ * Replaces the graph with the snapshot in [begin, end), named source in
+ * messages. Layouts are stopped and selections cleared if reset.
+ */
+bool Graph::readSnapshot(const char* begin, const char* end, const string& source, bool reset)
 {
+    SnapshotReader reader(begin, end);
+    const uint32_t* header = reader.array<uint32_t>(4);
+
+    if(!header || header[0] != SNAPSHOT_MAGIC || header[1] != SNAPSHOT_VERSION)
+    {
+        cout << "not a version " << SNAPSHOT_VERSION << " snapshot: " << source << endl;
+        return false;
+    }
+
+    const SnapshotSection* table = reader.array<SnapshotSection>(header[2]);
+    SnapshotReader stringReader(0, 0), materialReader(0, 0), nodeReader(0, 0), topologyReader(0, 0), attributeReader(0, 0);
+    uint64_t size = end - begin;
+
+    for(uint32_t i = 0; table && i < header[2]; i++)
+    {
+        if(table[i].offset > size || table[i].size > size - table[i].offset) continue;
+
+        SnapshotReader section(begin + table[i].offset, begin + table[i].offset + table[i].size);
+
+        switch(table[i].type)
+        {
+            case SNAPSHOT_STRINGS: stringReader = section; break;
+            case SNAPSHOT_MATERIALS: materialReader = section; break;
+            case SNAPSHOT_NODES: nodeReader = section; break;
+            case SNAPSHOT_TOPOLOGY: topologyReader = section; break;
+            case SNAPSHOT_ATTRIBUTES: attributeReader = section; break;
+        }
+    }
+
+    uint32_t stringCount = stringReader.value<uint32_t>();
+    const uint32_t* stringOffsets = stringReader.array<uint32_t>((uint64_t)stringCount + 1);
+    const char* characters = stringOffsets ? stringReader.array<char>(stringOffsets[stringCount]) : 0;
+
+    uint32_t materialCount = materialReader.value<uint32_t>();
+    const float* rgba = materialReader.array<float>(4 * (uint64_t)materialCount);
+
+    uint32_t n = nodeReader.value<uint32_t>();
+    int32_t nextNodeId = nodeReader.value<int32_t>();
+    uint32_t textureMode = nodeReader.value<uint32_t>();
+    const int32_t* ids = nodeReader.array<int32_t>(n);
+    const double* xyz = nodeReader.array<double>(3 * (uint64_t)n);
+    const float* nodeSizes = nodeReader.array<float>(n);
+    const int32_t* materials = nodeReader.array<int32_t>(n);
+    const uint32_t* labels = nodeReader.array<uint32_t>(n);
+    const uint32_t* types = nodeReader.array<uint32_t>(n);
+    const uint32_t* imagePaths = nodeReader.array<uint32_t>(n);
+    const double* imageScales = nodeReader.array<double>(n);
+    nodeReader.array<int32_t>(n); // components, rebuilt from the edges
+
+    uint32_t m = topologyReader.value<uint32_t>();
+    int32_t nextEdgeId = topologyReader.value<int32_t>();
+    const uint32_t* offsets = topologyReader.array<uint32_t>((uint64_t)n + 1);
+    const int32_t* targets = topologyReader.array<int32_t>(m);
+    const int32_t* edgeIds = topologyReader.array<int32_t>(m);
+    const float* weights = topologyReader.array<float>(m);
+    const int32_t* edgeMaterials = topologyReader.array<int32_t>(m);
+    const uint32_t* edgeLabels = topologyReader.array<uint32_t>(m);
+
+    const uint32_t* attributeOffsets = attributeReader.array<uint32_t>((uint64_t)n + 1);
+    const uint32_t* attributes = attributeOffsets ? attributeReader.array<uint32_t>(2 * (uint64_t)attributeOffsets[n]) : 0;
+
+    bool valid = stringReader.isValid() && materialReader.isValid() && nodeReader.isValid()
+        && topologyReader.isValid() && attributeReader.isValid() && characters && attributes
+        && materialCount > MATERIAL_HIGHLIGHTED && offsets[0] == 0 && offsets[n] == m
+        && attributeOffsets[0] == 0 && textureMode < stringCount
+        && inRange(labels, n, stringCount) && inRange(types, n, stringCount)
+        && inRange(imagePaths, n, stringCount) && inRange(materials, n, materialCount)
+        && inRange(targets, m, n) && inRange(edgeMaterials, m, materialCount)
+        && inRange(edgeLabels, m, stringCount) && inRange(attributes, 2 * (uint64_t)attributeOffsets[n], stringCount);
+
+    for(uint32_t i = 0; valid && i < stringCount; i++)
+    {
+        valid = stringOffsets[i] <= stringOffsets[i + 1];
+    }
+
+    for(uint32_t i = 0; valid && i < n; i++)
+    {
+        valid = offsets[i] <= offsets[i + 1] && attributeOffsets[i] <= attributeOffsets[i + 1]
+            && ids[i] >= 0 && ids[i] <= nextNodeId;
+    }
+
+    for(uint32_t i = 0; valid && i < m; i++)
+    {
+        valid = edgeIds[i] >= 0 && edgeIds[i] <= nextEdgeId;
+    }
+
+    // sorted ids catch duplicates and fill the id sets in linear time
+    vector<int> sortedNodes(ids, ids + n);
+    vector<int> sortedEdges(edgeIds, edgeIds + m);
+
+    if(valid)
+    {
+        sort(sortedNodes.begin(), sortedNodes.end());
+        sort(sortedEdges.begin(), sortedEdges.end());
+        valid = adjacent_find(sortedNodes.begin(), sortedNodes.end()) == sortedNodes.end()
+            && adjacent_find(sortedEdges.begin(), sortedEdges.end()) == sortedEdges.end();
+    }
+
+    if(!valid)
+    {
+        cout << "corrupt snapshot: " << source << endl;
+        return false;
+    }
+
+    // interned once each, elements then take their ids
+    vector<int> strings(stringCount);
+    int image = stringPool.intern("image");
+
+    for(uint32_t i = 0; i < stringCount; i++)
+    {
+        strings[i] = stringPool.intern(string(characters + stringOffsets[i], characters + stringOffsets[i + 1]));
+    }
+
+    AttributeStore* store = new AttributeStore();
+    tr1::unordered_map<int, int> columns; // key -> column
+
+    for(uint32_t j = 0; j < attributeOffsets[n]; j++)
+    {
+        int key = strings[attributes[2 * j]];
+
+        if(columns.find(key) == columns.end())
+        {
+            columns[key] = store->keys.size();
+            store->keys.push_back(key);
+        }
+    }
+
+    store->columns.resize(store->keys.size());
+
+    if(reset)
+    {
+        application->stopLayout();
+    }
+
     mutex.lock();
 
-    Node n;
+    init();
 
-    Vrui::Scalar scale = lastMaxDistance / 2; // effective radius
+    materialVector.resize(materialCount);
 
-    // New point should be around previous center of graph
-    n.position = Vrui::Point(lastCenter[0] + scale * (2 * VruiHelp::randomFloat() - 1),
-                             lastCenter[1] + scale * (2 * VruiHelp::randomFloat() - 1),
-                             lastCenter[2] + scale * (2 * VruiHelp::randomFloat() - 1) );
+    for(uint32_t i = 0; i < materialCount; i++)
+    {
+        materialVector[i] = new GLMaterial(GLMaterial::Color(rgba[4 * i], rgba[4 * i + 1], rgba[4 * i + 2], rgba[4 * i + 3]));
+    }
 
-    nodeId++;
-    nodes.insert(nodeId);
-    nodeMap[nodeId] = n;
+    textureNodeMode = stringPool.get(strings[textureMode]);
+    attributeStore.reset(store);
+    nodeId = nextNodeId;
+    edgeId = nextEdgeId;
+
+    nodeMap.rehash(n);
+    vector<Node*> indexed(n); // map entries by index, for the edge pass
+    indexNodes.assign(ids, ids + n);
+    positions.resize(n);
+    velocities.assign(n, Vrui::Vector(0, 0, 0));
+    sizes.assign(nodeSizes, nodeSizes + n);
+
+    for(uint32_t i = 0; i < n; i++)
+    {
+        Node& node = nodeMap[ids[i]];
+        indexed[i] = &node;
+        node.index = i;
+        node.label = strings[labels[i]];
+        node.type = strings[types[i]] == image ? NODE_IMAGE : NODE_SHAPE;
+        node.imagePath = strings[imagePaths[i]];
+        node.imageScale = imageScales[i];
+        node.material = materials[i];
+
+        for(uint32_t j = attributeOffsets[i]; j < attributeOffsets[i + 1]; j++)
+        {
+            store->columns[columns[strings[attributes[2 * j]]]][ids[i]] = strings[attributes[2 * j + 1]];
+        }
+
+        positions[i] = Vrui::Point(xyz[3 * i], xyz[3 * i + 1], xyz[3 * i + 2]);
+    }
+
+    nodes.insert(sortedNodes.begin(), sortedNodes.end());
+    edges.insert(sortedEdges.begin(), sortedEdges.end());
+
+    edgeMap.rehash(m);
+
+    for(uint32_t i = 0; i < n; i++)
+    {
+        Node& source = *indexed[i];
+
+        for(uint32_t j = offsets[i]; j < offsets[i + 1]; j++)
+        {
+            Edge& e = edgeMap[edgeIds[j]];
+            e.source = ids[i];
+            e.target = ids[targets[j]];
+            e.weight = weights[j];
+            e.material = edgeMaterials[j];
+            e.label = strings[edgeLabels[j]];
+
+            source.outDegree++;
+            indexed[targets[j]]->inDegree++;
+            source.adjacent[e.target].push_back(edgeIds[j]);
+            indexed[targets[j]]->incoming[e.source].push_back(edgeIds[j]);
+        }
+    }
+
+    topologyVersion++;
 
     mutex.unlock();
+
+    if(reset)
+    {
+        application->clearSelections();
+    }
+
     update();
 
-    return nodeId;
+    return true;
 }
 
-const int Graph::addNode(const Vrui::Point& position)
+/*
+ * edges
+ */
+const int Graph::addEdge(int source, int target)
 {
-    int id = addNode();
-    setNodePosition(id, position);
-    return id;
+    mutex.lock();
+    int edge = createEdge(source, target);
+    mutex.unlock();
+
+    if(edge != -1)
+    {
+        update();
+    }
+
+    return edge;
 }
 
-const int Graph::addNode(const string& s)
+/*
+ * Adds an edge for every source and target pair in endpoints under one lock
+ * and one update. Ids go to edgeIds in the same order, -1 for pairs with an
+ * invalid node. Returns the number of edges added.
+ */
+const int Graph::addEdges(const vector<int>& endpoints, vector<int>& edgeIds)
 {
-    int id = addNode();
-    setNodeLabel(id, s);
-    return id;
+    int added = 0;
+    edgeIds.clear();
+    edgeIds.reserve(endpoints.size() / 2);
+
+    mutex.lock();
+
+    for(int i = 0; i + 1 < (int)endpoints.size(); i += 2)
+    {
+        edgeIds.push_back(createEdge(endpoints[i], endpoints[i + 1]));
+        added += edgeIds.back() != -1;
+    }
+
+    mutex.unlock();
+
+    if(added > 0)
+    {
+        update();
+    }
+
+    return added;
 }
 
-const int Graph::deleteNode()
+// caller holds the mutex and calls update()
+int Graph::createEdge(int source, int target)
 {
-    return deleteNode(*nodes.begin());
+    if(!isValidNode(source) || !isValidNode(target))
+    {
+        cout << "invalid node(s): " << source << " " << target << endl;
+        return -1;
+    }
+
+    edgeId++;
+    edges.insert(edgeId);
+    edgeMap[edgeId] = Edge(source, target);
+
+    nodeMap[source].outDegree++;
+    nodeMap[target].inDegree++;
+    nodeMap[source].adjacent[target].push_back(edgeId);
+    nodeMap[target].incoming[source].push_back(edgeId);
+    touchNode(source);
+    touchNode(target);
+
+    if(componentsVersion == topologyVersion)
+    {
+        components.join(nodeMap[source].index, nodeMap[target].index);
+        componentsVersion++;
+    }
+
+    topologyVersion++;
+
+    return edgeId;
+}
+
+void Graph::clearEdges()
+{
+    mutex.lock();
+
+    foreach(int node, nodes)
+    {
+        Node& n = nodeMap[node];
+        n.adjacent.clear();
+        n.incoming.clear();
+        n.inDegree = 0;
+        n.outDegree = 0;
+    }
+
+    edges.clear();
+    edgeMap.clear();
+    allTouched = true;
+    topologyVersion++;
+
+    mutex.unlock();
+    update();
+}
+
+const int Graph::deleteEdge(int edge)
+{
+    mutex.lock();
+
+    if(!isValidEdge(edge))
+    {
+        mutex.unlock();
+        return -1;
+    }
+
+    removeEdge(edge);
+
+    mutex.unlock();
+    update();
+
+    return edge;
+}
+
+/*
+ * Deletes every valid edge in edgeIds under one lock and one update.
+ * Returns the number of edges deleted.
+ */
+const int Graph::deleteEdges(const vector<int>& edgeIds)
+{
+    int deleted = 0;
+
+    mutex.lock();
+
+    foreach(int edge, edgeIds)
+    {
+        deleted += removeEdge(edge);
+    }
+
+    mutex.unlock();
+
+    if(deleted > 0)
+    {
+        update();
+    }
+
+    return deleted;
+}
+
+// drops edge from the incidence lists of both ends, O(parallel edges);
+// caller holds the mutex and calls update()
+bool Graph::removeEdge(int edge)
+{
+    if(!isValidEdge(edge))
+    {
+        return false;
+    }
+
+    Edge& e = edgeMap[edge];
+    Node& source = nodeMap[e.source];
+    Node& target = nodeMap[e.target];
+
+    list<int>& out = source.adjacent[e.target];
+    out.remove(edge);
+    if(out.empty())
+    {
+        source.adjacent.erase(e.target);
+    }
+
+    list<int>& in = target.incoming[e.source];
+    in.remove(edge);
+    if(in.empty())
+    {
+        target.incoming.erase(e.source);
+    }
+
+    source.outDegree--;
+    target.inDegree--;
+    touchNode(e.source);
+    touchNode(e.target);
+
+    edges.erase(edge);
+    edgeMap.erase(edge);
+    topologyVersion++;
+
+    return true;
+}
+
+const Edge& Graph::getEdge(int edge)
+{
+    return edgeMap[edge];
+}
+
+const list<int>& Graph::getEdges(int source, int target)
+{
+    if(hasEdge(source, target))
+        return nodeMap[source].adjacent[target];
+
+    return empty;
+}
+
+const std::string& Graph::getEdgeLabel(int edge)
+{
+    return stringPool.get(edgeMap[edge].label);
+}
+
+const GLMaterial* Graph::getEdgeMaterial(int edge)
+{
+    return getEdgeMaterialFromId(edgeMap[edge].material);
+}
+
+const float Graph::getEdgeWeight(int edge)
+{
+    return edgeMap[edge].weight;
+}
+
+const set<int>& Graph::getEdges() const
+{
+    return edges;
+}
+
+const int Graph::getEdgeCount() const
+{
+    return (int)edges.size();
+}
+
+const bool Graph::hasEdge(int source, int target)
+{
+    return nodeMap[source].adjacent.find(target) != nodeMap[source].adjacent.end();
+}
+
+const bool Graph::isBidirectional(int edge)
+{
+    return isBidirectional(edgeMap[edge].source, edgeMap[edge].target);
+}
+
+const bool Graph::isBidirectional(int source, int target)
+{
+    return hasEdge(source, target) && hasEdge(target, source);
+}
+
+const bool Graph::isValidEdge(int edge) const
+{
+    return edgeMap.find(edge) != edgeMap.end();
+}
+
+void Graph::setEdgeColor(int edge, int r, int g, int b, int a)
+{
+    setEdgeColor(edge, r / 255.0, g / 255.0, b / 255.0, a / 255.0);
+}
+
+void Graph::setEdgeColor(int edge, double r, double g, double b, double a)
+{
+    mutex.lock();
+    bool valid = assignEdgeColor(edge, GLMaterial::Color(r, g, b, a));
+    mutex.unlock();
+
+    if(valid) notifyChange();
+}
+
+bool Graph::assignEdgeColor(int edge, const GLMaterial::Color& color)
+{
+    tr1::unordered_map<int, Edge>::iterator it = edgeMap.find(edge);
+
+    if(it == edgeMap.end())
+    {
+        return false;
+    }
+
+    it->second.material = getMaterial(color);
+    recordChange(edge, true, CHANGE_MATERIAL);
+
+    return true;
+}
+
+// rgba holds four components per edge; returns the number of edges colored
+const int Graph::setEdgeColors(const vector<int>& edgeIds, const vector<double>& rgba)
+{
+    int count = min(edgeIds.size(), rgba.size() / 4);
+    int colored = 0;
+
+    mutex.lock();
+
+    for(int i = 0; i < count; i++)
+    {
+        if(assignEdgeColor(edgeIds[i], GLMaterial::Color(rgba[4 * i], rgba[4 * i + 1], rgba[4 * i + 2], rgba[4 * i + 3])))
+        {
+            colored++;
+        }
+    }
+
+    // past the change log's size consumers rebuild anyway
+    if(count > CHANGE_LOG_SIZE && colored > 0)
+    {
+        markRebuild();
+    }
+
+    mutex.unlock();
+
+    if(colored > 0)
+    {
+        notifyChange();
+    }
+
+    return colored;
+}
+
+void Graph::setEdgeLabel(int edge, const std::string& label)
+{
+    mutex.lock();
+    bool valid = assignEdgeLabel(edge, label);
+    mutex.unlock();
+
+    if(valid) notifyChange();
+}
+
+bool Graph::assignEdgeLabel(int edge, const string& label)
+{
+    tr1::unordered_map<int, Edge>::iterator it = edgeMap.find(edge);
+
+    if(it == edgeMap.end())
+    {
+        return false;
+    }
+
+    it->second.label = stringPool.intern(label);
+    recordChange(edge, true, 0);
+
+    return true;
+}
+
+// returns the number of edges labelled
+const int Graph::setEdgeLabels(const vector<int>& edgeIds, const vector<string>& labels)
+{
+    int count = min(edgeIds.size(), labels.size());
+    int labelled = 0;
+
+    mutex.lock();
+
+    for(int i = 0; i < count; i++)
+    {
+        if(assignEdgeLabel(edgeIds[i], labels[i]))
+        {
+            labelled++;
+        }
+    }
+
+    // past the change log's size consumers rebuild anyway
+    if(count > CHANGE_LOG_SIZE && labelled > 0)
+    {
+        markRebuild();
+    }
+
+    mutex.unlock();
+
+    if(labelled > 0)
+    {
+        notifyChange();
+    }
+
+    return labelled;
+}
+
+void Graph::setEdgeWeight(int edge, float weight)
+{
+    mutex.lock();
+    bool valid = assignEdgeWeight(edge, weight);
+    mutex.unlock();
+
+    if(valid) notifyChange();
+}
+
+bool Graph::assignEdgeWeight(int edge, float weight)
+{
+    tr1::unordered_map<int, Edge>::iterator it = edgeMap.find(edge);
+
+    if(it == edgeMap.end())
+    {
+        return false;
+    }
+
+    it->second.weight = weight;
+    adjacencyVersion = -1; // weights are cached in the adjacency
+    edgePairsVersion = -1; // and in the edge pairs
+    boostViewVersion = -1; // and in the boost view
+    recordChange(edge, true, CHANGE_GEOMETRY);
+
+    return true;
+}
+
+// returns the number of edges weighted
+const int Graph::setEdgeWeights(const vector<int>& edgeIds, const vector<double>& weights)
+{
+    int count = min(edgeIds.size(), weights.size());
+    int weighted = 0;
+
+    mutex.lock();
+
+    for(int i = 0; i < count; i++)
+    {
+        if(assignEdgeWeight(edgeIds[i], weights[i]))
+        {
+            weighted++;
+        }
+    }
+
+    // past the change log's size consumers rebuild anyway
+    if(count > CHANGE_LOG_SIZE && weighted > 0)
+    {
+        markRebuild();
+    }
+
+    mutex.unlock();
+
+    if(weighted > 0)
+    {
+        notifyChange();
+    }
+
+    return weighted;
+}
+
+/*
+ * nodes
+ */
+const int Graph::addNode()
+{
+    mutex.lock();
+    int node = createNode();
+    mutex.unlock();
+
+    update();
+
+    return node;
+}
+
+// count new nodes under one lock and one update; their ids are consecutive
+// from the returned first one
+const int Graph::addNodes(int count)
+{
+    if(count <= 0)
+    {
+        return -1;
+    }
+
+    mutex.lock();
+
+    positions.reserve(positions.size() + count);
+    velocities.reserve(velocities.size() + count);
+    sizes.reserve(sizes.size() + count);
+    indexNodes.reserve(indexNodes.size() + count);
+
+    int first = createNode();
+
+    for(int i = 1; i < count; i++)
+    {
+        createNode();
+    }
+
+    mutex.unlock();
+    update();
+
+    return first;
+}
+
+// room for nodeCount more nodes and edgeCount more edges, so bulk loads do
+// not grow and rehash the stores as they go
+void Graph::reserve(int nodeCount, int edgeCount)
+{
+    mutex.lock();
+
+    size_t n = indexNodes.size() + max(nodeCount, 0);
+    size_t m = edges.size() + max(edgeCount, 0);
+
+    positions.reserve(n);
+    velocities.reserve(n);
+    sizes.reserve(n);
+    indexNodes.reserve(n);
+    nodeMap.rehash((size_t)(n / nodeMap.max_load_factor()) + 1);
+    edgeMap.rehash((size_t)(m / edgeMap.max_load_factor()) + 1);
+
+    mutex.unlock();
+}
+
+// caller holds the mutex and calls update()
+int Graph::createNode()
+{
+    Node n;
+    n.index = (int)indexNodes.size();
+
+    Vrui::Scalar scale = lastMaxDistance / 2; // effective radius
+
+    // New point should be around previous center of graph
+    positions.push_back(Vrui::Point(lastCenter[0] + scale * (2 * VruiHelp::randomFloat() - 1),
+                                    lastCenter[1] + scale * (2 * VruiHelp::randomFloat() - 1),
+                                    lastCenter[2] + scale * (2 * VruiHelp::randomFloat() - 1) ));
+    velocities.push_back(Vrui::Vector(0, 0, 0));
+    sizes.push_back(1);
+
+    nodeId++;
+    nodes.insert(nodeId);
+    nodeMap[nodeId] = n;
+    indexNodes.push_back(nodeId);
+    touchNode(nodeId);
+
+    if(componentsVersion == topologyVersion)
+    {
+        components.add();
+        componentsVersion++;
+    }
+
+    if(boundsPositionVersion == positionVersion && boundsTopologyVersion == topologyVersion)
+    {
+        bounds.add(positions.back());
+        boundsTopologyVersion++;
+    }
+
+    topologyVersion++;
+
+    return nodeId;
+}
+
+const int Graph::addNode(const Vrui::Point& position)
+{
+    int id = addNode();
+    setNodePosition(id, position);
+    return id;
+}
+
+const int Graph::addNode(const string& s)
+{
+    int id = addNode();
+    setNodeLabel(id, s);
+    return id;
+}
+
+const int Graph::deleteNode()
+{
+    return deleteNode(*nodes.begin());
+}
+
+const int Graph::deleteNode(int node)
+{
+    mutex.lock();
+
+    if(!removeNode(node))
+    {
+        mutex.unlock();
+        return -1;
+    }
+
+    mutex.unlock();
+    update();
+
+    return node;
+}
+
+/*
+ * Deletes every valid node in nodeIds together with its edges under one
+ * lock and one update. Returns the number of nodes deleted.
+ */
+const int Graph::deleteNodes(const vector<int>& nodeIds)
+{
+    int deleted = 0;
+
+    mutex.lock();
+
+    foreach(int node, nodeIds)
+    {
+        deleted += removeNode(node);
+    }
+
+    mutex.unlock();
+
+    if(deleted > 0)
+    {
+        update();
+    }
+
+    return deleted;
+}
+
+// removes node and its edges through its incidence lists, O(degree);
+// caller holds the mutex and calls update()
+bool Graph::removeNode(int node)
+{
+    if(!isValidNode(node))
+    {
+        return false;
+    }
+
+    Node& n = nodeMap[node];
+    typedef std::tr1::unordered_map<int, list<int> > Incidence;
+
+    // former neighbors lose the edges and relax into the gap
+    foreach(const Incidence::value_type& out, n.adjacent)
+    {
+        if(out.first != node)
+        {
+            Node& target = nodeMap[out.first];
+            target.incoming.erase(node);
+            target.inDegree -= out.second.size();
+            touchNode(out.first);
+        }
+
+        foreach(int edge, out.second)
+        {
+            edges.erase(edge);
+            edgeMap.erase(edge);
+        }
+    }
+
+    foreach(const Incidence::value_type& in, n.incoming)
+    {
+        // self loops went with the out-edges
+        if(in.first == node)
+        {
+            continue;
+        }
+
+        Node& source = nodeMap[in.first];
+        source.adjacent.erase(node);
+        source.outDegree -= in.second.size();
+        touchNode(in.first);
+
+        foreach(int edge, in.second)
+        {
+            edges.erase(edge);
+            edgeMap.erase(edge);
+        }
+    }
+
+    // keep the dense arrays compact by moving the last node into the hole
+    int index = n.index;
+    int last = (int)indexNodes.size() - 1;
+
+    if(index != last)
+    {
+        indexNodes[index] = indexNodes[last];
+        positions[index] = positions[last];
+        velocities[index] = velocities[last];
+        sizes[index] = sizes[last];
+        nodeMap[indexNodes[index]].index = index;
+    }
+
+    indexNodes.pop_back();
+    positions.pop_back();
+    velocities.pop_back();
+    sizes.pop_back();
+
+    // the bounds still hold the remaining nodes
+    if(boundsPositionVersion == positionVersion && boundsTopologyVersion == topologyVersion)
+    {
+        boundsTopologyVersion++;
+    }
+
+    removeNodeAttributes(node);
+    nodes.erase(node);
+    nodeMap.erase(node);
+    topologyVersion++;
+
+    return true;
+}
+
+// in the order the keys were first set on any node
+const Attributes Graph::getNodeAttributes(int node)
+{
+    const AttributeStore& store = *attributeStore;
+    Attributes result;
+
+    for(int i = 0; i < (int)store.keys.size(); i++)
+    {
+        tr1::unordered_map<int, int>::const_iterator value = store.columns[i].find(node);
+
+        if(value != store.columns[i].end())
+        {
+            result.push_back(make_pair(stringPool.get(store.keys[i]), stringPool.get(value->second)));
+        }
+    }
+
+    return result;
+}
+
+const int Graph::getNodeComponent(int node)
+{
+    refreshComponents();
+
+    return indexNodes[components.find(nodeMap[node].index)];
+}
+
+const vector<int>& Graph::getComponentIndices(int node)
+{
+    refreshComponents();
+
+    return components.members[components.find(nodeMap[node].index)];
+}
+
+const int Graph::getNodeDegree(int node)
+{
+    return nodeMap[node].inDegree + nodeMap[node].outDegree;
+}
+
+const string& Graph::getNodeLabel(int node)
+{
+    return stringPool.get(nodeMap[node].label);
+}
+
+const GLMaterial* Graph::getNodeMaterial(int node)
+{
+    return getNodeMaterialFromId(nodeMap[node].material);
+}
+
+const set<int>& Graph::getNodes() const
+{
+    return nodes;
+}
+
+const int Graph::getNodeCount() const
+{
+    return (int)nodes.size();
+}
+
+const std::string& Graph::getNodeImagePath(int node)
+{
+    return stringPool.get(nodeMap[node].imagePath);
+}
+
+const double Graph::getNodeImageScale(int node)
+{
+    return nodeMap[node].imageScale;
+}
+
+const Vrui::Point& Graph::getNodePosition(int node)
+{
+    return positions[nodeMap[node].index];
+}
+
+const float Graph::getNodeSize(int node)
+{
+    return sizes[nodeMap[node].index];
+}
+
+const int Graph::getNodeType(int node)
+{
+    return nodeMap[node].type;
+}
+
+const Vrui::Point& Graph::getSourceNodePosition(int edge)
+{
+    return positions[nodeMap[edgeMap[edge].source].index];
+}
+
+const Vrui::Point& Graph::getTargetNodePosition(int edge)
+{
+    return positions[nodeMap[edgeMap[edge].target].index];
+}
+
+const Vrui::Vector& Graph::getNodeVelocity(int node)
+{
+    return velocities[nodeMap[node].index];
+}
+
+const bool Graph::isValidNode(int node) const
+{
+    return nodeMap.find(node) != nodeMap.end();
+}
+
+void Graph::moveNodes(const Vrui::Vector &offset)
+{
+    // Note: we don't lock.  The drawing methods work with a copy.
+    // And so what if the layout algorithm works with the old position
+    // for one more time step, assuming the main or RPC thread modifies it.
+    // It will get the new one at the update. Hopefully this causes no issues.
+    for(int index = 0; index < (int)positions.size(); index++)
+    {
+        positions[index] += offset;
+    }
+    lastCenter += offset;
+
+    bool boundsCurrent = boundsPositionVersion == positionVersion && boundsTopologyVersion == topologyVersion;
+    bounds.translate(offset);
+
+    updatePositions();
+
+    if(boundsCurrent)
+    {
+        boundsPositionVersion = positionVersion;
+    }
+}
+
+void Graph::moveNodes(const Vrui::Point &offset)
+{
+    Vrui::Vector v(offset[0], offset[1], offset[2]);
+    moveNodes(v);
+}
+
+
+// replaces the node's value for key, if any
+void Graph::setNodeAttribute(int node, const string& key, const string& value)
+{
+    mutex.lock();
+    assignNodeAttribute(node, key, value);
+    mutex.unlock();
+}
+
+bool Graph::assignNodeAttribute(int node, const string& key, const string& value)
+{
+    if(!isValidNode(node))
+    {
+        return false;
+    }
+
+    int keyId = stringPool.intern(key);
+    int valueId = stringPool.intern(value);
+    AttributeStore& store = editAttributes();
+
+    // few keys per graph, each a column
+    int column = find(store.keys.begin(), store.keys.end(), keyId) - store.keys.begin();
+
+    if(column == (int)store.keys.size())
+    {
+        store.keys.push_back(keyId);
+        store.columns.resize(column + 1);
+    }
+
+    store.columns[column][node] = valueId;
+
+    return true;
+}
+
+// the attribute store, unshared first if a copy still uses it
+AttributeStore& Graph::editAttributes()
+{
+    if(!attributeStore.unique())
+    {
+        attributeStore.reset(new AttributeStore(*attributeStore));
+    }
+
+    return *attributeStore;
+}
+
+void Graph::removeNodeAttributes(int node)
+{
+    const AttributeStore& store = *attributeStore;
+    bool found = false;
+
+    for(int i = 0; !found && i < (int)store.columns.size(); i++)
+    {
+        found = store.columns[i].count(node) > 0;
+    }
+
+    if(found)
+    {
+        AttributeStore& edited = editAttributes();
+
+        for(int i = 0; i < (int)edited.columns.size(); i++)
+        {
+            edited.columns[i].erase(node);
+        }
+    }
+}
+
+void Graph::setNodeColor(int node, int r, int g, int b, int a)
+{
+    setNodeColor(node, r / 255.0, g / 255.0, b / 255.0, a / 255.0);
+}
+
+void Graph::setNodeColor(int node, double r, double g, double b, double a)
+{
+    mutex.lock();
+    bool valid = assignNodeColor(node, GLMaterial::Color(r, g, b, a));
+    mutex.unlock();
+
+    if(valid) notifyChange();
+}
+
+bool Graph::assignNodeColor(int node, const GLMaterial::Color& color)
+{
+    tr1::unordered_map<int, Node>::iterator it = nodeMap.find(node);
+
+    if(it == nodeMap.end())
+    {
+        return false;
+    }
+
+    it->second.material = getMaterial(color);
+    recordChange(node, false, CHANGE_MATERIAL);
+
+    return true;
+}
+
+// rgba holds four components per node; returns the number of nodes colored
+const int Graph::setNodeColors(const vector<int>& nodeIds, const vector<double>& rgba)
+{
+    int count = min(nodeIds.size(), rgba.size() / 4);
+    int colored = 0;
+
+    mutex.lock();
+
+    for(int i = 0; i < count; i++)
+    {
+        if(assignNodeColor(nodeIds[i], GLMaterial::Color(rgba[4 * i], rgba[4 * i + 1], rgba[4 * i + 2], rgba[4 * i + 3])))
+        {
+            colored++;
+        }
+    }
+
+    // past the change log's size consumers rebuild anyway
+    if(count > CHANGE_LOG_SIZE && colored > 0)
+    {
+        markRebuild();
+    }
+
+    mutex.unlock();
+
+    if(colored > 0)
+    {
+        notifyChange();
+    }
+
+    return colored;
+}
+
+void Graph::setNodeImagePath(int node, const string& imagePath)
+{
+    mutex.lock();
+    bool valid = assignNodeImagePath(node, imagePath);
+    mutex.unlock();
+
+    if(valid) notifyChange();
+}
+
+bool Graph::assignNodeImagePath(int node, const string& imagePath)
+{
+    tr1::unordered_map<int, Node>::iterator it = nodeMap.find(node);
+
+    if(it == nodeMap.end())
+    {
+        return false;
+    }
+
+    it->second.imagePath = stringPool.intern(imagePath);
+    markRebuild();
+
+    return true;
+}
+
+void Graph::setNodeImageScale(int node, const double& scale)
+{
+    mutex.lock();
+    bool valid = assignNodeImageScale(node, scale);
+    mutex.unlock();
+
+    if(valid) notifyChange();
+}
+
+bool Graph::assignNodeImageScale(int node, double scale)
+{
+    tr1::unordered_map<int, Node>::iterator it = nodeMap.find(node);
+
+    if(it == nodeMap.end())
+    {
+        return false;
+    }
+
+    it->second.imageScale = scale;
+    markRebuild();
+
+    return true;
+}
+
+void Graph::setNodeLabel(int node, const std::string& label)
+{
+    mutex.lock();
+    bool valid = assignNodeLabel(node, label);
+    mutex.unlock();
+
+    if(valid) notifyChange();
+}
+
+bool Graph::assignNodeLabel(int node, const string& label)
+{
+    tr1::unordered_map<int, Node>::iterator it = nodeMap.find(node);
+
+    if(it == nodeMap.end())
+    {
+        return false;
+    }
+
+    it->second.label = stringPool.intern(label);
+    recordChange(node, false, 0);
+
+    return true;
+}
+
+// returns the number of nodes labelled
+const int Graph::setNodeLabels(const vector<int>& nodeIds, const vector<string>& labels)
+{
+    int count = min(nodeIds.size(), labels.size());
+    int labelled = 0;
+
+    mutex.lock();
+
+    for(int i = 0; i < count; i++)
+    {
+        if(assignNodeLabel(nodeIds[i], labels[i]))
+        {
+            labelled++;
+        }
+    }
+
+    // past the change log's size consumers rebuild anyway
+    if(count > CHANGE_LOG_SIZE && labelled > 0)
+    {
+        markRebuild();
+    }
+
+    mutex.unlock();
+
+    if(labelled > 0)
+    {
+        notifyChange();
+    }
+
+    return labelled;
+}
+
+void Graph::setNodePosition(int node, const Vrui::Point& position)
+{
+    mutex.lock();
+
+    tr1::unordered_map<int, Node>::iterator it = nodeMap.find(node);
+
+    if(it == nodeMap.end())
+    {
+        mutex.unlock();
+        return;
+    }
+
+    positions[it->second.index] = position;
+
+    mutex.unlock();
+    updatePositions();
+}
+
+// xyz holds three coordinates per node; returns the number of nodes moved
+const int Graph::setNodePositions(const vector<int>& nodeIds, const vector<double>& xyz)
+{
+    int count = min(nodeIds.size(), xyz.size() / 3);
+    int moved = 0;
+
+    mutex.lock();
+
+    for(int i = 0; i < count; i++)
+    {
+        if(isValidNode(nodeIds[i]))
+        {
+            positions[nodeMap[nodeIds[i]].index] = Vrui::Point(xyz[3 * i], xyz[3 * i + 1], xyz[3 * i + 2]);
+            moved++;
+        }
+    }
+
+    mutex.unlock();
+
+    if(moved > 0)
+    {
+        updatePositions();
+    }
+
+    return moved;
+}
+
+// "image" or "shape", anything else draws as a shape
+void Graph::setNodeType(int node, const string& type)
+{
+    mutex.lock();
+    bool valid = assignNodeType(node, type);
+    mutex.unlock();
+
+    if(valid) notifyChange();
+}
+
+bool Graph::assignNodeType(int node, const string& type)
+{
+    tr1::unordered_map<int, Node>::iterator it = nodeMap.find(node);
+
+    if(it == nodeMap.end())
+    {
+        return false;
+    }
+
+    it->second.type = type == "image" ? NODE_IMAGE : NODE_SHAPE;
+    markRebuild();
+
+    return true;
+}
+
+void Graph::setNodeVelocity(int node, const Vrui::Vector& velocity)
+{
+    mutex.lock();
+
+    tr1::unordered_map<int, Node>::iterator it = nodeMap.find(node);
+
+    if(it != nodeMap.end())
+    {
+        velocities[it->second.index] = velocity;
+    }
+
+    mutex.unlock();
+}
+
+void Graph::setNodeSize(int node, float size)
+{
+    mutex.lock();
+    bool valid = assignNodeSize(node, size);
+    mutex.unlock();
+
+    if(valid) notifyChange();
 }
 
-const int Graph::deleteNode(int node)
+bool Graph::assignNodeSize(int node, float size)
 {
-    mutex.lock();
+    tr1::unordered_map<int, Node>::iterator it = nodeMap.find(node);
 
-    if(!isValidNode(node))
+    if(it == nodeMap.end())
     {
-        mutex.unlock();
-        return -1;
+        return false;
     }
 
-    vector<int> killList(0);
+    sizes[it->second.index] = size;
+    recordChange(node, false, CHANGE_GEOMETRY);
 
-    foreach(int edge, edges)
-    {
-        Edge& e = edgeMap[edge];
+    return true;
+}
+
+// returns the number of nodes resized
+const int Graph::setNodeSizes(const vector<int>& nodeIds, const vector<double>& newSizes)
+{
+    int count = min(nodeIds.size(), newSizes.size());
+    int resized = 0;
+
+    mutex.lock();
 
-        if(e.source == node || e.target == node)
+    for(int i = 0; i < count; i++)
+    {
+        if(assignNodeSize(nodeIds[i], newSizes[i]))
         {
-            killList.push_back(edge);
+            resized++;
         }
     }
 
-    foreach(int edge, killList)
+    // past the change log's size consumers rebuild anyway
+    if(count > CHANGE_LOG_SIZE && resized > 0)
     {
-        edges.erase(edge);
-        edgeMap.erase(edge);
+        markRebuild();
     }
 
-    nodes.erase(node);
-    nodeMap.erase(node);
-
     mutex.unlock();
-    update();
 
-    return node;
-}
+    if(resized > 0)
+    {
+        notifyChange();
+    }
 
-const Attributes& Graph::getNodeAttributes(int node)
-{
-    return nodeMap[node].attributes;
+    return resized;
 }
 
-const int Graph::getNodeComponent(int node)
+void Graph::updateNodePosition(int node, const Vrui::Vector& delta)
 {
-    return nodeMap[node].component;
+    mutex.lock();
+
+    tr1::unordered_map<int, Node>::iterator it = nodeMap.find(node);
+
+    if(it == nodeMap.end())
+    {
+        mutex.unlock();
+        return;
+    }
+
+    positions[it->second.index] += delta;
+
+    mutex.unlock();
+    updatePositions();
 }
 
-const int Graph::getNodeDegree(int node)
+// no update() needed
+void Graph::updateNodeVelocity(int node, const Vrui::Vector& delta)
 {
-    return nodeMap[node].inDegree + nodeMap[node].outDegree;
+    mutex.lock();
+
+    tr1::unordered_map<int, Node>::iterator it = nodeMap.find(node);
+
+    if(it != nodeMap.end())
+    {
+        velocities[it->second.index] += delta;
+    }
+
+    mutex.unlock();
 }
 
-const string& Graph::getNodeLabel(int node)
+/*
+ * dense storage
+ */
+
+// the returned cache is rebuilt in place by the next topology change, so only
+// a thread no other thread edits the graph for may hold on to it (the render copy)
+const Adjacency& Graph::getAdjacency()
 {
-    return nodeMap[node].label;
+    mutex.lock();
+    refreshAdjacency();
+    mutex.unlock();
+
+    return adjacency;
 }
 
-const GLMaterial* Graph::getNodeMaterial(int node)
+// copied under the lock, safe while other threads edit the graph
+void Graph::getAdjacency(Adjacency& out)
 {
-    return getNodeMaterialFromId(nodeMap[node].material);
+    mutex.lock();
+    refreshAdjacency();
+    out = adjacency;
+    mutex.unlock();
 }
 
-const set<int>& Graph::getNodes() const
+void Graph::refreshAdjacency()
 {
-    return nodes;
+    if(adjacencyVersion != topologyVersion)
+    {
+        int nodeCount = (int)indexNodes.size();
+
+        adjacency.offsets.assign(nodeCount + 1, 0);
+        adjacency.targets.resize(edges.size());
+        adjacency.edges.resize(edges.size());
+        adjacency.weights.resize(edges.size());
+
+        // count out-edges per source, then prefix sum into row offsets
+        foreach(int edge, edges)
+        {
+            adjacency.offsets[nodeMap[edgeMap[edge].source].index + 1]++;
+        }
+
+        for(int index = 0; index < nodeCount; index++)
+        {
+            adjacency.offsets[index + 1] += adjacency.offsets[index];
+        }
+
+        vector<int> fill(adjacency.offsets.begin(), adjacency.offsets.end() - 1);
+
+        foreach(int edge, edges)
+        {
+            const Edge& e = edgeMap[edge];
+            int slot = fill[nodeMap[e.source].index]++;
+
+            adjacency.targets[slot] = nodeMap[e.target].index;
+            adjacency.edges[slot] = edge;
+            adjacency.weights[slot] = e.weight;
+        }
+
+        adjacencyVersion = topologyVersion;
+    }
 }
 
-const int Graph::getNodeCount() const
+const EdgePairs& Graph::getEdgePairs()
 {
-    return (int)nodes.size();
+    mutex.lock();
+    refreshEdgePairs();
+    mutex.unlock();
+
+    return edgePairs;
 }
 
-const std::string& Graph::getNodeImagePath(int node)
+// returns the topology version the copy matches
+const int Graph::getEdgePairs(EdgePairs& out)
 {
-    return nodeMap[node].imagePath;
+    mutex.lock();
+    refreshEdgePairs();
+    out = edgePairs;
+    int version = topologyVersion;
+    mutex.unlock();
+
+    return version;
 }
 
-const double Graph::getNodeImageScale(int node)
+// after deletions, every node starts alone again and the edges join them
+void Graph::refreshComponents()
 {
-    return nodeMap[node].imageScale;
+    if(componentsVersion != topologyVersion)
+    {
+        components.clear();
+
+        for(int index = 0; index < (int)indexNodes.size(); index++)
+        {
+            components.add();
+        }
+
+        foreach(int edge, edges)
+        {
+            const Edge& e = edgeMap[edge];
+            components.join(nodeMap[e.source].index, nodeMap[e.target].index);
+        }
+
+        componentsVersion = topologyVersion;
+    }
 }
 
-const Vrui::Point& Graph::getNodePosition(int node)
+void Graph::refreshEdgePairs()
 {
-    return nodeMap[node].position;
+    refreshAdjacency();
+
+    if(edgePairsVersion != topologyVersion)
+    {
+        // (low, high, direction, slot) per edge, sorted so both directions of
+        // a pair and any parallel edges end up next to each other
+        vector<pair<pair<int, int>, pair<int, int> > > keyed;
+        keyed.reserve(adjacency.targets.size());
+
+        for(int source = 0; source + 1 < (int)adjacency.offsets.size(); source++)
+        {
+            for(int slot = adjacency.offsets[source]; slot < adjacency.offsets[source + 1]; slot++)
+            {
+                int target = adjacency.targets[slot];
+
+                if(source == target) continue;
+
+                keyed.push_back(make_pair(make_pair(min(source, target), max(source, target)),
+                                          make_pair(source < target ? EDGE_PAIR_FORWARD : EDGE_PAIR_BACKWARD, slot)));
+            }
+        }
+
+        sort(keyed.begin(), keyed.end());
+        edgePairs.clear();
+        edgePairs.nodeCount = (int)adjacency.offsets.size() - 1;
+
+        for(int i = 0; i < (int)keyed.size(); i++)
+        {
+            int slot = keyed[i].second.second;
+
+            // forward edges sort first, so the representative is forward when possible
+            if(i == 0 || keyed[i].first != keyed[i - 1].first)
+            {
+                edgePairs.sources.push_back(keyed[i].first.first);
+                edgePairs.targets.push_back(keyed[i].first.second);
+                edgePairs.weights.push_back(0);
+                edgePairs.counts.push_back(0);
+                edgePairs.edges.push_back(adjacency.edges[slot]);
+                edgePairs.multiplicities.push_back(0);
+                edgePairs.directions.push_back(0);
+            }
+
+            char& directions = edgePairs.directions.back();
+            directions |= keyed[i].second.first;
+            edgePairs.weights.back() += adjacency.weights[slot];
+            edgePairs.counts.back() = (directions & EDGE_PAIR_FORWARD ? 1 : 0) + (directions & EDGE_PAIR_BACKWARD ? 1 : 0);
+            edgePairs.multiplicities.back()++;
+        }
+
+        edgePairsVersion = topologyVersion;
+    }
 }
 
-const float Graph::getNodeSize(int node)
+const int Graph::getIndexNode(int index) const
 {
-    return nodeMap[node].size;
+    return indexNodes[index];
 }
 
-const std::string& Graph::getNodeType(int node)
+const vector<int>& Graph::getIndexNodes() const
 {
-    return nodeMap[node].type;
+    return indexNodes;
 }
 
-const Vrui::Point& Graph::getSourceNodePosition(int edge)
+const int Graph::getNodeIndex(int node)
 {
-    return nodeMap[edgeMap[edge].source].position;
+    return nodeMap[node].index;
 }
 
-const Vrui::Point& Graph::getTargetNodePosition(int edge)
+const vector<Vrui::Point>& Graph::getPositions() const
 {
-    return nodeMap[edgeMap[edge].target].position;
+    return positions;
 }
 
-const Vrui::Vector& Graph::getNodeVelocity(int node)
+const vector<float>& Graph::getSizes() const
 {
-    return nodeMap[node].velocity;
+    return sizes;
 }
 
-const bool Graph::isValidNode(int node) const
+const vector<Vrui::Vector>& Graph::getVelocities() const
 {
-    return nodeMap.find(node) != nodeMap.end();
+    return velocities;
 }
 
-void Graph::moveNodes(const Vrui::Vector &offset)
+// deltas are indexed by dense node index
+// caller holds the mutex
+void Graph::touchNode(int node)
 {
-    // Note: we don't lock.  The drawing methods work with a copy.
-    // And so what if the layout algorithm works with the old position
-    // for one more time step, assuming the main or RPC thread modifies it.
-    // It will get the new one at the update. Hopefully this causes no issues.
-    foreach(int node, nodes)
+    // past this many entries a full relaxation is cheaper than tracking
+    if(allTouched || touchedNodes.size() > indexNodes.size())
     {
-        nodeMap[node].position += offset;
+        allTouched = true;
+        touchedNodes.clear();
+        return;
     }
-    lastCenter += offset;
 
-    update();
+    touchedNodes.push_back(node);
 }
 
-void Graph::moveNodes(const Vrui::Point &offset)
+/*
+ * Moves the nodes touched by edits since the last call into the given list,
+ * possibly with duplicates or since deleted ids. Returns true instead if
+ * everything should be considered touched (after a clear or a bulk change).
+ */
+bool Graph::takeTouchedNodes(vector<int>& nodes)
 {
-    Vrui::Vector v(offset[0], offset[1], offset[2]);
-    moveNodes(v);
-}
+    mutex.lock();
 
+    bool all = allTouched;
+    nodes.clear();
+    nodes.swap(touchedNodes);
+    allTouched = false;
 
-void Graph::setNodeAttribute(int node, string& key, string& value)
-{
-    nodeMap[node].attributes.push_back(pair<string, string>(key, value));
-}
+    mutex.unlock();
 
-void Graph::setNodeColor(int node, int r, int g, int b, int a)
-{
-    setNodeColor(node, r / 255.0, g / 255.0, b / 255.0, a / 255.0);
+    return all;
 }
 
-void Graph::setNodeColor(int node, double r, double g, double b, double a)
+// absolute positions by dense index, ignored if the node count has changed;
+// returns the resulting position version
+const int Graph::setNodePositions(const vector<Vrui::Point>& newPositions)
 {
-    GLMaterial::Color c(r, g, b, a);
-    int materialId = -1;
+    mutex.lock();
 
-    // look for color in the cache
-    for(int i = 0; i < (int)materialVector.size(); i++)
+    if(newPositions.size() == positions.size())
     {
-        if(materialVector[i]->ambient == c)
-        {
-            materialId = i;
-            break;
-        }
+        positions = newPositions;
+        commitPositions();
     }
 
-    // if not found, add it
-    if(materialId == -1)
+    int result = positionVersion;
+    mutex.unlock();
+    Vrui::requestUpdate();
+
+    return result;
+}
+
+void Graph::updateNodePositions(const vector<Vrui::Vector>& deltas)
+{
+    mutex.lock();
+
+    int count = min(deltas.size(), positions.size());
+
+    for(int index = 0; index < count; index++)
     {
-        materialVector.push_back(new GLMaterial(c));
-        materialId = materialVector.size() - 1;
+        positions[index] += deltas[index];
     }
 
-    nodeMap[node].material = materialId;
+    commitPositions();
 
-    update();
+    mutex.unlock();
+    Vrui::requestUpdate();
 }
 
-void Graph::setNodeImagePath(int node, const string& imagePath)
+/*
+ * Ends a layout step. The step always gets a new position version, but is
+ * only published if the last publication is older than the publish
+ * interval; otherwise it is left to the next step or to flushPositions(),
+ * so that fast layouts don't copy every position for every step while the
+ * renderer only draws one step per frame. Caller holds the graph mutex.
+ */
+void Graph::commitPositions()
 {
-    nodeMap[node].imagePath = imagePath;
+    positionVersion++;
 
-    update();
+    if(Vrui::getApplicationTime() - lastPublishTime >= publishInterval)
+    {
+        publishPositions();
+    }
+    else
+    {
+        deferredPositionVersion = positionVersion;
+    }
 }
 
-void Graph::setNodeImageScale(int node, const double& scale)
+// caller holds the graph mutex
+void Graph::publishPositions()
 {
-    nodeMap[node].imageScale = scale;
+    lastPublishTime = Vrui::getApplicationTime();
+    deferredPositionVersion = -1;
+    backPositions = positions;
+    refreshBounds();
 
-    update();
+    publishMutex.lock();
+    readyPositions.swap(backPositions);
+    readyPositionVersion = positionVersion;
+    readyTopologyVersion = topologyVersion;
+    positionsReady = true;
+    publishMutex.unlock();
 }
 
-void Graph::setNodeLabel(int node, const std::string& label)
+/*
+ * Publishes a step held back by commitPositions() once the publish interval
+ * has passed, e.g. the last step before a layout stopped or slowed down.
+ * Called by the renderer every frame; returns true if it published.
+ */
+bool Graph::flushPositions()
 {
-    nodeMap[node].label = label;
+    if(!isPublishPending())
+    {
+        return false;
+    }
 
-    update();
-}
+    if(Vrui::getApplicationTime() - lastPublishTime < publishInterval)
+    {
+        // come back for it on a later frame
+        Vrui::requestUpdate();
+        return false;
+    }
 
-void Graph::setNodePosition(int node, const Vrui::Point& position)
-{
-    nodeMap[node].position = position;
+    mutex.lock();
+    bool flushed = isPublishPending();
+    if(flushed)
+    {
+        publishPositions();
+    }
+    mutex.unlock();
 
-    update();
+    return flushed;
 }
 
-void Graph::setNodeType(int node, const string& type)
+// at most hz publications a second, every step if hz is not positive
+void Graph::setPublishRate(double hz)
 {
-    nodeMap[node].type = type;
-
-    update();
+    publishInterval = hz > 0 ? 1.0 / hz : 0;
 }
 
-void Graph::setNodeVelocity(int node, const Vrui::Vector& velocity)
+void Graph::copyPositions(Graph& g)
 {
-    nodeMap[node].velocity = velocity;
+    positions = g.positions;
+    positionVersion = g.positionVersion;
 }
 
-void Graph::setNodeSize(int node, float size)
+/*
+ * Swaps in the positions last published by g without touching g's mutex.
+ * Fails if nothing newer was published or if the topology has changed since,
+ * in which case the caller falls back to copyPositions or a full copy.
+ */
+bool Graph::takePublishedPositions(Graph& g)
 {
-    nodeMap[node].size = size;
+    bool taken = false;
 
-    update();
-}
+    g.publishMutex.lock();
 
-void Graph::updateNodePosition(int node, const Vrui::Vector& delta)
-{
-    nodeMap[node].position += delta;
+    if(g.positionsReady && g.readyPositionVersion > positionVersion
+       && g.readyTopologyVersion == topologyVersion && g.readyPositions.size() == positions.size())
+    {
+        positions.swap(g.readyPositions);
+        positionVersion = g.readyPositionVersion;
+        g.positionsReady = false;
+        taken = true;
+    }
 
-    update();
+    g.publishMutex.unlock();
+
+    return taken;
 }
 
 // no update() needed
-void Graph::updateNodeVelocity(int node, const Vrui::Vector& delta)
+void Graph::updateNodeVelocities(const vector<Vrui::Vector>& deltas)
 {
-    nodeMap[node].velocity += delta;
+    mutex.lock();
+
+    int count = min(deltas.size(), velocities.size());
+
+    for(int index = 0; index < count; index++)
+    {
+        velocities[index] += deltas[index];
+    }
+
+    mutex.unlock();
 }
 
 /*
  * boost wrappers
  */
-boost::BoostGraph Graph::toBoost()
+/*
+ * Rebuilds the boost view from the edge pairs when the topology or the
+ * weights have changed since it was built, dropping the cached results.
+ */
+void Graph::refreshBoostView()
+{
+    if(boostViewVersion == topologyVersion)
+    {
+        return;
+    }
+
+    refreshEdgePairs();
+
+    int n = edgePairs.nodeCount;
+    int pairCount = (int)edgePairs.sources.size();
+
+    // both directions of every pair, sorted by source as the CSR wants them
+    vector<int> offsets(n + 1, 0);
+
+    for(int i = 0; i < pairCount; i++)
+    {
+        offsets[edgePairs.sources[i] + 1]++;
+        offsets[edgePairs.targets[i] + 1]++;
+    }
+
+    for(int i = 0; i < n; i++)
+    {
+        offsets[i + 1] += offsets[i];
+    }
+
+    vector<pair<int, int> > arcs(2 * pairCount);
+    boostView.clear();
+    boostView.weights.resize(2 * pairCount);
+
+    for(int i = 0; i < pairCount; i++)
+    {
+        int s = edgePairs.sources[i];
+        int t = edgePairs.targets[i];
+
+        boostView.weights[offsets[s]] = edgePairs.weights[i];
+        arcs[offsets[s]++] = make_pair(s, t);
+        boostView.weights[offsets[t]] = edgePairs.weights[i];
+        arcs[offsets[t]++] = make_pair(t, s);
+    }
+
+    boostView.graph = boost::CsrGraph(boost::edges_are_sorted, arcs.begin(), arcs.end(), n);
+    boostView.nodes = indexNodes;
+    boostView.idCount = nodeId + 1;
+    boostViewVersion = topologyVersion;
+}
+
+// a predecessor map by dense index as one by node id, nodes without a
+// predecessor and ids without a node pointing to themselves
+vector<int> Graph::toNodeIds(const vector<int>& predecessors) const
 {
-    boost::BoostGraph g;
+    vector<int> result(boostView.idCount);
 
-    for(int node = 0; node > getNodeCount(); node++)
+    for(int id = 0; id < (int)result.size(); id++)
     {
-        boost::add_vertex(g);
+        result[id] = id;
     }
 
-    for(int edge = 0; edge < getEdgeCount(); edge++)
+    for(int i = 0; i < (int)predecessors.size(); i++)
     {
-        boost::add_edge(edgeMap[edge].source, edgeMap[edge].target, g);
+        result[boostView.nodes[i]] = boostView.nodes[predecessors[i]];
     }
 
-    return g;
+    return result;
 }
 
 // boost divides degree by 2, results won't match networkx python package
@@ -723,70 +2773,87 @@ boost::BoostGraph Graph::toBoost()
 vector<double> Graph::getBetweennessCentrality()
 {
     mutex.lock();
+    refreshBoostView();
 
-    boost::BoostGraph g = toBoost();
-    vector<double> bc(getNodeCount());
+    if(boostView.centrality.empty())
+    {
+        const boost::CsrGraph& g = boostView.graph;
+        vector<double> bc(num_vertices(g), 0);
+
+        brandes_betweenness_centrality(g,
+                boost::centrality_map(boost::make_iterator_property_map(bc.begin(), get(boost::vertex_index, g))));
+
+        // every pair is counted from both directions, halve it as for undirected graphs
+        boostView.centrality.assign(boostView.idCount, 0);
+
+        for(int i = 0; i < (int)bc.size(); i++)
+        {
+            boostView.centrality[boostView.nodes[i]] = bc[i] / 2;
+        }
+    }
 
-    if(getNodeCount() == 0) return bc;
-    brandes_betweenness_centrality(g,
-            make_iterator_property_map(bc.begin(), boost::get(boost::vertex_index, g)));
+    vector<double> result = boostView.centrality;
 
     mutex.unlock();
-    return bc;
+    return result;
 }
 
+// fewest hops from the previously selected node, as a predecessor map
 vector<int> Graph::getShortestPath()
 {
     mutex.lock();
+    refreshBoostView();
+
+    int source = application->getPreviousNode();
 
-    boost::BoostGraph g = toBoost();
-    vector<int> p(getNodeCount());
-    vector<int> d(getNodeCount());
+    if(source != boostView.shortestPathSource || boostView.shortestPath.empty())
+    {
+        boostView.shortestPath.clear();
+        boostView.shortestPathSource = source;
 
-    if(getNodeCount() == 0) return p;
-    dijkstra_shortest_paths(g,
-            application->getPreviousNode(),
-            &p[0],
-            &d[0],
-            boost::get(boost::edge_weight, g),
-            boost::get(boost::vertex_index, g),
-            std::less<int>(), // compare
-            boost::closed_plus<int>(), // combine
-            std::numeric_limits<int>::max(), // max dist
-            0, // zero dist
-            boost::default_dijkstra_visitor());
+        if(isValidNode(source))
+        {
+            const boost::CsrGraph& g = boostView.graph;
+            vector<int> p(num_vertices(g));
 
-    mutex.unlock();
-    return p;
-}
+            for(int i = 0; i < (int)p.size(); i++)
+            {
+                p[i] = i;
+            }
 
-vector<int> Graph::getSpanningTree()
-{
-    mutex.lock();
+            breadth_first_search(g, nodeMap[source].index,
+                    boost::visitor(boost::make_bfs_visitor(boost::record_predecessors(
+                        boost::make_iterator_property_map(p.begin(), get(boost::vertex_index, g)), boost::on_tree_edge()))));
 
-    boost::BoostGraph g = toBoost();
-    vector<int> p(getNodeCount());
+            boostView.shortestPath = toNodeIds(p);
+        }
+    }
 
-    if(getNodeCount() == 0) return p;
-    prim_minimum_spanning_tree(g, &p[0]);
+    vector<int> result = boostView.shortestPath;
 
     mutex.unlock();
-    return p;
+    return result;
 }
 
-void Graph::setComponents()
+vector<int> Graph::getSpanningTree()
 {
     mutex.lock();
+    refreshBoostView();
 
-    boost::BoostGraph g = toBoost();
-    vector<int> c(getNodeCount());
+    if(boostView.spanningTree.empty() && boostView.idCount > 0)
+    {
+        const boost::CsrGraph& g = boostView.graph;
+        vector<int> p(num_vertices(g));
 
-    connected_components(g, &c[0]);
+        prim_minimum_spanning_tree(g,
+                boost::make_iterator_property_map(p.begin(), get(boost::vertex_index, g)),
+                boost::weight_map(boost::make_iterator_property_map(boostView.weights.begin(), get(boost::edge_index, g))));
 
-    foreach(int node, nodes)
-    {
-        nodeMap[node].component = c[node];
+        boostView.spanningTree = toNodeIds(p);
     }
 
+    vector<int> result = boostView.spanningTree;
+
     mutex.unlock();
+    return result;
 }
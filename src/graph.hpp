@@ -22,6 +22,9 @@
 #include <mycelia.hpp>
 #include <vruihelp.hpp>
 
+#include <deque>
+#include <tr1/memory>
+
 #define MATERIAL_NODE_DEFAULT 0
 #define MATERIAL_EDGE_DEFAULT 1
 #define MATERIAL_SELECTED 2
@@ -30,42 +33,68 @@
 
 namespace boost
 {
-typedef adjacency_list < vecS, vecS, undirectedS,
-        property<vertex_index_t, int>,
-        property<edge_weight_t, double> > BoostGraph;
+typedef compressed_sparse_row_graph<directedS> CsrGraph;
 }
 
 typedef std::vector<std::pair<std::string, std::string> > Attributes;
 
-class Node
+/*
+ * Strings interned once for the process and shared by every graph, so
+ * nodes and edges hold ids and copying a graph copies no characters. Ids
+ * and references stay valid for the life of the process, as entries are
+ * never removed. Safe to use from any thread; "" is id 0.
+ */
+class StringPool
 {
+private:
+    Threads::Mutex mutex;
+    std::deque<std::string> strings; // references survive growth
+    std::tr1::unordered_map<std::string, int> ids;
+
 public:
-    Vrui::Point position;
-    Vrui::Vector velocity;
-    std::tr1::unordered_map<int, std::list<int> > adjacent;
+    StringPool();
 
+    int intern(const std::string&);
+    const std::string& get(int);
+};
 
-    std::string label;
-    std::string type;
+/*
+ * Node attributes by column, one per key in the order keys first appeared:
+ * node id -> value, all as string ids. Graphs share their store with their
+ * copies until one of them changes it.
+ */
+class AttributeStore
+{
+public:
+    std::vector<int> keys;
+    std::vector<std::tr1::unordered_map<int, int> > columns;
+};
 
-    // These are used if the type is "image".
-    std::string imagePath;
+class Node
+{
+public:
+    // position, velocity and size live in the graph's dense arrays at this index
+    int index;
+    std::tr1::unordered_map<int, std::list<int> > adjacent; // target -> out-edges
+    std::tr1::unordered_map<int, std::list<int> > incoming; // source -> in-edges
+
+    int label; // string ids, see StringPool
+    int type; // NODE_SHAPE or NODE_IMAGE
+
+    // These are used if the type is NODE_IMAGE.
+    int imagePath;
     double imageScale;
 
-    Attributes attributes;
-    float size;
-    int component;
     int inDegree;
     int outDegree;
     int material;
 
     Node()
     {
-        position = Vrui::Point(0, 0, 0);
-        velocity = Vrui::Vector(0, 0, 0);
-        type = "shape";
-        size = 1;
-        component = 0;
+        index = -1;
+        label = 0;
+        type = NODE_SHAPE;
+        imagePath = 0;
         inDegree = 0;
         outDegree = 0;
         material = MATERIAL_NODE_DEFAULT;
@@ -78,13 +107,14 @@ class Edge
 public:
     int source;
     int target;
-    std::string label;
+    int label; // string id, see StringPool
     int material;
     float weight;
 
     Edge()
        : source(0),
          target(0),
+         label(0),
          material(MATERIAL_EDGE_DEFAULT),
          weight(1)
     {
@@ -93,12 +123,259 @@ public:
     Edge(int s, int t)
       : source(s),
         target(t),
+        label(0),
         material(MATERIAL_EDGE_DEFAULT),
         weight(1)
     {
     }
 };
 
+/*
+ * Compressed sparse row view of the out-edges, indexed by dense node index.
+ * The out-edges of index i are targets[offsets[i]] .. targets[offsets[i + 1] - 1],
+ * with the matching edge ids and weights stored at the same positions.
+ */
+class Adjacency
+{
+public:
+    std::vector<int> offsets;
+    std::vector<int> targets;
+    std::vector<int> edges;
+    std::vector<float> weights;
+
+    void clear()
+    {
+        offsets.assign(1, 0);
+        targets.clear();
+        edges.clear();
+        weights.clear();
+    }
+};
+
+#define EDGE_PAIR_FORWARD 1 // an edge runs from source to target
+#define EDGE_PAIR_BACKWARD 2 // an edge runs from target to source
+
+/*
+ * Edges collapsed to unordered node pairs by dense index, with source < target.
+ * Weights are summed over both directions and counts records how many
+ * directions are present (1 or 2). Self loops are dropped.
+ *
+ * For drawing, edges holds one representative edge id per pair (a forward
+ * one when there is one), multiplicities the number of parallel edges in
+ * both directions and directions the EDGE_PAIR_* bits present.
+ */
+class EdgePairs
+{
+public:
+    int nodeCount; // dense nodes when the pairs were built
+    std::vector<int> sources;
+    std::vector<int> targets;
+    std::vector<float> weights;
+    std::vector<char> counts;
+    std::vector<int> edges;
+    std::vector<int> multiplicities;
+    std::vector<char> directions;
+
+    void clear()
+    {
+        nodeCount = 0;
+        sources.clear();
+        targets.clear();
+        weights.clear();
+        counts.clear();
+        edges.clear();
+        multiplicities.clear();
+        directions.clear();
+    }
+
+    bool isBidirectional(int pair) const
+    {
+        return directions[pair] == (EDGE_PAIR_FORWARD | EDGE_PAIR_BACKWARD);
+    }
+};
+
+/*
+ * Read-only Boost view of the topology for the boost wrappers. Vertices
+ * are dense node indices and every linked pair of nodes appears once in
+ * each direction, so the directed CSR graph stands in for an undirected
+ * one. Weights are the summed pair weights by CSR edge index.
+ *
+ * Results are by node id, sized to the largest id + 1, and stay cached
+ * until the view is rebuilt; empty ones have not been computed yet.
+ */
+class BoostView
+{
+public:
+    boost::CsrGraph graph;
+    std::vector<float> weights;
+    std::vector<int> nodes; // dense index -> node id
+    int idCount;
+
+    std::vector<double> centrality;
+    std::vector<int> spanningTree;
+    std::vector<int> shortestPath;
+    int shortestPathSource;
+
+    void clear()
+    {
+        graph = boost::CsrGraph();
+        weights.clear();
+        nodes.clear();
+        idCount = 0;
+        centrality.clear();
+        spanningTree.clear();
+        shortestPath.clear();
+        shortestPathSource = -1;
+    }
+};
+
+/*
+ * Connected components by union-find over dense indices, by size with
+ * path halving. Each root keeps the indices of its component, the smaller
+ * list being appended on a union, so every index moves O(log n) times.
+ */
+class Components
+{
+public:
+    std::vector<int> parents;
+    std::vector<std::vector<int> > members; // empty except at roots
+
+    void clear()
+    {
+        parents.clear();
+        members.clear();
+    }
+
+    void add()
+    {
+        int index = (int)parents.size();
+        parents.push_back(index);
+        members.push_back(std::vector<int>(1, index));
+    }
+
+    int find(int index)
+    {
+        while(parents[index] != index)
+        {
+            parents[index] = parents[parents[index]];
+            index = parents[index];
+        }
+
+        return index;
+    }
+
+    void join(int a, int b)
+    {
+        a = find(a);
+        b = find(b);
+
+        if(a == b) return;
+        if(members[a].size() < members[b].size()) std::swap(a, b);
+
+        parents[b] = a;
+        members[a].insert(members[a].end(), members[b].begin(), members[b].end());
+        std::vector<int>().swap(members[b]);
+    }
+};
+
+/*
+ * Axis aligned box and bounding sphere of node positions. compute() finds
+ * Ritter's sphere, within a few percent of the smallest one; add() grows both
+ * to take in another point, so they stay bounds as nodes come and go.
+ */
+class Bounds
+{
+public:
+    Vrui::Point min;
+    Vrui::Point max;
+    Vrui::Point center;
+    Vrui::Scalar radius;
+    bool empty;
+
+    Bounds() { clear(); }
+
+    void clear()
+    {
+        min = max = center = Vrui::Point::origin;
+        radius = 0;
+        empty = true;
+    }
+
+    void add(const Vrui::Point& p)
+    {
+        if(empty)
+        {
+            min = max = center = p;
+            radius = 0;
+            empty = false;
+            return;
+        }
+
+        for(int i = 0; i < 3; i++)
+        {
+            if(p[i] < min[i]) min[i] = p[i];
+            if(p[i] > max[i]) max[i] = p[i];
+        }
+
+        // move the center toward p just enough to reach it
+        Vrui::Scalar d = Geometry::dist(center, p);
+
+        if(d > radius)
+        {
+            Vrui::Scalar grown = (radius + d) / 2;
+            center += (p - center) * ((grown - radius) / d);
+            radius = grown;
+        }
+    }
+
+    void translate(const Vrui::Vector& offset)
+    {
+        min += offset;
+        max += offset;
+        center += offset;
+    }
+
+    // all positions, or those at indices if given
+    void compute(const std::vector<Vrui::Point>&, const std::vector<int>* = 0);
+};
+
+#define CHANGE_MATERIAL 1 // color
+#define CHANGE_GEOMETRY 2 // node size or edge weight
+#define CHANGE_LOG_SIZE 4096 // logged changes kept for the renderer
+#define GRAPH_PUBLISH_RATE 60 // layout steps published per second, at most
+
+/*
+ * Binary snapshots hold a whole graph for reopening without parsing: a
+ * header of magic, version and section count, a table of (type, offset, size)
+ * sections and the sections themselves. Every array in a section is padded
+ * to 8 bytes so the mapped file can be read in place. Strings are interned
+ * once and referenced by index; node and edge ids are kept, so ids handed
+ * out before a save stay valid after a load.
+ */
+#define SNAPSHOT_MAGIC 0x4e53594d // "MYSN" in file byte order
+#define SNAPSHOT_VERSION 1
+#define SNAPSHOT_EXTENSION ".snap"
+#define SNAPSHOT_STRINGS 1 // count, offsets[count + 1], characters
+#define SNAPSHOT_MATERIALS 2 // count, rgba[4 * count]
+#define SNAPSHOT_NODES 3 // count, next id, texture mode, then one array per field
+#define SNAPSHOT_TOPOLOGY 4 // out-edges by dense source index, in edge id order
+#define SNAPSHOT_ATTRIBUTES 5 // offsets[nodes + 1], key and value strings
+
+/*
+ * An attribute change to a single node or edge, stamped with the version
+ * that published it. Flags of 0 mark changes that draw nothing, e.g. labels.
+ */
+class GraphChange
+{
+public:
+    int version;
+    int id;
+    bool edge;
+    int flags;
+};
+
+class GraphCommand;
+
 class Graph
 {
 private:
@@ -108,10 +385,21 @@ private:
     std::set<int> nodes;
     int nodeId;
 
+    // dense per-node storage, compacted on delete
+    std::vector<int> indexNodes; // dense index -> node id
+    std::vector<Vrui::Point> positions;
+    std::vector<Vrui::Vector> velocities;
+    std::vector<float> sizes;
+
     std::tr1::unordered_map<int, Edge> edgeMap;
     std::set<int> edges;
     int edgeId;
 
+    static StringPool stringPool; // labels, image paths and attributes
+    std::tr1::shared_ptr<AttributeStore> attributeStore;
+    AttributeStore& editAttributes();
+    void removeNodeAttributes(int);
+
     /** This needs to be moved to dataItem, or Graph should derive from GLObject */
     std::vector<GLMaterial*> materialVector;
 
@@ -120,9 +408,95 @@ private:
     Vrui::Point lastCenter;
     Vrui::Scalar lastMaxDistance;
 
+    // rebuilt lazily when topologyVersion moves past adjacencyVersion
+    Adjacency adjacency;
+    int adjacencyVersion;
+    EdgePairs edgePairs;
+    int edgePairsVersion;
+    BoostView boostView;
+    int boostViewVersion;
+
+    // computed by each published layout step, kept as a bound by added and
+    // deleted nodes and otherwise recomputed by locate() once positions move
+    Bounds bounds;
+    int boundsPositionVersion;
+    int boundsTopologyVersion;
+
+    // added nodes and edges keep it current, other changes leave it to be
+    // rebuilt when next asked for
+    Components components;
+    int componentsVersion;
+
+    void refreshAdjacency(); // caller holds the mutex
+    void refreshEdgePairs(); // caller holds the mutex
+    void refreshBoostView(); // caller holds the mutex
+    void refreshComponents(); // caller holds the mutex
+    void refreshBounds(); // caller holds the mutex
+    std::vector<int> toNodeIds(const std::vector<int>&) const;
+    int createEdge(int, int);
+    int createNode();
+    bool removeEdge(int);
+    bool removeNode(int);
+    int getMaterial(const GLMaterial::Color&);
+
+    // nodes added or rewired since the layout last asked, see takeTouchedNodes()
+    std::vector<int> touchedNodes;
+    bool allTouched;
+
+    void touchNode(int); // caller holds the mutex
+
+    // single element changes since changeLogVersion; any other update()
+    // moves rebuildVersion and forces consumers to start over
+    std::vector<GraphChange> changes;
+    int changeLogVersion;
+    int rebuildVersion;
+
+    void logChange(int, bool, int);
+    void recordChange(int, bool, int); // caller holds the mutex
+    void markRebuild(); // caller holds the mutex
+    void notifyChange(); // after an edit, without the mutex
+
+    // single element setters for a caller holding the mutex, e.g. a batch of
+    // queued commands; false if the element does not exist
+    bool assignEdgeColor(int, const GLMaterial::Color&);
+    bool assignEdgeLabel(int, const std::string&);
+    bool assignEdgeWeight(int, float);
+    bool assignNodeAttribute(int, const std::string&, const std::string&);
+    bool assignNodeColor(int, const GLMaterial::Color&);
+    bool assignNodeImagePath(int, const std::string&);
+    bool assignNodeImageScale(int, double);
+    bool assignNodeLabel(int, const std::string&);
+    bool assignNodeSize(int, float);
+    bool assignNodeType(int, const std::string&);
+    void assignTextureNodeMode(const std::string&);
+
+    friend class GraphCommand;
+
     int version;
+    int epoch; // bumped by init(), when ids start over
+    int topologyVersion;
+    int positionVersion; // bumped by position-only changes, see updatePositions()
     Threads::Mutex mutex;
 
+    // triple-buffered positions published by layout steps: the live array
+    // above, a back array filled under the graph mutex, and a ready array
+    // traded with the renderer's copy under the publish mutex only
+    std::vector<Vrui::Point> backPositions;
+    std::vector<Vrui::Point> readyPositions;
+    int readyPositionVersion;
+    int readyTopologyVersion;
+    bool positionsReady;
+    Threads::Mutex publishMutex;
+
+    // layout steps are published at most once per publish interval; a step
+    // held back in between is deferredPositionVersion, -1 if none
+    double publishInterval;
+    double lastPublishTime;
+    int deferredPositionVersion;
+
+    void commitPositions();
+    void publishPositions();
+
     const std::list<int> empty; // returned by getEdges when none exist
 
 public:
@@ -138,18 +512,34 @@ public:
     const GLMaterial* getNodeMaterialFromId(int);
     const std::string& getTextureNodeMode() const;
     const int getVersion() const;
+    const int getPositionVersion() const;
+    const int getTopologyVersion() const;
+    const int getEpoch() const; // safe from any thread
+    bool getChanges(int, std::vector<GraphChange>&) const;
     void randomizePositions(Vrui::Scalar);
+    void reserve(int, int);
 
     void setTextureNodeMode(std::string&);
     void update();
+    const int apply(const std::vector<GraphCommand*>&); // under one lock
+    void updateEdge(int, int); // update() for a logged single edge change
+    void updateNode(int, int);
+    void updatePositions();
     void write(const char*);
-    void lock() { mutex.lock(); }
+    bool readSnapshot(const std::string&);
+    bool readSnapshot(const std::vector<char>&);
+    bool readSnapshot(const char*, const char*, const std::string&, bool);
+    bool writeSnapshot(const std::string&);
+    void writeSnapshot(std::vector<char>&);
+    void lock(); // waits are counted in the application's stats
     void unlock() { mutex.unlock(); }
 
     // edges
     const int addEdge(int, int);
+    const int addEdges(const std::vector<int>&, std::vector<int>&);
     void clearEdges();
     const int deleteEdge(int);
+    const int deleteEdges(const std::vector<int>&);
     const Edge& getEdge(int);
     const std::set<int>& getEdges() const;
     const std::list<int>& getEdges(int, int);
@@ -163,17 +553,23 @@ public:
     const bool isValidEdge(int) const;
     void setEdgeColor(int, int, int, int, int = 255.0);
     void setEdgeColor(int, double, double, double, double = 1.0);
+    const int setEdgeColors(const std::vector<int>&, const std::vector<double>&);
     void setEdgeLabel(int, const std::string&);
+    const int setEdgeLabels(const std::vector<int>&, const std::vector<std::string>&);
     void setEdgeWeight(int, float);
+    const int setEdgeWeights(const std::vector<int>&, const std::vector<double>&);
 
     // nodes
     const int addNode();
     const int addNode(const Vrui::Point&);
     const int addNode(const std::string&);
+    const int addNodes(int);
     const int deleteNode();
     const int deleteNode(int);
-    const Attributes& getNodeAttributes(int);
-    const int getNodeComponent(int);
+    const int deleteNodes(const std::vector<int>&);
+    const Attributes getNodeAttributes(int);
+    const int getNodeComponent(int); // a node of the component, the same for all of its nodes
+    const std::vector<int>& getComponentIndices(int); // dense indices of the node's component
     const int getNodeDegree(int);
     const std::string& getNodeLabel(int);
     const std::set<int>& getNodes() const;
@@ -184,31 +580,56 @@ public:
     const Vrui::Point& getNodePosition(int);
     const Vrui::Vector& getNodeVelocity(int);
     const float getNodeSize(int);
-    const std::string& getNodeType(int);
+    const int getNodeType(int);
     const Vrui::Point& getSourceNodePosition(int);
     const Vrui::Point& getTargetNodePosition(int);
     const bool isValidNode(int) const;
     void moveNodes(const Vrui::Vector&);
     void moveNodes(const Vrui::Point&);
-    void setNodeAttribute(int, std::string&, std::string&);
+    void setNodeAttribute(int, const std::string&, const std::string&);
     void setNodeColor(int, int, int, int, int = 255.0);
     void setNodeColor(int, double, double, double, double = 1.0);
+    const int setNodeColors(const std::vector<int>&, const std::vector<double>&);
     void setNodeImagePath(int, const std::string&);
     void setNodeImageScale(int, const double&);    
     void setNodeLabel(int, const std::string&);
+    const int setNodeLabels(const std::vector<int>&, const std::vector<std::string>&);
     void setNodePosition(int, const Vrui::Point&);
+    const int setNodePositions(const std::vector<int>&, const std::vector<double>&);
     void setNodeType(int, const std::string&);
     void setNodeVelocity(int, const Vrui::Vector&);
     void setNodeSize(int, float);
+    const int setNodeSizes(const std::vector<int>&, const std::vector<double>&);
     void updateNodePosition(int, const Vrui::Vector&);
     void updateNodeVelocity(int, const Vrui::Vector&);
 
+    // dense storage
+    const Adjacency& getAdjacency();
+    void getAdjacency(Adjacency&);
+    const EdgePairs& getEdgePairs();
+    const int getEdgePairs(EdgePairs&); // returns the topology version copied
+    const int getIndexNode(int) const;
+    const std::vector<int>& getIndexNodes() const;
+    const int getNodeIndex(int);
+    const std::vector<Vrui::Point>& getPositions() const;
+    const std::vector<float>& getSizes() const;
+    const std::vector<Vrui::Vector>& getVelocities() const;
+    bool takeTouchedNodes(std::vector<int>&);
+    const int setNodePositions(const std::vector<Vrui::Point>&);
+    void updateNodePositions(const std::vector<Vrui::Vector>&);
+    void updateNodeVelocities(const std::vector<Vrui::Vector>&);
+
+    // renderer side of the position snapshot
+    void copyPositions(Graph&); // caller holds the source graph's lock
+    bool takePublishedPositions(Graph&);
+    bool flushPositions();
+    bool isPublishPending() const { return deferredPositionVersion == positionVersion; }
+    void setPublishRate(double);
+
     // boost wrappers
-    boost::BoostGraph toBoost();
     std::vector<double> getBetweennessCentrality();
     std::vector<int> getShortestPath();
     std::vector<int> getSpanningTree();
-    void setComponents();
 };
 
 #endif
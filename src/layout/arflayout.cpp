@@ -26,6 +26,12 @@ ArfLayout::ArfLayout(Mycelia* application)
     : GraphLayout(application)
 {
     dynamic = true;
+    threadCount = pool.getThreadCount();
+    incremental = false;
+    incrementalStep = false;
+    settling = false;
+    activeCount = 0;
+    activeHops = INCREMENTAL_HOPS;
     
     dampingConstant = -3;
     beta = -0.45;
@@ -39,6 +45,17 @@ ArfLayout::ArfLayout(Mycelia* application)
     connectedSpringLength = 1;
     stronglyConnectedSpringLength = 1;
     unconnectedSpringLength = 1;
+    
+    kineticEnergy = 0;
+    springEnergy = 0;
+    lastEnergy = numeric_limits<double>::max();
+    stepTime = deltaTime;
+    progress = 0;
+    restSteps = 0;
+    asleep = false;
+    wakeups = 0;
+    stepWakeups = 0;
+    converged = false;
 }
 
 inline double ArfLayout::getSpringConstant(int edgeCount) const
@@ -81,8 +98,21 @@ inline double ArfLayout::getSpringLength(int edgeCount) const
 // locked.
 void* ArfLayout::layout()
 {
+    asleep = false;
+    stepTime = deltaTime;
+    lastEnergy = numeric_limits<double>::max();
+    progress = 0;
+    restSteps = 0;
+    converged = false;
+    
     while(!stopped)
     {
+        if(asleep)
+        {
+            sleep();
+            continue;
+        }
+        
         //application->g->lock();
         layoutStep();
         //application->g->unlock();
@@ -91,56 +121,472 @@ void* ArfLayout::layout()
     return 0;
 }
 
+// blocks until wake() or stop()
+void ArfLayout::sleep()
+{
+    sleepMutex.lock();
+    while(asleep && !stopped)
+    {
+        sleepCond.wait(sleepMutex);
+    }
+    sleepMutex.unlock();
+    
+    // restart the adaptive step from the user's setting
+    stepTime = deltaTime;
+    lastEnergy = numeric_limits<double>::max();
+    progress = 0;
+    restSteps = 0;
+}
+
+// sleeps after this step unless something woke the layout during it,
+// announcing convergence only if nodes moved since the last announcement
+void ArfLayout::fallAsleep()
+{
+    bool announce = false;
+    
+    sleepMutex.lock();
+    if(wakeups == stepWakeups && !asleep)
+    {
+        asleep = true;
+        settling = false;
+        announce = !converged;
+        converged = true;
+    }
+    sleepMutex.unlock();
+    
+    restSteps = 0;
+    
+    if(announce)
+    {
+        application->postEvent("layout_converged", -1);
+    }
+}
+
+void ArfLayout::wake()
+{
+    sleepMutex.lock();
+    wakeups++;
+    asleep = false;
+    sleepCond.signal();
+    sleepMutex.unlock();
+}
+
 void ArfLayout::layoutStep()
 {
+    StatTimer timer(application->stats, STAT_LAYOUT_STEP);
+
+    // thread count changes are applied here since the pool is idle between steps
+    if(threadCount != pool.getThreadCount())
+    {
+        pool.setThreadCount(threadCount);
+    }
+    
+    sleepMutex.lock();
+    stepWakeups = wakeups;
+    sleepMutex.unlock();
+    
+    // edits since the last step seed the active set in incremental mode
+    incrementalStep = incremental || settling;
+    vector<int> touched;
+    bool allTouched = application->g->takeTouchedNodes(touched);
+    
+    // the graph was just loaded, only the nodes given to settle() are new
+    if(!settleNodes.empty())
+    {
+        touched.swap(settleNodes);
+        settleNodes.clear();
+        allTouched = false;
+    }
+    
+    // snapshot the dense arrays so the inner loops avoid per-node hash lookups
+    application->g->getEdgePairs(pairs);
+    
+    application->g->lock();
     int nodeCount = application->g->getNodeCount();
-    vector<Vrui::Vector> velocityVector(nodeCount);
-    vector<Vrui::Vector> positionVector(nodeCount);
     
-    foreach(int source, application->g->getNodes())
+    if(pairs.nodeCount != nodeCount)
     {
-        if(!application->isSelectedComponent(source) || source == application->getSelectedNode())
+        // topology changed since the pairs were built, try again next step
+        application->g->unlock();
+        return;
+    }
+    
+    positions = application->g->getPositions();
+    velocities = application->g->getVelocities();
+    sizes = application->g->getSizes();
+    int selection = application->getSelectedNode();
+    int selectedNode = application->g->isValidNode(selection) ? application->g->getNodeIndex(selection) : -1;
+    const vector<int>* component = application->getSelectedComponent(application->g);
+    selected.assign(nodeCount, component == 0);
+    
+    for(int i = 0; component && i < (int)component->size(); i++)
+    {
+        selected[(*component)[i]] = true;
+    }
+    
+    if(incrementalStep)
+    {
+        updateActiveSet(touched, allTouched);
+        activeCount = activeIndices.size();
+    }
+    else
+    {
+        activeNodes.clear();
+        activeIndices.clear();
+        activeIds.clear();
+        activeCount = nodeCount;
+    }
+    application->g->unlock();
+    
+    if(nodeCount == 0 || (incrementalStep && activeIndices.empty()))
+    {
+        // nothing to move, wait for the next edit
+        fallAsleep();
+        return;
+    }
+    
+    // repulsion pass: every pair feels the unconnected spring plus repulsion
+    RepulsionLaw law;
+    law.constant = unconnectedSpringConstant;
+    law.inverse = -unconnectedSpringConstant * unconnectedSpringLength;
+    law.power = layoutRadius * sqrt(nodeCount);
+    law.exponent = -(1 + beta);
+    kernel.setLaw(law);
+    
+    // Vrui points are stored as packed xyz triples
+    kernel.setPoints(nodeCount, positions[0].getComponents(), selected, 0);
+    forceX.resize(nodeCount);
+    forceY.resize(nodeCount);
+    forceZ.resize(nodeCount);
+    
+    // each source is owned by exactly one worker, so the result does not
+    // depend on the number of threads
+    pool.run(this, incrementalStep ? (int)activeIndices.size() : nodeCount);
+    
+    if(stopped)
+    {
+        return;
+    }
+    
+    vector<Vrui::Vector> forces(nodeCount);
+    int targets = -1; // each node interacts with every other selected node
+    
+    for(int index = 0; index < nodeCount; index++)
+    {
+        forces[index] = Vrui::Vector(forceX[index], forceY[index], forceZ[index]);
+        if(selected[index]) targets++;
+    }
+    
+    // attraction pass: swap the unconnected spring for the connected one,
+    // once per node pair
+    springEnergy = 0;
+    
+    for(int pair = 0; pair < (int)pairs.sources.size(); pair++)
+    {
+        int source = pairs.sources[pair];
+        int target = pairs.targets[pair];
+        
+        if(!selected[source] || !selected[target])
         {
             continue;
         }
         
-        double mass = application->g->getNodeSize(source); // treat size as mass
-        Vrui::Vector velocity = application->g->getNodeVelocity(source);
+        if(incrementalStep && !active[source] && !active[target])
+        {
+            continue;
+        }
+        
+        Vrui::Vector v = positions[source] - positions[target];
+        Vrui::Scalar mag = Geometry::mag(v);
+        
+        if(mag == 0)
+        {
+            continue;
+        }
+        
+        int edgeCount = pairs.counts[pair];
+        double connected = getSpringConstant(edgeCount) * (mag - getSpringLength(edgeCount));
+        double unconnected = unconnectedSpringConstant * (mag - unconnectedSpringLength);
+        Vrui::Vector correction = (connected - unconnected) / mag * v;
+        
+        forces[source] += correction;
+        forces[target] -= correction;
+        
+        // spring constants are negative for attraction
+        double stretch = mag - getSpringLength(edgeCount);
+        springEnergy -= 0.5 * getSpringConstant(edgeCount) * stretch * stretch;
+    }
+    
+    // keep the adapted step within range of the user's setting
+    stepTime = max(min(stepTime, deltaTime * ARF_MAX_STEP_SCALE), deltaTime * ARF_MIN_STEP_SCALE);
+    
+    vector<Vrui::Vector> velocityVector(nodeCount, Vrui::Vector(0, 0, 0));
+    vector<Vrui::Vector> positionVector(nodeCount, Vrui::Vector(0, 0, 0));
+    double kinetic = 0;
+    int moving = 0;
+    
+    for(int source = 0; source < nodeCount; source++)
+    {
+        if(!selected[source] || source == selectedNode || (incrementalStep && !active[source]))
+        {
+            continue;
+        }
+        
+        // damping acts once per target, as in the pairwise formulation
+        double mass = sizes[source]; // treat size as mass
+        Vrui::Vector velocity = velocities[source];
         Vrui::Vector dampingForce = dampingConstant * velocity;
+        Vrui::Vector force = forces[source] + targets * dampingForce;
+        
+        velocityVector[source] = VruiHelp::rk4(Vrui::Vector(0, 0, 0), force / mass, stepTime);
+        positionVector[source] = VruiHelp::rk4(Vrui::Vector(0, 0, 0), targets * velocity, stepTime);
         
-        foreach(int target, application->g->getNodes())
+        kinetic += 0.5 * mass * Geometry::sqr(velocity + velocityVector[source]);
+        moving++;
+    }
+    
+    application->g->updateNodeVelocities(velocityVector);
+    application->g->updateNodePositions(positionVector);
+    kineticEnergy = kinetic;
+    
+    if(incrementalStep)
+    {
+        relaxActiveSet(positionVector);
+    }
+    
+    // grow the step after steady progress, shrink it as soon as energy rises
+    double energy = kineticEnergy + springEnergy;
+    
+    if(energy < lastEnergy)
+    {
+        if(++progress >= ARF_STEP_PROGRESS)
         {
-            if(stopped)
-            {
-                return;
-            }
+            progress = 0;
+            stepTime /= ARF_STEP_COOLING;
+        }
+    }
+    else
+    {
+        progress = 0;
+        stepTime *= ARF_STEP_COOLING;
+    }
+    lastEnergy = energy;
+    
+    // sleep once motion has died down for a while
+    if(moving == 0 || kineticEnergy / moving < ARF_SLEEP_ENERGY)
+    {
+        if(++restSteps >= ARF_SLEEP_STEPS)
+        {
+            // everything has converged, the next edit starts a fresh active set
+            activeNodes.clear();
+            fallAsleep();
+        }
+    }
+    else
+    {
+        restSteps = 0;
+        converged = false;
+    }
+}
+
+/*
+ * Activates touched nodes and everything within activeHops edges of them,
+ * then rebuilds the dense active list. Caller holds the graph lock and has
+ * refreshed the per-step snapshot.
+ */
+void ArfLayout::updateActiveSet(const vector<int>& touched, bool allTouched)
+{
+    Graph* g = application->g;
+    int nodeCount = g->getNodeCount();
+    vector<int> frontier;
+    
+    if(allTouched)
+    {
+        for(int index = 0; index < nodeCount; index++) frontier.push_back(index);
+    }
+    else
+    {
+        foreach(int node, touched)
+        {
+            if(g->isValidNode(node)) frontier.push_back(g->getNodeIndex(node));
+        }
+    }
+    
+    if(!frontier.empty())
+    {
+        // undirected neighbor lists from the pairs, by dense index
+        vector<int> offsets(nodeCount + 1, 0);
+        
+        for(int pair = 0; pair < (int)pairs.sources.size(); pair++)
+        {
+            offsets[pairs.sources[pair] + 1]++;
+            offsets[pairs.targets[pair] + 1]++;
+        }
+        
+        for(int index = 0; index < nodeCount; index++)
+        {
+            offsets[index + 1] += offsets[index];
+        }
+        
+        vector<int> next(offsets.begin(), offsets.end() - 1);
+        vector<int> neighbors(offsets[nodeCount]);
+        
+        for(int pair = 0; pair < (int)pairs.sources.size(); pair++)
+        {
+            neighbors[next[pairs.sources[pair]]++] = pairs.targets[pair];
+            neighbors[next[pairs.targets[pair]]++] = pairs.sources[pair];
+        }
+        
+        // breadth first out to activeHops
+        vector<bool> reached(nodeCount, false);
+        
+        for(int hop = 0; !frontier.empty(); hop++)
+        {
+            vector<int> expanded;
             
-            if(!application->isSelectedComponent(target) || source == target)
+            foreach(int index, frontier)
             {
-                continue;
+                if(reached[index]) continue;
+                
+                reached[index] = true;
+                activeNodes[g->getIndexNode(index)] = 0;
+                
+                if(hop == activeHops) continue;
+                
+                for(int slot = offsets[index]; slot < offsets[index + 1]; slot++)
+                {
+                    if(!reached[neighbors[slot]]) expanded.push_back(neighbors[slot]);
+                }
             }
             
-            Vrui::Vector v = application->g->getNodePosition(source) - application->g->getNodePosition(target);
-            Vrui::Scalar mag = Geometry::mag(v);
-            
-            int edgeCount = (int)application->g->hasEdge(source, target) + (int)application->g->hasEdge(target, source);
-            double springConstant = getSpringConstant(edgeCount);
-            double springLength = getSpringLength(edgeCount);
-            
-            double constA = springConstant * (mag - springLength) / mag;
-            Vrui::Vector springForce = constA * v;
-            
-            double constB = layoutRadius * sqrt(nodeCount) / pow(mag, 1 + beta);
-            Vrui::Vector repulsionForce = constB * v;
+            frontier.swap(expanded);
+        }
+    }
+    
+    activeIndices.clear();
+    activeIds.clear();
+    active.assign(nodeCount, false);
+    
+    typedef std::tr1::unordered_map<int, int>::iterator ActiveIterator;
+    
+    for(ActiveIterator it = activeNodes.begin(); it != activeNodes.end();)
+    {
+        if(!g->isValidNode(it->first))
+        {
+            activeNodes.erase(it++);
+            continue;
+        }
+        
+        active[g->getNodeIndex(it->first)] = true;
+        ++it;
+    }
+    
+    // in index order for a deterministic work partition regardless of hash order
+    for(int index = 0; index < nodeCount; index++)
+    {
+        if(active[index])
+        {
+            activeIndices.push_back(index);
+            activeIds.push_back(g->getIndexNode(index));
+        }
+    }
+}
 
-            velocityVector[source] = VruiHelp::rk4(velocityVector[source], (dampingForce + springForce + repulsionForce) / mass, deltaTime);
-            positionVector[source] = VruiHelp::rk4(positionVector[source], velocity, deltaTime);
+// freezes active nodes that have stayed at rest long enough
+void ArfLayout::relaxActiveSet(const vector<Vrui::Vector>& positionVector)
+{
+    for(int i = 0; i < (int)activeIndices.size(); i++)
+    {
+        int index = activeIndices[i];
+        int node = activeIds[i];
+        
+        if(Geometry::mag(positionVector[index]) >= INCREMENTAL_REST_DISTANCE)
+        {
+            activeNodes[node] = 0;
+        }
+        else if(++activeNodes[node] >= INCREMENTAL_REST_STEPS)
+        {
+            activeNodes.erase(node);
         }
     }
+}
+
+void ArfLayout::run(int worker, int begin, int end)
+{
+    if(!incrementalStep)
+    {
+        kernel.compute(begin, end, 0, &forceX[0], &forceY[0], &forceZ[0]);
+        return;
+    }
     
-    foreach(int node, application->g->getNodes())
+    // only active sources need their repulsion
+    for(int i = begin; i < end; i++)
     {
-        application->g->updateNodeVelocity(node, velocityVector[node]);
-        application->g->updateNodePosition(node, positionVector[node]);
+        int source = activeIndices[i];
+        kernel.compute(source, source + 1, 0, &forceX[0], &forceY[0], &forceZ[0]);
     }
 }
+
+int ArfLayout::getThreadCount() const
+{
+    return threadCount;
+}
+
+void ArfLayout::setThreadCount(int threadCount)
+{
+    this->threadCount = threadCount > 0 ? threadCount : WorkerPool::getProcessorCount();
+}
+
+double ArfLayout::getKineticEnergy() const
+{
+    return kineticEnergy;
+}
+
+double ArfLayout::getSpringEnergy() const
+{
+    return springEnergy;
+}
+
+double ArfLayout::getStepTime() const
+{
+    return stepTime;
+}
+
+bool ArfLayout::isAsleep() const
+{
+    return asleep;
+}
+
+bool ArfLayout::isIncremental() const
+{
+    return incremental;
+}
+
+int ArfLayout::getActiveCount() const
+{
+    return activeCount;
+}
+
+/*
+ * Runs the next start() in incremental mode until it converges, with nodes
+ * and their neighborhood active, e.g. the nodes a warm start had no
+ * position for. Afterwards the layout is incremental again only if
+ * setIncremental asked for it.
+ */
+void ArfLayout::settle(const vector<int>& nodes)
+{
+    settling = !nodes.empty();
+    settleNodes = nodes;
+}
+
+// the active set itself is only touched by the layout thread
+void ArfLayout::setIncremental(bool incremental, int hops)
+{
+    if(hops >= 0)
+    {
+        activeHops = hops;
+    }
+    
+    this->incremental = incremental;
+    wake();
+}
@@ -23,11 +23,28 @@
 
 #include <graph.hpp>
 #include <mycelia.hpp>
+#include <Threads/Cond.h>
+#include <Threads/Mutex.h>
 #include <layout/graphlayout.hpp>
+#include <layout/repulsion.hpp>
+#include <layout/workerpool.hpp>
 
-class ArfLayout : public GraphLayout
+#define INCREMENTAL_HOPS 2
+#define INCREMENTAL_REST_DISTANCE 0.001 // per step movement considered at rest
+#define INCREMENTAL_REST_STEPS 50 // steps at rest before a node is frozen again
+
+#define ARF_SLEEP_ENERGY 1e-4 // mean kinetic energy per node considered at rest
+#define ARF_SLEEP_STEPS 100 // steps at rest before the layout sleeps
+#define ARF_STEP_COOLING 0.9 // adaptive time step scale, see Hu 2005
+#define ARF_STEP_PROGRESS 5 // steps of falling energy before the time step grows
+#define ARF_MIN_STEP_SCALE 0.1 // bounds on the time step relative to deltaTime
+#define ARF_MAX_STEP_SCALE 4
+
+class ArfLayout : public GraphLayout, public WorkerTask
 {
     friend class ArfWindow;
+    friend class GpuLayout;
+    friend class GraphBench;
     
 private:
     double dampingConstant;
@@ -43,11 +60,76 @@ private:
     double stronglyConnectedSpringLength;
     double unconnectedSpringLength;
     
+    // force evaluation is split over sources by a pool of worker threads
+    WorkerPool pool;
+    int threadCount;
+    
+    // per-step snapshot shared read-only by the workers
+    EdgePairs pairs;
+    std::vector<Vrui::Point> positions;
+    std::vector<Vrui::Vector> velocities;
+    std::vector<float> sizes;
+    std::vector<bool> selected;
+    RepulsionKernel kernel;
+    
+    // repulsion results, written by the workers
+    std::vector<float> forceX, forceY, forceZ;
+    
+    // incremental mode only moves nodes touched by edits and their k-hop
+    // neighborhood, everything else is frozen but still exerts force
+    bool incremental;
+    bool incrementalStep; // incremental as of the current step
+    int activeHops;
+    bool settling; // incremental until the next convergence, see settle()
+    std::vector<int> settleNodes; // seed the first settling step's active set
+    int activeCount;
+    std::tr1::unordered_map<int, int> activeNodes; // node id -> consecutive steps at rest
+    std::vector<int> activeIndices; // dense, sorted
+    std::vector<int> activeIds; // node ids matching activeIndices
+    std::vector<bool> active;
+    
+    // convergence: energy after the last step and the adapted time step
+    double kineticEnergy;
+    double springEnergy;
+    double lastEnergy;
+    double stepTime;
+    int progress;
+    int restSteps;
+    
+    // sleeping until the next wake(), counted to catch wakeups mid step
+    bool asleep;
+    int wakeups;
+    int stepWakeups;
+    bool converged; // layout_converged posted, nothing has moved since
+    Threads::Mutex sleepMutex;
+    Threads::Cond sleepCond;
+    
+    void sleep();
+    void fallAsleep();
+    void updateActiveSet(const std::vector<int>&, bool);
+    void relaxActiveSet(const std::vector<Vrui::Vector>&);
+    
 public:
     ArfLayout(Mycelia*);
     
     double getSpringConstant(int) const;
     double getSpringLength(int) const;
+    
+    double getKineticEnergy() const;
+    double getSpringEnergy() const;
+    double getStepTime() const;
+    bool isAsleep() const;
+    virtual void wake();
+    
+    int getThreadCount() const;
+    void setThreadCount(int); // 0 uses one thread per online processor
+    
+    bool isIncremental() const;
+    int getActiveCount() const;
+    void setIncremental(bool, int hops=-1); // hops < 0 keeps the current radius
+    void settle(const std::vector<int>&); // while stopped; empty cancels
+    
+    virtual void run(int, int, int);
 
 protected:
     virtual void* layout();
@@ -102,4 +102,7 @@ void ArfWindow::sliderCallback(GLMotif::Slider::ValueChangedCallbackData* cbData
         layout->unconnectedSpringConstant = f;
         unconnectedConstantField->setValue(f);
     }
+    
+    // new parameters move the equilibrium, resume if the layout was at rest
+    layout->wake();
 }
@@ -21,32 +21,100 @@
 using namespace std;
 
 EdgeBundler::EdgeBundler(Mycelia* application)
-    : GraphLayout(application)
+    : GraphLayout(application),
+      segments(SUBDIVISIONS_0),
+      current(0),
+      stride(0),
+      version(0),
+      sweepSegment(0),
+      accelerated(true),
+      minCompatibility(BUNDLE_COMPATIBILITY),
+      cutoffFraction(BUNDLE_CUTOFF),
+      cutoff(0)
 {
 }
 
+void EdgeBundler::setAcceleration(bool enabled, double compatibility, double cutoff)
+{
+    accelerated = enabled;
+    minCompatibility = compatibility;
+    cutoffFraction = cutoff;
+}
+
+/*
+ * Straight polylines from source to target for every edge.
+ */
 void EdgeBundler::allocateSegments()
 {
-    // calculate maximum subdivisions
-    int maxSegments = 2; // endpoints
-    
-    for(int i = 0; i <= MAX_CYCLE; i++)
+    const set<int>& edgeIds = application->g->getEdges();
+    vector<int> newEdges(edgeIds.begin(), edgeIds.end());
+
+    int newStride = segments + 2;
+    vector<Vrui::Point>& next = buffers[1 - current];
+    next.resize(newEdges.size() * newStride);
+
+    for(int slot = 0; slot < (int)newEdges.size(); slot++)
     {
-        maxSegments += pow(2.0, i);
+        const Vrui::Point& source = application->g->getSourceNodePosition(newEdges[slot]);
+        const Vrui::Vector edge = application->g->getTargetNodePosition(newEdges[slot]) - source;
+
+        for(int i = 0; i < newStride; i++)
+        {
+            next[slot * newStride + i] = source + edge * (Vrui::Scalar(i) / (newStride - 1));
+        }
     }
-    
-    // allocate per-edge segment vector
-    segmentVector = vector<vector<Vrui::Point> >(application->g->getEdgeCount());
-    
-    for(int edge = 0; edge < application->g->getEdgeCount(); edge++)
+
+    // the renderer may be reading the old edges and points
+    bufferMutex.lock();
+    edges.swap(newEdges);
+    stride = newStride;
+    current = 1 - current;
+    version++;
+    bufferMutex.unlock();
+}
+
+/*
+ * Doubles the segments of every polyline, old points staying at even
+ * positions with midpoints between them.
+ */
+void EdgeBundler::subdivide()
+{
+    const vector<Vrui::Point>& points = buffers[current];
+    vector<Vrui::Point>& next = buffers[1 - current];
+    int newStride = 2 * stride - 1;
+    next.resize(edges.size() * newStride);
+
+    for(int slot = 0; slot < (int)edges.size(); slot++)
     {
-        segmentVector[edge] = vector<Vrui::Point>(maxSegments);
-        
-        for(int segment = 0; segment < maxSegments; segment++)
+        const Vrui::Point* line = &points[slot * stride];
+        Vrui::Point* newLine = &next[slot * newStride];
+
+        for(int i = 0; i < stride; i++)
         {
-            segmentVector[edge][segment] = Vrui::Point(numeric_limits<float>::max(), 0, 0);
+            newLine[2 * i] = line[i];
+        }
+
+        for(int i = 0; i + 1 < stride; i++)
+        {
+            newLine[2 * i + 1] = VruiHelp::midpoint(line[i], line[i + 1]);
         }
     }
+
+    bufferMutex.lock();
+    current = 1 - current;
+    stride = newStride;
+    version++;
+    bufferMutex.unlock();
+
+    segments = 2 * segments + 1;
+}
+
+void EdgeBundler::swapBuffers()
+{
+    bufferMutex.lock();
+    current = 1 - current;
+    version++;
+    bufferMutex.unlock();
 }
 
 void* EdgeBundler::layout()
@@ -56,104 +124,284 @@ void* EdgeBundler::layout()
     stepsize = STEPSIZE_0;
     iterations = ITERATIONS_0;
     allocateSegments();
+
+    int workers = pool.getThreadCount();
+    compatibility.assign(workers, vector<float>(edges.size(), 0));
+    cells.assign(workers, vector<int>());
+
+    if(accelerated)
+    {
+        buildCompatibility();
+    }
     
     while(cycle <= MAX_CYCLE && !stopped)
     {
         for(int iteration = 0; iteration < iterations; iteration++)
         {
+            // the graph itself is untouched, so only the bundled edges are
+            // redrawn, at most once per frame however fast steps run
             layoutStep();
-            application->g->update();
+            Vrui::requestUpdate();
         }
         
         cycle++;
-        segments += pow(2.0, cycle);
         stepsize /= 2.0;
         iterations *= 0.66;
+
+        if(cycle <= MAX_CYCLE)
+        {
+            subdivide();
+        }
     }
     return 0;
 }
 
+/*
+ * Angle, scale and position compatibility of every pair of edges whose
+ * midpoints are close enough to pass the position term, after Holten and
+ * van Wijk's force directed edge bundling. Candidates come from a grid over
+ * the edge midpoints rather than from all pairs.
+ */
+void EdgeBundler::buildCompatibility()
+{
+    int edgeCount = edges.size();
+    vector<Vrui::Vector> vectors(edgeCount);
+    vector<Vrui::Scalar> lengths(edgeCount);
+    vector<Vrui::Point> midpoints(edgeCount);
+    Vrui::Scalar maxLength = 0;
+    Vrui::Scalar totalLength = 0;
+
+    for(int slot = 0; slot < edgeCount; slot++)
+    {
+        const Vrui::Point& source = application->g->getSourceNodePosition(edges[slot]);
+        const Vrui::Point& target = application->g->getTargetNodePosition(edges[slot]);
+        vectors[slot] = target - source;
+        lengths[slot] = Geometry::mag(vectors[slot]);
+        midpoints[slot] = VruiHelp::midpoint(source, target);
+        maxLength = max(maxLength, lengths[slot]);
+        totalLength += lengths[slot];
+    }
+
+    cutoff = edgeCount > 0 ? cutoffFraction * totalLength / edgeCount : 0;
+    compatibleEdges.assign(edgeCount, vector<pair<int, float> >());
+
+    NodeGrid midpointGrid;
+    midpointGrid.update(midpoints);
+    vector<int> cells;
+
+    for(int first = 0; first < edgeCount; first++)
+    {
+        if(lengths[first] == 0) continue;
+
+        // position compatibility lavg / (lavg + d) falls below the minimum
+        // past this midpoint distance, for the longest possible partner
+        Vrui::Scalar average = (lengths[first] + maxLength) / 2;
+        Vrui::Scalar radius = average * (1 / minCompatibility - 1);
+        GridBox box;
+        box.add(midpoints[first], radius);
+        midpointGrid.getCells(box, cells);
+
+        foreach(int cell, cells)
+        {
+            foreach(int second, midpointGrid.getCellNodes(cell))
+            {
+                if(second <= first || lengths[second] == 0) continue;
+
+                Vrui::Scalar lavg = (lengths[first] + lengths[second]) / 2;
+                Vrui::Scalar angle = Math::abs(vectors[first] * vectors[second]) / (lengths[first] * lengths[second]);
+                Vrui::Scalar scale = 2 / (lavg / min(lengths[first], lengths[second]) +
+                                          max(lengths[first], lengths[second]) / lavg);
+                Vrui::Scalar position = lavg / (lavg + Geometry::dist(midpoints[first], midpoints[second]));
+                Vrui::Scalar c = angle * scale * position;
+
+                if(c >= minCompatibility)
+                {
+                    compatibleEdges[first].push_back(make_pair(second, (float)c));
+                    compatibleEdges[second].push_back(make_pair(first, (float)c));
+                }
+            }
+        }
+    }
+}
+
+/*
+ * One step from the current buffer into the other. The accelerated mode
+ * sweeps one subdivision point at a time, against a grid over that point
+ * of every edge.
+ */
 void EdgeBundler::layoutStep()
 {
-    for(int firstEdge = 0; firstEdge < (int)application->g->getEdgeCount(); firstEdge++)
+    StatTimer timer(application->stats, STAT_BUNDLE_STEP);
+
+    const vector<Vrui::Point>& points = buffers[current];
+    vector<Vrui::Point>& next = buffers[1 - current];
+    int edgeCount = edges.size();
+
+    // still sized for the last subdivision
+    next.resize(points.size());
+
+    if(accelerated)
     {
-        Vrui::Scalar k_p = _K / Geometry::abs(application->g->getSourceNodePosition(firstEdge) - application->g->getTargetNodePosition(firstEdge));
-        
-        for(int segment = 1; *getSegment(firstEdge, segment) != application->g->getTargetNodePosition(firstEdge); segment++)
+        // endpoints stay put
+        for(int slot = 0; slot < edgeCount; slot++)
+        {
+            next[slot * stride] = points[slot * stride];
+            next[slot * stride + stride - 1] = points[slot * stride + stride - 1];
+        }
+
+        for(sweepSegment = 1; sweepSegment <= segments; sweepSegment++)
         {
-            Vrui::Point& p_prev     = *getSegment(firstEdge, segment - 1);
-            Vrui::Point& p          = *getSegment(firstEdge, segment);
-            Vrui::Point& p_next     = *getSegment(firstEdge, segment + 1);
-            
-            Vrui::Vector F_s_prev_v = p_prev - p;
-            Vrui::Vector F_s_next_v = p_next - p;
-            Vrui::Vector F_s_v      = (F_s_prev_v + F_s_next_v) * k_p;
-            Vrui::Vector F_e_v      = Vrui::Vector(0, 0, 0);
-            
-            for(int secondEdge = 0; secondEdge < application->g->getEdgeCount(); secondEdge++)
+            // neighbouring points are close, so most stay in their cells
+            pointGrid.update(edgeCount > 0 ? &points[sweepSegment] : 0, edgeCount, stride);
+            pool.run(this, edgeCount);
+        }
+    }
+    else
+    {
+        pool.run(this, edgeCount);
+    }
+
+    swapBuffers();
+}
+
+void EdgeBundler::run(int worker, int begin, int end)
+{
+    if(accelerated)
+    {
+        moveAccelerated(worker, begin, end);
+    }
+    else
+    {
+        moveExact(begin, end);
+    }
+}
+
+/*
+ * Pull of a point towards its neighbours on the polyline, stiffer for
+ * shorter edges.
+ */
+Vrui::Vector EdgeBundler::getSpringForce(const Vrui::Point* line, int segment) const
+{
+    Vrui::Scalar k_p = _K / Geometry::abs(line[stride - 1] - line[0]);
+    return ((line[segment - 1] - line[segment]) + (line[segment + 1] - line[segment])) * k_p;
+}
+
+static Vrui::Point applyForce(const Vrui::Point& p, Vrui::Vector F_v, double stepsize)
+{
+    Vrui::Scalar mag = Geometry::mag(F_v);
+
+    if(mag > 0)
+    {
+        if(mag > 1) F_v = F_v.normalize();
+        return p + F_v * stepsize;
+    }
+
+    return p;
+}
+
+/*
+ * Every interior point attracted by the same point of every other edge.
+ */
+void EdgeBundler::moveExact(int begin, int end)
+{
+    const vector<Vrui::Point>& points = buffers[current];
+    vector<Vrui::Point>& next = buffers[1 - current];
+    int edgeCount = edges.size();
+
+    for(int firstEdge = begin; firstEdge < end; firstEdge++)
+    {
+        const Vrui::Point* line = &points[firstEdge * stride];
+        Vrui::Point* newLine = &next[firstEdge * stride];
+        newLine[0] = line[0];
+        newLine[stride - 1] = line[stride - 1];
+
+        bool degenerate = line[0] == line[stride - 1];
+
+        for(int segment = 1; segment <= segments; segment++)
+        {
+            const Vrui::Point& p = line[segment];
+
+            if(degenerate)
+            {
+                newLine[segment] = p;
+                continue;
+            }
+
+            Vrui::Vector F_e_v = Vrui::Vector(0, 0, 0);
+
+            for(int secondEdge = 0; secondEdge < edgeCount; secondEdge++)
             {
                 if(firstEdge == secondEdge) continue;
-                
-                Vrui::Point& q = *getSegment(secondEdge, segment);
-                Vrui::Vector v = q - p;
+
+                Vrui::Vector v = points[secondEdge * stride + segment] - p;
                 Vrui::Scalar mag = Geometry::mag(v);
-                
+
                 if(mag > 0)
                 {
-                    Vrui::Vector F_e_v_delta = v / Math::pow(mag, 3); // power 2=linear, 3=quadratic
-                    F_e_v += F_e_v_delta;
+                    F_e_v += v / Math::pow(mag, 3); // power 2=linear, 3=quadratic
                 }
             }
-            
-            Vrui::Vector force  = Vrui::Vector(0, 0, 0);
-            Vrui::Vector F_v    = F_s_v + F_e_v;
-            Vrui::Scalar mag    = Geometry::mag(F_v);
-            
-            if(mag > 0)
-            {
-                if(mag > 1) F_v = F_v.normalize();
-                force += F_v * stepsize;
-            }
-            
-            p += force;
+
+            newLine[segment] = applyForce(p, getSpringForce(line, segment) + F_e_v, stepsize);
         }
     }
 }
 
-inline int EdgeBundler::getIndex(int i) const
+/*
+ * The sweep's point of each edge, attracted only by that point of
+ * compatible edges within the cutoff, each weighted by its compatibility.
+ */
+void EdgeBundler::moveAccelerated(int worker, int begin, int end)
 {
-    return i * pow(2.0, MAX_CYCLE - cycle);
-}
+    const vector<Vrui::Point>& points = buffers[current];
+    vector<Vrui::Point>& next = buffers[1 - current];
+    vector<float>& weights = compatibility[worker];
+    vector<int>& nearCells = cells[worker];
+    const int segment = sweepSegment;
 
-Vrui::Point* EdgeBundler::getSegment(int edge, int segment)
-{
-    int index = getIndex(segment);
-    
-    if(isSegmentEmpty(edge, index))
+    for(int firstEdge = begin; firstEdge < end; firstEdge++)
     {
-        if(segment == 0)
+        const Vrui::Point* line = &points[firstEdge * stride];
+        const Vrui::Point& p = line[segment];
+
+        if(line[0] == line[stride - 1])
         {
-            segmentVector[edge][index] = Vrui::Point(application->g->getSourceNodePosition(edge));
+            next[firstEdge * stride + segment] = p;
+            continue;
         }
-        else if(segment > segments)
+
+        const vector<pair<int, float> >& compatible = compatibleEdges[firstEdge];
+        for(int i = 0; i < (int)compatible.size(); i++)
         {
-            segmentVector[edge][index] = Vrui::Point(application->g->getTargetNodePosition(edge));
+            weights[compatible[i].first] = compatible[i].second;
         }
-        else
+
+        Vrui::Vector F_e_v = Vrui::Vector(0, 0, 0);
+        GridBox box;
+        box.add(p, cutoff);
+        pointGrid.getCells(box, nearCells);
+
+        foreach(int cell, nearCells)
         {
-            segmentVector[edge][index] = VruiHelp::midpoint(*getSegment(edge, segment - 1), *getSegment(edge, segment + 1));
+            foreach(int secondEdge, pointGrid.getCellNodes(cell))
+            {
+                if(weights[secondEdge] == 0) continue;
+
+                Vrui::Vector v = points[secondEdge * stride + segment] - p;
+                Vrui::Scalar mag = Geometry::mag(v);
+
+                if(mag > 0 && mag < cutoff)
+                {
+                    F_e_v += v * (weights[secondEdge] / Math::pow(mag, 3));
+                }
+            }
         }
-    }
-    
-    return &segmentVector[edge][index];
-}
 
-int EdgeBundler::getSegmentCount() const
-{
-    return segments;
-}
+        for(int i = 0; i < (int)compatible.size(); i++)
+        {
+            weights[compatible[i].first] = 0;
+        }
 
-inline bool EdgeBundler::isSegmentEmpty(int edge, int index) const
-{
-    return segmentVector[edge][index][0] == numeric_limits<float>::max();
+        next[firstEdge * stride + segment] = applyForce(p, getSpringForce(line, segment) + F_e_v, stepsize);
+    }
 }
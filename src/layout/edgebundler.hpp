@@ -23,36 +23,80 @@
 #include <mycelia.hpp>
 #include <vruihelp.hpp>
 #include <layout/graphlayout.hpp>
+#include <layout/workerpool.hpp>
+#include <render/nodegrid.hpp>
 
 #define SUBDIVISIONS_0      1
 #define STEPSIZE_0          0.04
 #define ITERATIONS_0        50
 #define MAX_CYCLE           5
 #define _K                  1.5     // higher = less bundling
+#define BUNDLE_COMPATIBILITY 0.6    // least edge compatibility that still attracts
+#define BUNDLE_CUTOFF       0.5     // of the mean edge length, beyond which points do not attract
 
-class EdgeBundler : public GraphLayout
+/*
+ * Force directed edge bundling. Every edge is a polyline of segments + 2
+ * points, source and target included, and all polylines sit back to back
+ * in one buffer. A step computes every new point from the current buffer
+ * into the other one, split over edges by a worker pool, and then swaps
+ * them; each cycle doubles the subdivision the same way.
+ */
+class EdgeBundler : public GraphLayout, public WorkerTask
 {
+    friend class GraphBench;
+
 private:
     int segments;
     double stepsize;
     int iterations;
     int cycle;
-    std::vector<std::vector<Vrui::Point> > segmentVector;
-    
-public:
-    EdgeBundler(Mycelia*);
-    
+
+    std::vector<int> edges; // bundled edge ids, by slot
+    std::vector<Vrui::Point> buffers[2];
+    int current; // buffer the renderer and the next step read
+    int stride; // points per edge, segments + 2
+    int version; // bumped by every swap, see getVersion()
+    Threads::Mutex bufferMutex; // held for swaps and while the renderer reads
+
+    WorkerPool pool;
+    int sweepSegment; // point moved by the current accelerated sweep
+
+    // accelerated mode: points only attract the same point of compatible
+    // edges, found through a grid over those points, within a cutoff
+    bool accelerated;
+    double minCompatibility;
+    double cutoffFraction;
+    Vrui::Scalar cutoff;
+    std::vector<std::vector<std::pair<int, float> > > compatibleEdges; // by slot, with compatibility
+    std::vector<std::vector<float> > compatibility; // per worker, of the moving edge by other slot
+    std::vector<std::vector<int> > cells; // per worker
+    NodeGrid pointGrid;
+
     void allocateSegments();
-    int getIndex(int) const;
-    Vrui::Point* getSegment(int, int);
-    int getSegmentCount() const;
-    bool isSegmentEmpty(int, int) const;
+    void buildCompatibility();
+    void subdivide();
+    void swapBuffers();
+    Vrui::Vector getSpringForce(const Vrui::Point*, int) const;
+    void moveExact(int, int);
+    void moveAccelerated(int, int, int);
 
 protected:
     virtual void* layout();
     virtual void layoutStep();
 
+public:
+    EdgeBundler(Mycelia*);
+
+    virtual void run(int, int, int);
+    void setAcceleration(bool, double compatibility=BUNDLE_COMPATIBILITY, double cutoff=BUNDLE_CUTOFF);
 
+    // for drawing: edge slot's points are getPoints()[slot * stride ..]
+    void lockPoints() { bufferMutex.lock(); }
+    void unlockPoints() { bufferMutex.unlock(); }
+    const std::vector<int>& getEdges() const { return edges; }
+    const std::vector<Vrui::Point>& getPoints() const { return buffers[current]; }
+    int getPointStride() const { return stride; }
+    int getVersion() const { return version; }
 };
 
 #endif
@@ -23,6 +23,78 @@ using namespace std;
 FruchtermanReingoldLayout::FruchtermanReingoldLayout(Mycelia* application)
     : GraphLayout(application)
 {
+    theta = BARNES_HUT_THETA;
+}
+
+double FruchtermanReingoldLayout::getTheta() const
+{
+    return theta;
+}
+
+void FruchtermanReingoldLayout::setTheta(double theta)
+{
+    this->theta = max(theta, 0.0);
+}
+
+/*
+ * Net repulsion on a node from every other included node. A pair pushes both
+ * nodes apart by k^2 * (1/d - d^2/R) weighted by the sum of their degrees, so
+ * a distant cell of the octree acts as a single body at its centroid with
+ * weight (degree * count + total cell degree).
+ */
+Vrui::Vector FruchtermanReingoldLayout::getRepulsion(int index, const vector<Vrui::Point>& positions, const vector<int>& degree) const
+{
+    const vector<Octree::Cell>& cells = octree.getCells();
+    const Vrui::Point& p = positions[index];
+    Vrui::Vector force(0, 0, 0);
+    double k2 = springForceConstant * springForceConstant;
+    
+    if(cells.empty()) return force;
+    
+    vector<int> stack;
+    stack.push_back(0);
+    
+    while(!stack.empty())
+    {
+        const Octree::Cell& c = cells[stack.back()];
+        stack.pop_back();
+        
+        if(c.body != -1)
+        {
+            // leaf, interact with each resident body exactly
+            for(int body = c.body; body != -1; body = octree.getNextBody(body))
+            {
+                if(body == index) continue;
+                
+                Vrui::Vector v = p - positions[body];
+                Vrui::Scalar mag = Geometry::mag(v);
+                
+                if(mag == 0) continue;
+                
+                double f = k2 * (1 / mag - mag * mag / REPULSION_RADIUS);
+                force += v * (f * (degree[index] + degree[body]) / mag);
+            }
+            continue;
+        }
+        
+        Vrui::Vector v = p - c.centroid;
+        Vrui::Scalar mag = Geometry::mag(v);
+        
+        // open cells that contain the node or that are too close for their size
+        if(octree.contains(c, p) || 2 * c.halfSize >= theta * mag)
+        {
+            for(int i = 0; i < 8; i++)
+            {
+                if(c.children[i] != -1) stack.push_back(c.children[i]);
+            }
+            continue;
+        }
+        
+        double f = k2 * (1 / mag - mag * mag / REPULSION_RADIUS);
+        force += v * (f * (degree[index] * c.count + c.charge) / mag);
+    }
+    
+    return force;
 }
 
 void* FruchtermanReingoldLayout::layout()
@@ -33,76 +105,169 @@ void* FruchtermanReingoldLayout::layout()
         stopped = true;
         return 0;
     }
-    springForceConstant = Math::pow(VOLUME / numNodes, 1.0 / 3.0);
+    springForceConstant = getSpringForceConstant(numNodes);
     
     for(remainingIterations = MAX_ITERATIONS; remainingIterations > 0 && !stopped; remainingIterations--)
     {
         layoutStep();
     }
     
+    // not stopped early
+    if(remainingIterations == 0)
+    {
+        application->postEvent("layout_converged", -1);
+    }
+
     stopped = true;
     application->resetNavigationCallback(0);
 
     return 0;
 }
 
-void FruchtermanReingoldLayout::layoutStep()
+double FruchtermanReingoldLayout::getSpringForceConstant(int nodeCount)
+{
+    return Math::pow((double)VOLUME / nodeCount, 1.0 / 3.0);
+}
+
+double FruchtermanReingoldLayout::getTemperature(int remainingIterations, int maxIterations)
 {
     // temperature affects rate of movement, starts at 1 and moves gradually to 0
-    double temperature = MAX_DELTA * Math::pow(remainingIterations / (double)MAX_ITERATIONS, COOLING_EXPONENT);
-    vector<Vrui::Vector> forceVector(application->g->getNodeCount());
+    return MAX_DELTA * Math::pow(remainingIterations / (double)maxIterations, COOLING_EXPONENT);
+}
+
+void FruchtermanReingoldLayout::layoutStep()
+{
+    StatTimer timer(application->stats, STAT_LAYOUT_STEP);
+
+    double temperature = getTemperature(remainingIterations, MAX_ITERATIONS);
+    
+    // snapshot the dense arrays so the inner loops avoid per-node hash lookups
+    Adjacency adjacency;
+    EdgePairs pairs;
+    application->g->getAdjacency(adjacency);
+    application->g->getEdgePairs(pairs);
+    
+    application->g->lock();
+    int nodeCount = application->g->getNodeCount();
+    
+    if((int)adjacency.offsets.size() != nodeCount + 1 || pairs.nodeCount != nodeCount)
+    {
+        // topology changed since the adjacency was built, try again next step
+        application->g->unlock();
+        return;
+    }
     
-    // calculate repulsion between all nodes
-    foreach(int source, application->g->getNodes())
+    vector<Vrui::Point> positions = application->g->getPositions();
+    const vector<int>* component = application->getSelectedComponent(application->g);
+    vector<bool> selected(nodeCount, component == 0);
+    
+    for(int i = 0; component && i < (int)component->size(); i++)
+    {
+        selected[(*component)[i]] = true;
+    }
+    application->g->unlock();
+    
+    // degree counts every edge end, as getNodeDegree does
+    vector<int> degree(nodeCount, 0);
+    
+    for(int index = 0; index < nodeCount; index++)
     {
-        if(!application->isSelectedComponent(source))
+        degree[index] += adjacency.offsets[index + 1] - adjacency.offsets[index];
+        
+        for(int slot = adjacency.offsets[index]; slot < adjacency.offsets[index + 1]; slot++)
         {
-            continue;
+            degree[adjacency.targets[slot]]++;
         }
+    }
+    
+    vector<Vrui::Vector> forceVector;
+    computeDisplacements(positions, selected, degree, pairs, springForceConstant, temperature, forceVector);
+    
+    application->g->updateNodePositions(forceVector);
+}
+
+/*
+ * One FR iteration over an array graph. The displacement of every selected
+ * node is limited by the temperature; unselected nodes do not move. Also
+ * used as the smoother of the multilevel layout.
+ */
+void FruchtermanReingoldLayout::computeDisplacements(const vector<Vrui::Point>& positions, const vector<bool>& selected,
+        const vector<int>& degree, const EdgePairs& pairs, double k, double temperature, vector<Vrui::Vector>& forceVector)
+{
+    int nodeCount = (int)positions.size();
+    springForceConstant = k;
+    
+    // repulsion only depends on nodes
+    forceVector.assign(nodeCount, Vrui::Vector(0, 0, 0));
+    
+    if(theta > 0)
+    {
+        // approximate repulsion with an octree rebuilt for this step
+        vector<double> charges(degree.begin(), degree.end());
+        octree.build(positions, charges, selected);
         
-        foreach(int target, application->g->getNodes())
+        for(int source = 0; source < nodeCount; source++)
         {
-            if(!application->isSelectedComponent(target) || source == target)
+            if(selected[source])
             {
-                continue;
+                forceVector[source] = getRepulsion(source, positions, degree);
             }
-            
-            // calculate repulsive force as k^2 / distance (or variant)
-            Vrui::Vector v = application->g->getNodePosition(source) - application->g->getNodePosition(target);
-            Vrui::Scalar mag = Geometry::mag(v);
-            
-            if(mag > 0) v = v.normalize();
-            else mag = 0.001;
-            
-            Vrui::Scalar repulsiveForce = springForceConstant * springForceConstant * (1 / mag - mag * mag / REPULSION_RADIUS);
-            Vrui::Scalar weightedForce = repulsiveForce * application->g->getNodeDegree(source);
-            
-            forceVector[source] += v * weightedForce;
-            forceVector[target] -= v * weightedForce;
-            
-            // attract connected nodes as distance^2 / k
-            if(application->g->hasEdge(source, target))
+        }
+    }
+    else if(nodeCount > 0)
+    {
+        // exact all-pairs repulsion, k^2 * (1/d - d^2/R) along the unit vector
+        RepulsionLaw law;
+        law.inverseSquare = springForceConstant * springForceConstant;
+        law.linear = -springForceConstant * springForceConstant / REPULSION_RADIUS;
+        kernel.setLaw(law);
+        
+        vector<double> charges(degree.begin(), degree.end());
+        vector<float> weights(degree.begin(), degree.end());
+        vector<float> fx(nodeCount), fy(nodeCount), fz(nodeCount);
+        
+        // Vrui points are stored as packed xyz triples
+        kernel.setPoints(nodeCount, positions[0].getComponents(), selected, &charges[0]);
+        kernel.compute(0, nodeCount, &weights[0], &fx[0], &fy[0], &fz[0]);
+        
+        for(int source = 0; source < nodeCount; source++)
+        {
+            if(selected[source])
             {
-                Vrui::Scalar attractiveForce = mag * mag / springForceConstant;
-                float edgeWeights = 0;
-                
-                foreach(int edge, application->g->getEdges(source, target))
-                {
-                    edgeWeights += application->g->getEdgeWeight(edge);
-                }
-                
-                attractiveForce *= edgeWeights;
-                forceVector[source] -= v * attractiveForce;
-                forceVector[target] += v * attractiveForce;
+                forceVector[source] = Vrui::Vector(fx[source], fy[source], fz[source]);
             }
         }
     }
     
+    // attract connected nodes as distance^2 / k, once per node pair with
+    // the weights of both directions summed
+    for(int pair = 0; pair < (int)pairs.sources.size(); pair++)
+    {
+        int source = pairs.sources[pair];
+        int target = pairs.targets[pair];
+        
+        if(!selected[source] || !selected[target])
+        {
+            continue;
+        }
+        
+        Vrui::Vector v = positions[source] - positions[target];
+        Vrui::Scalar mag = Geometry::mag(v);
+        
+        if(mag > 0) v = v.normalize();
+        else mag = 0.001;
+        
+        Vrui::Scalar attractiveForce = mag * mag / springForceConstant * pairs.weights[pair];
+        forceVector[source] -= v * attractiveForce;
+        forceVector[target] += v * attractiveForce;
+    }
+    
     // dampen motion and update position
-    for(int node = 0; node < application->g->getNodeCount(); node++)
+    for(int node = 0; node < nodeCount; node++)
     {
-        if(!application->isSelectedComponent(node))
+        if(!selected[node])
         {
+            forceVector[node] = Vrui::Vector(0, 0, 0);
             continue;
         }
         
@@ -112,7 +277,6 @@ void FruchtermanReingoldLayout::layoutStep()
         {
             forceVector[node] *= temperature / mag;
         }
-        
-        application->g->updateNodePosition(node, forceVector[node]);
     }
 }
+
@@ -22,22 +22,40 @@
 #include <graph.hpp>
 #include <mycelia.hpp>
 #include <layout/graphlayout.hpp>
+#include <layout/octree.hpp>
+#include <layout/repulsion.hpp>
 
 #define MAX_ITERATIONS 300
 #define MAX_DELTA 100
 #define COOLING_EXPONENT 1.5
 #define VOLUME 1000
 #define REPULSION_RADIUS 10000
+#define BARNES_HUT_THETA 0.5
 
 class FruchtermanReingoldLayout : public GraphLayout
 {
+    friend class GraphBench;
+    
 private:
     int remainingIterations;
     double springForceConstant;
+    double theta; // barnes-hut opening angle, 0 computes repulsion exactly
+    Octree octree;
+    RepulsionKernel kernel;
+    
+    Vrui::Vector getRepulsion(int, const std::vector<Vrui::Point>&, const std::vector<int>&) const;
     
 public:
     FruchtermanReingoldLayout(Mycelia*);
     
+    double getTheta() const;
+    void setTheta(double);
+    
+    static double getSpringForceConstant(int);
+    static double getTemperature(int, int);
+    void computeDisplacements(const std::vector<Vrui::Point>&, const std::vector<bool>&, const std::vector<int>&,
+                              const EdgePairs&, double, double, std::vector<Vrui::Vector>&);
+    
 protected:
     virtual void* layout();
     virtual void layoutStep();
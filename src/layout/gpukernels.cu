@@ -0,0 +1,395 @@
+/*
+ * Mycelia immersive 3d network visualization tool.
+ * Copyright (C) 2008-2010 Sean Whalen.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <cuda.h>
+#include <cutil.h>
+#include <cutil_math.h>
+#include <math_functions.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <layout/gpukernels.hpp>
+
+#define REPULSION_RADIUS 10000
+#define BLOCK_SIZE 256
+
+inline __host__ __device__ void operator+=(float4& p, float3 q)
+{
+    p.x += q.x;
+    p.y += q.y;
+    p.z += q.z;
+}
+
+/*
+ * Device resident graph. Edges are a symmetric CSR over unordered pairs so
+ * each thread accumulates its own row and no atomics are needed. Positions
+ * are copied to a snapshot buffer on the compute stream and streamed to
+ * pinned host memory on the copy stream while the next steps run.
+ */
+struct GpuLayoutContext
+{
+    int nodeCount;
+    int edgeSlots;
+    int targets; // every node interacts with every other included node
+
+    float4* positions_d; // w holds the node's fr weight (degree)
+    float4* velocities_d;
+    float4* forces_d;
+    float4* snapshot_d;
+    float* masses_d;
+    unsigned char* included_d;
+
+    int* offsets_d;
+    int* targets_d;
+    float* weights_d;
+    unsigned char* counts_d;
+
+    float4* positions_h; // pinned
+    cudaStream_t computeStream;
+    cudaStream_t copyStream;
+    cudaEvent_t stepDone;
+    cudaEvent_t copyDone;
+    bool copyPending;
+};
+
+__global__ void
+repulsionKernel(int size, const float4* positions, const unsigned char* included, int model,
+                GpuLayoutParameters params, float4* forces)
+{
+    __shared__ float4 tile[BLOCK_SIZE];
+
+    int i = blockIdx.x*blockDim.x + threadIdx.x;
+    float4 p = i < size ? positions[i] : make_float4(0, 0, 0, 0);
+    float3 f = make_float3(0, 0, 0);
+    float k2 = params.springForceConstant * params.springForceConstant;
+    float power = params.layoutRadius * sqrtf((float)size);
+    float exponent = -(1 + params.beta);
+    float ku = params.springConstants[0];
+    float lu = params.springLengths[0];
+
+    // all pairs, one tile of sources staged in shared memory at a time
+    for(int start = 0; start < size; start += BLOCK_SIZE)
+    {
+        int j = start + threadIdx.x;
+        tile[threadIdx.x] = j < size && included[j] ? positions[j] : make_float4(0, 0, 0, -1);
+        __syncthreads();
+
+        for(int t = 0; t < BLOCK_SIZE; t++)
+        {
+            float4 q = tile[t];
+            if(q.w < 0) continue; // excluded or padding
+
+            float3 v = make_float3(p) - make_float3(q);
+            float d2 = dot(v, v);
+            if(d2 == 0) continue; // self or coincident
+
+            float d = sqrtf(d2);
+
+            if(model == GPU_LAYOUT_STATIC)
+            {
+                // k^2 * (1/d - d^2/R) along the unit vector, weighted by both degrees
+                f += v * (k2 * (1 / d - d2 / REPULSION_RADIUS) * (p.w + q.w) / d);
+            }
+            else
+            {
+                // unconnected spring plus repulsion, corrected for edges below
+                f += v * (ku * (d - lu) / d + power * powf(d, exponent));
+            }
+        }
+        __syncthreads();
+    }
+
+    if(i < size)
+    {
+        forces[i] = make_float4(f.x, f.y, f.z, 0);
+    }
+}
+
+__global__ void
+attractionKernel(int size, const float4* positions, const unsigned char* included, const int* offsets,
+                 const int* targets, const float* weights, const unsigned char* counts, int model,
+                 GpuLayoutParameters params, float4* forces)
+{
+    int i = blockIdx.x*blockDim.x + threadIdx.x;
+    if(i >= size || !included[i]) return;
+
+    float3 p = make_float3(positions[i]);
+    float3 f = make_float3(0, 0, 0);
+
+    for(int slot = offsets[i]; slot < offsets[i + 1]; slot++)
+    {
+        int j = targets[slot];
+        if(!included[j]) continue;
+
+        float3 v = p - make_float3(positions[j]);
+        float d = length(v);
+
+        if(model == GPU_LAYOUT_STATIC)
+        {
+            if(d == 0) d = 0.001f;
+            f -= v * (d / params.springForceConstant * weights[slot]);
+        }
+        else
+        {
+            if(d == 0) continue;
+
+            int edgeCount = counts[slot];
+            float connected = params.springConstants[edgeCount] * (d - params.springLengths[edgeCount]);
+            float unconnected = params.springConstants[0] * (d - params.springLengths[0]);
+            f += v * ((connected - unconnected) / d);
+        }
+    }
+
+    forces[i] += f;
+}
+
+__global__ void
+staticIntegrateKernel(int size, float4* positions, const float4* forces, const unsigned char* included,
+                      GpuLayoutParameters params)
+{
+    int i = blockIdx.x*blockDim.x + threadIdx.x;
+    if(i >= size || !included[i]) return;
+
+    // scale if change is too large
+    float3 delta = make_float3(forces[i]);
+    float mag = length(delta);
+
+    if(mag > params.temperature)
+    {
+        delta *= params.temperature / mag;
+    }
+
+    positions[i] += delta;
+}
+
+__global__ void
+dynamicIntegrateKernel(int size, float4* positions, float4* velocities, const float4* forces,
+                       const float* masses, const unsigned char* included, int targets,
+                       GpuLayoutParameters params)
+{
+    int i = blockIdx.x*blockDim.x + threadIdx.x;
+    if(i >= size || !included[i] || i == params.pinned) return;
+
+    // damping acts once per target, as in the pairwise formulation
+    float3 velocity = make_float3(velocities[i]);
+    float3 force = make_float3(forces[i]) + velocity * (targets * params.damping);
+
+    velocities[i] += force * (params.integration / masses[i]);
+    positions[i] += velocity * (params.integration * targets);
+}
+
+extern "C"
+{
+    __host__ GpuLayoutContext*
+    gpuLayoutCreate()
+    {
+        GpuLayoutContext* context = new GpuLayoutContext();
+        memset(context, 0, sizeof(GpuLayoutContext));
+
+        CUDA_SAFE_CALL(cudaStreamCreate(&context->computeStream));
+        CUDA_SAFE_CALL(cudaStreamCreate(&context->copyStream));
+        CUDA_SAFE_CALL(cudaEventCreateWithFlags(&context->stepDone, cudaEventDisableTiming));
+        CUDA_SAFE_CALL(cudaEventCreateWithFlags(&context->copyDone, cudaEventDisableTiming));
+
+        return context;
+    }
+
+    static __host__ void
+    gpuLayoutRelease(GpuLayoutContext* context)
+    {
+        cudaStreamSynchronize(context->copyStream);
+        cudaStreamSynchronize(context->computeStream);
+
+        cudaFree(context->positions_d);
+        cudaFree(context->velocities_d);
+        cudaFree(context->forces_d);
+        cudaFree(context->snapshot_d);
+        cudaFree(context->masses_d);
+        cudaFree(context->included_d);
+        cudaFree(context->offsets_d);
+        cudaFree(context->targets_d);
+        cudaFree(context->weights_d);
+        cudaFree(context->counts_d);
+        cudaFreeHost(context->positions_h);
+
+        context->positions_d = context->velocities_d = context->forces_d = context->snapshot_d = 0;
+        context->masses_d = 0;
+        context->included_d = 0;
+        context->offsets_d = context->targets_d = 0;
+        context->weights_d = 0;
+        context->counts_d = 0;
+        context->positions_h = 0;
+        context->nodeCount = context->edgeSlots = context->targets = 0;
+        context->copyPending = false;
+    }
+
+    __host__ void
+    gpuLayoutDestroy(GpuLayoutContext* context)
+    {
+        gpuLayoutRelease(context);
+        cudaEventDestroy(context->stepDone);
+        cudaEventDestroy(context->copyDone);
+        cudaStreamDestroy(context->computeStream);
+        cudaStreamDestroy(context->copyStream);
+        delete context;
+    }
+
+    __host__ void
+    gpuLayoutSetGraph(GpuLayoutContext* context, int size, const float* positions, const float* masses,
+                      const unsigned char* included, const int* offsets, const int* targets,
+                      const float* weights, const unsigned char* counts)
+    {
+        gpuLayoutRelease(context);
+
+        int slots = offsets[size];
+        int allocated = slots > 0 ? slots : 1;
+        context->nodeCount = size;
+        context->edgeSlots = slots;
+        if(size == 0) return;
+
+        CUDA_SAFE_CALL(cudaMalloc((void**)&context->positions_d, sizeof(float4)*size));
+        CUDA_SAFE_CALL(cudaMalloc((void**)&context->velocities_d, sizeof(float4)*size));
+        CUDA_SAFE_CALL(cudaMalloc((void**)&context->forces_d, sizeof(float4)*size));
+        CUDA_SAFE_CALL(cudaMalloc((void**)&context->snapshot_d, sizeof(float4)*size));
+        CUDA_SAFE_CALL(cudaMalloc((void**)&context->masses_d, sizeof(float)*size));
+        CUDA_SAFE_CALL(cudaMalloc((void**)&context->included_d, size));
+        CUDA_SAFE_CALL(cudaMalloc((void**)&context->offsets_d, sizeof(int)*(size + 1)));
+        CUDA_SAFE_CALL(cudaMalloc((void**)&context->targets_d, sizeof(int)*allocated));
+        CUDA_SAFE_CALL(cudaMalloc((void**)&context->weights_d, sizeof(float)*allocated));
+        CUDA_SAFE_CALL(cudaMalloc((void**)&context->counts_d, allocated));
+        CUDA_SAFE_CALL(cudaMallocHost((void**)&context->positions_h, sizeof(float4)*size));
+
+        // fr weights are the node degree, summed over the row's direction counts
+        context->targets = -1;
+
+        for(int i = 0; i < size; i++)
+        {
+            if(included[i]) context->targets++;
+
+            float degree = 0;
+            for(int slot = offsets[i]; slot < offsets[i + 1]; slot++) degree += counts[slot];
+            context->positions_h[i] = make_float4(positions[3*i], positions[3*i + 1], positions[3*i + 2], degree);
+        }
+
+        cudaMemcpy(context->positions_d, context->positions_h, sizeof(float4)*size, cudaMemcpyHostToDevice);
+        cudaMemset(context->velocities_d, 0, sizeof(float4)*size);
+        cudaMemcpy(context->masses_d, masses, sizeof(float)*size, cudaMemcpyHostToDevice);
+        cudaMemcpy(context->included_d, included, size, cudaMemcpyHostToDevice);
+        cudaMemcpy(context->offsets_d, offsets, sizeof(int)*(size + 1), cudaMemcpyHostToDevice);
+        cudaMemcpy(context->targets_d, targets, sizeof(int)*slots, cudaMemcpyHostToDevice);
+        cudaMemcpy(context->weights_d, weights, sizeof(float)*slots, cudaMemcpyHostToDevice);
+        cudaMemcpy(context->counts_d, counts, slots, cudaMemcpyHostToDevice);
+    }
+
+    __host__ void
+    gpuLayoutSetPositions(GpuLayoutContext* context, const float* positions)
+    {
+        int size = context->nodeCount;
+        if(size == 0) return;
+
+        // the pinned buffer may still be in use by a pending copy
+        cudaStreamSynchronize(context->copyStream);
+        cudaStreamSynchronize(context->computeStream);
+        context->copyPending = false;
+
+        // keep the degree weights already on the device
+        cudaMemcpy(context->positions_h, context->positions_d, sizeof(float4)*size, cudaMemcpyDeviceToHost);
+
+        for(int i = 0; i < size; i++)
+        {
+            context->positions_h[i].x = positions[3*i];
+            context->positions_h[i].y = positions[3*i + 1];
+            context->positions_h[i].z = positions[3*i + 2];
+        }
+
+        cudaMemcpy(context->positions_d, context->positions_h, sizeof(float4)*size, cudaMemcpyHostToDevice);
+    }
+
+    __host__ void
+    gpuLayoutStep(GpuLayoutContext* context, int model, const GpuLayoutParameters* params)
+    {
+        int size = context->nodeCount;
+        if(size == 0) return;
+
+        dim3 dimBlock(BLOCK_SIZE);
+        dim3 dimGrid((size + BLOCK_SIZE - 1) / BLOCK_SIZE);
+        cudaStream_t stream = context->computeStream;
+
+        repulsionKernel<<<dimGrid, dimBlock, 0, stream>>>(size, context->positions_d, context->included_d,
+                                                          model, *params, context->forces_d);
+        attractionKernel<<<dimGrid, dimBlock, 0, stream>>>(size, context->positions_d, context->included_d,
+                                                           context->offsets_d, context->targets_d, context->weights_d,
+                                                           context->counts_d, model, *params, context->forces_d);
+
+        if(model == GPU_LAYOUT_STATIC)
+        {
+            staticIntegrateKernel<<<dimGrid, dimBlock, 0, stream>>>(size, context->positions_d, context->forces_d,
+                                                                    context->included_d, *params);
+        }
+        else
+        {
+            dynamicIntegrateKernel<<<dimGrid, dimBlock, 0, stream>>>(size, context->positions_d, context->velocities_d,
+                                                                     context->forces_d, context->masses_d,
+                                                                     context->included_d, context->targets, *params);
+        }
+    }
+
+    __host__ int
+    gpuLayoutRequestPositions(GpuLayoutContext* context)
+    {
+        int size = context->nodeCount;
+        if(size == 0 || context->copyPending) return 0;
+
+        // snapshot on the compute stream, then stream to the host behind it
+        cudaMemcpyAsync(context->snapshot_d, context->positions_d, sizeof(float4)*size,
+                        cudaMemcpyDeviceToDevice, context->computeStream);
+        cudaEventRecord(context->stepDone, context->computeStream);
+        cudaStreamWaitEvent(context->copyStream, context->stepDone, 0);
+        cudaMemcpyAsync(context->positions_h, context->snapshot_d, sizeof(float4)*size,
+                        cudaMemcpyDeviceToHost, context->copyStream);
+        cudaEventRecord(context->copyDone, context->copyStream);
+
+        context->copyPending = true;
+        return 1;
+    }
+
+    __host__ int
+    gpuLayoutFetchPositions(GpuLayoutContext* context, float* positions, int wait)
+    {
+        if(!context->copyPending) return 0;
+
+        if(wait)
+        {
+            cudaEventSynchronize(context->copyDone);
+        }
+        else if(cudaEventQuery(context->copyDone) != cudaSuccess)
+        {
+            return 0;
+        }
+
+        for(int i = 0; i < context->nodeCount; i++)
+        {
+            positions[3*i] = context->positions_h[i].x;
+            positions[3*i + 1] = context->positions_h[i].y;
+            positions[3*i + 2] = context->positions_h[i].z;
+        }
+
+        context->copyPending = false;
+        return 1;
+    }
+}
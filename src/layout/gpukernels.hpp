@@ -0,0 +1,73 @@
+/*
+ * Mycelia immersive 3d network visualization tool.
+ * Copyright (C) 2008-2010 Sean Whalen.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __GPUKERNELS_HPP
+#define __GPUKERNELS_HPP
+
+/*
+ * C interface to the CUDA layout kernels in gpukernels.cu. The graph lives on
+ * the device between steps; positions are streamed back through a pinned
+ * host buffer without stalling the step loop.
+ */
+
+#define GPU_LAYOUT_STATIC 0
+#define GPU_LAYOUT_DYNAMIC 1
+
+struct GpuLayoutContext;
+
+// force law parameters for both models, unused fields are ignored
+struct GpuLayoutParameters
+{
+    // fruchterman-reingold
+    float springForceConstant;
+    float temperature;
+
+    // arf
+    float damping;
+    float beta;
+    float layoutRadius;
+    float integration; // scale of rk4 from rest, see VruiHelp::rk4
+    float springConstants[3]; // by number of directed edges between a pair
+    float springLengths[3];
+    int pinned; // node held by the user, -1 for none
+};
+
+extern "C"
+{
+    GpuLayoutContext* gpuLayoutCreate();
+    void gpuLayoutDestroy(GpuLayoutContext*);
+
+    // xyz positions, masses and selection by dense index, and a symmetric
+    // CSR of unordered edge pairs with summed weights and direction counts
+    void gpuLayoutSetGraph(GpuLayoutContext*, int nodeCount, const float* positions, const float* masses,
+                           const unsigned char* included, const int* offsets, const int* targets,
+                           const float* weights, const unsigned char* counts);
+    void gpuLayoutSetPositions(GpuLayoutContext*, const float* positions);
+
+    void gpuLayoutStep(GpuLayoutContext*, int model, const GpuLayoutParameters*);
+
+    // starts copying the current positions back, returns 0 if a copy is
+    // still in flight
+    int gpuLayoutRequestPositions(GpuLayoutContext*);
+
+    // copies finished positions into the xyz array, returns 0 if not ready;
+    // wait blocks until the copy completes
+    int gpuLayoutFetchPositions(GpuLayoutContext*, float* positions, int wait);
+}
+
+#endif
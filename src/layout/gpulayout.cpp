@@ -0,0 +1,276 @@
+/*
+ * Mycelia immersive 3d network visualization tool.
+ * Copyright (C) 2008-2010 Sean Whalen.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <layout/arflayout.hpp>
+#include <layout/frlayout.hpp>
+#include <layout/gpulayout.hpp>
+
+using namespace std;
+
+GpuLayout::GpuLayout(Mycelia* application, bool dynamic)
+    : GraphLayout(application), context(0), pinned(-1), wakeups(0)
+{
+    this->dynamic = dynamic;
+}
+
+int GpuLayout::getWakeups()
+{
+    sleepMutex.lock();
+    int result = wakeups;
+    sleepMutex.unlock();
+
+    return result;
+}
+
+// blocks until a wake() after the given count, or stop()
+void GpuLayout::sleep(int seen)
+{
+    sleepMutex.lock();
+    while(wakeups == seen && !stopped)
+    {
+        sleepCond.wait(sleepMutex);
+    }
+    sleepMutex.unlock();
+}
+
+void GpuLayout::wake()
+{
+    sleepMutex.lock();
+    wakeups++;
+    sleepCond.signal();
+    sleepMutex.unlock();
+}
+
+void GpuLayout::getParameters(GpuLayoutParameters& params) const
+{
+    const ArfLayout* arf = application->getDynamicLayout();
+    int nodeCount = positions.size() / 3;
+
+    params.springForceConstant = FruchtermanReingoldLayout::getSpringForceConstant(max(nodeCount, 1));
+    params.temperature = FruchtermanReingoldLayout::getTemperature(remainingIterations, MAX_ITERATIONS);
+
+    params.damping = arf->dampingConstant;
+    params.beta = arf->beta;
+    params.layoutRadius = arf->layoutRadius;
+
+    // indexed by the number of directed edges between a pair
+    params.springConstants[0] = arf->unconnectedSpringConstant;
+    params.springConstants[1] = arf->connectedSpringConstant;
+    params.springConstants[2] = arf->stronglyConnectedSpringConstant;
+    params.springLengths[0] = arf->unconnectedSpringLength;
+    params.springLengths[1] = arf->connectedSpringLength;
+    params.springLengths[2] = arf->stronglyConnectedSpringLength;
+
+    // VruiHelp::rk4 from rest reduces to a scale of the derivative
+    double dt = arf->deltaTime;
+    params.integration = (dt + dt*dt + dt*dt*dt / 2 + dt*dt*dt*dt / 4) / 6;
+    params.pinned = pinned;
+}
+
+/*
+ * Brings the device up to date with the graph. Topology or selection changes
+ * upload everything, position changes from elsewhere (dragging, rpc) only
+ * upload positions. Returns false if there is nothing to lay out.
+ */
+bool GpuLayout::upload()
+{
+    EdgePairs pairs;
+    application->g->getEdgePairs(pairs);
+
+    application->g->lock();
+    int nodeCount = application->g->getNodeCount();
+
+    if(pairs.nodeCount != nodeCount || nodeCount == 0)
+    {
+        // topology changed since the pairs were built, try again next step
+        application->g->unlock();
+        return false;
+    }
+
+    int topology = application->g->getTopologyVersion();
+    int selection = application->getSelectedNode();
+    bool full = topology != uploadedTopology || selection != uploadedSelection;
+    bool moved = application->g->getPositionVersion() != writtenPositionVersion;
+
+    if(!full && !moved)
+    {
+        application->g->unlock();
+        return true;
+    }
+
+    const vector<Vrui::Point>& points = application->g->getPositions();
+    positions.resize(3 * nodeCount);
+
+    for(int index = 0; index < nodeCount; index++)
+    {
+        for(int i = 0; i < 3; i++) positions[3 * index + i] = points[index][i];
+    }
+    writtenPositionVersion = application->g->getPositionVersion();
+
+    if(!full)
+    {
+        application->g->unlock();
+        gpuLayoutSetPositions(context, &positions[0]);
+        return true;
+    }
+
+    vector<float> masses(application->g->getSizes()); // treat size as mass
+    const vector<int>* component = application->getSelectedComponent(application->g);
+    vector<unsigned char> included(nodeCount, component == 0);
+    pinned = application->g->isValidNode(selection) ? application->g->getNodeIndex(selection) : -1;
+
+    for(int i = 0; component && i < (int)component->size(); i++)
+    {
+        included[(*component)[i]] = 1;
+    }
+    application->g->unlock();
+
+    // symmetric csr over the pairs, each pair appears in both rows
+    int pairCount = pairs.sources.size();
+    vector<int> offsets(nodeCount + 1, 0);
+
+    for(int pair = 0; pair < pairCount; pair++)
+    {
+        offsets[pairs.sources[pair] + 1]++;
+        offsets[pairs.targets[pair] + 1]++;
+    }
+
+    for(int index = 0; index < nodeCount; index++)
+    {
+        offsets[index + 1] += offsets[index];
+    }
+
+    vector<int> next(offsets.begin(), offsets.end() - 1);
+    vector<int> targets(2 * pairCount + 1);
+    vector<float> weights(2 * pairCount + 1);
+    vector<unsigned char> counts(2 * pairCount + 1);
+
+    for(int pair = 0; pair < pairCount; pair++)
+    {
+        int source = pairs.sources[pair];
+        int target = pairs.targets[pair];
+
+        int slot = next[source]++;
+        targets[slot] = target;
+        weights[slot] = pairs.weights[pair];
+        counts[slot] = pairs.counts[pair];
+
+        slot = next[target]++;
+        targets[slot] = source;
+        weights[slot] = pairs.weights[pair];
+        counts[slot] = pairs.counts[pair];
+    }
+
+    gpuLayoutSetGraph(context, nodeCount, &positions[0], &masses[0], &included[0], &offsets[0],
+                      &targets[0], &weights[0], &counts[0]);
+
+    uploadedTopology = topology;
+    uploadedSelection = selection;
+    return true;
+}
+
+/*
+ * Publishes finished device positions, returns false if no copy completed.
+ * Results for a graph that has since changed shape are dropped.
+ */
+bool GpuLayout::download(bool wait)
+{
+    if(!gpuLayoutFetchPositions(context, &positions[0], wait))
+    {
+        return false;
+    }
+
+    if(application->g->getTopologyVersion() != uploadedTopology)
+    {
+        return false;
+    }
+
+    int nodeCount = positions.size() / 3;
+    vector<Vrui::Point> points(nodeCount);
+
+    for(int index = 0; index < nodeCount; index++)
+    {
+        points[index] = Vrui::Point(positions[3 * index], positions[3 * index + 1], positions[3 * index + 2]);
+    }
+
+    writtenPositionVersion = application->g->setNodePositions(points);
+    return true;
+}
+
+void* GpuLayout::layout()
+{
+    context = gpuLayoutCreate();
+    uploadedTopology = -1;
+    uploadedSelection = -1;
+    writtenPositionVersion = -1;
+    remainingIterations = MAX_ITERATIONS;
+
+    GpuLayoutParameters params;
+
+    if(dynamic)
+    {
+        while(!stopped)
+        {
+            // read before uploading so an edit during the upload is not missed
+            int seen = getWakeups();
+
+            if(!upload())
+            {
+                // an empty graph, or one edited mid upload, which woke us already
+                sleep(seen);
+                continue;
+            }
+
+            StatTimer timer(application->stats, STAT_LAYOUT_STEP);
+            getParameters(params);
+            gpuLayoutStep(context, GPU_LAYOUT_DYNAMIC, &params);
+
+            // keep at most one copy in flight, the device runs ahead meanwhile
+            gpuLayoutRequestPositions(context);
+            download(false);
+        }
+    }
+    else if(upload())
+    {
+        for(; remainingIterations > 0 && !stopped; remainingIterations--)
+        {
+            StatTimer timer(application->stats, STAT_LAYOUT_STEP);
+            getParameters(params);
+            gpuLayoutStep(context, GPU_LAYOUT_STATIC, &params);
+
+            gpuLayoutRequestPositions(context);
+            download(false);
+        }
+
+        // flush any copy in flight, then fetch the final positions
+        download(true);
+        gpuLayoutRequestPositions(context);
+        download(true);
+    }
+
+    gpuLayoutDestroy(context);
+    context = 0;
+
+    if(!dynamic)
+    {
+        stopped = true;
+        application->resetNavigationCallback(0);
+    }
+
+    return 0;
+}
@@ -0,0 +1,69 @@
+/*
+ * Mycelia immersive 3d network visualization tool.
+ * Copyright (C) 2008-2010 Sean Whalen.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __GPULAYOUT_HPP
+#define __GPULAYOUT_HPP
+
+#include <Threads/Cond.h>
+#include <Threads/Mutex.h>
+
+#include <graph.hpp>
+#include <mycelia.hpp>
+#include <layout/gpukernels.hpp>
+#include <layout/graphlayout.hpp>
+
+/*
+ * Runs the static fruchterman-reingold or dynamic arf model on the gpu. The
+ * graph is uploaded once per topology change and stays on the device, and
+ * positions are streamed back while the next steps run. Parameters are
+ * shared with the cpu layouts so the arf window controls both.
+ */
+class GpuLayout : public GraphLayout
+{
+private:
+    GpuLayoutContext* context;
+    int uploadedTopology;
+    int uploadedSelection;
+    int writtenPositionVersion; // graph position version after our last write
+    int remainingIterations;
+    int pinned;
+
+    // xyz triples by dense index, shared with the device
+    std::vector<float> positions;
+
+    // counted so the dynamic loop can wait for the next graph edit
+    int wakeups;
+    Threads::Mutex sleepMutex;
+    Threads::Cond sleepCond;
+
+    bool upload();
+    bool download(bool);
+    void getParameters(GpuLayoutParameters&) const;
+    int getWakeups();
+    void sleep(int);
+
+public:
+    GpuLayout(Mycelia*, bool);
+
+    virtual void wake();
+
+protected:
+    virtual void* layout();
+};
+
+#endif
@@ -34,7 +34,7 @@ protected:
     virtual void* layout() = 0;
 
 public:
-    GraphLayout(Mycelia* application) : application(application), dynamic(false)
+    GraphLayout(Mycelia* application) : application(application), stopped(true), dynamic(false)
     {
         layoutThread = new Threads::Thread();
     }
@@ -52,6 +52,7 @@ public:
     void stop()
     {
         stopped = true;
+        wake();
         
         if(layoutThread && !layoutThread->isJoined())
         {
@@ -68,6 +69,11 @@ public:
     {
         return dynamic;
     }
+
+    // called on graph edits and drags, layouts that idle override this
+    virtual void wake()
+    {
+    }
 };
 
 #endif
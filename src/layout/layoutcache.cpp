@@ -0,0 +1,360 @@
+/*
+ * Mycelia immersive 3d network visualization tool.
+ * Copyright (C) 2008-2010 Sean Whalen.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <layout/layoutcache.hpp>
+#include <vruihelp.hpp>
+
+#include <climits>
+#include <cstdlib>
+#include <deque>
+#include <sys/stat.h>
+
+using namespace std;
+
+namespace
+{
+// FNV-1a, 64 bit
+void hashBytes(uint64_t& hash, const void* bytes, size_t size)
+{
+    const unsigned char* p = (const unsigned char*)bytes;
+
+    for(size_t i = 0; i < size; i++)
+    {
+        hash = (hash ^ p[i]) * 1099511628211ULL;
+    }
+}
+
+void hashInt(uint64_t& hash, int32_t value)
+{
+    hashBytes(hash, &value, sizeof(value));
+}
+
+// label -> node id, or -1 for labels on more than one node
+void indexLabels(Graph* g, tr1::unordered_map<string, int>& labels)
+{
+    foreach(int node, g->getNodes())
+    {
+        const string& label = g->getNodeLabel(node);
+
+        if(label.empty()) continue;
+
+        tr1::unordered_map<string, int>::iterator it = labels.find(label);
+
+        if(it == labels.end())
+        {
+            labels[label] = node;
+        }
+        else
+        {
+            it->second = -1;
+        }
+    }
+}
+
+// mkdir -p, existing components are fine
+void makeDirectories(const string& path)
+{
+    for(size_t end = path.find('/', 1); end != string::npos; end = path.find('/', end + 1))
+    {
+        mkdir(path.substr(0, end).c_str(), 0755);
+    }
+
+    mkdir(path.c_str(), 0755);
+}
+}
+
+LayoutCache::LayoutCache(Mycelia* application, const string& directory)
+    : application(application),
+      directory(directory)
+{
+}
+
+// of node ids and labels and of edges, in id order
+uint64_t LayoutCache::getTopologyHash(Graph* g)
+{
+    uint64_t hash = 14695981039346656037ULL;
+
+    hashInt(hash, g->getNodeCount());
+
+    foreach(int node, g->getNodes())
+    {
+        const string& label = g->getNodeLabel(node);
+        hashInt(hash, node);
+        hashInt(hash, label.size());
+        hashBytes(hash, label.data(), label.size());
+    }
+
+    hashInt(hash, g->getEdgeCount());
+
+    foreach(int edge, g->getEdges())
+    {
+        const Edge& e = g->getEdge(edge);
+        hashInt(hash, edge);
+        hashInt(hash, e.source);
+        hashInt(hash, e.target);
+    }
+
+    return hash;
+}
+
+// one snapshot per source, named for a hash of its full path
+string LayoutCache::getPath(const string& source) const
+{
+    if(directory.empty() || source.empty())
+    {
+        return "";
+    }
+
+    char resolved[PATH_MAX];
+    string name = realpath(source.c_str(), resolved) ? resolved : source;
+
+    uint64_t hash = 14695981039346656037ULL;
+    hashBytes(hash, name.data(), name.size());
+
+    ostringstream path;
+    path << directory << "/" << hex << hash << SNAPSHOT_EXTENSION;
+    return path.str();
+}
+
+/*
+ * Positions g from the cache of source and returns how much of it matched,
+ * a LAYOUT_CACHE_* value, with the ids of the seeded nodes in unmatched.
+ * g is left alone on a miss.
+ */
+int LayoutCache::load(Graph* g, const string& source, vector<int>& unmatched) const
+{
+    unmatched.clear();
+
+    string path = getPath(source);
+    struct stat info;
+
+    if(path.empty() || stat(path.c_str(), &info) != 0)
+    {
+        return LAYOUT_CACHE_MISS;
+    }
+
+    VruiHelp::MappedFile file(path);
+    Graph cached(application);
+
+    if(!file.isOpen() || !cached.readSnapshot(file.begin(), file.end(), path, false))
+    {
+        return LAYOUT_CACHE_MISS;
+    }
+
+    bool exact = getTopologyHash(g) == getTopologyHash(&cached);
+
+    tr1::unordered_map<string, int> labels;
+    tr1::unordered_map<string, int> cachedLabels;
+
+    if(!exact)
+    {
+        indexLabels(g, labels);
+        indexLabels(&cached, cachedLabels);
+    }
+
+    const vector<int>& indexNodes = g->getIndexNodes();
+    int n = indexNodes.size();
+    vector<Vrui::Point> positions = g->getPositions();
+    vector<bool> placed(n, false);
+    int matched = 0;
+
+    for(int i = 0; i < n; i++)
+    {
+        int node = indexNodes[i];
+        int match = -1;
+
+        if(exact)
+        {
+            match = node;
+        }
+        else
+        {
+            const string& label = g->getNodeLabel(node);
+            tr1::unordered_map<string, int>::const_iterator own = labels.find(label);
+            tr1::unordered_map<string, int>::const_iterator other = cachedLabels.find(label);
+
+            if(own != labels.end() && own->second != -1 && other != cachedLabels.end() && other->second != -1)
+            {
+                match = other->second;
+            }
+            else if(cached.isValidNode(node) && cached.getNodeLabel(node) == label)
+            {
+                match = node;
+            }
+        }
+
+        if(match != -1)
+        {
+            positions[i] = cached.getNodePosition(match);
+            placed[i] = true;
+            matched++;
+        }
+    }
+
+    if(matched == 0 || matched < LAYOUT_CACHE_MIN_MATCH * n)
+    {
+        return LAYOUT_CACHE_MISS;
+    }
+
+    if(matched < n)
+    {
+        for(int i = 0; i < n; i++)
+        {
+            if(!placed[i]) unmatched.push_back(indexNodes[i]);
+        }
+
+        seed(g, positions, placed);
+    }
+
+    g->setNodePositions(positions);
+
+    return exact ? LAYOUT_CACHE_EXACT : LAYOUT_CACHE_PARTIAL;
+}
+
+/*
+ * Places the nodes not yet placed, breadth first from those that are: each
+ * at the mean of its placed neighbors, jittered by a fraction of the mean
+ * edge length, or one mean edge length from its only placed neighbor.
+ * Nodes connected to nothing placed go anywhere in the placed nodes' box.
+ */
+void LayoutCache::seed(Graph* g, vector<Vrui::Point>& positions, vector<bool>& placed) const
+{
+    EdgePairs pairs;
+    g->getEdgePairs(pairs);
+    int n = positions.size();
+    int m = pairs.sources.size();
+
+    // undirected neighbor lists by dense index
+    vector<int> offsets(n + 1, 0);
+    vector<int> neighbors(2 * m);
+
+    for(int e = 0; e < m; e++)
+    {
+        offsets[pairs.sources[e] + 1]++;
+        offsets[pairs.targets[e] + 1]++;
+    }
+
+    for(int i = 0; i < n; i++)
+    {
+        offsets[i + 1] += offsets[i];
+    }
+
+    vector<int> fill(offsets.begin(), offsets.end() - 1);
+
+    for(int e = 0; e < m; e++)
+    {
+        neighbors[fill[pairs.sources[e]]++] = pairs.targets[e];
+        neighbors[fill[pairs.targets[e]]++] = pairs.sources[e];
+    }
+
+    double length = 0;
+    int lengths = 0;
+    Vrui::Point min = Vrui::Point::origin;
+    Vrui::Point max = Vrui::Point::origin;
+    deque<int> queue;
+
+    for(int i = 0; i < n; i++)
+    {
+        if(!placed[i]) continue;
+
+        for(int j = 0; j < 3; j++)
+        {
+            if(queue.empty() || positions[i][j] < min[j]) min[j] = positions[i][j];
+            if(queue.empty() || positions[i][j] > max[j]) max[j] = positions[i][j];
+        }
+
+        queue.push_back(i);
+    }
+
+    for(int e = 0; e < m; e++)
+    {
+        if(placed[pairs.sources[e]] && placed[pairs.targets[e]])
+        {
+            length += Geometry::dist(positions[pairs.sources[e]], positions[pairs.targets[e]]);
+            lengths++;
+        }
+    }
+
+    double meanLength = lengths > 0 ? length / lengths : 1;
+    double jitter = LAYOUT_CACHE_JITTER * meanLength;
+
+    while(!queue.empty())
+    {
+        int i = queue.front();
+        queue.pop_front();
+
+        for(int k = offsets[i]; k < offsets[i + 1]; k++)
+        {
+            int next = neighbors[k];
+
+            if(placed[next]) continue;
+
+            Vrui::Vector sum(0, 0, 0);
+            int count = 0;
+
+            for(int l = offsets[next]; l < offsets[next + 1]; l++)
+            {
+                if(placed[neighbors[l]])
+                {
+                    sum += positions[neighbors[l]] - Vrui::Point::origin;
+                    count++;
+                }
+            }
+
+            Vrui::Vector offset(0, 0, 0);
+
+            for(int j = 0; j < 3; j++)
+            {
+                offset[j] = 2 * VruiHelp::randomFloat() - 1;
+            }
+
+            // a leaf goes one edge length out, on top of its neighbor it
+            // would be thrown clear by the repulsion
+            double scale = Geometry::mag(offset) > 0 ? meanLength / Geometry::mag(offset) : 0;
+            positions[next] = Vrui::Point::origin + sum / count + (count == 1 ? scale : jitter) * offset;
+
+            placed[next] = true;
+            queue.push_back(next);
+        }
+    }
+
+    for(int i = 0; i < n; i++)
+    {
+        if(placed[i]) continue;
+
+        for(int j = 0; j < 3; j++)
+        {
+            positions[i][j] = min[j] + (max[j] - min[j]) * VruiHelp::randomFloat();
+        }
+    }
+}
+
+// a snapshot of g as laid out, for the next time source is opened
+bool LayoutCache::save(Graph* g, const string& source) const
+{
+    string path = getPath(source);
+
+    if(path.empty())
+    {
+        return false;
+    }
+
+    makeDirectories(directory);
+
+    return g->writeSnapshot(path);
+}
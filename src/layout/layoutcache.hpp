@@ -0,0 +1,63 @@
+/*
+ * Mycelia immersive 3d network visualization tool.
+ * Copyright (C) 2008-2010 Sean Whalen.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __LAYOUTCACHE_HPP
+#define __LAYOUTCACHE_HPP
+
+#include <graph.hpp>
+#include <mycelia.hpp>
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#define LAYOUT_CACHE_MISS 0 // nothing usable cached, lay out from random positions
+#define LAYOUT_CACHE_PARTIAL 1 // cached positions for most nodes, the rest seeded near them
+#define LAYOUT_CACHE_EXACT 2 // same nodes, labels and edges as cached, already settled
+#define LAYOUT_CACHE_DIRECTORY "data/layouts" // see etc/mycelia.cfg
+#define LAYOUT_CACHE_MIN_MATCH 0.5 // fraction of nodes to match for a partial start
+#define LAYOUT_CACHE_JITTER 0.1 // seeded nodes land this far from their neighbors' mean, in mean edge lengths
+
+/*
+ * Settled layouts saved per source file, as snapshots in the cache
+ * directory, so reopening a file starts from where its last layout
+ * stopped. A file whose graph changed since reuses the cached positions of
+ * its matching nodes: by label where a label is unique on both sides, else
+ * by id where the labels agree. The other nodes are seeded breadth first
+ * near their placed neighbors.
+ */
+class LayoutCache
+{
+private:
+    Mycelia* application;
+    std::string directory; // empty disables the cache
+
+    std::string getPath(const std::string&) const;
+    void seed(Graph*, std::vector<Vrui::Point>&, std::vector<bool>&) const;
+
+public:
+    LayoutCache(Mycelia*, const std::string& = LAYOUT_CACHE_DIRECTORY);
+
+    static uint64_t getTopologyHash(Graph*);
+
+    int load(Graph*, const std::string&, std::vector<int>&) const;
+    bool save(Graph*, const std::string&) const;
+    void setDirectory(const std::string& directory) { this->directory = directory; }
+};
+
+#endif
@@ -0,0 +1,362 @@
+/*
+ * Mycelia immersive 3d network visualization tool.
+ * Copyright (C) 2008-2010 Sean Whalen.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <layout/multilevellayout.hpp>
+
+#include <algorithm>
+
+using namespace std;
+
+MultilevelLayout::MultilevelLayout(Mycelia* application)
+    : GraphLayout(application), smoother(application), seed(1)
+{
+}
+
+// small deterministic generator so a layout can be reproduced
+int MultilevelLayout::random(int range)
+{
+    seed = seed * 1103515245 + 12345;
+    return (int)((seed >> 8) % (unsigned int)range);
+}
+
+void* MultilevelLayout::layout()
+{
+    // snapshot the selected part of the graph as an undirected level
+    Adjacency adjacency;
+    application->g->getAdjacency(adjacency);
+
+    application->g->lock();
+    int nodeCount = application->g->getNodeCount();
+    int topologyVersion = application->g->getTopologyVersion();
+
+    if((int)adjacency.offsets.size() != nodeCount + 1 || nodeCount == 0)
+    {
+        application->g->unlock();
+        stopped = true;
+        return 0;
+    }
+
+    vector<Vrui::Point> original = application->g->getPositions();
+    vector<int> local(nodeCount, -1);
+    vector<int> global;
+    const vector<int>* component = application->getSelectedComponent(application->g);
+
+    if(component)
+    {
+        // ascending, as for the whole graph
+        global = *component;
+        sort(global.begin(), global.end());
+    }
+    else
+    {
+        global.resize(nodeCount);
+
+        for(int index = 0; index < nodeCount; index++)
+        {
+            global[index] = index;
+        }
+    }
+
+    for(int i = 0; i < (int)global.size(); i++)
+    {
+        local[global[i]] = i;
+    }
+    application->g->unlock();
+
+    Level fine;
+    fine.nodeCount = (int)global.size();
+    fine.mass.assign(fine.nodeCount, 1);
+
+    for(int source = 0; source < nodeCount; source++)
+    {
+        for(int slot = adjacency.offsets[source]; slot < adjacency.offsets[source + 1]; slot++)
+        {
+            int s = local[source];
+            int t = local[adjacency.targets[slot]];
+
+            if(s == -1 || t == -1 || s == t) continue;
+
+            fine.sources.push_back(min(s, t));
+            fine.targets.push_back(max(s, t));
+            fine.weights.push_back(adjacency.weights[slot]);
+        }
+    }
+
+    mergeEdges(fine);
+
+    vector<Vrui::Point> positions;
+    seed = 1;
+
+    if(layoutLevels(fine, positions) && application->g->getTopologyVersion() == topologyVersion)
+    {
+        vector<Vrui::Vector> deltas(nodeCount, Vrui::Vector(0, 0, 0));
+
+        for(int i = 0; i < fine.nodeCount; i++)
+        {
+            deltas[global[i]] = positions[i] - original[global[i]];
+        }
+
+        application->g->updateNodePositions(deltas);
+    }
+
+    stopped = true;
+    application->resetNavigationCallback(0);
+
+    return 0;
+}
+
+bool MultilevelLayout::layoutLevels(Level& fine, vector<Vrui::Point>& positions)
+{
+    // coarsen until the graph is small or stops shrinking
+    vector<Level> levels(1, fine);
+
+    while(levels.back().nodeCount > MULTILEVEL_MIN_NODES)
+    {
+        Level coarse;
+        if(!coarsen(levels.back(), coarse)) break;
+        levels.push_back(coarse);
+    }
+
+    // full schedule on the coarsest level from random positions
+    const Level& coarsest = levels.back();
+    positions.resize(coarsest.nodeCount);
+
+    for(int i = 0; i < coarsest.nodeCount; i++)
+    {
+        positions[i] = Vrui::Point(100 * (2 * VruiHelp::randomFloat() - 1),
+                                   100 * (2 * VruiHelp::randomFloat() - 1),
+                                   100 * (2 * VruiHelp::randomFloat() - 1));
+    }
+
+    smooth(positions, coarsest, MAX_ITERATIONS, MAX_DELTA);
+
+    // interpolate and refine each finer level
+    for(int level = (int)levels.size() - 2; level >= 0 && !stopped; level--)
+    {
+        const Level& current = levels[level];
+        double k = FruchtermanReingoldLayout::getSpringForceConstant(current.nodeCount);
+        vector<Vrui::Point> finer(current.nodeCount);
+
+        for(int i = 0; i < current.nodeCount; i++)
+        {
+            // children start at their parent, jittered so they can separate
+            finer[i] = positions[current.parent[i]];
+            for(int j = 0; j < 3; j++)
+            {
+                finer[i][j] += 0.1 * k * (2 * VruiHelp::randomFloat() - 1);
+            }
+        }
+
+        positions.swap(finer);
+        smooth(positions, current, MULTILEVEL_ITERATIONS, MULTILEVEL_TEMPERATURE * k);
+    }
+
+    return !stopped;
+}
+
+void MultilevelLayout::smooth(vector<Vrui::Point>& positions, const Level& level, int iterations, double temperature)
+{
+    // levels are already unordered pairs
+    EdgePairs pairs;
+    pairs.sources = level.sources;
+    pairs.targets = level.targets;
+    pairs.weights = level.weights;
+    pairs.counts.assign(level.sources.size(), 1);
+
+    vector<int> degree(level.nodeCount, 0);
+    for(int e = 0; e < (int)level.sources.size(); e++)
+    {
+        degree[level.sources[e]]++;
+        degree[level.targets[e]]++;
+    }
+
+    vector<bool> selected(level.nodeCount, true);
+    vector<Vrui::Vector> displacements;
+    double k = FruchtermanReingoldLayout::getSpringForceConstant(level.nodeCount);
+
+    for(int remaining = iterations; remaining > 0 && !stopped; remaining--)
+    {
+        StatTimer timer(application->stats, STAT_LAYOUT_STEP);
+        double t = temperature * Math::pow(remaining / (double)iterations, COOLING_EXPONENT);
+        smoother.computeDisplacements(positions, selected, degree, pairs, k, t, displacements);
+
+        for(int i = 0; i < level.nodeCount; i++)
+        {
+            positions[i] += displacements[i];
+        }
+    }
+}
+
+bool MultilevelLayout::coarsen(Level& fine, Level& coarse)
+{
+    int n = fine.nodeCount;
+
+    // symmetric neighbor lists for matching
+    vector<int> offsets(n + 1, 0);
+    for(int e = 0; e < (int)fine.sources.size(); e++)
+    {
+        offsets[fine.sources[e] + 1]++;
+        offsets[fine.targets[e] + 1]++;
+    }
+    for(int i = 0; i < n; i++)
+    {
+        offsets[i + 1] += offsets[i];
+    }
+
+    vector<int> neighbors(offsets[n]);
+    vector<float> weights(offsets[n]);
+    vector<int> fill(offsets.begin(), offsets.end() - 1);
+
+    for(int e = 0; e < (int)fine.sources.size(); e++)
+    {
+        int s = fine.sources[e], t = fine.targets[e];
+        neighbors[fill[s]] = t; weights[fill[s]++] = fine.weights[e];
+        neighbors[fill[t]] = s; weights[fill[t]++] = fine.weights[e];
+    }
+
+    // heavy-edge matching in a shuffled order, normalized by mass so that
+    // clusters stay balanced
+    vector<int> order(n);
+    for(int i = 0; i < n; i++) order[i] = i;
+    for(int i = n - 1; i > 0; i--) swap(order[i], order[random(i + 1)]);
+
+    vector<int> match(n, -1);
+    int pairs = 0;
+
+    foreach(int u, order)
+    {
+        if(match[u] != -1) continue;
+
+        int best = -1;
+        double bestScore = 0;
+
+        for(int slot = offsets[u]; slot < offsets[u + 1]; slot++)
+        {
+            int v = neighbors[slot];
+            double score = weights[slot] / ((double)fine.mass[u] * fine.mass[v]);
+
+            if(v != u && match[v] == -1 && (best == -1 || score > bestScore))
+            {
+                best = v;
+                bestScore = score;
+            }
+        }
+
+        if(best != -1)
+        {
+            match[u] = best;
+            match[best] = u;
+            pairs++;
+        }
+    }
+
+    // matching stalls on stars and other hub-heavy graphs, so collapse
+    // unmatched nodes into their heaviest neighbor in that case
+    bool collapse = n - pairs > MULTILEVEL_MIN_SHRINK * n;
+
+    fine.parent.assign(n, -1);
+    coarse.nodeCount = 0;
+
+    for(int u = 0; u < n; u++)
+    {
+        if(match[u] != -1 && fine.parent[u] == -1)
+        {
+            fine.parent[u] = fine.parent[match[u]] = coarse.nodeCount++;
+        }
+    }
+
+    foreach(int u, order)
+    {
+        if(fine.parent[u] != -1) continue;
+
+        int best = -1;
+
+        if(collapse)
+        {
+            for(int slot = offsets[u]; slot < offsets[u + 1]; slot++)
+            {
+                int v = neighbors[slot];
+                if(fine.parent[v] != -1 && (best == -1 || weights[slot] > weights[best]))
+                {
+                    best = slot;
+                }
+            }
+        }
+
+        fine.parent[u] = best == -1 ? coarse.nodeCount++ : fine.parent[neighbors[best]];
+    }
+
+    if(coarse.nodeCount >= n || coarse.nodeCount == 0)
+    {
+        return false;
+    }
+
+    coarse.mass.assign(coarse.nodeCount, 0);
+    for(int u = 0; u < n; u++)
+    {
+        coarse.mass[fine.parent[u]] += fine.mass[u];
+    }
+
+    for(int e = 0; e < (int)fine.sources.size(); e++)
+    {
+        int s = fine.parent[fine.sources[e]];
+        int t = fine.parent[fine.targets[e]];
+
+        if(s == t) continue;
+
+        coarse.sources.push_back(min(s, t));
+        coarse.targets.push_back(max(s, t));
+        coarse.weights.push_back(fine.weights[e]);
+    }
+
+    mergeEdges(coarse);
+
+    // give up if the graph barely shrinks, e.g. a set of isolated nodes
+    return coarse.nodeCount < 0.95 * n;
+}
+
+// sorts edges and sums the weights of parallel ones
+void MultilevelLayout::mergeEdges(Level& level)
+{
+    vector<pair<pair<int, int>, float> > edges(level.sources.size());
+
+    for(int e = 0; e < (int)edges.size(); e++)
+    {
+        edges[e] = make_pair(make_pair(level.sources[e], level.targets[e]), level.weights[e]);
+    }
+
+    sort(edges.begin(), edges.end());
+
+    level.sources.clear();
+    level.targets.clear();
+    level.weights.clear();
+
+    for(int e = 0; e < (int)edges.size(); e++)
+    {
+        if(!level.sources.empty() && level.sources.back() == edges[e].first.first
+           && level.targets.back() == edges[e].first.second)
+        {
+            level.weights.back() += edges[e].second;
+            continue;
+        }
+
+        level.sources.push_back(edges[e].first.first);
+        level.targets.push_back(edges[e].first.second);
+        level.weights.push_back(edges[e].second);
+    }
+}
@@ -0,0 +1,68 @@
+/*
+ * Mycelia immersive 3d network visualization tool.
+ * Copyright (C) 2008-2010 Sean Whalen.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __MULTILEVELLAYOUT_HPP
+#define __MULTILEVELLAYOUT_HPP
+
+#include <graph.hpp>
+#include <mycelia.hpp>
+#include <layout/frlayout.hpp>
+#include <layout/graphlayout.hpp>
+
+#define MULTILEVEL_MIN_NODES 50 // stop coarsening below this many nodes
+#define MULTILEVEL_MIN_SHRINK 0.75 // collapse unmatched nodes if matching keeps more than this
+#define MULTILEVEL_ITERATIONS 50 // smoother iterations per refined level
+#define MULTILEVEL_TEMPERATURE 2.0 // initial refinement temperature, in units of the spring length
+
+/*
+ * Coarsens the graph by heavy-edge matching (collapsing unmatched nodes into
+ * a neighbor when matching alone stalls), lays out the coarsest level with
+ * the full FR schedule, then interpolates each finer level from its parents
+ * and refines it with a short, cool FR run.
+ */
+class MultilevelLayout : public GraphLayout
+{
+private:
+    // undirected weighted graph, each pair stored once with source < target
+    struct Level
+    {
+        int nodeCount;
+        std::vector<int> sources;
+        std::vector<int> targets;
+        std::vector<float> weights;
+        std::vector<int> mass; // number of original nodes collapsed into each node
+        std::vector<int> parent; // node of the next coarser level
+    };
+
+    FruchtermanReingoldLayout smoother;
+    unsigned int seed;
+
+    int random(int);
+    bool coarsen(Level&, Level&);
+    void mergeEdges(Level&);
+    void smooth(std::vector<Vrui::Point>&, const Level&, int, double);
+    bool layoutLevels(Level&, std::vector<Vrui::Point>&);
+
+public:
+    MultilevelLayout(Mycelia*);
+
+protected:
+    virtual void* layout();
+};
+
+#endif
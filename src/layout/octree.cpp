@@ -0,0 +1,195 @@
+/*
+ * Mycelia immersive 3d network visualization tool.
+ * Copyright (C) 2008-2010 Sean Whalen.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <layout/octree.hpp>
+
+using namespace std;
+
+Octree::Octree()
+    : points(0)
+{
+}
+
+int Octree::addCell(const Vrui::Point& center, Vrui::Scalar halfSize, int depth)
+{
+    Cell c;
+    c.center = center;
+    c.halfSize = halfSize;
+    c.centroid = Vrui::Point(0, 0, 0);
+    c.count = 0;
+    c.charge = 0;
+    c.body = -1;
+    c.depth = depth;
+
+    for(int i = 0; i < 8; i++)
+    {
+        c.children[i] = -1;
+    }
+
+    cells.push_back(c);
+    return (int)cells.size() - 1;
+}
+
+int Octree::getOctant(const Cell& c, const Vrui::Point& p) const
+{
+    return (p[0] >= c.center[0] ? 1 : 0) | (p[1] >= c.center[1] ? 2 : 0) | (p[2] >= c.center[2] ? 4 : 0);
+}
+
+bool Octree::contains(const Cell& c, const Vrui::Point& p) const
+{
+    for(int i = 0; i < 3; i++)
+    {
+        if(Math::abs(p[i] - c.center[i]) > c.halfSize) return false;
+    }
+
+    return true;
+}
+
+void Octree::build(const vector<Vrui::Point>& points, const vector<double>& charges, const vector<bool>& include)
+{
+    this->points = &points;
+    cells.clear();
+    next.assign(points.size(), -1);
+
+    // bounding cube of the included bodies
+    Vrui::Point lower, upper;
+    bool empty = true;
+
+    for(int i = 0; i < (int)points.size(); i++)
+    {
+        if(!include[i]) continue;
+
+        for(int j = 0; j < 3; j++)
+        {
+            if(empty || points[i][j] < lower[j]) lower[j] = points[i][j];
+            if(empty || points[i][j] > upper[j]) upper[j] = points[i][j];
+        }
+
+        empty = false;
+    }
+
+    if(empty) return;
+
+    Vrui::Scalar halfSize = 0;
+
+    for(int j = 0; j < 3; j++)
+    {
+        halfSize = max(halfSize, (upper[j] - lower[j]) / 2);
+    }
+
+    addCell(Geometry::mid(lower, upper), halfSize * 1.001 + 0.001, 0);
+
+    for(int i = 0; i < (int)points.size(); i++)
+    {
+        if(include[i]) insert(i);
+    }
+
+    summarize(charges);
+}
+
+int Octree::addChild(int cell, int octant)
+{
+    Vrui::Scalar h = cells[cell].halfSize / 2;
+    Vrui::Point center = cells[cell].center;
+    center[0] += octant & 1 ? h : -h;
+    center[1] += octant & 2 ? h : -h;
+    center[2] += octant & 4 ? h : -h;
+
+    int child = addCell(center, h, cells[cell].depth + 1);
+    cells[cell].children[octant] = child;
+
+    return child;
+}
+
+void Octree::insert(int body)
+{
+    const Vrui::Point& p = (*points)[body];
+    int cell = 0; // the root is always an internal cell
+
+    while(true)
+    {
+        if(cells[cell].body != -1)
+        {
+            // occupied leaf, share it if we cannot subdivide any further
+            if(cells[cell].depth >= OCTREE_MAX_DEPTH)
+            {
+                next[body] = cells[cell].body;
+                cells[cell].body = body;
+                return;
+            }
+
+            // otherwise push the resident body one level down
+            int resident = cells[cell].body;
+            int octant = getOctant(cells[cell], (*points)[resident]);
+            cells[cell].body = -1;
+
+            int child = addChild(cell, octant);
+            cells[child].body = resident;
+        }
+
+        int octant = getOctant(cells[cell], p);
+        int child = cells[cell].children[octant];
+
+        if(child == -1)
+        {
+            child = addChild(cell, octant);
+            cells[child].body = body;
+            return;
+        }
+
+        cell = child;
+    }
+}
+
+void Octree::summarize(const vector<double>& charges)
+{
+    // children are always created after their parent, so a reverse sweep
+    // visits every child before the cell that owns it
+    for(int cell = (int)cells.size() - 1; cell >= 0; cell--)
+    {
+        Cell& c = cells[cell];
+        Vrui::Vector sum(0, 0, 0);
+
+        if(c.body != -1)
+        {
+            for(int body = c.body; body != -1; body = next[body])
+            {
+                sum += (*points)[body] - Vrui::Point::origin;
+                c.charge += charges[body];
+                c.count++;
+            }
+        }
+        else
+        {
+            for(int i = 0; i < 8; i++)
+            {
+                if(c.children[i] == -1) continue;
+
+                const Cell& child = cells[c.children[i]];
+                sum += (child.centroid - Vrui::Point::origin) * child.count;
+                c.charge += child.charge;
+                c.count += child.count;
+            }
+        }
+
+        if(c.count > 0)
+        {
+            c.centroid = Vrui::Point::origin + sum / c.count;
+        }
+    }
+}
@@ -0,0 +1,68 @@
+/*
+ * Mycelia immersive 3d network visualization tool.
+ * Copyright (C) 2008-2010 Sean Whalen.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __OCTREE_HPP
+#define __OCTREE_HPP
+
+#include <mycelia.hpp>
+
+#define OCTREE_MAX_DEPTH 32
+
+/*
+ * Barnes-Hut octree over a set of points. Each cell aggregates the number of
+ * bodies, their centroid and the sum of a per-body charge so that distant
+ * groups of nodes can be treated as a single body during force evaluation.
+ */
+class Octree
+{
+public:
+    struct Cell
+    {
+        Vrui::Point center; // center of the bounding cube
+        Vrui::Scalar halfSize;
+        Vrui::Point centroid;
+        int count;
+        double charge;
+        int children[8]; // -1 if absent
+        int body; // first body in a leaf, -1 for internal cells
+        int depth;
+    };
+
+private:
+    std::vector<Cell> cells;
+    std::vector<int> next; // bodies sharing a leaf, -1 terminated
+    const std::vector<Vrui::Point>* points;
+
+    int addCell(const Vrui::Point&, Vrui::Scalar, int);
+    int addChild(int, int);
+    int getOctant(const Cell&, const Vrui::Point&) const;
+    void insert(int);
+    void summarize(const std::vector<double>&);
+
+public:
+    Octree();
+
+    // builds the tree over the bodies with include[i] set
+    void build(const std::vector<Vrui::Point>&, const std::vector<double>&, const std::vector<bool>&);
+    bool contains(const Cell&, const Vrui::Point&) const;
+
+    const std::vector<Cell>& getCells() const { return cells; }
+    const int getNextBody(int body) const { return next[body]; }
+};
+
+#endif
@@ -0,0 +1,253 @@
+/*
+ * Mycelia immersive 3d network visualization tool.
+ * Copyright (C) 2008-2010 Sean Whalen.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <layout/repulsion.hpp>
+
+#include <cmath>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+using namespace std;
+
+RepulsionKernel::RepulsionKernel()
+    : vectorized(isVectorAvailable()), count(0), charged(false)
+{
+}
+
+bool RepulsionKernel::isVectorAvailable()
+{
+#ifdef __SSE2__
+    return true;
+#else
+    return false;
+#endif
+}
+
+void RepulsionKernel::setVectorized(bool vectorized)
+{
+    this->vectorized = vectorized && isVectorAvailable();
+}
+
+void RepulsionKernel::setPoints(int count, const double* positions, const vector<bool>& included, const double* charges)
+{
+    int padded = (count + 3) & ~3;
+
+    this->count = count;
+    charged = charges != 0;
+
+    // padding lanes are excluded so the vector loop needs no remainder
+    x.assign(padded, 0);
+    y.assign(padded, 0);
+    z.assign(padded, 0);
+    include.assign(padded, 0);
+    charge.assign(padded, 0);
+
+    for(int i = 0; i < count; i++)
+    {
+        x[i] = (float)positions[3 * i];
+        y[i] = (float)positions[3 * i + 1];
+        z[i] = (float)positions[3 * i + 2];
+        include[i] = included[i] ? 1 : 0;
+        if(charged) charge[i] = (float)charges[i];
+    }
+}
+
+void RepulsionKernel::compute(int begin, int end, const float* a, float* fx, float* fy, float* fz) const
+{
+    if(vectorized)
+    {
+        computeVector(begin, end, a, fx, fy, fz);
+    }
+    else
+    {
+        computeScalar(begin, end, a, fx, fy, fz);
+    }
+}
+
+void RepulsionKernel::computeScalar(int begin, int end, const float* a, float* fx, float* fy, float* fz) const
+{
+    for(int i = begin; i < end; i++)
+    {
+        double sum[3] = {0, 0, 0}; // weighted by a_i
+        double charges[3] = {0, 0, 0}; // weighted by charge_j
+
+        for(int j = 0; j < count; j++)
+        {
+            if(include[j] == 0) continue;
+
+            double dx = x[i] - x[j];
+            double dy = y[i] - y[j];
+            double dz = z[i] - z[j];
+            double d2 = dx * dx + dy * dy + dz * dz;
+
+            if(d2 == 0) continue;
+
+            double d = sqrt(d2);
+            double phi = law.constant + law.inverse / d + law.inverseSquare / d2 + law.linear * d;
+            if(law.power != 0) phi += law.power * pow(d, (double)law.exponent);
+
+            sum[0] += phi * dx;
+            sum[1] += phi * dy;
+            sum[2] += phi * dz;
+
+            if(charged)
+            {
+                charges[0] += charge[j] * phi * dx;
+                charges[1] += charge[j] * phi * dy;
+                charges[2] += charge[j] * phi * dz;
+            }
+        }
+
+        double weight = a ? a[i] : 1;
+        fx[i] = (float)(weight * sum[0] + charges[0]);
+        fy[i] = (float)(weight * sum[1] + charges[1]);
+        fz[i] = (float)(weight * sum[2] + charges[2]);
+    }
+}
+
+#ifdef __SSE2__
+
+/*
+ * log2 and exp2 approximations for positive, normal inputs, accurate to
+ * about 1e-7 relative which is well below the float rounding of the sums.
+ */
+static inline __m128 log2_ps(__m128 x)
+{
+    __m128i bits = _mm_castps_si128(x);
+    __m128 e = _mm_cvtepi32_ps(_mm_sub_epi32(_mm_srli_epi32(bits, 23), _mm_set1_epi32(127)));
+    __m128 m = _mm_or_ps(_mm_castsi128_ps(_mm_and_si128(bits, _mm_set1_epi32(0x007fffff))), _mm_set1_ps(1.0f));
+
+    // log2(m) = 2 atanh(t) / ln 2 with t = (m - 1) / (m + 1) in [0, 1/3)
+    __m128 t = _mm_div_ps(_mm_sub_ps(m, _mm_set1_ps(1.0f)), _mm_add_ps(m, _mm_set1_ps(1.0f)));
+    __m128 t2 = _mm_mul_ps(t, t);
+    __m128 p = _mm_set1_ps(0.2623137f); // 2 / (11 ln 2)
+    p = _mm_add_ps(_mm_mul_ps(p, t2), _mm_set1_ps(0.3205989f)); // 2 / (9 ln 2)
+    p = _mm_add_ps(_mm_mul_ps(p, t2), _mm_set1_ps(0.4121986f)); // 2 / (7 ln 2)
+    p = _mm_add_ps(_mm_mul_ps(p, t2), _mm_set1_ps(0.5770780f)); // 2 / (5 ln 2)
+    p = _mm_add_ps(_mm_mul_ps(p, t2), _mm_set1_ps(0.9617967f)); // 2 / (3 ln 2)
+    p = _mm_add_ps(_mm_mul_ps(p, t2), _mm_set1_ps(2.8853901f)); // 2 / ln 2
+
+    return _mm_add_ps(e, _mm_mul_ps(p, t));
+}
+
+static inline __m128 exp2_ps(__m128 x)
+{
+    x = _mm_min_ps(_mm_max_ps(x, _mm_set1_ps(-126.0f)), _mm_set1_ps(127.0f));
+
+    // split into integer and fractional part in [-0.5, 0.5]
+    __m128i i = _mm_cvtps_epi32(x);
+    __m128 f = _mm_sub_ps(x, _mm_cvtepi32_ps(i));
+
+    // taylor series of 2^f = e^(f ln 2)
+    __m128 p = _mm_set1_ps(1.5403530e-4f);
+    p = _mm_add_ps(_mm_mul_ps(p, f), _mm_set1_ps(1.3333558e-3f));
+    p = _mm_add_ps(_mm_mul_ps(p, f), _mm_set1_ps(9.6181291e-3f));
+    p = _mm_add_ps(_mm_mul_ps(p, f), _mm_set1_ps(5.5504109e-2f));
+    p = _mm_add_ps(_mm_mul_ps(p, f), _mm_set1_ps(2.4022651e-1f));
+    p = _mm_add_ps(_mm_mul_ps(p, f), _mm_set1_ps(6.9314718e-1f));
+    p = _mm_add_ps(_mm_mul_ps(p, f), _mm_set1_ps(1.0f));
+
+    __m128i scale = _mm_slli_epi32(_mm_add_epi32(i, _mm_set1_epi32(127)), 23);
+    return _mm_mul_ps(p, _mm_castsi128_ps(scale));
+}
+
+static inline float sum_ps(__m128 v)
+{
+    float lanes[4];
+    _mm_storeu_ps(lanes, v);
+    return (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+}
+
+void RepulsionKernel::computeVector(int begin, int end, const float* a, float* fx, float* fy, float* fz) const
+{
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 one = _mm_set1_ps(1.0f);
+    const __m128 constant = _mm_set1_ps(law.constant);
+    const __m128 inverse = _mm_set1_ps(law.inverse);
+    const __m128 inverseSquare = _mm_set1_ps(law.inverseSquare);
+    const __m128 linear = _mm_set1_ps(law.linear);
+    const __m128 power = _mm_set1_ps(law.power);
+    const __m128 halfExponent = _mm_set1_ps(law.exponent / 2); // applied to d^2
+    const bool powered = law.power != 0;
+    int padded = (int)x.size();
+
+    for(int i = begin; i < end; i++)
+    {
+        __m128 px = _mm_set1_ps(x[i]);
+        __m128 py = _mm_set1_ps(y[i]);
+        __m128 pz = _mm_set1_ps(z[i]);
+        __m128 sx = zero, sy = zero, sz = zero;
+        __m128 cx = zero, cy = zero, cz = zero;
+
+        for(int j = 0; j < padded; j += 4)
+        {
+            __m128 dx = _mm_sub_ps(px, _mm_loadu_ps(&x[j]));
+            __m128 dy = _mm_sub_ps(py, _mm_loadu_ps(&y[j]));
+            __m128 dz = _mm_sub_ps(pz, _mm_loadu_ps(&z[j]));
+            __m128 d2 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz));
+
+            // excluded and coincident lanes get a zero mask; d2 is made
+            // nonzero there so the divisions below stay finite
+            __m128 mask = _mm_and_ps(_mm_cmpgt_ps(d2, zero), _mm_cmpgt_ps(_mm_loadu_ps(&include[j]), zero));
+            d2 = _mm_or_ps(_mm_and_ps(mask, d2), _mm_andnot_ps(mask, one));
+
+            __m128 d = _mm_sqrt_ps(d2);
+            __m128 phi = _mm_add_ps(constant, _mm_div_ps(inverse, d));
+            phi = _mm_add_ps(phi, _mm_div_ps(inverseSquare, d2));
+            phi = _mm_add_ps(phi, _mm_mul_ps(linear, d));
+
+            if(powered)
+            {
+                phi = _mm_add_ps(phi, _mm_mul_ps(power, exp2_ps(_mm_mul_ps(halfExponent, log2_ps(d2)))));
+            }
+
+            phi = _mm_and_ps(phi, mask);
+
+            __m128 vx = _mm_mul_ps(phi, dx);
+            __m128 vy = _mm_mul_ps(phi, dy);
+            __m128 vz = _mm_mul_ps(phi, dz);
+            sx = _mm_add_ps(sx, vx);
+            sy = _mm_add_ps(sy, vy);
+            sz = _mm_add_ps(sz, vz);
+
+            if(charged)
+            {
+                __m128 q = _mm_loadu_ps(&charge[j]);
+                cx = _mm_add_ps(cx, _mm_mul_ps(q, vx));
+                cy = _mm_add_ps(cy, _mm_mul_ps(q, vy));
+                cz = _mm_add_ps(cz, _mm_mul_ps(q, vz));
+            }
+        }
+
+        float weight = a ? a[i] : 1;
+        fx[i] = weight * sum_ps(sx) + sum_ps(cx);
+        fy[i] = weight * sum_ps(sy) + sum_ps(cy);
+        fz[i] = weight * sum_ps(sz) + sum_ps(cz);
+    }
+}
+
+#else
+
+void RepulsionKernel::computeVector(int begin, int end, const float* a, float* fx, float* fy, float* fz) const
+{
+    computeScalar(begin, end, a, fx, fy, fz);
+}
+
+#endif
@@ -0,0 +1,84 @@
+/*
+ * Mycelia immersive 3d network visualization tool.
+ * Copyright (C) 2008-2010 Sean Whalen.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __REPULSION_HPP
+#define __REPULSION_HPP
+
+#include <vector>
+
+/*
+ * All-pairs force kernel shared by the force-directed layouts. It has no Vrui
+ * dependencies so it can be benchmarked headless. For each node i in
+ * [begin, end) it accumulates
+ *
+ *     f_i = sum over included j != i of (a_i + charge_j) * phi(d_ij) * (p_i - p_j)
+ *
+ * where the magnitude law is
+ *
+ *     phi(d) = constant + inverse / d + inverseSquare / d^2 + linear * d + power * d^exponent
+ *
+ * Coincident pairs (d = 0) are skipped. The SSE path is used when the
+ * compiler targets SSE2, and the scalar path is kept as the reference.
+ */
+struct RepulsionLaw
+{
+    float constant;
+    float inverse;
+    float inverseSquare;
+    float linear;
+    float power;
+    float exponent;
+
+    RepulsionLaw()
+        : constant(0), inverse(0), inverseSquare(0), linear(0), power(0), exponent(0) {}
+};
+
+class RepulsionKernel
+{
+private:
+    RepulsionLaw law;
+    bool vectorized;
+
+    // positions, inclusion mask and charges, padded to a multiple of 4
+    std::vector<float> x, y, z;
+    std::vector<float> include;
+    std::vector<float> charge;
+    int count;
+    bool charged;
+
+    void computeScalar(int, int, const float*, float*, float*, float*) const;
+    void computeVector(int, int, const float*, float*, float*, float*) const;
+
+public:
+    RepulsionKernel();
+
+    static bool isVectorAvailable();
+
+    void setLaw(const RepulsionLaw& law) { this->law = law; }
+    void setVectorized(bool); // ignored if the vector path is unavailable
+    bool isVectorized() const { return vectorized; }
+
+    // positions are interleaved xyz triples; charges may be null, in which
+    // case only a_i weights the pairs
+    void setPoints(int, const double* positions, const std::vector<bool>& included, const double* charges);
+
+    // a may be null for a weight of 1, outputs are indexed by node
+    void compute(int begin, int end, const float* a, float* fx, float* fy, float* fz) const;
+};
+
+#endif
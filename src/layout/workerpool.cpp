@@ -0,0 +1,149 @@
+/*
+ * Mycelia immersive 3d network visualization tool.
+ * Copyright (C) 2008-2010 Sean Whalen.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <layout/workerpool.hpp>
+
+#include <unistd.h>
+
+using namespace std;
+
+WorkerPool::WorkerPool(int threadCount)
+    : task(0), itemCount(0), generation(0), pending(0), shutdown(false)
+{
+    startThreads(threadCount);
+}
+
+WorkerPool::~WorkerPool()
+{
+    stopThreads();
+}
+
+int WorkerPool::getProcessorCount()
+{
+    long count = sysconf(_SC_NPROCESSORS_ONLN);
+    return count > 0 ? (int)count : 1;
+}
+
+int WorkerPool::getThreadCount() const
+{
+    return (int)threads.size() + 1; // include the calling thread
+}
+
+void WorkerPool::setThreadCount(int threadCount)
+{
+    if(threadCount <= 0) threadCount = getProcessorCount();
+    if(threadCount == getThreadCount()) return;
+
+    stopThreads();
+    startThreads(threadCount);
+}
+
+void WorkerPool::startThreads(int threadCount)
+{
+    if(threadCount <= 0) threadCount = getProcessorCount();
+
+    // new workers start out having seen generation 0
+    shutdown = false;
+    generation = 0;
+
+    for(int worker = 1; worker < threadCount; worker++)
+    {
+        Threads::Thread* thread = new Threads::Thread();
+        thread->start(this, &WorkerPool::work, worker);
+        threads.push_back(thread);
+    }
+}
+
+void WorkerPool::stopThreads()
+{
+    mutex.lock();
+    shutdown = true;
+    workCond.broadcast();
+    mutex.unlock();
+
+    for(int i = 0; i < (int)threads.size(); i++)
+    {
+        threads[i]->join();
+        delete threads[i];
+    }
+
+    threads.clear();
+}
+
+void* WorkerPool::work(int worker)
+{
+    int seen = 0;
+
+    while(true)
+    {
+        mutex.lock();
+        while(!shutdown && generation == seen)
+        {
+            workCond.wait(mutex);
+        }
+
+        if(shutdown)
+        {
+            mutex.unlock();
+            return 0;
+        }
+
+        seen = generation;
+        WorkerTask* current = task;
+        int items = itemCount;
+        int workers = getThreadCount();
+        mutex.unlock();
+
+        current->run(worker, (int)((long)items * worker / workers), (int)((long)items * (worker + 1) / workers));
+
+        mutex.lock();
+        if(--pending == 0)
+        {
+            doneCond.signal();
+        }
+        mutex.unlock();
+    }
+}
+
+void WorkerPool::run(WorkerTask* task, int items)
+{
+    int workers = getThreadCount();
+
+    if(workers == 1)
+    {
+        task->run(0, 0, items);
+        return;
+    }
+
+    mutex.lock();
+    this->task = task;
+    itemCount = items;
+    pending = workers - 1;
+    generation++;
+    workCond.broadcast();
+    mutex.unlock();
+
+    task->run(0, 0, (int)((long)items / workers));
+
+    mutex.lock();
+    while(pending > 0)
+    {
+        doneCond.wait(mutex);
+    }
+    mutex.unlock();
+}
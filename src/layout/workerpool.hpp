@@ -0,0 +1,71 @@
+/*
+ * Mycelia immersive 3d network visualization tool.
+ * Copyright (C) 2008-2010 Sean Whalen.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __WORKERPOOL_HPP
+#define __WORKERPOOL_HPP
+
+#include <Threads/Cond.h>
+#include <Threads/Mutex.h>
+#include <Threads/Thread.h>
+#include <vector>
+
+/*
+ * A unit of data-parallel work. run() is called once per worker with a
+ * contiguous, non-overlapping range of items. The ranges only depend on the
+ * item and worker counts, so results are reproducible from run to run.
+ */
+class WorkerTask
+{
+public:
+    virtual ~WorkerTask() {}
+    virtual void run(int worker, int begin, int end) = 0;
+};
+
+class WorkerPool
+{
+private:
+    std::vector<Threads::Thread*> threads;
+    Threads::Mutex mutex;
+    Threads::Cond workCond;
+    Threads::Cond doneCond;
+
+    WorkerTask* task;
+    int itemCount;
+    int generation; // bumped for every run() so sleeping workers notice new work
+    int pending; // workers still busy with the current generation
+    bool shutdown;
+
+    void* work(int);
+    void startThreads(int);
+    void stopThreads();
+
+public:
+    WorkerPool(int threadCount=0); // 0 uses one thread per online processor
+    ~WorkerPool();
+
+    static int getProcessorCount();
+
+    int getThreadCount() const;
+    void setThreadCount(int); // must not be called while run() is in progress
+
+    // splits [0, items) over the workers and blocks until every range is done;
+    // the calling thread works on the first range itself
+    void run(WorkerTask*, int items);
+};
+
+#endif
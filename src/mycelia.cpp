@@ -17,10 +17,16 @@
  */
 
 #include <IO/OpenFile.h>
+#include <Misc/ConfigurationFile.h>
+#include <Misc/StandardValueCoders.h>
 
+#include <centrality.hpp>
+#include <clustersync.hpp>
+#include <commandqueue.hpp>
 #include <dataitem.hpp>
 #include <graph.hpp>
 #include <mycelia.hpp>
+#include <pluginhost.hpp>
 #include <vruihelp.hpp>
 #include <generators/barabasigenerator.hpp>
 #include <generators/erdosgenerator.hpp>
@@ -31,10 +37,17 @@
 #include <layout/edgebundler.hpp>
 #include <layout/frlayout.hpp>
 #include <layout/graphlayout.hpp>
+#include <layout/layoutcache.hpp>
+#include <layout/multilevellayout.hpp>
+#ifdef __CUDA__
+#include <layout/gpulayout.hpp>
+#endif
 #include <parsers/chacoparser.hpp>
 #include <parsers/dotparser.hpp>
+#include <parsers/edgelistparser.hpp>
 #include <parsers/gmlparser.hpp>
 #include <parsers/xmlparser.hpp>
+#include <render/viewfrustum.hpp>
 #include <tools/graphbuilder.hpp>
 #include <tools/nodeselector.hpp>
 #include <windows/attributewindow.hpp>
@@ -48,14 +61,6 @@
 
 using namespace std;
 
-/*
- * link to gpu layout function if cuda is enabled
- */
-#ifdef __CUDA__
-#include <vector_types.h>
-extern "C" { void gpuLayout(float4*, int*, int); }
-#endif
-
 /** Returns the base directory for resource files.
 *
 * Returns RESOURCEDIR if it exists or
@@ -82,8 +87,20 @@ Mycelia::Mycelia(int argc, char** argv, char** appDefaults)
     // node layout / edge bundler
     dynamicLayout = new ArfLayout(this);
     staticLayout = new FruchtermanReingoldLayout(this);
+    multilevelLayout = new MultilevelLayout(this);
+#ifdef __CUDA__
+    gpuStaticLayout = new GpuLayout(this, false);
+    gpuDynamicLayout = new GpuLayout(this, true);
+#endif
     edgeBundler = new EdgeBundler(this);
     skipLayout = false;
+    layoutCache = new LayoutCache(this);
+    warmStart = LAYOUT_CACHE_MISS;
+    layoutCachePending = false;
+    centrality = new Centrality(this);
+    centralityPlotPending = false;
+
+    loadConfiguration();
 
     // node selection tool factory
     NodeSelectorFactory* selectorFactory = new NodeSelectorFactory(*Vrui::getToolManager(), this);
@@ -103,6 +120,9 @@ Mycelia::Mycelia(int argc, char** argv, char** appDefaults)
     GLMotif::Button* writeGraphButton = new GLMotif::Button("WriteGraphButton", fileSubMenu, "Save");
     writeGraphButton->getSelectCallbacks().add(this, &Mycelia::writeGraphCallback);
 
+    GLMotif::Button* writeSnapshotButton = new GLMotif::Button("WriteSnapshotButton", fileSubMenu, "Save Snapshot");
+    writeSnapshotButton->getSelectCallbacks().add(this, &Mycelia::writeSnapshotCallback);
+
     // graph generators submenu
     GLMotif::Popup* generatorPopup = new GLMotif::Popup("GeneratorMenu", Vrui::getWidgetManager());
     generatorRadioBox = new GLMotif::RadioBox("GeneratorRadioBox", generatorPopup, false);
@@ -115,13 +135,24 @@ Mycelia::Mycelia(int argc, char** argv, char** appDefaults)
 
     // layout submenu
     GLMotif::Popup* layoutPopup = new GLMotif::Popup("LayoutPopup", Vrui::getWidgetManager());
-    layoutRadioBox = new GLMotif::RadioBox("LayoutSubMenu", layoutPopup, false);
+    GLMotif::SubMenu* layoutSubMenu = new GLMotif::SubMenu("LayoutOptionsSubMenu", layoutPopup, false);
+    layoutRadioBox = new GLMotif::RadioBox("LayoutSubMenu", layoutSubMenu, false);
     layoutRadioBox->setSelectionMode(GLMotif::RadioBox::ALWAYS_ONE);
     layoutRadioBox->getValueChangedCallbacks().add(this, &Mycelia::resetLayoutCallback);
 
     staticButton = new GLMotif::ToggleButton("StaticButton", layoutRadioBox, "Static");
     dynamicButton = new GLMotif::ToggleButton("DynamicButton", layoutRadioBox, "Dynamic");
+    multilevelButton = new GLMotif::ToggleButton("MultilevelButton", layoutRadioBox, "Multilevel");
+#ifdef __CUDA__
+    gpuStaticButton = new GLMotif::ToggleButton("GpuStaticButton", layoutRadioBox, "GPU Static");
+    gpuDynamicButton = new GLMotif::ToggleButton("GpuDynamicButton", layoutRadioBox, "GPU Dynamic");
+#endif
     layout = staticLayout;
+    layoutRadioBox->manageChild();
+
+    barnesHutButton = new GLMotif::ToggleButton("BarnesHutButton", layoutSubMenu, "Approximate Static Repulsion");
+    barnesHutButton->setToggle(staticLayout->getTheta() > 0);
+    barnesHutButton->getValueChangedCallbacks().add(this, &Mycelia::barnesHutCallback);
 
     // render submenu
     GLMotif::Popup* renderPopup = new GLMotif::Popup("RenderPopup", Vrui::getWidgetManager());
@@ -130,6 +161,9 @@ Mycelia::Mycelia(int argc, char** argv, char** appDefaults)
     bundleButton = new GLMotif::ToggleButton("BundleButton", renderSubMenu, "Bundle Edges");
     bundleButton->getValueChangedCallbacks().add(this, &Mycelia::bundleCallback);
 
+    instancedButton = new GLMotif::ToggleButton("InstancedButton", renderSubMenu, "Instanced Rendering");
+    instancedButton->setToggle(true);
+
     nodeInfoButton = new GLMotif::ToggleButton("NodeInfoButton", renderSubMenu, "Show Node Information");
     nodeInfoButton->getValueChangedCallbacks().add(this, &Mycelia::nodeInfoCallback);
 
@@ -144,6 +178,9 @@ Mycelia::Mycelia(int argc, char** argv, char** appDefaults)
     componentButton = new GLMotif::ToggleButton("ComponentButton", renderSubMenu, "Show Only Selected Subgraph");
     componentButton->getValueChangedCallbacks().add(this, &Mycelia::componentCallback);
 
+    statsButton = new GLMotif::ToggleButton("StatsButton", renderSubMenu, "Show Statistics");
+    statsButton->getValueChangedCallbacks().add(this, &Mycelia::statsCallback);
+
     // algorithms submenu
     GLMotif::Popup* algorithmsPopup = new GLMotif::Popup("AlgorithmsPopup", Vrui::getWidgetManager());
     GLMotif::SubMenu* algorithmsSubMenu = new GLMotif::SubMenu("AlgorithmsSubMenu", algorithmsPopup, false);
@@ -199,7 +236,7 @@ Mycelia::Mycelia(int argc, char** argv, char** appDefaults)
 
     fileSubMenu->manageChild();
     generatorRadioBox->manageChild();
-    layoutRadioBox->manageChild();
+    layoutSubMenu->manageChild();
     renderSubMenu->manageChild();
     algorithmsSubMenu->manageChild();
     pythonSubMenu->manageChild();
@@ -213,7 +250,7 @@ Mycelia::Mycelia(int argc, char** argv, char** appDefaults)
     IO::DirectoryPtr dirPtr = IO::openDirectory(dataDirectory.c_str());
 
     fileWindow = new GLMotif::FileSelectionDialog(mainMenu->getManager(),
-                    "Open file...", dirPtr, ".xml;.dot;.chaco;.gml");
+                    "Open file...", dirPtr, ".xml;.dot;.chaco;.gml;.edges;" SNAPSHOT_EXTENSION);
     fileWindow->getOKCallbacks().add(this, &Mycelia::fileOpenAction);
     fileWindow->getCancelCallbacks().add(this, &Mycelia::fileCancelAction);
 
@@ -226,8 +263,9 @@ Mycelia::Mycelia(int argc, char** argv, char** appDefaults)
     imageWindow = new ImageWindow(this);
     imageWindow->hide();
 
-    statusWindow = new AttributeWindow(this, "Status", 1);
+    statusWindow = new AttributeWindow(this, "Status", STATUS_ROWS);
     statusWindow->hide();
+    lastStatusTime = 0;
 
     // generators
     barabasiGenerator = new BarabasiGenerator(this);
@@ -244,24 +282,32 @@ Mycelia::Mycelia(int argc, char** argv, char** appDefaults)
     // parsers
     chacoParser = new ChacoParser(this);
     dotParser = new DotParser(this);
+    edgeListParser = new EdgeListParser(this);
     gmlParser = new GmlParser(this);
     xmlParser = new XmlParser(this);
 
     // misc
     selectedNode = SELECTION_NONE;
     previousNode = SELECTION_NONE;
+    highlightedNode = SELECTION_NONE;
     coneAngle = 0.005;
 
     upVector = Vrui::getUpDirection();
     rightVector = Geometry::cross( Vrui::getForwardDirection(), upVector );
 
+    commands = new CommandQueue();
+    cluster = Vrui::getMainPipe() ? new ClusterSync(Vrui::getMainPipe(), Vrui::isMaster()) : 0;
+
 #ifdef __RPCSERVER__
-    server = new RpcServer(this);
+    server = Vrui::isMaster() ? new RpcServer(this, rpcConnections) : 0;
 #endif
 
-    // graph
+    // graph, on slaves received positions are drawn in the same frame
     g = new Graph(this);
+    g->setPublishRate(cluster && !cluster->isMaster() ? 0 : publishRate);
     gCopy = new Graph(this);
+    gridVersion = -1;
+    gridPositionVersion = -1;
 
     // establishes initial node+edge sizes if graph builder is used first
     resetNavigationCallback(0);
@@ -270,13 +316,81 @@ Mycelia::Mycelia(int argc, char** argv, char** appDefaults)
 Mycelia::~Mycelia()
 {
     stopLayout();
+    centrality->stop();
 }
 
-void Mycelia::buildGraphList(MyceliaDataItem* dataItem) const
+void Mycelia::loadConfiguration()
 {
-    // update version first in case of preemption
-    dataItem->graphListVersion = gCopy->getVersion();
+    detailEnabled = true;
+    lowDetailSize = DETAIL_LOW_SIZE;
+    farDetailSize = DETAIL_FAR_SIZE;
+    detailUpdateFraction = DETAIL_UPDATE_FRACTION;
+    detailPointSize = DETAIL_POINT_SIZE;
+    cullingEnabled = true;
+    textureMegabytes = TEXTURE_CACHE_MEGABYTES;
+    textureMaxSize = TEXTURE_MAX_SIZE;
+    textureMipmaps = true;
+    textureUploads = TEXTURE_UPLOADS_PER_FRAME;
+    labelMinPixels = LABEL_MIN_PIXELS;
+    labelCellPixels = LABEL_CELL_PIXELS;
+    labelCellCapacity = LABEL_CELL_CAPACITY;
+    publishRate = GRAPH_PUBLISH_RATE;
+    rpcConnections = RPC_CONNECTIONS;
+    centralitySamples = CENTRALITY_SAMPLES;
+    int centralityThreads = 0;
+
+    std::string path = getResourceDir() + "/etc/mycelia.cfg";
+
+    try
+    {
+        Misc::ConfigurationFile file(path.c_str());
+        Misc::ConfigurationFileSection detail = file.getSection("/Mycelia/LevelOfDetail");
+        detailEnabled = detail.retrieveValue<bool>("./enabled", detailEnabled);
+        lowDetailSize = detail.retrieveValue<double>("./lowDetailSize", lowDetailSize);
+        farDetailSize = detail.retrieveValue<double>("./farDetailSize", farDetailSize);
+        detailUpdateFraction = detail.retrieveValue<double>("./updateFraction", detailUpdateFraction);
+        detailPointSize = detail.retrieveValue<float>("./pointSize", detailPointSize);
+
+        Misc::ConfigurationFileSection culling = file.getSection("/Mycelia/Culling");
+        cullingEnabled = culling.retrieveValue<bool>("./enabled", cullingEnabled);
+
+        Misc::ConfigurationFileSection layout = file.getSection("/Mycelia/Layout");
+        publishRate = layout.retrieveValue<double>("./publishRate", publishRate);
+        layoutCache->setDirectory(layout.retrieveValue<std::string>("./cacheDirectory", LAYOUT_CACHE_DIRECTORY));
+
+        Misc::ConfigurationFileSection rpc = file.getSection("/Mycelia/Rpc");
+        rpcConnections = rpc.retrieveValue<int>("./connections", rpcConnections);
+
+        Misc::ConfigurationFileSection bundling = file.getSection("/Mycelia/Bundling");
+        edgeBundler->setAcceleration(bundling.retrieveValue<bool>("./accelerated", true),
+                                     bundling.retrieveValue<double>("./compatibility", BUNDLE_COMPATIBILITY),
+                                     bundling.retrieveValue<double>("./cutoff", BUNDLE_CUTOFF));
+
+        Misc::ConfigurationFileSection centralitySection = file.getSection("/Mycelia/Centrality");
+        centralitySamples = centralitySection.retrieveValue<int>("./samples", centralitySamples);
+        centralityThreads = centralitySection.retrieveValue<int>("./threads", centralityThreads);
+
+        Misc::ConfigurationFileSection textures = file.getSection("/Mycelia/Textures");
+        textureMegabytes = textures.retrieveValue<int>("./cacheMegabytes", textureMegabytes);
+        textureMaxSize = textures.retrieveValue<int>("./maxSize", textureMaxSize);
+        textureMipmaps = textures.retrieveValue<bool>("./mipmaps", textureMipmaps);
+        textureUploads = textures.retrieveValue<int>("./uploadsPerFrame", textureUploads);
+
+        Misc::ConfigurationFileSection labels = file.getSection("/Mycelia/Labels");
+        labelMinPixels = labels.retrieveValue<double>("./minPixels", labelMinPixels);
+        labelCellPixels = labels.retrieveValue<int>("./cellPixels", labelCellPixels);
+        labelCellCapacity = labels.retrieveValue<int>("./cellCapacity", labelCellCapacity);
+    }
+    catch (const std::runtime_error&)
+    {
+        cerr << "Failed to read " << path << ", using default settings" << endl;
+    }
+
+    centrality->setThreadCount(centralityThreads);
+}
 
+void Mycelia::buildShapeLists(MyceliaDataItem* dataItem) const
+{
     glNewList(dataItem->nodeList, GL_COMPILE);
     gluSphere(dataItem->quadric, nodeRadius, 20, 20);
     glEndList();
@@ -289,22 +403,575 @@ void Mycelia::buildGraphList(MyceliaDataItem* dataItem) const
     gluQuadricOrientation(dataItem->quadric, GLU_OUTSIDE);
     glEndList();
 
+    // coarse versions for mid range detail
+    glNewList(dataItem->nodeLowList, GL_COMPILE);
+    gluSphere(dataItem->quadric, nodeRadius, RENDER_LOW_SPHERE_SLICES, RENDER_LOW_SPHERE_STACKS);
+    glEndList();
+
+    glNewList(dataItem->arrowLowList, GL_COMPILE);
+    gluCylinder(dataItem->quadric, arrowWidth, 0.0, arrowHeight, RENDER_LOW_SEGMENT_SLICES, 1);
+    glEndList();
+}
+
+void Mycelia::buildGraphList(MyceliaDataItem* dataItem) const
+{
+    StatTimer timer(stats, STAT_GRAPH_LIST);
+
+    // update version first in case of preemption
+    dataItem->graphListVersion = gCopy->getVersion();
+    dataItem->graphListPositionVersion = gCopy->getPositionVersion();
+    dataItem->graphListBundleVersion = edgeBundler->getVersion();
+
+    buildShapeLists(dataItem);
+
     glNewList(dataItem->graphList, GL_COMPILE);
 
-    // Camera aligned texture nodes cannot be part of the display list since
-    // we must readjust their orientation anytime we are rotating the graph.
-    if (gCopy->getTextureNodeMode() == "align")
+    // Texture nodes cannot be part of the display list: camera aligned ones
+    // turn with the view, and every texture streams in from the cache after
+    // the list is built and may be evicted again.
+    drawNodes(dataItem, NODE_IMAGE);
+
+    drawEdges(dataItem);
+    glEndList();
+}
+
+static void setInstanceColor(GLfloat* color, const GLMaterial* material)
+{
+    for(int i = 0; i < 4; i++)
+    {
+        color[i] = material->diffuse[i];
+    }
+}
+
+static void addPointVertex(vector<InstancedRenderer::PointVertex>& vertices, const Vrui::Point& p, const GLMaterial* material)
+{
+    InstancedRenderer::PointVertex vertex;
+    for(int i = 0; i < 3; i++)
+    {
+        vertex.position[i] = p[i];
+    }
+    setInstanceColor(vertex.color, material);
+    vertices.push_back(vertex);
+}
+
+/*
+ * Sorts and merges dirty element slots into (first, count) ranges. Short
+ * clean gaps are folded in, trading a few extra bytes for fewer uploads.
+ */
+static vector<pair<int, int> > getDirtyRanges(vector<int>& slots)
+{
+    vector<pair<int, int> > ranges;
+
+    sort(slots.begin(), slots.end());
+
+    foreach(int slot, slots)
+    {
+        if(!ranges.empty() && slot - (ranges.back().first + ranges.back().second) <= DIRTY_RANGE_GAP)
+        {
+            ranges.back().second = max(ranges.back().second, slot - ranges.back().first + 1);
+        }
+        else
+        {
+            ranges.push_back(make_pair(slot, 1));
+        }
+    }
+
+    return ranges;
+}
+
+/*
+ * Instance data for one node: returns its detail level, with far nodes
+ * filling the point instead, or -1 for nodes left to drawNodes.
+ */
+int Mycelia::getNodeInstance(int node, MyceliaDataItem* dataItem,
+                             InstancedRenderer::NodeInstance& instance,
+                             InstancedRenderer::PointVertex& point) const
+{
+    if(!isSelectedComponent(node) || gCopy->getNodeType(node) == NODE_IMAGE)
+    {
+        return -1;
+    }
+
+    const Vrui::Point& p = gCopy->getNodePosition(node);
+    const Vrui::Scalar radius = nodeRadius * gCopy->getNodeSize(node);
+    int detail = getDetail(p, radius, dataItem);
+
+    if(detail == DETAIL_FAR)
     {
-        std::string filter = "image";
-        drawNodes(dataItem, filter);
+        for(int i = 0; i < 3; i++)
+        {
+            point.position[i] = p[i];
+        }
+        setInstanceColor(point.color, getShapeNodeMaterial(node));
     }
     else
     {
-        drawNodes(dataItem);
+        instance.center[0] = p[0];
+        instance.center[1] = p[1];
+        instance.center[2] = p[2];
+        instance.center[3] = radius;
+        setInstanceColor(instance.color, getShapeNodeMaterial(node));
     }
 
-    drawEdges(dataItem);
-    glEndList();
+    return detail;
+}
+
+/*
+ * Appends the shaft and arrow heads of one edge pair at the given detail
+ * level, laid out like drawEdgePair, or two line vertices when far away.
+ * Returns false for pairs that draw nothing.
+ */
+bool Mycelia::getEdgePairInstances(const EdgePairs& pairs, int pair, int detail, MyceliaDataItem* dataItem,
+                                   vector<InstancedRenderer::SegmentInstance>& segments,
+                                   vector<InstancedRenderer::PointVertex>& lines) const
+{
+    if(!isSelectedComponent(gCopy->getIndexNode(pairs.sources[pair])))
+    {
+        return false;
+    }
+
+    const Edge& edge = gCopy->getEdge(pairs.edges[pair]);
+    const Vrui::Point& p = gCopy->getNodePosition(edge.source);
+    const Vrui::Point& q = gCopy->getNodePosition(edge.target);
+    const Vrui::Scalar length = Geometry::dist(p, q);
+
+    if(length == 0)
+    {
+        return false;
+    }
+
+    const GLMaterial* material = gCopy->getEdgeMaterialFromId(edge.material);
+
+    if(detail == DETAIL_FAR)
+    {
+        addPointVertex(lines, p, material);
+        addPointVertex(lines, q, material);
+        return true;
+    }
+
+    const Vrui::Vector direction = (q - p) / length;
+    double sourceOffset = getNodeEdgeOffset(edge.source, dataItem);
+    double targetOffset = length - sourceOffset - getNodeEdgeOffset(edge.target, dataItem) - edgeOffset;
+    bool isBidirectional = pairs.isBidirectional(pair);
+
+    if(isBidirectional)
+    {
+        sourceOffset += edgeOffset;
+        targetOffset -= edgeOffset;
+    }
+
+    const Vrui::Point shaftStart = p + direction * sourceOffset;
+    const Vrui::Point shaftEnd = shaftStart + direction * targetOffset;
+    const Vrui::Point arrowEnd = shaftEnd + direction * arrowHeight;
+    const Vrui::Point reverseEnd = shaftStart - direction * arrowHeight;
+    const Vrui::Scalar width = edgeThickness * edge.weight;
+
+    InstancedRenderer::SegmentInstance shaft, arrow, reverse;
+    for(int i = 0; i < 3; i++)
+    {
+        shaft.source[i] = shaftStart[i];
+        shaft.target[i] = shaftEnd[i];
+        arrow.source[i] = shaftEnd[i];
+        arrow.target[i] = arrowEnd[i];
+        reverse.source[i] = shaftStart[i];
+        reverse.target[i] = reverseEnd[i];
+    }
+    shaft.source[3] = width;
+    shaft.target[3] = width;
+    arrow.source[3] = reverse.source[3] = arrowWidth;
+    arrow.target[3] = reverse.target[3] = 0;
+
+    setInstanceColor(shaft.color, material);
+    setInstanceColor(arrow.color, material);
+    segments.push_back(shaft);
+    segments.push_back(arrow);
+
+    if(isBidirectional)
+    {
+        setInstanceColor(reverse.color, material);
+        segments.push_back(reverse);
+    }
+
+    return true;
+}
+
+/*
+ * Counting sort of items by cell, returning the items in cell order and
+ * the first position of each cell, followed by the item count.
+ */
+static void sortByCell(const vector<int>& itemCells, int cellCount, vector<int>& order, vector<int>& starts)
+{
+    starts.assign(cellCount + 1, 0);
+    foreach(int cell, itemCells)
+    {
+        starts[cell + 1]++;
+    }
+
+    for(int cell = 0; cell < cellCount; cell++)
+    {
+        starts[cell + 1] += starts[cell];
+    }
+
+    vector<int> next(starts.begin(), starts.end() - 1);
+    order.resize(itemCells.size());
+
+    for(int item = 0; item < (int)itemCells.size(); item++)
+    {
+        order[next[itemCells[item]]++] = item;
+    }
+}
+
+static void startNodeCell(InstanceCell& cell, const MyceliaDataItem* dataItem)
+{
+    for(int level = 0; level < RENDER_MESH_LEVELS; level++)
+    {
+        cell.nodes[level] = dataItem->nodeInstances[level].size();
+    }
+    cell.points = dataItem->pointVertices.size();
+}
+
+static void startEdgeCell(InstanceCell& cell, const MyceliaDataItem* dataItem)
+{
+    for(int level = 0; level < RENDER_MESH_LEVELS; level++)
+    {
+        cell.segments[level] = dataItem->segmentInstances[level].size();
+    }
+    cell.lines = dataItem->lineVertices.size();
+}
+
+/*
+ * Fill the renderer's instance buffers with the same geometry the display
+ * list would hold: one sphere per shape node and one shaft with its arrow
+ * heads per edge pair. Instances are split by level of detail, with far
+ * ones as points and lines, and a copy is kept in the data item along with
+ * where each node and pair went, for updateInstances. Within each buffer
+ * instances are laid out cell by cell of the node grid, so culling can
+ * pick whole cells. Image nodes are left to drawNodes.
+ */
+void Mycelia::buildInstances(MyceliaDataItem* dataItem) const
+{
+    StatTimer timer(stats, STAT_INSTANCES);
+
+    // update version first in case of preemption
+    dataItem->instanceVersion = gCopy->getVersion();
+    dataItem->instancePositionVersion = gCopy->getPositionVersion();
+
+    // still used for image nodes that fall back to shapes and for overlays
+    buildShapeLists(dataItem);
+
+    InstancedRenderer* renderer = dataItem->renderer;
+    const vector<int>& indexNodes = gCopy->getIndexNodes();
+    const vector<Vrui::Point>& positions = gCopy->getPositions();
+
+    for(int level = 0; level < RENDER_MESH_LEVELS; level++)
+    {
+        dataItem->nodeInstances[level].clear();
+        dataItem->segmentInstances[level].clear();
+    }
+    dataItem->pointVertices.clear();
+    dataItem->lineVertices.clear();
+    dataItem->nodeLevels.assign(indexNodes.size(), -1);
+    dataItem->nodeSlots.assign(indexNodes.size(), -1);
+
+    // a grid behind the graph, e.g. mid copy, leaves everything in one cell
+    int cellCount = 1;
+    dataItem->nodeCells.assign(indexNodes.size(), 0);
+
+    if(cullingEnabled && nodeGrid.getNodeCount() == (int)indexNodes.size())
+    {
+        cellCount = nodeGrid.getCellCount();
+        for(int index = 0; index < (int)indexNodes.size(); index++)
+        {
+            dataItem->nodeCells[index] = nodeGrid.getNodeCell(index);
+        }
+    }
+
+    dataItem->instanceCells.assign(cellCount + 1, InstanceCell());
+
+    vector<int> order, starts;
+    sortByCell(dataItem->nodeCells, cellCount, order, starts);
+
+    for(int cell = 0; cell < cellCount; cell++)
+    {
+        InstanceCell& instanceCell = dataItem->instanceCells[cell];
+        startNodeCell(instanceCell, dataItem);
+
+        for(int i = starts[cell]; i < starts[cell + 1]; i++)
+        {
+            int index = order[i];
+            InstancedRenderer::NodeInstance instance;
+            InstancedRenderer::PointVertex point;
+            int detail = getNodeInstance(indexNodes[index], dataItem, instance, point);
+
+            if(detail == DETAIL_FAR)
+            {
+                dataItem->nodeSlots[index] = dataItem->pointVertices.size();
+                dataItem->pointVertices.push_back(point);
+            }
+            else if(detail >= 0)
+            {
+                dataItem->nodeSlots[index] = dataItem->nodeInstances[detail].size();
+                dataItem->nodeInstances[detail].push_back(instance);
+            }
+
+            if(detail >= 0)
+            {
+                instanceCell.nodeBounds.add(positions[index], nodeRadius * gCopy->getSizes()[index]);
+            }
+
+            dataItem->nodeLevels[index] = detail;
+        }
+    }
+
+    // one edge per connected pair, as in drawEdges
+    const EdgePairs& pairs = gCopy->getEdgePairs();
+    int pairCount = pairs.sources.size();
+    dataItem->pairLevels.assign(pairCount, -1);
+    dataItem->pairSlots.assign(pairCount, -1);
+    dataItem->pairEdges.clear();
+
+    vector<int> pairCells(pairCount);
+    for(int pair = 0; pair < pairCount; pair++)
+    {
+        pairCells[pair] = dataItem->nodeCells[pairs.sources[pair]];
+    }
+    sortByCell(pairCells, cellCount, order, starts);
+
+    for(int cell = 0; cell < cellCount; cell++)
+    {
+        InstanceCell& instanceCell = dataItem->instanceCells[cell];
+        startEdgeCell(instanceCell, dataItem);
+
+        for(int i = starts[cell]; i < starts[cell + 1]; i++)
+        {
+            int pair = order[i];
+            int detail = getEdgePairDetail(pairs, pair, dataItem);
+            vector<InstancedRenderer::SegmentInstance>& segments =
+                dataItem->segmentInstances[detail == DETAIL_FAR ? DETAIL_FULL : detail];
+            int slot = detail == DETAIL_FAR ? dataItem->lineVertices.size() : segments.size();
+
+            if(getEdgePairInstances(pairs, pair, detail, dataItem, segments, dataItem->lineVertices))
+            {
+                dataItem->pairLevels[pair] = detail;
+                dataItem->pairSlots[pair] = slot;
+                dataItem->pairEdges[pairs.edges[pair]] = pair;
+                instanceCell.edgeBounds.add(positions[pairs.sources[pair]], arrowWidth);
+                instanceCell.edgeBounds.add(positions[pairs.targets[pair]], arrowWidth);
+            }
+        }
+    }
+
+    startNodeCell(dataItem->instanceCells[cellCount], dataItem);
+    startEdgeCell(dataItem->instanceCells[cellCount], dataItem);
+
+    for(int level = 0; level < RENDER_MESH_LEVELS; level++)
+    {
+        renderer->setNodes(level, dataItem->nodeInstances[level]);
+        renderer->setSegments(level, dataItem->segmentInstances[level]);
+    }
+    renderer->setPoints(dataItem->pointVertices);
+    renderer->setLines(dataItem->lineVertices);
+    renderer->setPointSize(detailPointSize);
+}
+
+static void addVisibleRange(InstancedRenderer::RangeList& ranges, int first, int end)
+{
+    if(end == first) return;
+
+    // neighbouring visible cells share one draw
+    if(!ranges.empty() && ranges.back().first + ranges.back().second == first)
+    {
+        ranges.back().second += end - first;
+    }
+    else
+    {
+        ranges.push_back(make_pair(first, end - first));
+    }
+}
+
+/*
+ * Collects the instance ranges of the cells whose node or edge bounds meet
+ * the frustum, for one eye.
+ */
+void Mycelia::getVisibleInstances(const MyceliaDataItem* dataItem, const ViewFrustum& frustum,
+                                  InstancedRenderer::Ranges& ranges) const
+{
+    ranges.clear();
+
+    const vector<InstanceCell>& cells = dataItem->instanceCells;
+
+    for(int cell = 0; cell + 1 < (int)cells.size(); cell++)
+    {
+        const InstanceCell& c = cells[cell];
+        const InstanceCell& next = cells[cell + 1];
+
+        if(frustum.intersects(c.nodeBounds))
+        {
+            for(int level = 0; level < RENDER_MESH_LEVELS; level++)
+            {
+                addVisibleRange(ranges.nodes[level], c.nodes[level], next.nodes[level]);
+            }
+            addVisibleRange(ranges.points, c.points, next.points);
+        }
+
+        if(frustum.intersects(c.edgeBounds))
+        {
+            for(int level = 0; level < RENDER_MESH_LEVELS; level++)
+            {
+                addVisibleRange(ranges.segments[level], c.segments[level], next.segments[level]);
+            }
+            addVisibleRange(ranges.lines, c.lines, next.lines);
+        }
+    }
+}
+
+/*
+ * Patches the instances built by buildInstances for single node and edge
+ * changes, uploading only the dirty ranges. A resized node also patches
+ * the edges drawn to it, which start and end at its radius. Returns false
+ * when a change cannot be patched in place, e.g. a resized node that
+ * changes detail level, and everything has to be rebuilt.
+ */
+bool Mycelia::updateInstances(MyceliaDataItem* dataItem, const vector<GraphChange>& changes) const
+{
+    vector<int> dirtyNodes[RENDER_MESH_LEVELS];
+    vector<int> dirtySegments[RENDER_MESH_LEVELS];
+    vector<int> dirtyPoints;
+    vector<int> dirtyLines;
+    vector<int> dirtyPairs;
+    vector<bool> resized; // by dense index, their edges start at the node's radius
+
+    foreach(const GraphChange& change, changes)
+    {
+        if(change.flags == 0)
+        {
+            continue;
+        }
+
+        if(change.edge)
+        {
+            // only the edge a pair is drawn with shows up on screen
+            tr1::unordered_map<int, int>::const_iterator it = dataItem->pairEdges.find(change.id);
+
+            if(gCopy->isValidEdge(change.id) && it != dataItem->pairEdges.end())
+            {
+                dirtyPairs.push_back(it->second);
+            }
+        }
+        else
+        {
+            if(!gCopy->isValidNode(change.id))
+            {
+                continue;
+            }
+
+            int index = gCopy->getNodeIndex(change.id);
+            int level = dataItem->nodeLevels[index];
+            int slot = dataItem->nodeSlots[index];
+            InstancedRenderer::NodeInstance instance;
+            InstancedRenderer::PointVertex point;
+
+            if(getNodeInstance(change.id, dataItem, instance, point) != level)
+            {
+                return false;
+            }
+
+            if(change.flags & CHANGE_GEOMETRY)
+            {
+                resized.resize(dataItem->nodeLevels.size(), false);
+                resized[index] = true;
+            }
+
+            if(level == DETAIL_FAR)
+            {
+                dataItem->pointVertices[slot] = point;
+                dirtyPoints.push_back(slot);
+            }
+            else if(level >= 0)
+            {
+                dataItem->nodeInstances[level][slot] = instance;
+                dirtyNodes[level].push_back(slot);
+
+                // a grown node must still pass culling
+                dataItem->instanceCells[dataItem->nodeCells[index]].nodeBounds.add(
+                    gCopy->getNodePosition(change.id), instance.center[3]);
+            }
+        }
+    }
+
+    const EdgePairs& pairs = gCopy->getEdgePairs();
+
+    // one pass over the pairs for all resized nodes together
+    if(!resized.empty())
+    {
+        for(int pair = 0; pair < (int)pairs.sources.size(); pair++)
+        {
+            if(dataItem->pairSlots[pair] != -1 && (resized[pairs.sources[pair]] || resized[pairs.targets[pair]]))
+            {
+                dirtyPairs.push_back(pair);
+            }
+        }
+    }
+
+    foreach(int pair, dirtyPairs)
+    {
+        int level = dataItem->pairLevels[pair];
+        int slot = dataItem->pairSlots[pair];
+        vector<InstancedRenderer::SegmentInstance> segments;
+        vector<InstancedRenderer::PointVertex> lines;
+
+        if(!getEdgePairInstances(pairs, pair, level, dataItem, segments, lines))
+        {
+            return false;
+        }
+
+        for(int i = 0; i < (int)lines.size(); i++)
+        {
+            dataItem->lineVertices[slot + i] = lines[i];
+            dirtyLines.push_back(slot + i);
+        }
+
+        for(int i = 0; i < (int)segments.size(); i++)
+        {
+            dataItem->segmentInstances[level][slot + i] = segments[i];
+            dirtySegments[level].push_back(slot + i);
+        }
+    }
+
+    InstancedRenderer* renderer = dataItem->renderer;
+    vector<pair<int, int> > ranges;
+
+    for(int level = 0; level < RENDER_MESH_LEVELS; level++)
+    {
+        ranges = getDirtyRanges(dirtyNodes[level]);
+        for(int i = 0; i < (int)ranges.size(); i++)
+        {
+            renderer->updateNodes(level, ranges[i].first, ranges[i].second,
+                                  &dataItem->nodeInstances[level][ranges[i].first]);
+        }
+
+        ranges = getDirtyRanges(dirtySegments[level]);
+        for(int i = 0; i < (int)ranges.size(); i++)
+        {
+            renderer->updateSegments(level, ranges[i].first, ranges[i].second,
+                                     &dataItem->segmentInstances[level][ranges[i].first]);
+        }
+    }
+
+    ranges = getDirtyRanges(dirtyPoints);
+    for(int i = 0; i < (int)ranges.size(); i++)
+    {
+        renderer->updatePoints(ranges[i].first, ranges[i].second, &dataItem->pointVertices[ranges[i].first]);
+    }
+
+    ranges = getDirtyRanges(dirtyLines);
+    for(int i = 0; i < (int)ranges.size(); i++)
+    {
+        renderer->updateLines(ranges[i].first, ranges[i].second, &dataItem->lineVertices[ranges[i].first]);
+    }
+
+    dataItem->instanceVersion = gCopy->getVersion();
+    return true;
 }
 
 void Mycelia::drawEdge(const Edge& edge, MyceliaDataItem* dataItem) const
@@ -328,7 +995,8 @@ void Mycelia::drawEdge(const Vrui::Point& source,
                        bool isBidirectional,
                        MyceliaDataItem* dataItem,
                        double sourceEdgeOffset,
-                       double targetEdgeOffset) const
+                       double targetEdgeOffset,
+                       int detail) const
 {
     // computer graphics 2nd ed, p.413
     const Vrui::Vector edgeVector = target - source;
@@ -360,73 +1028,146 @@ void Mycelia::drawEdge(const Vrui::Point& source,
 
     // draw edge, leaving room for arrow
     glTranslatef(0, 0, sourceOffset);
-    gluCylinder(dataItem->quadric, edgeThickness, edgeThickness, targetOffset, 10, 1);
+    gluCylinder(dataItem->quadric, edgeThickness, edgeThickness, targetOffset,
+                detail == DETAIL_FULL ? RENDER_SEGMENT_SLICES : RENDER_LOW_SEGMENT_SLICES, 1);
 
     if(drawArrow)
     {
         // move near point 2 and draw arrow for this directed edge only.
         // if bidirectional, the other arrow will be drawn with that edge is drawn
         glTranslatef(0, 0, targetOffset);
-        glCallList(dataItem->arrowList);
+        glCallList(detail == DETAIL_FULL ? dataItem->arrowList : dataItem->arrowLowList);
     }
 
     glPopMatrix();
 }
 
+void Mycelia::drawEdgePair(const EdgePairs& pairs, int pair, MyceliaDataItem* dataItem, int detail) const
+{
+    const Edge& edge = gCopy->getEdge(pairs.edges[pair]);
+    const Vrui::Point& source = gCopy->getNodePosition(edge.source);
+    const Vrui::Point& target = gCopy->getNodePosition(edge.target);
+    double sourceEdgeOffset = getNodeEdgeOffset(edge.source, dataItem);
+    bool isBidirectional = pairs.isBidirectional(pair);
+
+    drawEdge(source,
+             target,
+             gCopy->getEdgeMaterialFromId(edge.material),
+             edgeThickness * edge.weight,
+             true,
+             isBidirectional,
+             dataItem,
+             sourceEdgeOffset,
+             getNodeEdgeOffset(edge.target, dataItem),
+             detail);
+
+    if(isBidirectional)
+    {
+        // the reverse arrow goes in the room drawEdge left at the source
+        const Vrui::Vector edgeVector = source - target;
+        const Vrui::Vector normalVector = Geometry::cross(edgeVector, upVector);
+
+        glPushMatrix();
+        glTranslatef(target[0], target[1], target[2]);
+        glRotatef(-VruiHelp::degrees(VruiHelp::angle(edgeVector, upVector)), normalVector[0], normalVector[1], normalVector[2]);
+        glTranslatef(0, 0, Geometry::mag(edgeVector) - sourceEdgeOffset - edgeOffset);
+        glCallList(detail == DETAIL_FULL ? dataItem->arrowList : dataItem->arrowLowList);
+        glPopMatrix();
+    }
+}
+
 void Mycelia::drawEdges(MyceliaDataItem* dataItem) const
 {
+    if(bundleButton->getToggle())
+    {
+        // one unlit line strip per edge, straight from the bundler's buffer
+        edgeBundler->lockPoints();
+        const vector<int>& edges = edgeBundler->getEdges();
+        const vector<Vrui::Point>& points = edgeBundler->getPoints();
+        int stride = edgeBundler->getPointStride();
+
+        if(!points.empty())
+        {
+            glPushAttrib(GL_ENABLE_BIT | GL_LINE_BIT | GL_CURRENT_BIT);
+            glPushClientAttrib(GL_CLIENT_VERTEX_ARRAY_BIT);
+            glDisable(GL_LIGHTING);
+            glLineWidth(BUNDLE_LINE_WIDTH);
+            glEnableClientState(GL_VERTEX_ARRAY);
+            glVertexPointer(3, GL_DOUBLE, sizeof(Vrui::Point), &points[0]);
+
+            for(int slot = 0; slot < (int)edges.size(); slot++)
+            {
+                int edge = edges[slot];
+
+                if(!gCopy->isValidEdge(edge) || !isSelectedComponent(gCopy->getEdge(edge).source))
+                {
+                    continue;
+                }
+
+                glColor4fv(gCopy->getEdgeMaterial(edge)->diffuse.getRgba());
+                glDrawArrays(GL_LINE_STRIP, slot * stride, stride);
+            }
+
+            glPopClientAttrib();
+            glPopAttrib();
+        }
+
+        edgeBundler->unlockPoints();
+        return;
+    }
+
     /*
-    we don't draw an edge if one was already drawn between two nodes.
-    this saves lots of time for very dense graphs.
-    todo: the current approach to tracking drawn edges is a quick hack.
+    parallel edges and both directions between two nodes share one draw,
+    which saves lots of time for very dense graphs.
     */
-    bool drawn[1000][1000] = {{false}};
-
-    const GLMaterial *material;
-    Vrui::Scalar width;
+    const EdgePairs& pairs = gCopy->getEdgePairs();
+    vector<int> farPairs;
 
-    foreach(int edge, gCopy->getEdges())
+    for(int pair = 0; pair < (int)pairs.sources.size(); pair++)
     {
-        const Edge& e = gCopy->getEdge(edge);
-
-        if(!isSelectedComponent(e.source) || drawn[e.source][e.target])
+        if(!isSelectedComponent(gCopy->getIndexNode(pairs.sources[pair])))
         {
             continue;
         }
 
-        if(bundleButton->getToggle())
+        int detail = getEdgePairDetail(pairs, pair, dataItem);
+
+        if(detail == DETAIL_FAR)
         {
-            material = gCopy->getEdgeMaterial(edge);
-            width = edgeThickness * e.weight;
-            for(int segment = 0; segment <= edgeBundler->getSegmentCount(); segment++)
-            {
-                const Vrui::Point& p = *edgeBundler->getSegment(edge, segment);
-                const Vrui::Point& q = *edgeBundler->getSegment(edge, segment + 1);
-                drawEdge(p, q, material, width, false, false, dataItem);
-            }
+            farPairs.push_back(pair);
         }
         else
         {
-            drawEdge(e, dataItem);
-            drawn[e.source][e.target] = true;
+            drawEdgePair(pairs, pair, dataItem, detail);
         }
     }
+
+    drawFarEdges(pairs, farPairs);
 }
 
-void Mycelia::drawEdgeLabels(MyceliaDataItem* dataItem) const
+void Mycelia::drawFarEdges(const EdgePairs& pairs, const vector<int>& farPairs) const
 {
-    if(!edgeLabelButton->getToggle()) return;
+    if(farPairs.empty()) return;
 
-    Vrui::Rotation inverseRotation = Vrui::getInverseNavigationTransformation().getRotation();
+    glPushAttrib(GL_ENABLE_BIT | GL_CURRENT_BIT);
+    glDisable(GL_LIGHTING);
+    glBegin(GL_LINES);
 
-    // Fonts are drawn with up direction (0,1,0). So we need to rotate them to
-    // Vrui's up direction which is not necessarily (0,0,1).
-    Vrui::Vector fontUpVector = Vrui::Vector(0,1,0);
-    Vrui::Scalar angle = VruiHelp::angle( fontUpVector, upVector );
-    Vrui::Vector rotationAxis = Geometry::cross(fontUpVector, upVector);
-    inverseRotation *= Vrui::Rotation(rotationAxis, angle);
+    foreach(int pair, farPairs)
+    {
+        const Edge& edge = gCopy->getEdge(pairs.edges[pair]);
+        glColor4fv(gCopy->getEdgeMaterialFromId(edge.material)->diffuse.getRgba());
+        glVertex(gCopy->getNodePosition(edge.source));
+        glVertex(gCopy->getNodePosition(edge.target));
+    }
+
+    glEnd();
+    glPopAttrib();
+}
 
-    float scale = nodeRadius * FONT_MODIFIER;
+void Mycelia::addEdgeLabels(LabelRenderer* labels) const
+{
+    if(!edgeLabelButton->getToggle()) return;
 
     foreach(int edge, gCopy->getEdges())
     {
@@ -440,13 +1181,7 @@ void Mycelia::drawEdgeLabels(MyceliaDataItem* dataItem) const
         if(label.size() > 0)
         {
             const Vrui::Point& p = VruiHelp::midpoint(gCopy->getSourceNodePosition(edge), gCopy->getTargetNodePosition(edge));
-
-            glPushMatrix();
-            glTranslatef(p[0] + nodeRadius, p[1] + nodeRadius, p[2] + nodeRadius);
-            glRotate(inverseRotation);
-            glScalef(scale, scale, scale);
-            dataItem->font->Render(label.c_str());
-            glPopMatrix();
+            labels->add(p + Vrui::Vector(nodeRadius, nodeRadius, nodeRadius), label, false);
         }
     }
 }
@@ -491,7 +1226,7 @@ bool Mycelia::drawTextureNode(int node, MyceliaDataItem* dataItem) const
 {
     std::string imagePath = gCopy->getNodeImagePath(node);
 
-    std::pair<GLuint, std::pair<float, float> > texturePair = dataItem->getTextureId(imagePath);
+    std::pair<GLuint, std::pair<float, float> > texturePair = dataItem->textures->getTexture(imagePath);
     GLuint imageId = texturePair.first;
     float W = texturePair.second.first;
     float H = texturePair.second.second;
@@ -559,22 +1294,14 @@ bool Mycelia::drawShapeNode(int node, MyceliaDataItem* dataItem) const
 {
     const Vrui::Point& p = gCopy->getNodePosition(node);
     const float size = gCopy->getNodeSize(node);
+    bool full = getDetail(p, nodeRadius * size, dataItem) == DETAIL_FULL;
 
-    if(node == highlightedNode)
-    {
-        glMaterial(GLMaterialEnums::FRONT_AND_BACK, *gCopy->getNodeMaterialFromId(MATERIAL_HIGHLIGHTED));
-    }
-    else if(node == selectedNode)
-        glMaterial(GLMaterialEnums::FRONT_AND_BACK, *gCopy->getNodeMaterialFromId(MATERIAL_SELECTED));
-    else if(node == previousNode)
-        glMaterial(GLMaterialEnums::FRONT_AND_BACK, *gCopy->getNodeMaterialFromId(MATERIAL_SELECTED_PREVIOUS));
-    else
-        glMaterial(GLMaterialEnums::FRONT_AND_BACK, *gCopy->getNodeMaterial(node));
+    glMaterial(GLMaterialEnums::FRONT_AND_BACK, *getShapeNodeMaterial(node));
 
     glPushMatrix();
     glTranslatef(p[0], p[1], p[2]);
     glScalef(size, size, size);
-    glCallList(dataItem->nodeList);
+    glCallList(full ? dataItem->nodeList : dataItem->nodeLowList);
     glPopMatrix();
 
     return true;
@@ -582,88 +1309,115 @@ bool Mycelia::drawShapeNode(int node, MyceliaDataItem* dataItem) const
 
 void Mycelia::drawNode(int node, MyceliaDataItem* dataItem) const
 {
-    std::string type = gCopy->getNodeType(node);
+    int type = gCopy->getNodeType(node);
 
     bool success = false;
-    if (type == "image")
+    if (type == NODE_IMAGE)
     {
         success = drawTextureNode(node, dataItem);
     }
 
-    if (type == "shape" || !success)
+    if (type == NODE_SHAPE || !success)
     {
         success = drawShapeNode(node, dataItem);
     }
 }
 
-void Mycelia::drawNodes(MyceliaDataItem* dataItem, std::string filter) const
+void Mycelia::drawNodes(MyceliaDataItem* dataItem, int filter) const
 {
-    std::string node_type;
-    foreach(int node, gCopy->getNodes())
+    int node_type;
+    vector<int> farNodes;
+    const vector<int>& indexNodes = gCopy->getIndexNodes();
+    const vector<int>* component = getSelectedComponent(gCopy);
+    int count = component ? (int)component->size() : (int)indexNodes.size();
+
+    for(int i = 0; i < count; i++)
     {
-        if(!isSelectedComponent(node))
+        int node = indexNodes[component ? (*component)[i] : i];
+
+        node_type = gCopy->getNodeType(node);
+        if (node_type == filter)
         {
             continue;
         }
 
-        node_type = gCopy->getNodeType(node);
-        if (node_type != filter)
+        // far away shapes are batched into points, images keep their quads
+        if (node_type != NODE_IMAGE &&
+            getDetail(gCopy->getNodePosition(node), nodeRadius * gCopy->getNodeSize(node), dataItem) == DETAIL_FAR)
+        {
+            farNodes.push_back(node);
+        }
+        else
         {
             drawNode(node, dataItem);
         }
     }
+
+    drawFarNodes(farNodes);
 }
 
-void Mycelia::drawNodeLabels(MyceliaDataItem* dataItem) const
+void Mycelia::drawFarNodes(const vector<int>& farNodes) const
 {
-    if(!nodeLabelButton->getToggle()) return;
+    if(farNodes.empty()) return;
 
-    Vrui::Rotation inverseRotation = Vrui::getInverseNavigationTransformation().getRotation();
+    glPushAttrib(GL_ENABLE_BIT | GL_POINT_BIT | GL_CURRENT_BIT);
+    glDisable(GL_LIGHTING);
+    glPointSize(detailPointSize);
+    glBegin(GL_POINTS);
 
-    // Fonts are drawn with up direction (0,1,0). So we need to rotate them to
-    // Vrui's up direction which is not necessarily (0,0,1).
-    Vrui::Vector fontUpVector = Vrui::Vector(0,1,0);
-    Vrui::Scalar angle = VruiHelp::angle( fontUpVector, upVector );
-    Vrui::Vector rotationAxis = Geometry::cross(fontUpVector, upVector);
-    inverseRotation *= Vrui::Rotation(rotationAxis, angle);
+    foreach(int node, farNodes)
+    {
+        glColor4fv(getShapeNodeMaterial(node)->diffuse.getRgba());
+        glVertex(gCopy->getNodePosition(node));
+    }
 
-    float scale = nodeRadius * FONT_MODIFIER;
+    glEnd();
+    glPopAttrib();
+}
 
-    foreach(int node, gCopy->getNodes())
-    {
-        if(!isSelectedComponent(node))
-        {
-            continue;
-        }
+void Mycelia::addNodeLabels(LabelRenderer* labels) const
+{
+    if(!nodeLabelButton->getToggle()) return;
+
+    const Vrui::Scalar offset = 1.1 * nodeRadius;
+    const vector<int>& indexNodes = gCopy->getIndexNodes();
+    const vector<int>* component = getSelectedComponent(gCopy);
+    int count = component ? (int)component->size() : (int)indexNodes.size();
 
-        const Vrui::Point& p = gCopy->getNodePosition(node);
+    for(int i = 0; i < count; i++)
+    {
+        int node = indexNodes[component ? (*component)[i] : i];
         const string& label = gCopy->getNodeLabel(node);
 
         if(label.size() > 0)
         {
-            glPushMatrix();
-            glTranslatef(p[0] + 1.1 * nodeRadius, p[1] + 1.1 * nodeRadius, p[2] + 1.1 * nodeRadius);
-            glRotate(inverseRotation);
-            glScalef(scale, scale, scale);
-
-            // draw a shadow for readability
-            glPushMatrix();
-            glColor3f(0, 0, 0);
-            glTranslatef(1, 0, -1);
-            dataItem->font->Render(label.c_str());
-            glPopMatrix();
-
-            glColor3f(1, 1, 1);
-            dataItem->font->Render(label.c_str());
-            glPopMatrix();
+            // shadowed for readability
+            labels->add(gCopy->getNodePosition(node) + Vrui::Vector(offset, offset, offset), label);
         }
     }
 }
 
+void Mycelia::drawLabels(MyceliaDataItem* dataItem) const
+{
+    LabelRenderer* labels = dataItem->labels;
+
+    if(!labels->isInitialized()) return;
+
+    labels->clear();
+    addNodeLabels(labels);
+    addEdgeLabels(labels);
+    labels->draw(getLabelRotation(), nodeRadius * FONT_MODIFIER);
+}
+
 void Mycelia::drawShortestPath(MyceliaDataItem* dataItem) const
 {
     glMaterial(GLMaterialEnums::FRONT_AND_BACK, *gCopy->getNodeMaterialFromId(MATERIAL_SELECTED));
 
+    if(selectedNode < 0 || selectedNode >= (int)predecessorVector.size())
+    {
+        return;
+    }
+
     for(int i = selectedNode; i != previousNode; i = predecessorVector[i])
     {
         if(i == predecessorVector[i]) break;
@@ -681,6 +1435,9 @@ void Mycelia::drawSpanningTree(MyceliaDataItem* dataItem) const
 
     for(int i = 0; i < (int)predecessorVector.size(); i++)
     {
+        // roots and ids without a node are their own predecessor
+        if(i == predecessorVector[i]) continue;
+
         drawNode(i, dataItem);
         Edge e(i, predecessorVector[i]);
         drawEdge(e, const_cast<MyceliaDataItem*>(dataItem) );
@@ -689,7 +1446,7 @@ void Mycelia::drawSpanningTree(MyceliaDataItem* dataItem) const
 
 void Mycelia::display(GLContextData& contextData) const
 {
-
+    StatTimer timer(stats, STAT_DISPLAY);
     MyceliaDataItem* dataItem = contextData.retrieveDataItem<MyceliaDataItem>(this);
 
     if(showingLogo)
@@ -698,9 +1455,47 @@ void Mycelia::display(GLContextData& contextData) const
         return;
     }
 
+    // edges end on image nodes only while their image can still load
+    double textureStart = Stats::now();
+    bool texturesChanged = dataItem->textures->update();
+    stats.add(STAT_TEXTURES, Stats::now() - textureStart);
+
+    if(texturesChanged)
+    {
+        dataItem->graphListVersion = -1;
+        dataItem->instanceVersion = -1;
+    }
+
+    bool instanced = dataItem->renderer && instancedButton->getToggle() && !bundleButton->getToggle();
+
+    // detail levels are chosen again once the viewer has moved far enough
+    // for nodes near the closest detail boundary to change level
+    Vrui::Point viewer = Vrui::getInverseNavigationTransformation().transform(Vrui::getDisplayState(contextData).eyePosition);
+    bool viewerMoved = detailEnabled &&
+        Geometry::dist(viewer, dataItem->detailViewer) > detailUpdateFraction * nodeRadius / lowDetailSize;
+
+    if(instanced)
+    {
+        bool rebuild = viewerMoved || dataItem->instancePositionVersion != gCopy->getPositionVersion();
+
+        // attribute edits to a few elements are patched into the buffers
+        if(!rebuild && dataItem->instanceVersion != gCopy->getVersion())
+        {
+            vector<GraphChange> changes;
+            rebuild = !gCopy->getChanges(dataItem->instanceVersion, changes) || !updateInstances(dataItem, changes);
+        }
+
+        if(rebuild)
+        {
+            dataItem->detailViewer = viewer;
+            buildInstances(dataItem);
+        }
+    }
     // re-create display list if it's been updated
-    if(dataItem->graphListVersion != gCopy->getVersion())
+    else if(dataItem->graphListVersion != gCopy->getVersion() || dataItem->graphListPositionVersion != gCopy->getPositionVersion() ||
+            (bundleButton->getToggle() && dataItem->graphListBundleVersion != edgeBundler->getVersion()) || viewerMoved)
     {
+        dataItem->detailViewer = viewer;
         buildGraphList(dataItem);
     }
 
@@ -710,27 +1505,32 @@ void Mycelia::display(GLContextData& contextData) const
     }
     else
     {
-        glCallList(dataItem->graphList);
+        if(instanced)
+        {
+            if(cullingEnabled)
+            {
+                ViewFrustum frustum;
+                frustum.load();
+                getVisibleInstances(dataItem, frustum, dataItem->visibleRanges);
+                dataItem->renderer->draw(dataItem->visibleRanges);
+            }
+            else
+            {
+                dataItem->renderer->draw();
+            }
 
-        // Camera aligned texture nodes must be redrawn each time.
-        // Rotatable texture nodes will be in the display list and thus
-        // will rotate so long as we don't redraw the display list.
-        if (gCopy->getTextureNodeMode() == "align")
+            // image nodes are not instanced, so draw them every frame
+            drawNodes(dataItem, NODE_SHAPE);
+        }
+        else
         {
-            std::string filter = "shape";
-            drawNodes(dataItem, filter);
+            glCallList(dataItem->graphList);
+
+            // texture nodes are left out of the display list
+            drawNodes(dataItem, NODE_SHAPE);
         }
 
-        // Haven't figure out what FTGLTextureFont::Render() is changing...
-        // but unless we push GL_TEXTURE_BIT, the rendered text disappears on
-        // the second call to display() on some platforms
-        // (eg Linux on Intel Mac).
-        glDisable(GL_LIGHTING);
-        glPushAttrib(GL_TEXTURE_BIT);
-        drawNodeLabels(dataItem);
-        drawEdgeLabels(dataItem);
-        glPopAttrib();
-        glEnable(GL_LIGHTING);
+        drawLabels(dataItem);
 
         if(shortestPathButton->getToggle())
         {
@@ -740,6 +1540,55 @@ void Mycelia::display(GLContextData& contextData) const
 
 }
 
+const GLMaterial* Mycelia::getShapeNodeMaterial(int node) const
+{
+    if(node == highlightedNode)
+        return gCopy->getNodeMaterialFromId(MATERIAL_HIGHLIGHTED);
+    else if(node == selectedNode)
+        return gCopy->getNodeMaterialFromId(MATERIAL_SELECTED);
+    else if(node == previousNode)
+        return gCopy->getNodeMaterialFromId(MATERIAL_SELECTED_PREVIOUS);
+    else
+        return gCopy->getNodeMaterial(node);
+}
+
+/*
+ * Level of detail for something of the given radius at p, from its size
+ * projected from the viewer the display lists or instances were built for.
+ */
+int Mycelia::getDetail(const Vrui::Point& p, Vrui::Scalar radius, const MyceliaDataItem* dataItem) const
+{
+    if(!detailEnabled) return DETAIL_FULL;
+
+    Vrui::Scalar distance = Geometry::dist(p, dataItem->detailViewer);
+
+    if(radius >= lowDetailSize * distance) return DETAIL_FULL;
+    if(radius >= farDetailSize * distance) return DETAIL_LOW;
+    return DETAIL_FAR;
+}
+
+// edges follow the finer of their two end nodes
+int Mycelia::getEdgePairDetail(const EdgePairs& pairs, int pair, const MyceliaDataItem* dataItem) const
+{
+    const Edge& edge = gCopy->getEdge(pairs.edges[pair]);
+    return min(getDetail(gCopy->getNodePosition(edge.source), nodeRadius, dataItem),
+               getDetail(gCopy->getNodePosition(edge.target), nodeRadius, dataItem));
+}
+
+Vrui::Rotation Mycelia::getLabelRotation() const
+{
+    Vrui::Rotation inverseRotation = Vrui::getInverseNavigationTransformation().getRotation();
+
+    // Fonts are drawn with up direction (0,1,0). So we need to rotate them to
+    // Vrui's up direction which is not necessarily (0,0,1).
+    Vrui::Vector fontUpVector = Vrui::Vector(0,1,0);
+    Vrui::Scalar angle = VruiHelp::angle( fontUpVector, upVector );
+    Vrui::Vector rotationAxis = Geometry::cross(fontUpVector, upVector);
+    inverseRotation *= Vrui::Rotation(rotationAxis, angle);
+
+    return inverseRotation;
+}
+
 double Mycelia::getNodeEdgeOffset(int node, MyceliaDataItem* dataItem) const
 {
     // Determine an additional offset while drawing edges due to the node
@@ -747,13 +1596,10 @@ double Mycelia::getNodeEdgeOffset(int node, MyceliaDataItem* dataItem) const
 
     double offset = nodeRadius;
 
-    std::string type = gCopy->getNodeType(node);
-    if (type == "image")
+    if (gCopy->getNodeType(node) == NODE_IMAGE)
     {
-        std::string imagePath = gCopy->getNodeImagePath(node);
-        std::pair<GLuint, std::pair<float, float> > texturePair = dataItem->getTextureId(imagePath);
-        GLuint imageId = texturePair.first;
-        if (imageId != 0)
+        // only asks whether the image will show, without waiting for it
+        if (dataItem->textures->isUsable(gCopy->getNodeImagePath(node)))
         {
             // The height is normalized to nodeDiameter = 2*nodeRadius when
             // imageScale = 1. So we use the height as the diameter of the sphere which edges
@@ -768,20 +1614,121 @@ double Mycelia::getNodeEdgeOffset(int node, MyceliaDataItem* dataItem) const
             return offset;
         }
     }
-    offset = nodeRadius * gCopy->getNodeSize(node);
-    return offset;
-}
+    offset = nodeRadius * gCopy->getNodeSize(node);
+    return offset;
+}
+
+void Mycelia::frame()
+{
+    StatTimer timer(stats, STAT_FRAME);
+    double newFrameTime = Vrui::getApplicationTime();
+    rotationAngle += (newFrameTime - lastFrameTime) * rotationSpeed;
+    rotationAngle = Math::mod(rotationAngle, Vrui::Scalar(360));
+    lastFrameTime = newFrameTime;
+
+    // edits queued by RPC threads land between frames, never mid-copy
+    applyCommands();
+
+    if(cluster && !cluster->isMaster())
+    {
+        cluster->receive(g);
+    }
+
+    // copy the whole graph only when structure or attributes change; layout
+    // steps just publish positions, which are swapped in without the lock
+    g->flushPositions();
+
+    if(g->getVersion() != gCopy->getVersion())
+    {
+        g->lock();
+        copyGraph();
+        g->unlock();
+    }
+    else if(g->getPositionVersion() != gCopy->getPositionVersion())
+    {
+        gCopy->takePublishedPositions(*g);
+
+        // a step held back by the publish rate arrives with a later frame
+        if(g->getPositionVersion() != gCopy->getPositionVersion() && !g->isPublishPending())
+        {
+            g->lock();
+            if(g->getVersion() == gCopy->getVersion())
+            {
+                gCopy->copyPositions(*g);
+            }
+            else
+            {
+                copyGraph();
+            }
+            g->unlock();
+        }
+    }
+
+    if(cluster && cluster->isMaster())
+    {
+        cluster->send(gCopy);
+    }
+
+    // keep the culling and picking grid on the positions about to be drawn
+    if(gridVersion != gCopy->getVersion() || gridPositionVersion != gCopy->getPositionVersion())
+    {
+        gridVersion = gCopy->getVersion();
+        gridPositionVersion = gCopy->getPositionVersion();
+        nodeGrid.update(gCopy->getPositions());
+    }
+
+    // refresh the layout energy in the status window only when it changes
+    if(newFrameTime - lastStatusTime >= STATUS_INTERVAL)
+    {
+        lastStatusTime = newFrameTime;
+        string energy;
+
+        if(layout == dynamicLayout && !layout->isStopped())
+        {
+            ostringstream out;
+            out << dynamicLayout->getKineticEnergy() + dynamicLayout->getSpringEnergy();
+            if(dynamicLayout->isAsleep()) out << " (at rest)";
+            energy = out.str();
+        }
+
+        string progress;
+
+        if(centrality->isRunning())
+        {
+            ostringstream out;
+            out << (int)(100 * centrality->getProgress()) << "%";
+            progress = out.str();
+        }
+
+        if(energy != statusEnergy || progress != statusCentrality || statsButton->getToggle())
+        {
+            statusEnergy = energy;
+            statusCentrality = progress;
+            updateStatus();
+        }
+
+        // rates fall back to zero while nothing else asks for frames
+        if(statsButton->getToggle())
+        {
+            Vrui::scheduleUpdate(Vrui::getApplicationTime() + STATUS_INTERVAL);
+        }
+    }
 
-void Mycelia::frame()
-{
-    double newFrameTime = Vrui::getApplicationTime();
-    rotationAngle += (newFrameTime - lastFrameTime) * rotationSpeed;
-    rotationAngle = Math::mod(rotationAngle, Vrui::Scalar(360));
-    lastFrameTime = newFrameTime;
+    // keep the layout of an opened file once it settles or is stopped
+    if(layoutCachePending && (layout->isStopped() || (layout == dynamicLayout && dynamicLayout->isAsleep())))
+    {
+        layoutCachePending = false;
+        layoutCache->save(g, layoutSource);
+    }
 
-    g->lock();
-    *gCopy = *g;
-    g->unlock();
+    if(centralityPlotPending && !centrality->isRunning())
+    {
+        centralityPlotPending = false;
+        plotCentrality();
+    }
+
+    // plugin output finished since the last frame
+    imageWindow->update();
 
     if(gCopy->getNodeCount() == 0)
     {
@@ -819,18 +1766,36 @@ void Mycelia::initContext(GLContextData& contextData) const
 {
     MyceliaDataItem* dataItem = new MyceliaDataItem();
 
-    // fonts
+    // fall back to display lists without instancing support
+    if(InstancedRenderer::isSupported())
+    {
+        dataItem->renderer = new InstancedRenderer();
+
+        if(!dataItem->renderer->init())
+        {
+            delete dataItem->renderer;
+            dataItem->renderer = 0;
+        }
+    }
+
+    // fonts, the logo still goes through ftgl
     std::string fontDirectory(getResourceDir());
     fontDirectory += "/fonts";
     dataItem->font = new FTGLTextureFont((fontDirectory+"/Sansation_Light.ttf").c_str());
     dataItem->font->FaceSize(FONT_SIZE);
 
+    dataItem->textures = new TextureCache(textureMegabytes, textureMaxSize, textureMipmaps, textureUploads);
+
+    dataItem->labels = new LabelRenderer();
+    dataItem->labels->init((fontDirectory+"/Sansation_Light.ttf").c_str(), FONT_SIZE);
+    dataItem->labels->setCulling(labelMinPixels, labelCellPixels, labelCellCapacity);
+
     contextData.addDataItem(this, dataItem);
 }
 
 bool Mycelia::isSelectedComponent(int node) const
 {
-    if(componentButton->getToggle())
+    if(componentButton->getToggle() && gCopy->isValidNode(selectedNode))
     {
         return gCopy->getNodeComponent(node) == gCopy->getNodeComponent(selectedNode);
     }
@@ -838,11 +1803,27 @@ bool Mycelia::isSelectedComponent(int node) const
     return true;
 }
 
-void Mycelia::setStatus(const char* status) const
+/*
+ * Dense indices of graph's nodes in the selected node's component, or 0
+ * when every node is shown, so loops can skip the rest of the graph.
+ * Caller holds graph's lock unless it is gCopy.
+ */
+const vector<int>* Mycelia::getSelectedComponent(Graph* graph) const
+{
+    if(componentButton->getToggle() && graph->isValidNode(selectedNode))
+    {
+        return &graph->getComponentIndices(selectedNode);
+    }
+
+    return 0;
+}
+
+void Mycelia::setStatus(const char* status)
 {
-    statusWindow->update("", status);
+    statusMessage = status;
+    updateStatus();
 
-    if(strcmp(status, "") == 0)
+    if(strcmp(status, "") == 0 && !statsButton->getToggle())
     {
         statusWindow->hide();
     }
@@ -852,6 +1833,58 @@ void Mycelia::setStatus(const char* status) const
     }
 }
 
+static string formatRate(double rate)
+{
+    ostringstream out;
+    out.setf(ios::fixed);
+    out.precision(1);
+    out << rate;
+    return out.str();
+}
+
+// the status message, followed by the dynamic layout's energy while it runs
+// and the rolling rates while statistics are shown
+void Mycelia::updateStatus()
+{
+    Attributes status;
+    status.push_back(pair<string, string>("", statusMessage));
+
+    if(!statusEnergy.empty())
+    {
+        status.push_back(pair<string, string>("Layout Energy", statusEnergy));
+    }
+
+    if(!statusCentrality.empty())
+    {
+        status.push_back(pair<string, string>("Centrality", statusCentrality));
+    }
+
+    if(statsButton->getToggle())
+    {
+        double rates[STAT_COUNT];
+        double loads[STAT_COUNT];
+        stats.getRates(rates, loads);
+
+        status.push_back(pair<string, string>("Frames/s", formatRate(rates[STAT_FRAME])));
+        status.push_back(pair<string, string>("Frame ms", formatRate(rates[STAT_FRAME] > 0 ? 1000 * loads[STAT_FRAME] / rates[STAT_FRAME] : 0)));
+        status.push_back(pair<string, string>("Layout Steps/s", formatRate(rates[STAT_LAYOUT_STEP])));
+        status.push_back(pair<string, string>("Bundle Steps/s", formatRate(rates[STAT_BUNDLE_STEP])));
+        status.push_back(pair<string, string>("Rebuilds/s", formatRate(rates[STAT_GRAPH_LIST] + rates[STAT_INSTANCES])));
+        status.push_back(pair<string, string>("Graph Copies/s", formatRate(rates[STAT_GRAPH_COPY])));
+        status.push_back(pair<string, string>("Lock Wait ms/s", formatRate(1000 * loads[STAT_LOCK_WAIT])));
+        status.push_back(pair<string, string>("RPC Calls/s", formatRate(rates[STAT_RPC])));
+    }
+
+    statusWindow->update(status);
+}
+
+// the renderer's copy, caller holds g's lock
+void Mycelia::copyGraph()
+{
+    StatTimer timer(stats, STAT_GRAPH_COPY);
+    *gCopy = *g;
+}
+
 /*
  * layout
  */
@@ -873,8 +1906,19 @@ bool Mycelia::layoutIsStopped() const
     return layout->isStopped();
 }
 
-void Mycelia::setLayoutType(int type)
+void Mycelia::setLayoutType(int type, double theta)
 {
+    if(theta >= 0)
+    {
+        staticLayout->setTheta(theta);
+        barnesHutButton->setToggle(theta > 0);
+    }
+
+#ifndef __CUDA__
+    if(type == LAYOUT_GPU_STATIC) type = LAYOUT_STATIC;
+    if(type == LAYOUT_GPU_DYNAMIC) type = LAYOUT_DYNAMIC;
+#endif
+
     if(type == LAYOUT_DYNAMIC)
     {
         edgeBundler->stop();
@@ -900,6 +1944,45 @@ void Mycelia::setLayoutType(int type)
         layout = staticLayout;
         layoutWindow->hide();
     }
+    else if(type == LAYOUT_MULTILEVEL)
+    {
+        layoutRadioBox->setSelectedToggle(2);
+        if (layout != multilevelLayout)
+        {
+            // Then we are switching layouts!
+            stopLayout();
+        }
+        layout = multilevelLayout;
+        layoutWindow->hide();
+    }
+#ifdef __CUDA__
+    else if(type == LAYOUT_GPU_STATIC)
+    {
+        layoutRadioBox->setSelectedToggle(3);
+        if (layout != gpuStaticLayout)
+        {
+            // Then we are switching layouts!
+            stopLayout();
+        }
+        layout = gpuStaticLayout;
+        layoutWindow->hide();
+    }
+    else if(type == LAYOUT_GPU_DYNAMIC)
+    {
+        edgeBundler->stop();
+        bundleButton->setToggle(false);
+
+        // shares its parameters with the cpu dynamic layout
+        layoutRadioBox->setSelectedToggle(4);
+        if (layout != gpuDynamicLayout)
+        {
+            // Then we are switching layouts!
+            stopLayout();
+        }
+        layout = gpuDynamicLayout;
+        layoutWindow->show();
+    }
+#endif
 }
 
 void Mycelia::setSkipLayout(bool skipLayout)
@@ -909,6 +1992,12 @@ void Mycelia::setSkipLayout(bool skipLayout)
 
 void Mycelia::startLayout() const
 {
+    // slaves draw the master's layout
+    if(cluster && !cluster->isMaster())
+    {
+        return;
+    }
+
     layout->start();
 }
 
@@ -917,11 +2006,30 @@ void Mycelia::stopLayout() const
     edgeBundler->stop();
     staticLayout->stop();
     dynamicLayout->stop();
+    multilevelLayout->stop();
+#ifdef __CUDA__
+    gpuStaticLayout->stop();
+    gpuDynamicLayout->stop();
+#endif
+}
+
+// resumes a dynamic layout that went to sleep at rest
+void Mycelia::wakeLayout() const
+{
+    dynamicLayout->wake();
+#ifdef __CUDA__
+    gpuDynamicLayout->wake();
+#endif
 }
 
 /*
  * callbacks
  */
+void Mycelia::barnesHutCallback(GLMotif::ToggleButton::ValueChangedCallbackData* cbData)
+{
+    staticLayout->setTheta(cbData->set ? BARNES_HUT_THETA : 0);
+}
+
 void Mycelia::bundleCallback(GLMotif::ToggleButton::ValueChangedCallbackData* cbData)
 {
     if(g->getNodeCount() == 0) return;
@@ -942,10 +2050,13 @@ void Mycelia::bundleCallback(GLMotif::ToggleButton::ValueChangedCallbackData* cb
 void Mycelia::clearCallback(Misc::CallbackData* cbData)
 {
     g->clear();
+    layoutSource = "";
+    layoutCachePending = false;
 
     // clear menu toggles
     bundleButton->setToggle(false);
     componentButton->setToggle(false);
+    statsButton->setToggle(false);
     centralityButton->setToggle(false);
     degreeButton->setToggle(false);
     adjacencyButton->setToggle(false);
@@ -962,6 +2073,7 @@ void Mycelia::clearCallback(Misc::CallbackData* cbData)
     imageWindow->hide();
     nodeWindow->clear();
     nodeWindow->hide();
+    statusMessage.clear();
     statusWindow->clear();
     statusWindow->hide();
     generator->hide();
@@ -969,11 +2081,7 @@ void Mycelia::clearCallback(Misc::CallbackData* cbData)
 
 void Mycelia::componentCallback(GLMotif::ToggleButton::ValueChangedCallbackData* cbData)
 {
-    if(cbData->set)
-    {
-        g->setComponents();
-    }
-
+    // components are kept up to date by the graph
     resetLayoutCallback(0);
 }
 
@@ -988,6 +2096,9 @@ void Mycelia::fileOpen(string &filename)
 
     // set to true if parser detects nodes with explicit positions
     skipLayout = false;
+    layoutSource = "";
+    warmStart = LAYOUT_CACHE_MISS;
+    layoutCachePending = false;
 
     // call appropriate parser
     if(VruiHelp::endsWith(filename, ".dot"))
@@ -1006,6 +2117,22 @@ void Mycelia::fileOpen(string &filename)
     {
         gmlParser->parse(filename);
     }
+    else if(VruiHelp::endsWith(filename, ".edges"))
+    {
+        edgeListParser->parse(filename);
+    }
+    else if(VruiHelp::endsWith(filename, SNAPSHOT_EXTENSION))
+    {
+        // snapshots are saved laid out
+        skipLayout = g->readSnapshot(filename);
+    }
+
+    // start from the positions this file settled at before
+    if(!skipLayout && !VruiHelp::endsWith(filename, SNAPSHOT_EXTENSION))
+    {
+        layoutSource = filename;
+        warmStart = layoutCache->load(g, layoutSource, warmNodes);
+    }
 
     // reset navigation here in case skipLayout is true
     resetNavigationCallback(0);
@@ -1023,6 +2150,8 @@ void Mycelia::fileOpenAction(GLMotif::FileSelectionDialog::OKCallbackData* cbDat
 void Mycelia::generatorCallback(GLMotif::RadioBox::ValueChangedCallbackData* cbData)
 {
     g->clear();
+    layoutSource = "";
+    layoutCachePending = false;
 
     setLayoutType(LAYOUT_DYNAMIC);
     generator->hide();
@@ -1066,84 +2195,73 @@ void Mycelia::openFileCallback(Misc::CallbackData* cbData)
     VruiHelp::show(fileWindow, mainMenu);
 }
 
-void Mycelia::pythonCallback(GLMotif::RadioBox::ValueChangedCallbackData* cbData)
+// writes the plugin view of gCopy and has the image window run script on it
+void Mycelia::runPlugin(const string& script, const vector<double>& values)
 {
-    if(g->getNodeCount() == 0) return;
+    if(!PluginHost::writeView(PLUGIN_VIEW, gCopy, values))
+    {
+        cerr << "Failed to write " << PLUGIN_VIEW << endl;
+        return;
+    }
 
-    imageWindow->hide();
+    imageWindow->load(script);
+}
 
-    if(cbData->newSelectedToggle == centralityButton)
+// plots the last centrality run by gCopy's dense index; nodes added since
+// the run was started are 0
+void Mycelia::plotCentrality()
+{
+    vector<int> nodes;
+    vector<double> values;
+    double bound;
+    int samples;
+
+    if(centrality->getResult(nodes, values, bound, samples) < 0 || !centralityButton->getToggle())
     {
-        vector<double> bc = gCopy->getBetweennessCentrality();
-        ofstream out("/tmp/input.txt");
+        return;
+    }
 
-        foreach(int node, gCopy->getNodes())
-        {
-            out << bc[node] << endl;
-        }
+    map<int, double> byNode;
 
-        out.close();
-        imageWindow->load("python/plugins/bc.py");
-    }
-    else if(cbData->newSelectedToggle == degreeButton)
+    for(int i = 0; i < (int)nodes.size(); i++)
     {
-        ofstream out("/tmp/input.txt");
+        byNode[nodes[i]] = values[i];
+    }
 
-        foreach(int node, gCopy->getNodes())
-        {
-            out << gCopy->getNodeDegree(node) << endl;
-        }
+    const vector<int>& ids = gCopy->getIndexNodes();
+    vector<double> indexValues(ids.size(), 0);
 
-        out.close();
-        imageWindow->load("python/plugins/degree.py");
-    }
-    else if(cbData->newSelectedToggle == adjacencyButton)
+    for(int index = 0; index < (int)ids.size(); index++)
     {
-        bool a[1000][1000] = {{false}}; // temporary
-
-        foreach(int source, gCopy->getNodes())
-        {
-            foreach(int target, gCopy->getNodes())
-            {
-                if(gCopy->hasEdge(source, target))
-                {
-                    a[source][target] = true;
-                }
-            }
-        }
+        map<int, double>::const_iterator it = byNode.find(ids[index]);
+        if(it != byNode.end()) indexValues[index] = it->second;
+    }
 
-        ofstream out("/tmp/input.txt");
+    runPlugin("python/plugins/bc.py", indexValues);
+}
 
-        for(int source = 0; source < gCopy->getNodeCount(); source++)
-        {
-            for(int target = 0; target < gCopy->getNodeCount(); target++)
-            {
-                out << a[source][target] << " ";
-            }
+void Mycelia::pythonCallback(GLMotif::RadioBox::ValueChangedCallbackData* cbData)
+{
+    if(g->getNodeCount() == 0) return;
 
-            out << endl;
-        }
+    imageWindow->hide();
 
-        out.close();
-        imageWindow->load("python/plugins/adjmatrix.py");
+    if(cbData->newSelectedToggle == centralityButton)
+    {
+        // computed in the background, frame() plots it once done
+        centralityPlotPending = centrality->start(centralitySamples, true) || centrality->isRunning();
+    }
+    else if(cbData->newSelectedToggle == degreeButton)
+    {
+        runPlugin("python/plugins/degree.py");
+    }
+    else if(cbData->newSelectedToggle == adjacencyButton)
+    {
+        runPlugin("python/plugins/adjmatrix.py");
     }
     else if(cbData->newSelectedToggle == lanetButton)
     {
-        ofstream out("/tmp/input.txt");
-
-        foreach(int source, gCopy->getNodes())
-        {
-            foreach(int target, gCopy->getNodes())
-            {
-                if(gCopy->hasEdge(source, target))
-                {
-                    out << source << " " << target << endl;
-                }
-            }
-        }
-
-        out.close();
-        imageWindow->load("python/plugins/lanet.py");
+        runPlugin("python/plugins/lanet.py");
     }
 
     if(cbData->newSelectedToggle) imageWindow->show();
@@ -1164,6 +2282,20 @@ void Mycelia::resetLayout(bool watch)
     {
         setLayoutType(LAYOUT_STATIC);
     }
+    else if(multilevelButton->getToggle())
+    {
+        setLayoutType(LAYOUT_MULTILEVEL);
+    }
+#ifdef __CUDA__
+    else if(gpuStaticButton->getToggle())
+    {
+        setLayoutType(LAYOUT_GPU_STATIC);
+    }
+    else if(gpuDynamicButton->getToggle())
+    {
+        setLayoutType(LAYOUT_GPU_DYNAMIC);
+    }
+#endif
     else
     {
         setLayoutType(LAYOUT_DYNAMIC);
@@ -1177,65 +2309,46 @@ void Mycelia::resetLayout(bool watch)
         return;
     }
 
-    // reset layout state
-    g->randomizePositions(100);
-    g->clearVelocities();
+    // reset layout state, a file reopened unchanged is already settled
+    int start = warmStart;
+    warmStart = LAYOUT_CACHE_MISS;
+    dynamicLayout->settle(start == LAYOUT_CACHE_PARTIAL ? warmNodes : vector<int>());
+    warmNodes.clear();
 
-    // In order to avoid a flicker during layout...let's recenter.
-    if (watch)
+    if(start == LAYOUT_CACHE_EXACT)
     {
-        // Note, this will reset the dynamic layout since it calls
-        // resumeLayout(). Fortunately, the call to startLayout() (below)
-        // is smart enough to handle this and not restart the thread.
-        resetNavigationCallback(0);
+        g->clearVelocities();
+        return;
     }
 
-#ifndef __CUDA__
-    // Some layouts will automatically call resetNavigationCallback once
-    // they have finished laying out the graph.
-    startLayout();
-#else
-    // positions
-    float4* positions_h = new float4[size];
-
-    foreach(int node, g->getNodes())
+    if(start == LAYOUT_CACHE_MISS)
     {
-        const Vrui::Point& p = g->getNodePosition(node);
-        float4 q;
-        q.x = p[0];
-        q.y = p[1];
-        q.z = p[2];
-        q.w = g->getNodeDegree(node);
-        positions_h[node] = q;
+        g->randomizePositions(100);
     }
 
-    // adjacency matrix
-    int* adjacencies_h = new int[size * size];
-
-    for(int row = 0; row < size; row++)
+    // the static and multilevel layouts would start over from a random
+    // placement, so a partial match settles just the nodes the cache did not
+    // place, and their neighborhood, in the dynamic layout
+    if(start == LAYOUT_CACHE_PARTIAL)
     {
-        for(int col = 0; col < size; col++)
-        {
-            adjacencies_h[row * size + col] = g->hasEdge(row, col);
-        }
+        setLayoutType(LAYOUT_DYNAMIC);
     }
 
-    // layout
-    gpuLayout(positions_h, adjacencies_h, size);
+    g->clearVelocities();
+    layoutCachePending = !layoutSource.empty() && Vrui::isMaster();
 
-    // update positions
-    foreach(int node, g->getNodes())
+    // In order to avoid a flicker during layout...let's recenter.
+    if (watch)
     {
-        const float4& q = positions_h[node];
-        g->setNodePosition(node, Vrui::Point(q.x, q.y, q.z));
+        // Note, this will reset the dynamic layout since it calls
+        // resumeLayout(). Fortunately, the call to startLayout() (below)
+        // is smart enough to handle this and not restart the thread.
+        resetNavigationCallback(0);
     }
 
-    // free memory
-    delete[] positions_h;
-    delete[] adjacencies_h;
-
-    resetNavigationCallback(0);
-#endif
+    // Some layouts will automatically call resetNavigationCallback once
+    // they have finished laying out the graph.
+    startLayout();
 }
 
 void Mycelia::resetNavigationCallback(Misc::CallbackData* cbData)
@@ -1289,11 +2402,31 @@ void Mycelia::spanningTreeCallback(GLMotif::ToggleButton::ValueChangedCallbackDa
     }
 }
 
+void Mycelia::statsCallback(GLMotif::ToggleButton::ValueChangedCallbackData* cbData)
+{
+    updateStatus();
+
+    if(cbData->set)
+    {
+        statusWindow->show(true);
+        Vrui::scheduleUpdate(Vrui::getApplicationTime() + STATUS_INTERVAL);
+    }
+    else if(statusMessage.empty())
+    {
+        statusWindow->hide();
+    }
+}
+
 void Mycelia::writeGraphCallback(Misc::CallbackData* cbData)
 {
     g->write("data/graphdump.dot");
 }
 
+void Mycelia::writeSnapshotCallback(Misc::CallbackData* cbData)
+{
+    g->writeSnapshot("data/graphdump" SNAPSHOT_EXTENSION);
+}
+
 /*
  * node selection
  */
@@ -1331,8 +2464,27 @@ void Mycelia::setSelectedNode(int node)
 
     shortestPathCallback(0);
     g->update();
+    postEvent("select", node);
+}
+
+void Mycelia::postCommand(GraphCommand* command)
+{
+    command->epoch = g->getEpoch();
+    commands->push(command);
+    Vrui::requestUpdate();
+}
+
+// from any thread, before an edit that must come after the queued ones
+void Mycelia::applyCommands()
+{
+    commands->apply(g);
+}
+
+// tells RPC clients, from another thread
+void Mycelia::postEvent(const std::string& type, int node) const
+{
 #ifdef __RPCSERVER__
-    server->callback(node);
+    if(server) server->postEvent(type, node);
 #endif
 }
 
@@ -1340,8 +2492,14 @@ void Mycelia::setHighlightedNode(int node)
 {
     if (node != highlightedNode)
     {
+        // only the two nodes change color
+        int previous = highlightedNode;
         highlightedNode = node;
-        g->update();
+
+        if(previous != SELECTION_NONE) g->updateNode(previous, CHANGE_MATERIAL);
+        if(node != SELECTION_NONE) g->updateNode(node, CHANGE_MATERIAL);
+
+        postEvent("highlight", node);
     }
 }
 
@@ -1405,65 +2563,38 @@ int Mycelia::selectNode(const Vrui::Ray& ray) const
     // factor.  However, this doesn't seem to be the case because the picking
     // adjusts properly within other zoom levels.
     float coneAngle2 = Math::asin( Math::sqr(nodeRadius) / Geometry::sqr(ray.getOrigin()) );
+
+    // Nodes count when their squared tangent off the ray, y2 / x2 below, is
+    // at most coneAngle2, and of those the one nearest along the ray wins.
+    // The node grid visits cells outward along the ray and stops as soon as
+    // no farther cell can hold a nearer node, see NodeGrid::pickRay.
+    if(isGridCurrent())
+    {
+        int index = nodeGrid.pickRay(gCopy->getPositions(), ray, coneAngle2);
+        return index < 0 ? SELECTION_NONE : gCopy->getIndexNode(index);
+    }
+
     float lambdaMin2 = numeric_limits<float>::max();
+    const vector<Vrui::Point>& positions = gCopy->getPositions();
 
-    foreach(int node, g->getNodes())
+    for(int index = 0; index < (int)positions.size(); index++)
     {
         // vector pointing from origin to node position
-        Vrui::Vector sp = g->getNodePosition(node) - ray.getOrigin();
-        // squared dot product between sp and ray direction
-        float x2 = Math::sqr(sp * ray.getDirection());
-
-        // If the dot product is positive, then the node is in front of the
-        // plane perpendicular to the ray direction.  Thus, the node is
-        // in the general direction of the ray.  Generally, we want to balance
-        // two traits:
-        //
-        //   1) the angle between sp and the ray direction
-        //   2) the distance between the node and the ray origin
-        //
-        // For a fixed angle, minimizing the value of x gives us the nearest
-        // node.  For a fixed value of x, minimizing the angle between sp and
-        // the ray gives the nearest node. However, it is important to remember
-        // that at any fixed value of x and angle, there is an entire circle
-        // of points which are equally near the ray.
-        //
-        // We can think of a ray as an (uncountably) infinite collection of
-        // points.  For argument's sake, consider a finite collection of points
-        // along the ray direction.  For each point, we can find the node
-        // nearest to said point.  A priori, there is no "obvious" choice
-        // for how to choose amongst these nearest points. We must choose
-        // how to define the nearest node.
-
-        // One idea is to start with an initial max distance and then find
-        // points closer to the ray origin such that their angle is smaller
-        // than the angle that the current nearest point made with the ray.
-        // However, this brings in ordering issues. If you happen to find a
-        // really small angle immediately, then you could have another point
-        // with a slightly larger angle that is much closer in distance to the
-        // ray origin---this point would be excluded from being the nearest
-        // node (undesirably).
-        //
-        // However, this seems like an acceptable trade-off given that we are
-        // trying to hack a 3D operation onto a 2D device.  The initial max
-        // angle is the coneAngle2.
-
-        if (x2 >= 0 && x2 < lambdaMin2)
+        Vrui::Vector sp = positions[index] - ray.getOrigin();
+        float x = sp * ray.getDirection();
+
+        // x2 is (a b cos \theta)^2 and y2, the squared norm of the cross
+        // product, (a b sin \theta)^2, so y2 / x2 is (tan \theta)^2, which
+        // increases monotonically over the angles we care about. Only nodes
+        // in front of the plane perpendicular to the ray count.
+        if(x > 0 && x * x < lambdaMin2)
         {
-            // This is the squared norm of cross product between vector from
-            // origin to point and ray direction.  Even more importantly, this
-            // quantity is: (a b sin \theta)^2
             float y2 = Geometry::sqr(Geometry::cross(sp, ray.getDirection()));
 
-            // x2 is (a b cos \theta)^2. Thus, when we divide we get
-            // (tan \theta)^2 which is monotonically increasing over -pi/2 to
-            // pi/2, and thus, over the angles we care about (0 to 90 degrees).
-            // So we can use it for comparisons instead of solving explicitly
-            // for the angle.
-            if (y2 / x2 <= coneAngle2)
+            if(y2 / (x * x) <= coneAngle2)
             {
-                nearest = node;
-                lambdaMin2 = x2;
+                nearest = gCopy->getIndexNode(index);
+                lambdaMin2 = x * x;
             }
         }
     }
@@ -1492,22 +2623,54 @@ int Mycelia::selectNode(Vrui::InputDevice* device) const
 
 std::pair<int, float> Mycelia::nearestNode(const Vrui::Point& clickPosition) const
 {
-    int nearest = SELECTION_NONE;
-    float minDist2 = numeric_limits<float>::max();
+    vector<int> nodes;
+    vector<float> dist2;
+    nearestNodes(clickPosition, 1, nodes, dist2);
 
-    foreach(int node, g->getNodes())
+    if(nodes.empty())
     {
-        float dist2 = Geometry::sqrDist(clickPosition, g->getNodePosition(node));
+        return std::pair<int, float>(SELECTION_NONE, numeric_limits<float>::max());
+    }
+
+    return std::pair<int, float>(nodes[0], dist2[0]);
+}
+
+void Mycelia::nearestNodes(const Vrui::Point& point, int k, vector<int>& nodes, vector<float>& dist2) const
+{
+    nodes.clear();
+    dist2.clear();
+
+    vector<pair<Vrui::Scalar, int> > nearest;
+    const vector<Vrui::Point>& positions = gCopy->getPositions();
 
-        if(dist2 < minDist2)
+    if(isGridCurrent())
+    {
+        nodeGrid.getNearest(positions, point, k, nearest);
+    }
+    else
+    {
+        for(int index = 0; index < (int)positions.size(); index++)
         {
-            nearest = node;
-            minDist2 = dist2;
+            nearest.push_back(make_pair(Geometry::sqrDist(point, positions[index]), index));
         }
+
+        int count = min(k, (int)nearest.size());
+        partial_sort(nearest.begin(), nearest.begin() + count, nearest.end());
+        nearest.resize(count);
+    }
+
+    for(int i = 0; i < (int)nearest.size(); i++)
+    {
+        nodes.push_back(gCopy->getIndexNode(nearest[i].second));
+        dist2.push_back(nearest[i].first);
     }
+}
 
-    std::pair<int, float> result(nearest, minDist2);
-    return result;
+// false until frame() has binned gCopy's current positions
+bool Mycelia::isGridCurrent() const
+{
+    return gridVersion == gCopy->getVersion() && gridPositionVersion == gCopy->getPositionVersion() &&
+           nodeGrid.getNodeCount() == gCopy->getNodeCount();
 }
 
 Vrui::Scalar Mycelia::getArrowWidth() const
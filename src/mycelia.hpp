@@ -20,34 +20,68 @@
 #define __MYCELIA_HPP
 
 #include <precompiled.hpp>
+#include <render/instancedrenderer.hpp>
+#include <render/labelrenderer.hpp>
+#include <render/nodegrid.hpp>
+#include <render/texturecache.hpp>
+#include <stats.hpp>
 
 class ArfLayout;
 class ArfWindow;
 class AttributeWindow;
 class BarabasiGenerator;
+class Centrality;
 class ChacoParser;
+class ClusterSync;
+class CommandQueue;
 class DotParser;
 class Edge;
 class EdgeBundler;
+class EdgeListParser;
+class EdgePairs;
 class ErdosGenerator;
 class FruchtermanReingoldLayout;
 class GmlParser;
+class GpuLayout;
 class Graph;
+class GraphChange;
+class GraphCommand;
 class GraphGenerator;
 class GraphLayout;
 class ImageWindow;
+class LayoutCache;
+class MultilevelLayout;
 class MyceliaDataItem;
 class RpcServer;
 class XmlParser;
+class ViewFrustum;
 class WattsGenerator;
 
 #define LAYOUT_STATIC 0
 #define LAYOUT_DYNAMIC 1
+#define LAYOUT_MULTILEVEL 2
+#define LAYOUT_GPU_STATIC 3 // cpu equivalents are used without cuda
+#define LAYOUT_GPU_DYNAMIC 4
 #define SELECTION_NONE -1
+#define NODE_NONE -1 // node types, NODE_NONE filters out no type
+#define NODE_SHAPE 0
+#define NODE_IMAGE 1
 #define FONT_SIZE 96.0
 #define FONT_MODIFIER 0.04
 #define foreach BOOST_FOREACH
 #define PYTHON "/usr/bin/python"
+#define STATUS_INTERVAL 0.5 // seconds between layout energy refreshes
+#define STATUS_ROWS 12
+#define DETAIL_FULL 0 // doubles as the instanced renderer's mesh level
+#define DETAIL_LOW 1
+#define DETAIL_FAR 2 // unlit points and lines
+#define DETAIL_LOW_SIZE 0.01 // projected node radius over distance, see etc/mycelia.cfg
+#define DETAIL_FAR_SIZE 0.002
+#define DETAIL_UPDATE_FRACTION 0.1
+#define DETAIL_POINT_SIZE 3.0
+#define BUNDLE_LINE_WIDTH 2.0 // pixels, bundled edges are drawn as lines
+#define RPC_CONNECTIONS 16 // served at once, see etc/mycelia.cfg
+#define DIRTY_RANGE_GAP 8 // clean instances re-sent rather than splitting an upload
 
 class Mycelia : public Vrui::Application, public GLObject
 {
@@ -59,13 +93,52 @@ private:
     Vrui::Scalar edgeThickness;
     Vrui::Scalar edgeOffset;
 
+    // level of detail
+    bool detailEnabled;
+    Vrui::Scalar lowDetailSize;
+    Vrui::Scalar farDetailSize;
+    Vrui::Scalar detailUpdateFraction; // of the low detail distance the viewer may move
+    float detailPointSize;
+
+    // view culling over the rendered positions
+    bool cullingEnabled;
+    NodeGrid nodeGrid;
+    int gridVersion;
+    int gridPositionVersion;
+
+    // image node textures
+    int textureMegabytes;
+    int textureMaxSize;
+    bool textureMipmaps;
+    int textureUploads;
+
+    // label culling
+    double labelMinPixels;
+    int labelCellPixels;
+    int labelCellCapacity;
+
+    // layout steps published to the renderer per second
+    double publishRate;
+
     // layout and bundling
     FruchtermanReingoldLayout* staticLayout;
     ArfLayout* dynamicLayout;
+    MultilevelLayout* multilevelLayout;
+#ifdef __CUDA__
+    GpuLayout* gpuStaticLayout;
+    GpuLayout* gpuDynamicLayout;
+#endif
     GraphLayout* layout;
     EdgeBundler* edgeBundler;
     bool skipLayout;
 
+    // settled positions of opened files, see LayoutCache
+    LayoutCache* layoutCache;
+    std::string layoutSource; // file g was opened from, empty otherwise
+    int warmStart; // LAYOUT_CACHE_* of the last open, used once by resetLayout
+    std::vector<int> warmNodes; // nodes the cache had no position for
+    bool layoutCachePending; // save once the layout settles
+
     // gui
     GLMotif::Menu* mainMenu;
     GLMotif::PopupMenu* mainMenuPopup;
@@ -80,13 +153,21 @@ private:
     GLMotif::RadioBox* layoutRadioBox;
     GLMotif::ToggleButton* staticButton;
     GLMotif::ToggleButton* dynamicButton;
+    GLMotif::ToggleButton* multilevelButton;
+#ifdef __CUDA__
+    GLMotif::ToggleButton* gpuStaticButton;
+    GLMotif::ToggleButton* gpuDynamicButton;
+#endif
+    GLMotif::ToggleButton* barnesHutButton;
 
     // gui -- render options
     GLMotif::ToggleButton* bundleButton;
+    GLMotif::ToggleButton* instancedButton;
     GLMotif::ToggleButton* nodeInfoButton;
     GLMotif::ToggleButton* nodeLabelButton;
     GLMotif::ToggleButton* edgeLabelButton;
     GLMotif::ToggleButton* componentButton;
+    GLMotif::ToggleButton* statsButton;
 
     // gui -- algorithms
     GLMotif::ToggleButton* spanningTreeButton;
@@ -104,9 +185,16 @@ private:
     ArfWindow* layoutWindow;
     ImageWindow* imageWindow;
     AttributeWindow* statusWindow;
+    std::string statusMessage;
+    std::string statusEnergy; // last layout energy shown, refreshed from frame()
+    double lastStatusTime;
 
     // algorithms
     std::vector<int> predecessorVector;
+    Centrality* centrality;
+    int centralitySamples; // sources sampled from the menu, CENTRALITY_EXACT for all
+    bool centralityPlotPending; // show bc.py once the centrality run finishes
+    std::string statusCentrality; // progress shown, refreshed from frame()
 
     // generators
     GraphGenerator* generator;
@@ -117,6 +205,7 @@ private:
     // parsers
     ChacoParser* chacoParser;
     DotParser* dotParser;
+    EdgeListParser* edgeListParser;
     GmlParser* gmlParser;
     XmlParser* xmlParser;
 
@@ -137,6 +226,14 @@ private:
 #ifdef __RPCSERVER__
     RpcServer* server;
 #endif
+    int rpcConnections;
+
+    // setter calls from RPC threads, applied to g at the start of a frame
+    CommandQueue* commands;
+
+    // 0 unless on a cluster, where only the master lays out and serves RPC
+    // and slaves receive its graph
+    ClusterSync* cluster;
 
 public:
     Mycelia(int, char**, char**);
@@ -144,32 +241,56 @@ public:
 
     // graph functions
     void buildGraphList(MyceliaDataItem*) const;
+    void buildInstances(MyceliaDataItem*) const;
+    bool updateInstances(MyceliaDataItem*, const std::vector<GraphChange>&) const;
+    void getVisibleInstances(const MyceliaDataItem*, const ViewFrustum&, InstancedRenderer::Ranges&) const;
+    int getNodeInstance(int, MyceliaDataItem*, InstancedRenderer::NodeInstance&, InstancedRenderer::PointVertex&) const;
+    bool getEdgePairInstances(const EdgePairs&, int, int, MyceliaDataItem*,
+                              std::vector<InstancedRenderer::SegmentInstance>&,
+                              std::vector<InstancedRenderer::PointVertex>&) const;
+    void buildShapeLists(MyceliaDataItem*) const;
+    void copyGraph();
     void drawEdge(const Edge&, MyceliaDataItem*) const;
     void drawEdge(const Vrui::Point&, const Vrui::Point&,
                   const GLMaterial*, const Vrui::Scalar, bool, bool,
                   MyceliaDataItem*,
-                  double sourceEdgeOffset=0, double targetEdgeOffset=0) const;
+                  double sourceEdgeOffset=0, double targetEdgeOffset=0,
+                  int detail=DETAIL_FULL) const;
+    void drawEdgePair(const EdgePairs&, int, MyceliaDataItem*, int detail=DETAIL_FULL) const;
     void drawEdges(MyceliaDataItem*) const;
-    void drawEdgeLabels(MyceliaDataItem*) const;
+    void addEdgeLabels(LabelRenderer*) const;
     void drawLogo(MyceliaDataItem*) const;
     void drawNode(int, MyceliaDataItem*) const;
     bool drawShapeNode(int, MyceliaDataItem*) const;
     bool drawTextureNode(int, MyceliaDataItem*) const;
-    void drawNodes(MyceliaDataItem*, std::string filter="none") const;
-    void drawNodeLabels(MyceliaDataItem*) const;
+    void drawNodes(MyceliaDataItem*, int filter=NODE_NONE) const;
+    void drawFarEdges(const EdgePairs&, const std::vector<int>&) const;
+    void drawFarNodes(const std::vector<int>&) const;
+    void addNodeLabels(LabelRenderer*) const;
+    void drawLabels(MyceliaDataItem*) const;
     void drawShortestPath(MyceliaDataItem*) const;
     void drawSpanningTree(MyceliaDataItem*) const;
     void fileOpen(std::string &filename);
     double getNodeEdgeOffset(int node, MyceliaDataItem*) const;
+    const GLMaterial* getShapeNodeMaterial(int) const;
+    int getDetail(const Vrui::Point&, Vrui::Scalar, const MyceliaDataItem*) const;
+    int getEdgePairDetail(const EdgePairs&, int, const MyceliaDataItem*) const;
+    Vrui::Rotation getLabelRotation() const;
+    void loadConfiguration();
+    bool isGridCurrent() const;
     bool isSelectedComponent(int) const;
+    const std::vector<int>* getSelectedComponent(Graph*) const; // 0 when every node is shown
+    void plotCentrality();
+    void runPlugin(const std::string&, const std::vector<double>& values=std::vector<double>());
 
     // layout functions
     void resetLayout(bool watch=true);
     void resumeLayout() const;
-    void setLayoutType(int);
+    void setLayoutType(int, double theta=-1); // theta < 0 keeps the current opening angle
     void setSkipLayout(bool);
     void startLayout() const;
     void stopLayout() const;
+    void wakeLayout() const;
     bool layoutIsStopped() const;
 
     // vrui functions
@@ -178,6 +299,7 @@ public:
     void initContext(GLContextData&) const;
 
     // callbacks
+    void barnesHutCallback(GLMotif::ToggleButton::ValueChangedCallbackData*);
     void bundleCallback(GLMotif::ToggleButton::ValueChangedCallbackData*);
     void clearCallback(Misc::CallbackData*);
     void componentCallback(GLMotif::ToggleButton::ValueChangedCallbackData*);
@@ -193,7 +315,9 @@ public:
     void resetNavigationCallback(Misc::CallbackData* cbData);
     void shortestPathCallback(GLMotif::ToggleButton::ValueChangedCallbackData*);
     void spanningTreeCallback(GLMotif::ToggleButton::ValueChangedCallbackData*);
+    void statsCallback(GLMotif::ToggleButton::ValueChangedCallbackData*);
     void writeGraphCallback(Misc::CallbackData*);
+    void writeSnapshotCallback(Misc::CallbackData*);
 
     // node selection
     void clearSelections();
@@ -202,6 +326,12 @@ public:
     void setSelectedNode(int);
     void setHighlightedNode(int);
 
+    // "select", "highlight", "drag", "drop" and "layout_converged" of a node,
+    // or -1, are sent to RPC clients asynchronously
+    void postEvent(const std::string&, int) const;
+    void postCommand(GraphCommand*); // from any thread, applied by the next frame
+    void applyCommands(); // from any thread
+
     // Returns nearest node within one standard node radius.
     int selectNode(const Vrui::Point&) const;
 
@@ -213,10 +343,14 @@ public:
     // device is used to find the nearest node within some fixed cone angle.
     int selectNode(Vrui::InputDevice*) const;
 
-    // Returns nearest node and its squared distance from the point.
-    // Importantly, the returned node is never equal to SELECTION_NONE.
+    // Returns nearest node and its squared distance from the point, or
+    // SELECTION_NONE without nodes.
     std::pair<int, float> nearestNode(const Vrui::Point&) const;
 
+    // The k nearest nodes to the point, nearest first, with their squared
+    // distances. Picking is against gCopy, as drawn, through the node grid.
+    void nearestNodes(const Vrui::Point&, int, std::vector<int>&, std::vector<float>&) const;
+
     // arrowhead
     Vrui::Scalar getArrowWidth() const;
     Vrui::Scalar getArrowHeight() const;
@@ -225,9 +359,14 @@ public:
     // other
     Graph* g; // wrap this eventually
     Graph* gCopy;
+    mutable Stats stats; // hot path counts and timings, from any thread
+    const NodeGrid& getNodeGrid() const { return nodeGrid; } // over gCopy's dense positions
     GLMotif::PopupMenu* getMainMenuPopup() { return mainMenuPopup; }
     ArfLayout* getDynamicLayout() { return dynamicLayout; }
-    void setStatus(const char*) const;
+    Centrality* getCentrality() { return centrality; }
+    FruchtermanReingoldLayout* getStaticLayout() { return staticLayout; }
+    void setStatus(const char*);
+    void updateStatus();
 };
 
 #endif
@@ -18,44 +18,159 @@
 
 #include <parsers/chacoparser.hpp>
 
+#include <cstring>
+
 using namespace std;
 
 ChacoParser::ChacoParser(Mycelia* application)
-    : application(application)
+    : application(application),
+      vertexNumbers(false),
+      vertexWeights(0),
+      edgeWeights(false)
+{
+}
+
+void ChacoParser::run(int worker, int begin, int end)
 {
+    for(int chunk = begin; chunk < end; chunk++)
+    {
+        const char* p = chunks[chunk];
+        const char* chunkEnd = chunks[chunk + 1];
+        vector<int>& pairs = endpoints[chunk];
+        int line = 0;
+        
+        while(p < chunkEnd)
+        {
+            const char* eol = (const char*)memchr(p, '\n', chunkEnd - p);
+            const char* lineEnd = eol ? eol : chunkEnd;
+            
+            if(*p != '%')
+            {
+                double value;
+                int source = line;
+                
+                if(vertexNumbers && (p = VruiHelp::readNumber(p, lineEnd, value)) != 0)
+                {
+                    source = (int)value - 1;
+                }
+                
+                for(int i = 0; p && i < vertexWeights; i++)
+                {
+                    p = VruiHelp::readNumber(p, lineEnd, value);
+                }
+                
+                while(p && (p = VruiHelp::readNumber(p, lineEnd, value)) != 0)
+                {
+                    pairs.push_back(source);
+                    pairs.push_back((int)value - 1);
+                    
+                    if(edgeWeights)
+                    {
+                        p = VruiHelp::readNumber(p, lineEnd, value);
+                        weights[chunk].push_back(p ? value : 1.0);
+                    }
+                }
+                
+                line++;
+            }
+            
+            p = lineEnd + 1;
+        }
+        
+        lineCounts[chunk] = line;
+    }
 }
 
 void ChacoParser::parse(string& filename)
 {
-    ifstream in(filename.c_str());
-    int nodeCount;
-    int edgeCount;
+    VruiHelp::MappedFile file(filename);
+    const char* p = file.begin();
+    const char* end = file.end();
+    
+    // header, after any comment lines
+    while(p < end && *p == '%')
+    {
+        const char* eol = (const char*)memchr(p, '\n', end - p);
+        p = eol ? eol + 1 : end;
+    }
+    
+    const char* eol = p < end ? (const char*)memchr(p, '\n', end - p) : 0;
+    const char* headerEnd = eol ? eol : end;
+    double header[4] = {0, 0, 0, 1};
     
-    in >> nodeCount >> edgeCount;
+    for(int i = 0; i < 4 && p; i++)
+    {
+        p = VruiHelp::readNumber(p, headerEnd, header[i]);
+    }
+    
+    int nodeCount = (int)header[0];
+    int edgeCount = (int)header[1];
+    int format = (int)header[2];
+    vertexNumbers = format / 100 % 10;
+    vertexWeights = format / 10 % 10 ? max((int)header[3], 1) : 0;
+    edgeWeights = format % 10;
     cout << nodeCount << " nodes, " << edgeCount << " edges" << endl;
     
-    for(int i = 0; i < nodeCount; i++)
+    if(nodeCount <= 0)
     {
-        application->g->addNode();
+        return;
     }
     
-    int sourceNode = 0;
+    WorkerPool pool;
+    int chunkCount = 4 * pool.getThreadCount();
+    VruiHelp::splitLines(min(headerEnd + 1, end), end, chunkCount, chunks);
+    lineCounts.assign(chunkCount, 0);
+    endpoints.assign(chunkCount, vector<int>());
+    weights.assign(chunkCount, vector<double>());
+    pool.run(this, chunkCount);
+    
+    // every neighbor is listed from both sides, so edges come in pairs
+    Graph* g = application->g;
+    g->reserve(nodeCount, 2 * edgeCount);
+    int firstNode = g->addNodes(nodeCount);
     
-    while(!in.eof())
+    vector<int> pairs;
+    vector<double> pairWeights;
+    pairs.reserve(4 * (size_t)edgeCount);
+    int line = 0;
+    int skipped = 0;
+    
+    for(int chunk = 0; chunk < chunkCount; chunk++)
     {
-        char line[256];
-        in.getline(line, 256);
-        
-        stringstream stream(line);
-        int targetNode;
+        int offset = vertexNumbers ? 0 : line;
         
-        while(stream >> targetNode) // only works because space is delimiter
+        for(int i = 0; i < (int)endpoints[chunk].size(); i += 2)
         {
-            application->g->addEdge(sourceNode, targetNode);
+            int source = endpoints[chunk][i] + offset;
+            int target = endpoints[chunk][i + 1];
+            
+            if(source < 0 || source >= nodeCount || target < 0 || target >= nodeCount)
+            {
+                skipped++;
+                continue;
+            }
+            
+            pairs.push_back(firstNode + source);
+            pairs.push_back(firstNode + target);
+            if(edgeWeights) pairWeights.push_back(weights[chunk][i / 2]);
         }
         
-        sourceNode++;
+        line += lineCounts[chunk];
+        vector<int>().swap(endpoints[chunk]);
+    }
+    
+    if(line != nodeCount || skipped > 0)
+    {
+        cout << filename << ": " << line << " node lines, " << skipped << " neighbors out of range" << endl;
     }
     
-    in.close();
-}
\ No newline at end of file
+    vector<int> edges;
+    g->addEdges(pairs, edges);
+    
+    if(edgeWeights)
+    {
+        g->setEdgeWeights(edges, pairWeights);
+    }
+    
+    weights.clear();
+}
@@ -20,17 +20,37 @@
 #define __CHACOPARSER_HPP
 
 #include <graph.hpp>
+#include <layout/workerpool.hpp>
 #include <mycelia.hpp>
 
-class ChacoParser
+/*
+ * Reads Chaco graph files: a header of node count, edge count and optional
+ * format and weight count, then one line of 1-based neighbors per node.
+ * The mapped file is split into chunks at line boundaries that are parsed
+ * in parallel; nodes and edges are then added in bulk, in file order.
+ */
+class ChacoParser : public WorkerTask
 {
 private:
     Mycelia* application;
     
+    // format read from the header
+    bool vertexNumbers; // lines start with their vertex number
+    int vertexWeights; // weights after the vertex number, skipped
+    bool edgeWeights; // every neighbor is followed by its edge weight
+    
+    // by chunk: node lines seen, (source, neighbor) pairs with sources
+    // counted from the chunk's first line unless given, and edge weights
+    std::vector<const char*> chunks;
+    std::vector<int> lineCounts;
+    std::vector<std::vector<int> > endpoints;
+    std::vector<std::vector<double> > weights;
+    
 public:
     ChacoParser(Mycelia*);
     
     void parse(std::string&);
+    void run(int, int, int);
 };
 
 #endif
@@ -18,101 +18,567 @@
 
 #include <parsers/dotparser.hpp>
 
+#include <cstring>
+#include <strings.h>
+
 using namespace std;
-using namespace boost;
 
 DotParser::DotParser(Mycelia* application)
-    : application(application)
+    : application(application),
+      p(0),
+      end(0),
+      tokenType(DOT_END)
 {
 }
 
-void DotParser::parse(string& filename)
+/*
+ * Reads "#rrggbb", "#rrggbbaa", "h,s,v" or "h s v" in [0, 1], or one of the
+ * common color names into rgba. Only the first color of a color list counts.
+ */
+static bool parseColor(const string& value, double* rgba)
 {
-    string nodeString = "\\s*\"?([\\w\\d]+)\"?\\s*";
-    string toString = "-[-|>]";
-    string filterString = "[^-{};]*";
-    string eolString = ";";
-    string floatString = "([\\d\\.\\-]+)";
-    const basic_regex<char> edgeRegex("^" + nodeString + toString + nodeString + filterString + eolString);
-    const basic_regex<char> nodeRegex("^" + nodeString + filterString + eolString);
-    const basic_regex<char> positionRegex("pos=\"" + floatString + "," + floatString + "," + floatString + "\"");
-    const basic_regex<char> labelRegex("label=\"([^\"]+)\"");
-    
-    string fileBuffer = VruiHelp::fileToString(filename);
-    string::const_iterator lineStart;
-    string::const_iterator lineEnd;
-    smatch lineMatches;
-    smatch positionMatches;
-    smatch labelMatches;
-    nodeMap.clear();
+    string color = value.substr(0, value.find(':'));
+    rgba[3] = 1.0;
+    
+    if(color.size() >= 7 && color[0] == '#')
+    {
+        unsigned int c[4] = {0, 0, 0, 255};
+        int n = sscanf(color.c_str() + 1, "%2x%2x%2x%2x", &c[0], &c[1], &c[2], &c[3]);
+        for(int i = 0; i < 4; i++) rgba[i] = c[i] / 255.0;
+        return n >= 3;
+    }
+    
+    double h, s, v;
+    if(sscanf(color.c_str(), "%lf%*[, ]%lf%*[, ]%lf", &h, &s, &v) == 3)
+    {
+        h = 6.0 * (h - floor(h));
+        int sector = min((int)h, 5);
+        double f = h - sector;
+        double values[4] = {v, v * (1 - s), v * (1 - s * f), v * (1 - s * (1 - f))};
+        static const int rgbs[6][3] = {{0, 3, 1}, {2, 0, 1}, {1, 0, 3}, {1, 2, 0}, {3, 1, 0}, {0, 1, 2}};
+        for(int i = 0; i < 3; i++) rgba[i] = values[rgbs[sector][i]];
+        return true;
+    }
+    
+    static const struct { const char* name; double r, g, b; } names[] = {
+        {"black", 0, 0, 0}, {"white", 1, 1, 1}, {"red", 1, 0, 0},
+        {"green", 0, 1, 0}, {"blue", 0, 0, 1}, {"yellow", 1, 1, 0},
+        {"cyan", 0, 1, 1}, {"magenta", 1, 0, 1}, {"gray", 0.75, 0.75, 0.75},
+        {"grey", 0.75, 0.75, 0.75}, {"orange", 1, 0.65, 0}, {"purple", 0.63, 0.13, 0.94}
+    };
+    
+    for(int i = 0; i < (int)(sizeof(names) / sizeof(names[0])); i++)
+    {
+        if(strcasecmp(color.c_str(), names[i].name) == 0)
+        {
+            rgba[0] = names[i].r;
+            rgba[1] = names[i].g;
+            rgba[2] = names[i].b;
+            return true;
+        }
+    }
+    
+    return false;
+}
+
+bool DotParser::isPunct(char c) const
+{
+    return c != '\0' && strchr("{}[];,=:", c) != 0;
+}
+
+bool DotParser::isKeyword(const char* keyword) const
+{
+    return tokenType == DOT_ID && strcasecmp(token.c_str(), keyword) == 0;
+}
+
+/*
+ * Reads the next token into token and tokenType, skipping whitespace and
+ * comments. Quoted strings lose their quotes and escaped quotes, and are
+ * joined across '+'; html strings lose their outer angle brackets.
+ */
+int DotParser::next()
+{
+    token.clear();
     
-    // nodes
-    lineStart = fileBuffer.begin();
-    lineEnd = fileBuffer.end();
+    while(p < end)
+    {
+        if(isspace((unsigned char)*p))
+        {
+            p++;
+        }
+        else if(*p == '#' || (*p == '/' && p + 1 < end && p[1] == '/'))
+        {
+            const char* eol = (const char*)memchr(p, '\n', end - p);
+            p = eol ? eol : end;
+        }
+        else if(*p == '/' && p + 1 < end && p[1] == '*')
+        {
+            for(p += 2; p + 1 < end && !(p[0] == '*' && p[1] == '/'); p++);
+            p = min(p + 2, end);
+        }
+        else
+        {
+            break;
+        }
+    }
+    
+    if(p == end)
+    {
+        return tokenType = DOT_END;
+    }
+    
+    char c = *p;
+    
+    if(c == '"')
+    {
+        for(;;)
+        {
+            for(p++; p < end && *p != '"'; p++)
+            {
+                if(*p == '\\' && p + 1 < end && (p[1] == '"' || p[1] == '\n'))
+                {
+                    if(*++p == '"') token += '"';
+                }
+                else
+                {
+                    token += *p;
+                }
+            }
+            
+            if(p < end) p++;
+            
+            // "a" + "b" continues the string
+            const char* q = p;
+            while(q < end && isspace((unsigned char)*q)) q++;
+            if(q < end && *q == '+')
+            {
+                for(q++; q < end && isspace((unsigned char)*q); q++);
+                if(q < end && *q == '"')
+                {
+                    p = q;
+                    continue;
+                }
+            }
+            
+            break;
+        }
+        
+        return tokenType = DOT_STRING;
+    }
     
-    while(regex_search(lineStart, lineEnd, lineMatches, nodeRegex))
+    if(c == '<')
     {
-        string nodeId(lineMatches[1].first,  lineMatches[1].second);
-        nodeMap[nodeId] = application->g->addNode();
+        int depth = 0;
+        const char* start = p + 1;
         
-        string::const_iterator posStart = lineMatches[1].second; // end of node name
-        string::const_iterator posEnd = lineMatches[0].second;; // end of line
+        for(; p < end; p++)
+        {
+            if(*p == '<') depth++;
+            else if(*p == '>' && --depth == 0) break;
+        }
+        
+        token.assign(start, p);
+        if(p < end) p++;
+        return tokenType = DOT_STRING;
+    }
+    
+    if(c == '-' && p + 1 < end && (p[1] == '>' || p[1] == '-'))
+    {
+        token.assign(p, p + 2);
+        p += 2;
+        return tokenType = DOT_EDGEOP;
+    }
+    
+    if(isPunct(c))
+    {
+        token = c;
+        p++;
+        return tokenType = DOT_PUNCT;
+    }
+    
+    const char* start = p;
+    
+    while(p < end && !isspace((unsigned char)*p) && !isPunct(*p) && *p != '"' && *p != '<'
+          && !(*p == '-' && p > start && p + 1 < end && (p[1] == '>' || p[1] == '-')))
+    {
+        p++;
+    }
+    
+    token.assign(start, p == start ? ++p : p); // a stray character on its own
+    return tokenType = DOT_ID;
+}
+
+// reads [key=value, ...] lists, repeated lists included, into attributes
+void DotParser::readAttributes(Attributes& attributes)
+{
+    while(tokenType == DOT_PUNCT && token[0] == '[')
+    {
+        next();
         
-        if(regex_search(posStart, posEnd, positionMatches, positionRegex))
+        while(tokenType != DOT_END && !(tokenType == DOT_PUNCT && token[0] == ']'))
         {
-            string sx(positionMatches[1].first, positionMatches[1].second);
-            string sy(positionMatches[2].first, positionMatches[2].second);
-            string sz(positionMatches[3].first, positionMatches[3].second);
+            if(tokenType != DOT_ID && tokenType != DOT_STRING)
+            {
+                next();
+                continue;
+            }
             
-            float x = VruiHelp::stringToFloat(sx);
-            float y = VruiHelp::stringToFloat(sy);
-            float z = VruiHelp::stringToFloat(sz);
+            string key = token;
             
-            application->g->setNodePosition(nodeMap[nodeId], Vrui::Point(x, y, z));
-            application->setSkipLayout(true);
+            if(next() == DOT_PUNCT && token[0] == '=')
+            {
+                next();
+                attributes.push_back(make_pair(key, token));
+                next();
+            }
         }
         
-        string::const_iterator labelStart = lineMatches[1].second; // end of node name
-        string::const_iterator labelEnd = lineMatches[0].second;; // end of line
+        next();
+    }
+}
+
+// reads an edge operand, a node id with an optional port or a braced list of them
+void DotParser::readNodeIds(vector<int>& nodes)
+{
+    if(isKeyword("subgraph"))
+    {
+        if(next() != DOT_PUNCT) next();
+    }
+    
+    if(tokenType == DOT_PUNCT && token[0] == '{')
+    {
+        next();
         
-        if(regex_search(labelStart, labelEnd, labelMatches, labelRegex))
+        while(tokenType != DOT_END && !(tokenType == DOT_PUNCT && token[0] == '}'))
         {
-            string label(labelMatches[1].first, labelMatches[1].second);
-            application->g->setNodeLabel(nodeMap[nodeId], label);
+            if(tokenType == DOT_ID || tokenType == DOT_STRING)
+            {
+                string name = token;
+                
+                if(next() == DOT_PUNCT && token[0] == '=')
+                {
+                    next();
+                    next();
+                    continue;
+                }
+                
+                nodes.push_back(intern(name));
+            }
+            else if(tokenType == DOT_PUNCT && token[0] == '[')
+            {
+                Attributes ignored;
+                readAttributes(ignored);
+            }
+            else
+            {
+                next();
+            }
         }
         
-        lineStart = lineMatches[0].second;
+        next();
+    }
+    else if(tokenType == DOT_ID || tokenType == DOT_STRING)
+    {
+        nodes.push_back(intern(token));
+        next();
     }
     
-    // edges
-    lineStart = fileBuffer.begin();
-    lineEnd = fileBuffer.end();
+    while(tokenType == DOT_PUNCT && token[0] == ':')
+    {
+        next();
+        next();
+    }
+}
+
+void DotParser::readStatement()
+{
+    if(tokenType == DOT_PUNCT && token[0] == '{')
+    {
+        nodeDefaults.push_back(nodeDefaults.back());
+        edgeDefaults.push_back(edgeDefaults.back());
+        next();
+        return;
+    }
     
-    while(regex_search(lineStart, lineEnd, lineMatches, edgeRegex))
+    if(tokenType == DOT_PUNCT && token[0] == '}')
     {
-        string source(lineMatches[1].first, lineMatches[1].second);
-        string target(lineMatches[2].first, lineMatches[2].second);
-        
-        if(nodeMap.find(source) == nodeMap.end())
+        if(nodeDefaults.size() > 1)
         {
-            nodeMap[source] = application->g->addNode(source);
+            nodeDefaults.pop_back();
+            edgeDefaults.pop_back();
         }
         
-        if(nodeMap.find(target) == nodeMap.end())
+        next();
+        return;
+    }
+    
+    if(isKeyword("subgraph"))
+    {
+        if(next() == DOT_ID || tokenType == DOT_STRING) next();
+        return;
+    }
+    
+    if(isKeyword("node") || isKeyword("edge") || isKeyword("graph"))
+    {
+        char kind = tolower(token[0]);
+        Attributes attributes;
+        next();
+        readAttributes(attributes);
+        
+        if(kind == 'n') nodeDefaults.back().insert(nodeDefaults.back().end(), attributes.begin(), attributes.end());
+        if(kind == 'e') edgeDefaults.back().insert(edgeDefaults.back().end(), attributes.begin(), attributes.end());
+        return;
+    }
+    
+    if(tokenType != DOT_ID && tokenType != DOT_STRING)
+    {
+        next();
+        return;
+    }
+    
+    // graph attribute
+    const char* start = p;
+    int type = tokenType;
+    string name = token;
+    
+    if(next() == DOT_PUNCT && token[0] == '=')
+    {
+        next();
+        next();
+        return;
+    }
+    
+    // node statement or edge chain, the first node interned as it appeared
+    p = start;
+    tokenType = type;
+    token = name;
+    
+    vector<int> previous;
+    readNodeIds(previous);
+    
+    vector<int> edges;
+    bool isEdge = tokenType == DOT_EDGEOP;
+    
+    if(!isEdge)
+    {
+        declared[previous[0]] = true;
+    }
+    
+    while(tokenType == DOT_EDGEOP)
+    {
+        next();
+        vector<int> current;
+        readNodeIds(current);
+        
+        for(int i = 0; i < (int)previous.size(); i++)
         {
-            nodeMap[target] = application->g->addNode(target);
+            for(int j = 0; j < (int)current.size(); j++)
+            {
+                edges.push_back(endpoints.size() / 2);
+                endpoints.push_back(previous[i]);
+                endpoints.push_back(current[j]);
+            }
         }
         
-        int edgeId = application->g->addEdge(nodeMap[source], nodeMap[target]);
-        string::const_iterator labelStart = lineMatches[1].second; // end of transition
-        string::const_iterator labelEnd = lineMatches[0].second;; // end of line
+        previous.swap(current);
+    }
+    
+    Attributes attributes;
+    readAttributes(attributes);
+    
+    if(!isEdge)
+    {
+        setNodeAttributes(previous[0], attributes);
+    }
+    
+    for(int i = 0; i < (int)edges.size(); i++)
+    {
+        setEdgeAttributes(edges[i], edgeDefaults.back());
+        setEdgeAttributes(edges[i], attributes);
+    }
+}
+
+// index of the named node, new nodes taking the current node defaults
+int DotParser::intern(const string& name)
+{
+    tr1::unordered_map<string, int>::iterator it = nodeMap.find(name);
+    
+    if(it != nodeMap.end())
+    {
+        return it->second;
+    }
+    
+    int node = declared.size();
+    nodeMap[name] = node;
+    declared.push_back(false);
+    setNodeAttributes(node, nodeDefaults.back());
+    
+    return node;
+}
+
+void DotParser::setNodeAttributes(int node, const Attributes& attributes)
+{
+    for(int i = 0; i < (int)attributes.size(); i++)
+    {
+        const string& key = attributes[i].first;
+        const string& value = attributes[i].second;
         
-        if(regex_search(labelStart, labelEnd, labelMatches, labelRegex))
+        if(key == "pos")
+        {
+            // x,y[,z] with an optional trailing '!'
+            const char* s = value.c_str();
+            char* q;
+            double xyz[3] = {0, 0, 0};
+            int n = 0;
+            
+            for(; n < 3; n++)
+            {
+                xyz[n] = strtod(s, &q);
+                if(q == s) break;
+                s = *q == ',' ? q + 1 : q;
+            }
+            
+            if(n >= 2)
+            {
+                positionNodes.push_back(node);
+                positions.insert(positions.end(), xyz, xyz + 3);
+            }
+        }
+        else if(key == "label")
+        {
+            labelNodes.push_back(node);
+            labels.push_back(value);
+        }
+        else if(key == "color")
         {
-            string label(labelMatches[1].first, labelMatches[1].second);
-            application->g->setEdgeLabel(edgeId, label);
+            double rgba[4];
+            
+            if(parseColor(value, rgba))
+            {
+                colorNodes.push_back(node);
+                colors.insert(colors.end(), rgba, rgba + 4);
+            }
         }
+    }
+}
+
+void DotParser::setEdgeAttributes(int edge, const Attributes& attributes)
+{
+    for(int i = 0; i < (int)attributes.size(); i++)
+    {
+        const string& key = attributes[i].first;
+        const string& value = attributes[i].second;
         
-        lineStart = lineMatches[0].second;
+        if(key == "label")
+        {
+            labelEdges.push_back(edge);
+            edgeLabels.push_back(value);
+        }
+        else if(key == "color")
+        {
+            double rgba[4];
+            
+            if(parseColor(value, rgba))
+            {
+                colorEdges.push_back(edge);
+                edgeColors.insert(edgeColors.end(), rgba, rgba + 4);
+            }
+        }
+        else if(key == "weight")
+        {
+            weightEdges.push_back(edge);
+            weights.push_back(strtod(value.c_str(), 0));
+        }
+    }
+}
+
+void DotParser::parse(string& filename)
+{
+    VruiHelp::MappedFile file(filename);
+    p = file.begin();
+    end = file.end();
+    
+    // room for about a node per line before the table rehashes
+    int lines = 1;
+    for(const char* q = p; q < end && (q = (const char*)memchr(q, '\n', end - q)) != 0; q++)
+    {
+        lines++;
+    }
+    
+    nodeMap.clear();
+    nodeMap.rehash(lines);
+    nodeDefaults.assign(1, Attributes());
+    edgeDefaults.assign(1, Attributes());
+    declared.clear();
+    positionNodes.clear();
+    positions.clear();
+    labelNodes.clear();
+    labels.clear();
+    colorNodes.clear();
+    colors.clear();
+    endpoints.clear();
+    labelEdges.clear();
+    edgeLabels.clear();
+    colorEdges.clear();
+    edgeColors.clear();
+    weightEdges.clear();
+    weights.clear();
+    
+    // [strict] (graph|digraph) [name] {
+    while(next() != DOT_END && !(tokenType == DOT_PUNCT && token[0] == '{'));
+    next();
+    
+    while(tokenType != DOT_END)
+    {
+        readStatement();
+    }
+    
+    // nodes only seen as edge endpoints are labelled with their names
+    vector<string> names(nodeMap.size());
+    for(tr1::unordered_map<string, int>::iterator it = nodeMap.begin(); it != nodeMap.end(); ++it)
+    {
+        names[it->second] = it->first;
     }
-}
\ No newline at end of file
+    
+    Graph* g = application->g;
+    int firstNode = g->addNodes(declared.size());
+    vector<int> nameNodes;
+    vector<string> nameLabels;
+    
+    for(int i = 0; i < (int)declared.size(); i++)
+    {
+        if(!declared[i])
+        {
+            nameNodes.push_back(firstNode + i);
+            nameLabels.push_back(names[i]);
+        }
+    }
+    
+    g->setNodeLabels(nameNodes, nameLabels);
+    
+    for(int i = 0; i < (int)positionNodes.size(); i++) positionNodes[i] += firstNode;
+    for(int i = 0; i < (int)labelNodes.size(); i++) labelNodes[i] += firstNode;
+    for(int i = 0; i < (int)colorNodes.size(); i++) colorNodes[i] += firstNode;
+    for(int i = 0; i < (int)endpoints.size(); i++) endpoints[i] += firstNode;
+    
+    g->setNodePositions(positionNodes, positions);
+    g->setNodeLabels(labelNodes, labels);
+    g->setNodeColors(colorNodes, colors);
+    
+    if(!positionNodes.empty())
+    {
+        application->setSkipLayout(true);
+    }
+    
+    // edges, then their attributes by edge number
+    vector<int> edges;
+    g->addEdges(endpoints, edges);
+    
+    for(int i = 0; i < (int)labelEdges.size(); i++) labelEdges[i] = edges[labelEdges[i]];
+    for(int i = 0; i < (int)colorEdges.size(); i++) colorEdges[i] = edges[colorEdges[i]];
+    for(int i = 0; i < (int)weightEdges.size(); i++) weightEdges[i] = edges[weightEdges[i]];
+    
+    g->setEdgeLabels(labelEdges, edgeLabels);
+    g->setEdgeColors(colorEdges, edgeColors);
+    g->setEdgeWeights(weightEdges, weights);
+}
@@ -23,11 +23,63 @@
 #include <mycelia.hpp>
 #include <vruihelp.hpp>
 
+#define DOT_END 0
+#define DOT_ID 1     // bare identifier or numeral
+#define DOT_STRING 2 // quoted or html string
+#define DOT_EDGEOP 3 // -> or --
+#define DOT_PUNCT 4  // one of {}[];,=:
+
+/*
+ * Reads graphviz DOT files with a hand-written lexer over the mapped file.
+ * Node names are interned as they first appear, in statements or as edge
+ * endpoints, and pos, label, color and weight attributes are collected in
+ * the same pass; nodes, edges and attributes are then added through the
+ * bulk graph methods. node and edge default attribute statements apply
+ * until the end of the enclosing braces.
+ */
 class DotParser
 {
 private:
     Mycelia* application;
-    std::map<std::string, int> nodeMap;
+    std::tr1::unordered_map<std::string, int> nodeMap;
+    
+    // lexer state
+    const char* p;
+    const char* end;
+    int tokenType;
+    std::string token;
+    
+    // defaults for node and edge statements, one entry per open brace
+    std::vector<Attributes> nodeDefaults;
+    std::vector<Attributes> edgeDefaults;
+    
+    // collected nodes; the node with index i in nodeMap is firstNode + i
+    std::vector<char> declared;
+    std::vector<int> positionNodes;
+    std::vector<double> positions;
+    std::vector<int> labelNodes;
+    std::vector<std::string> labels;
+    std::vector<int> colorNodes;
+    std::vector<double> colors;
+    
+    // collected edges as pairs of node indices, attributes by edge number
+    std::vector<int> endpoints;
+    std::vector<int> labelEdges;
+    std::vector<std::string> edgeLabels;
+    std::vector<int> colorEdges;
+    std::vector<double> edgeColors;
+    std::vector<int> weightEdges;
+    std::vector<double> weights;
+    
+    int next();
+    bool isPunct(char) const;
+    bool isKeyword(const char*) const;
+    void readAttributes(Attributes&);
+    void readNodeIds(std::vector<int>&);
+    void readStatement();
+    int intern(const std::string&);
+    void setNodeAttributes(int, const Attributes&);
+    void setEdgeAttributes(int, const Attributes&);
     
 public:
     DotParser(Mycelia*);
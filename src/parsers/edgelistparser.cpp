@@ -0,0 +1,137 @@
+/*
+ * Mycelia immersive 3d network visualization tool.
+ * Copyright (C) 2008-2010 Sean Whalen.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <parsers/edgelistparser.hpp>
+
+#include <cstring>
+
+using namespace std;
+
+EdgeListParser::EdgeListParser(Mycelia* application)
+    : application(application)
+{
+}
+
+void EdgeListParser::run(int worker, int begin, int end)
+{
+    for(int chunk = begin; chunk < end; chunk++)
+    {
+        const char* p = chunks[chunk];
+        const char* chunkEnd = chunks[chunk + 1];
+        
+        while(p < chunkEnd)
+        {
+            const char* eol = (const char*)memchr(p, '\n', chunkEnd - p);
+            const char* lineEnd = eol ? eol : chunkEnd;
+            double source, target, weight;
+            
+            if(*p != '#' && *p != '%'
+               && (p = VruiHelp::readNumber(p, lineEnd, source)) != 0
+               && (p = VruiHelp::readNumber(p, lineEnd, target)) != 0)
+            {
+                endpoints[chunk].push_back((long)source);
+                endpoints[chunk].push_back((long)target);
+                
+                p = VruiHelp::readNumber(p, lineEnd, weight);
+                weights[chunk].push_back(p ? weight : 1.0);
+                weighted[chunk] |= p != 0;
+            }
+            
+            p = lineEnd + 1;
+        }
+    }
+}
+
+void EdgeListParser::parse(string& filename)
+{
+    VruiHelp::MappedFile file(filename);
+    
+    WorkerPool pool;
+    int chunkCount = 4 * pool.getThreadCount();
+    VruiHelp::splitLines(file.begin(), file.end(), chunkCount, chunks);
+    endpoints.assign(chunkCount, vector<long>());
+    weights.assign(chunkCount, vector<double>());
+    weighted.assign(chunkCount, false);
+    pool.run(this, chunkCount);
+    
+    vector<long> numbers;
+    bool anyWeighted = false;
+    
+    for(int chunk = 0; chunk < chunkCount; chunk++)
+    {
+        numbers.insert(numbers.end(), endpoints[chunk].begin(), endpoints[chunk].end());
+        anyWeighted |= weighted[chunk];
+        vector<long>().swap(endpoints[chunk]);
+    }
+    
+    if(numbers.empty())
+    {
+        return;
+    }
+    
+    // node numbers to nodes in sorted order, by table when they are dense
+    long low = *min_element(numbers.begin(), numbers.end());
+    long high = *max_element(numbers.begin(), numbers.end());
+    vector<int> table;
+    vector<long> sorted;
+    int nodeCount = 0;
+    
+    if(high - low < 4 * (long)numbers.size())
+    {
+        table.assign(high - low + 1, -1);
+        for(size_t i = 0; i < numbers.size(); i++) table[numbers[i] - low] = 0;
+        for(size_t i = 0; i < table.size(); i++) if(table[i] == 0) table[i] = nodeCount++;
+    }
+    else
+    {
+        sorted = numbers;
+        sort(sorted.begin(), sorted.end());
+        sorted.erase(unique(sorted.begin(), sorted.end()), sorted.end());
+        nodeCount = sorted.size();
+    }
+    
+    Graph* g = application->g;
+    g->reserve(nodeCount, numbers.size() / 2);
+    int firstNode = g->addNodes(nodeCount);
+    
+    for(size_t i = 0; i < numbers.size(); i++)
+    {
+        long node = table.empty() ? lower_bound(sorted.begin(), sorted.end(), numbers[i]) - sorted.begin() : table[numbers[i] - low];
+        numbers[i] = firstNode + node;
+    }
+    
+    vector<int> pairs(numbers.begin(), numbers.end());
+    vector<double> pairWeights;
+    vector<int> edges;
+    vector<long>().swap(numbers);
+    g->addEdges(pairs, edges);
+    
+    if(anyWeighted)
+    {
+        for(int chunk = 0; chunk < chunkCount; chunk++)
+        {
+            pairWeights.insert(pairWeights.end(), weights[chunk].begin(), weights[chunk].end());
+        }
+        
+        g->setEdgeWeights(edges, pairWeights);
+    }
+    
+    weights.clear();
+    
+    cout << nodeCount << " nodes, " << edges.size() << " edges" << endl;
+}
@@ -0,0 +1,50 @@
+/*
+ * Mycelia immersive 3d network visualization tool.
+ * Copyright (C) 2008-2010 Sean Whalen.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __EDGELISTPARSER_HPP
+#define __EDGELISTPARSER_HPP
+
+#include <graph.hpp>
+#include <layout/workerpool.hpp>
+#include <mycelia.hpp>
+
+/*
+ * Reads edge lists: one "source target [weight]" line per edge, separated
+ * by blanks or commas, with '#' and '%' comment lines. Node numbers can be
+ * sparse; nodes are added in their sorted order. The mapped file is split
+ * into chunks at line boundaries that are parsed in parallel.
+ */
+class EdgeListParser : public WorkerTask
+{
+private:
+    Mycelia* application;
+    
+    // by chunk: (source, target) node numbers and weights, 1 if not given
+    std::vector<const char*> chunks;
+    std::vector<std::vector<long> > endpoints;
+    std::vector<std::vector<double> > weights;
+    std::vector<char> weighted;
+    
+public:
+    EdgeListParser(Mycelia*);
+    
+    void parse(std::string&);
+    void run(int, int, int);
+};
+
+#endif
@@ -18,164 +18,275 @@
 
 #include <parsers/xmlparser.hpp>
 
+#include <cstring>
+
 using namespace std;
-using namespace boost;
 
 XmlParser::XmlParser(Mycelia* application)
-    : application(application)
+    : application(application),
+      firstNode(0)
 {
 }
 
-void XmlParser::parse(string& filename)
+static bool isNameChar(char c)
+{
+    return isalnum((unsigned char)c) || c == '_' || c == '-' || c == ':';
+}
+
+static int toInt(const string& s)
 {
-    const basic_regex<char> colorRegex("^\\s*<color attribute=\"?([\\w\\d]+)\"? value=\"?([\\w\\d])+\"? rgba=\"?([\\d]+) ([\\d]+) ([\\d]+) ([\\d]+)\"?");
-    const basic_regex<char> nodeRegex("^\\s*<node ([^>]+)>");
-    const basic_regex<char> edgeRegex("^\\s*<edge ([^>]+)>");
-    const basic_regex<char> keyvalueRegex("(\\w+)=\"?([^\"]+)\"?");
-    
-    string fileBuffer = VruiHelp::fileToString(filename);
-    smatch lineMatches;
-    smatch attributeMatches;
-    string::const_iterator lineStart;
-    string::const_iterator lineEnd;
-    idMap.clear();
-    
-    // colors
-    lineStart = fileBuffer.begin();
-    lineEnd = fileBuffer.end();
-    string colorKey;
-    
-    while(regex_search(lineStart, lineEnd, lineMatches, colorRegex))
+    return (int)strtol(s.c_str(), 0, 10);
+}
+
+/*
+ * Reads the tag whose name starts at p, just past its '<', into name and
+ * key/value attributes, quoted or not; empty values are skipped. Returns
+ * the position past the tag.
+ * Comments and declarations come back with an empty name.
+ */
+const char* XmlParser::readTag(const char* p, const char* end, string& name, Attributes& attributes)
+{
+    name.clear();
+    attributes.clear();
+
+    if(end - p >= 3 && memcmp(p, "!--", 3) == 0)
     {
-        colorKey = string(lineMatches[1].first, lineMatches[1].second);
-        string value(lineMatches[2].first, lineMatches[2].second);
-        string r(lineMatches[3].first, lineMatches[3].second);
-        string g(lineMatches[4].first, lineMatches[4].second);
-        string b(lineMatches[5].first, lineMatches[5].second);
-        string a(lineMatches[6].first, lineMatches[6].second);
-        
-        vector<int> rgba(4);
-        rgba[0] = VruiHelp::stringToFloat(r);
-        rgba[1] = VruiHelp::stringToFloat(g);
-        rgba[2] = VruiHelp::stringToFloat(b);
-        rgba[3] = VruiHelp::stringToFloat(a);
-        colorMap[value] = rgba;
-        
-        lineStart = lineMatches[0].second;
+        for(p += 3; p + 3 <= end && memcmp(p, "-->", 3) != 0; p++);
+        return min(p + 3, end);
     }
-    
-    // nodes -- find all nodes, then add in sorted order
-    lineStart = fileBuffer.begin();
-    lineEnd = fileBuffer.end();
-    vector<int> addList(0);
-    
-    while(regex_search(lineStart, lineEnd, lineMatches, nodeRegex))
+
+    const char* start = p;
+    while(p < end && isNameChar(*p)) p++;
+    name.assign(start, p);
+
+    while(p < end && *p != '>')
     {
-        string::const_iterator nodeStart = lineMatches[1].first;
-        string::const_iterator nodeEnd = lineMatches[1].second;
-        
-        while(regex_search(nodeStart, nodeEnd, attributeMatches, keyvalueRegex))
+        if(!isNameChar(*p))
         {
-            string key(attributeMatches[1].first, attributeMatches[1].second);
-            string value(attributeMatches[2].first, attributeMatches[2].second);
-            
-            if(key == "id")
-            {
-                addList.push_back(VruiHelp::stringToInt(value));
-            }
-            
-            nodeStart = attributeMatches[0].second;
+            p++;
+            continue;
+        }
+
+        start = p;
+        while(p < end && isNameChar(*p)) p++;
+        string key(start, p);
+
+        while(p < end && isspace((unsigned char)*p)) p++;
+        if(p == end || *p != '=') continue;
+        p++;
+        while(p < end && isspace((unsigned char)*p)) p++;
+
+        if(p < end && (*p == '"' || *p == '\''))
+        {
+            char quote = *p++;
+            start = p;
+            const char* close = (const char*)memchr(p, quote, end - p);
+            p = close ? close : end;
+            if(p > start) attributes.push_back(make_pair(key, string(start, p)));
+            if(p < end) p++;
+        }
+        else
+        {
+            start = p;
+            while(p < end && !isspace((unsigned char)*p) && *p != '>' && *p != '/') p++;
+            if(p > start) attributes.push_back(make_pair(key, string(start, p)));
         }
-        
-        lineStart = lineMatches[0].second;
-    }
-    
-    std::sort(addList.begin(), addList.end());
-    
-    foreach(int xmlId, addList)
-    {
-        int graphId = application->g->addNode();
-        idMap[xmlId] = graphId;
     }
-    
-    // nodes -- add attributes
-    lineStart = fileBuffer.begin();
-    lineEnd = fileBuffer.end();
-    
-    while(regex_search(lineStart, lineEnd, lineMatches, nodeRegex))
+
+    return p < end ? p + 1 : end;
+}
+
+// graph node for an xml id, -1 if no node had it
+int XmlParser::getNode(int xmlId) const
+{
+    vector<int>::const_iterator it = lower_bound(xmlIds.begin(), xmlIds.end(), xmlId);
+    return it != xmlIds.end() && *it == xmlId ? firstNode + (int)(it - xmlIds.begin()) : -1;
+}
+
+void XmlParser::parse(string& filename)
+{
+    VruiHelp::MappedFile file(filename);
+    const char* p = file.begin();
+    const char* end = file.end();
+
+    colorMap.clear();
+    colorKey.clear();
+    xmlIds.clear();
+
+    // nodes in file order with their attributes back to back
+    vector<int> nodeIds;
+    vector<int> nodeAttributeStart;
+    Attributes nodeAttributes;
+
+    // edges as xml source and target pairs, with their labels by edge
+    vector<int> edgeEnds;
+    vector<char> edgeDirected;
+    vector<pair<int, string> > edgeLabels;
+
+    string name;
+    Attributes attributes;
+
+    while(p < end && (p = (const char*)memchr(p, '<', end - p)) != 0)
     {
-        string::const_iterator nodeStart = lineMatches[1].first;
-        string::const_iterator nodeEnd = lineMatches[1].second;
-        int xmlId = -1;
-        
-        // loop through attributes
-        while(regex_search(nodeStart, nodeEnd, attributeMatches, keyvalueRegex))
+        p = readTag(p + 1, end, name, attributes);
+
+        if(name == "color")
         {
-            string key(attributeMatches[1].first, attributeMatches[1].second);
-            string value(attributeMatches[2].first, attributeMatches[2].second);
-            
-            if(key == "id")
+            string value;
+            vector<int> rgba(4, 255);
+
+            for(int i = 0; i < (int)attributes.size(); i++)
             {
-                xmlId = VruiHelp::stringToInt(value);
+                if(attributes[i].first == "attribute")
+                {
+                    colorKey = attributes[i].second;
+                }
+                else if(attributes[i].first == "value")
+                {
+                    value = attributes[i].second;
+                }
+                else if(attributes[i].first == "rgba")
+                {
+                    istringstream stream(attributes[i].second);
+                    stream >> rgba[0] >> rgba[1] >> rgba[2] >> rgba[3];
+                }
             }
-            else if(key == colorKey)
+
+            colorMap[value] = rgba;
+        }
+        else if(name == "node")
+        {
+            int xmlId = -1;
+            bool hasId = false;
+
+            for(int i = 0; i < (int)attributes.size(); i++)
             {
-                vector<int>& rgba = colorMap[value];
-                application->g->setNodeColor(idMap[xmlId], rgba[0], rgba[1], rgba[2], rgba[3]);
+                if(attributes[i].first == "id")
+                {
+                    xmlId = toInt(attributes[i].second);
+                    hasId = true;
+                }
             }
-            else if(key == "label")
+
+            if(hasId)
             {
-                application->g->setNodeLabel(idMap[xmlId], value);
+                nodeIds.push_back(xmlId);
+                nodeAttributeStart.push_back(nodeAttributes.size());
+                nodeAttributes.insert(nodeAttributes.end(), attributes.begin(), attributes.end());
             }
-            
-            application->g->setNodeAttribute(idMap[xmlId], key, value);
-            nodeStart = attributeMatches[0].second;
         }
-        
-        lineStart = lineMatches[0].second;
-    }
-    
-    // edges
-    lineStart = fileBuffer.begin();
-    lineEnd = fileBuffer.end();
-    
-    while(regex_search(lineStart, lineEnd, lineMatches, edgeRegex))
-    {
-        string::const_iterator edgeStart = lineMatches[1].first;
-        string::const_iterator edgeEnd = lineMatches[1].second;
-        int source = -1;
-        int target = -1;
-        int edgeId = -1;
-        bool directed = true;
-        
-        // loop through attributes
-        while(regex_search(edgeStart, edgeEnd, attributeMatches, keyvalueRegex))
+        else if(name == "edge")
         {
-            string key(attributeMatches[1].first, attributeMatches[1].second);
-            string value(attributeMatches[2].first, attributeMatches[2].second);
-            
-            if(key == "from")
+            int source = -1;
+            int target = -1;
+            bool directed = true; // unless directed=false in the edge tag
+            const string* label = 0;
+
+            for(int i = 0; i < (int)attributes.size(); i++)
             {
-                source = VruiHelp::stringToInt(value);
+                const string& key = attributes[i].first;
+
+                if(key == "from") source = toInt(attributes[i].second);
+                else if(key == "to") target = toInt(attributes[i].second);
+                else if(key == "directed" && attributes[i].second == "false") directed = false;
+                else if(key == "label") label = &attributes[i].second;
             }
-            else if(key == "to")
+
+            if(label)
             {
-                target = VruiHelp::stringToInt(value);
-                edgeId = application->g->addEdge(idMap[source], idMap[target]);
+                edgeLabels.push_back(make_pair((int)edgeDirected.size(), *label));
             }
-            else if(key == "directed" && value == "false")
+
+            edgeEnds.push_back(source);
+            edgeEnds.push_back(target);
+            edgeDirected.push_back(directed);
+        }
+    }
+
+    Graph* g = application->g;
+
+    // nodes, added in sorted order of their xml ids
+    xmlIds = nodeIds;
+    sort(xmlIds.begin(), xmlIds.end());
+    xmlIds.erase(unique(xmlIds.begin(), xmlIds.end()), xmlIds.end());
+    firstNode = g->addNodes(xmlIds.size());
+
+    // node attributes, colors and labels
+    vector<int> colorNodes;
+    vector<double> colors;
+    vector<int> labelNodes;
+    vector<string> labels;
+    nodeAttributeStart.push_back(nodeAttributes.size());
+
+    for(int n = 0; n < (int)nodeIds.size(); n++)
+    {
+        int node = getNode(nodeIds[n]);
+
+        for(int i = nodeAttributeStart[n]; i < nodeAttributeStart[n + 1]; i++)
+        {
+            string& key = nodeAttributes[i].first;
+            string& value = nodeAttributes[i].second;
+
+            if(key == colorKey && colorMap.find(value) != colorMap.end())
             {
-                directed = false; // assume directed unless directed=false in edge tag
+                const vector<int>& rgba = colorMap[value];
+                colorNodes.push_back(node);
+                for(int c = 0; c < 4; c++) colors.push_back(rgba[c] / 255.0);
             }
             else if(key == "label")
             {
-                application->g->setEdgeLabel(edgeId, value);
+                labelNodes.push_back(node);
+                labels.push_back(value);
             }
-            
-            edgeStart = attributeMatches[0].second;
+
+            g->setNodeAttribute(node, key, value);
         }
-        
-        if(!directed) application->g->addEdge(idMap[target], idMap[source]);
-        lineStart = lineMatches[0].second;
     }
-}
\ No newline at end of file
+
+    g->setNodeColors(colorNodes, colors);
+    g->setNodeLabels(labelNodes, labels);
+
+    // edges, and their reverse if undirected; the label goes on the first
+    vector<int> endpoints;
+    vector<int> forward(edgeDirected.size(), -1); // slot in endpoints / 2
+    endpoints.reserve(edgeEnds.size());
+
+    for(int e = 0; e < (int)edgeDirected.size(); e++)
+    {
+        int source = getNode(edgeEnds[2 * e]);
+        int target = getNode(edgeEnds[2 * e + 1]);
+
+        if(source == -1 || target == -1)
+        {
+            cout << "edge to unknown node: " << edgeEnds[2 * e] << " " << edgeEnds[2 * e + 1] << endl;
+            continue;
+        }
+
+        forward[e] = endpoints.size() / 2;
+        endpoints.push_back(source);
+        endpoints.push_back(target);
+
+        if(!edgeDirected[e])
+        {
+            endpoints.push_back(target);
+            endpoints.push_back(source);
+        }
+    }
+
+    vector<int> edges;
+    g->addEdges(endpoints, edges);
+
+    vector<int> labelEdges;
+    labels.clear();
+
+    for(int i = 0; i < (int)edgeLabels.size(); i++)
+    {
+        if(forward[edgeLabels[i].first] != -1)
+        {
+            labelEdges.push_back(edges[forward[edgeLabels[i].first]]);
+            labels.push_back(edgeLabels[i].second);
+        }
+    }
+
+    g->setEdgeLabels(labelEdges, labels);
+}
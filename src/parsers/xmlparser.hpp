@@ -22,6 +22,11 @@
 #include <graph.hpp>
 #include <mycelia.hpp>
 
+/*
+ * Reads the .xml network format in a single pass over the mapped file:
+ * colors, nodes and edges are collected as their tags go by and then added
+ * through the bulk graph methods, nodes in order of their xml ids.
+ */
 class XmlParser
 {
 private:
@@ -29,9 +34,14 @@ private:
     
     // stores a value/color mapping for nodes containing a colorAttributeName
     std::map<std::string, std::vector<int> > colorMap;
+    std::string colorKey;
+    
+    // sorted xml node ids; the node with xmlIds[i] is firstNode + i
+    std::vector<int> xmlIds;
+    int firstNode;
     
-    // maps optional node id from xml to internal node id
-    std::map<int, int> idMap;
+    static const char* readTag(const char*, const char*, std::string&, Attributes&);
+    int getNode(int) const;
     
 public:
     XmlParser(Mycelia*);
@@ -0,0 +1,334 @@
+/*
+ * Mycelia immersive 3d network visualization tool.
+ * Copyright (C) 2008-2010 Sean Whalen.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <graph.hpp>
+#include <mycelia.hpp>
+#include <pluginhost.hpp>
+
+#include <cstdio>
+#include <cstring>
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+using namespace std;
+
+static size_t padded(size_t bytes)
+{
+    return (bytes + 7) & ~(size_t)7;
+}
+
+PluginHost::PluginHost() : busy(false), stopping(false), version(0), fd(-1), pid(-1)
+{
+    thread = new Threads::Thread();
+    thread->start(this, &PluginHost::work);
+}
+
+PluginHost::~PluginHost()
+{
+    mutex.lock();
+    stopping = true;
+    cond.signal();
+    mutex.unlock();
+
+    thread->join();
+    delete thread;
+}
+
+bool PluginHost::writeView(const string& path, Graph* g, const vector<double>& values)
+{
+    const Adjacency& adjacency = g->getAdjacency();
+    const vector<int>& ids = g->getIndexNodes();
+
+    PluginViewHeader header;
+    header.magic = PLUGIN_VIEW_MAGIC;
+    header.version = PLUGIN_VIEW_VERSION;
+    header.nodeCount = (int)ids.size();
+    header.arcCount = (int)adjacency.targets.size();
+    header.valueCount = (int)values.size();
+    header.reserved = 0;
+
+    if((int)adjacency.offsets.size() != header.nodeCount + 1)
+    {
+        return false;
+    }
+
+    size_t nodeBytes = padded(header.nodeCount * sizeof(int));
+    size_t offsetBytes = padded((header.nodeCount + 1) * sizeof(int));
+    size_t arcBytes = padded(header.arcCount * sizeof(int));
+    size_t size = padded(sizeof(header)) + 2 * nodeBytes + offsetBytes + arcBytes + values.size() * sizeof(double);
+
+    string temporary = path + ".tmp";
+    int file = open(temporary.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+
+    if(file < 0 || ftruncate(file, size) < 0)
+    {
+        if(file >= 0) close(file);
+        return false;
+    }
+
+    void* mapping = mmap(0, size, PROT_READ | PROT_WRITE, MAP_SHARED, file, 0);
+    close(file);
+
+    if(mapping == MAP_FAILED)
+    {
+        return false;
+    }
+
+    // ftruncate zero filled the padding
+    char* p = (char*)mapping;
+    memcpy(p, &header, sizeof(header));
+    p += padded(sizeof(header));
+
+    if(!ids.empty())
+    {
+        memcpy(p, &ids[0], ids.size() * sizeof(int));
+    }
+
+    p += nodeBytes;
+
+    // degree counts every edge end, as getNodeDegree does
+    int* degrees = (int*)p;
+
+    for(int index = 0; index < header.nodeCount; index++)
+    {
+        degrees[index] += adjacency.offsets[index + 1] - adjacency.offsets[index];
+
+        for(int slot = adjacency.offsets[index]; slot < adjacency.offsets[index + 1]; slot++)
+        {
+            degrees[adjacency.targets[slot]]++;
+        }
+    }
+
+    p += nodeBytes;
+
+    memcpy(p, &adjacency.offsets[0], adjacency.offsets.size() * sizeof(int));
+    p += offsetBytes;
+
+    if(header.arcCount > 0)
+    {
+        memcpy(p, &adjacency.targets[0], adjacency.targets.size() * sizeof(int));
+    }
+
+    p += arcBytes;
+
+    if(!values.empty())
+    {
+        memcpy(p, &values[0], values.size() * sizeof(double));
+    }
+
+    munmap(mapping, size);
+
+    // a plugin still reading the previous view keeps its own file
+    return rename(temporary.c_str(), path.c_str()) == 0;
+}
+
+void PluginHost::run(const string& script)
+{
+    mutex.lock();
+    pending = script;
+    cond.signal();
+    mutex.unlock();
+}
+
+bool PluginHost::isBusy()
+{
+    mutex.lock();
+    bool result = busy || !pending.empty();
+    mutex.unlock();
+
+    return result;
+}
+
+int PluginHost::getVersion()
+{
+    mutex.lock();
+    int result = version;
+    mutex.unlock();
+
+    return result;
+}
+
+string PluginHost::getError()
+{
+    mutex.lock();
+    string result = error;
+    mutex.unlock();
+
+    return result;
+}
+
+bool PluginHost::startHost()
+{
+    int fds[2];
+
+    if(socketpair(AF_UNIX, SOCK_STREAM, 0, fds) < 0)
+    {
+        return false;
+    }
+
+    // looked up before forking, the child only makes system calls
+    long maxFd = sysconf(_SC_OPEN_MAX);
+
+    if(maxFd < 0)
+    {
+        maxFd = 1024;
+    }
+
+    pid = fork();
+
+    if(pid < 0)
+    {
+        close(fds[0]);
+        close(fds[1]);
+        return false;
+    }
+
+    if(pid == 0)
+    {
+        // requests on stdin, replies on stdout
+        dup2(fds[1], 0);
+        dup2(fds[1], 1);
+
+        // keep stderr, the host inherits none of our sockets, files or pipes
+        for(int i = 3; i < maxFd; i++)
+        {
+            close(i);
+        }
+
+        execl(PYTHON, PYTHON, PLUGIN_HOST, (char*)0);
+        _exit(127);
+    }
+
+    close(fds[1]);
+    fd = fds[0];
+    return true;
+}
+
+void PluginHost::stopHost()
+{
+    if(fd >= 0)
+    {
+        // the host exits at the end of its input
+        close(fd);
+        fd = -1;
+    }
+
+    if(pid > 0)
+    {
+        waitpid(pid, 0, 0);
+        pid = -1;
+    }
+}
+
+// one request line and its reply line; false if the host is gone
+bool PluginHost::request(const string& line, string& reply)
+{
+    const char* p = line.c_str();
+    size_t size = line.size();
+
+    while(size > 0)
+    {
+        ssize_t n = send(fd, p, size, MSG_NOSIGNAL);
+
+        if(n < 0 && errno == EINTR) continue;
+        if(n <= 0) return false;
+
+        p += n;
+        size -= n;
+    }
+
+    reply.clear();
+    char c;
+
+    while(true)
+    {
+        ssize_t n = recv(fd, &c, 1, 0);
+
+        if(n < 0 && errno == EINTR) continue;
+        if(n <= 0) return false;
+        if(c == '\n') return true;
+
+        reply += c;
+    }
+}
+
+void* PluginHost::work()
+{
+    mutex.lock();
+
+    while(true)
+    {
+        while(pending.empty() && !stopping)
+        {
+            cond.wait(mutex);
+        }
+
+        if(stopping)
+        {
+            break;
+        }
+
+        string script = pending;
+        pending.clear();
+        busy = true;
+        mutex.unlock();
+
+        string line = script + "\t" + PLUGIN_VIEW + "\t" + PLUGIN_OUTPUT + "\n";
+        string reply;
+
+        // a host that died is started again, once per request
+        bool answered = (fd >= 0 || startHost()) && request(line, reply);
+
+        if(!answered)
+        {
+            stopHost();
+            answered = startHost() && request(line, reply);
+        }
+
+        if(!answered)
+        {
+            stopHost();
+            reply = "error: cannot run " PYTHON " " PLUGIN_HOST;
+        }
+
+        mutex.lock();
+        busy = false;
+
+        if(reply == "ok")
+        {
+            error.clear();
+            version++;
+        }
+        else
+        {
+            error = reply;
+            cerr << script << ": " << reply << endl;
+        }
+
+        Vrui::requestUpdate();
+    }
+
+    mutex.unlock();
+    stopHost();
+
+    return 0;
+}
@@ -0,0 +1,95 @@
+/*
+ * Mycelia immersive 3d network visualization tool.
+ * Copyright (C) 2008-2010 Sean Whalen.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __PLUGINHOST_HPP
+#define __PLUGINHOST_HPP
+
+#include <Threads/Cond.h>
+#include <Threads/Mutex.h>
+#include <Threads/Thread.h>
+#include <string>
+#include <vector>
+
+#define PLUGIN_HOST "python/plugins/host.py"
+#define PLUGIN_VIEW "/tmp/mycelia-plugin.view"
+#define PLUGIN_OUTPUT "/tmp/output.png"
+#define PLUGIN_VIEW_MAGIC 0x5657594d // "MYVW" in file byte order
+#define PLUGIN_VIEW_VERSION 1
+
+class Graph;
+
+/*
+ * The binary graph view plugins read. A header of six 32 bit words, magic,
+ * version, node count, arc count, value count and 0, is followed by these
+ * arrays, each padded to 8 bytes and in native byte order: node ids and
+ * degrees by dense index, the out-arc offsets[nodes + 1] and targets by
+ * dense index, and doubles with any per node values of the plugin.
+ */
+struct PluginViewHeader
+{
+    unsigned int magic;
+    unsigned int version;
+    int nodeCount;
+    int arcCount;
+    int valueCount;
+    int reserved;
+};
+
+/*
+ * Runs plot scripts in one persistent python process, python/plugins/host.py,
+ * talking over a socket pair on a thread of its own, so that interpreter and
+ * matplotlib start only once and plotting never blocks a frame. Requests
+ * are a line with the script, view and output paths, answered by "ok" or an
+ * error line; a request made while one is running replaces any waiting one.
+ */
+class PluginHost
+{
+private:
+    Threads::Thread* thread;
+    Threads::Mutex mutex;
+    Threads::Cond cond;
+
+    std::string pending; // script to run next, empty for none
+    bool busy;
+    bool stopping;
+    int version; // bumped whenever a script wrote its output
+    std::string error; // of the last script, empty if it succeeded
+
+    int fd; // to the host process, -1 before it is started
+    int pid;
+
+    bool startHost();
+    void stopHost();
+    bool request(const std::string&, std::string&);
+    void* work();
+
+public:
+    PluginHost();
+    ~PluginHost();
+
+    // writes the view of g, by its dense indices, through a temporary file
+    // and a rename; g must not change meanwhile, as gCopy does not
+    static bool writeView(const std::string&, Graph*, const std::vector<double>& values=std::vector<double>());
+
+    void run(const std::string& script);
+    bool isBusy();
+    int getVersion(); // compare to tell when a new output is ready
+    std::string getError();
+};
+
+#endif
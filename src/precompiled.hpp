@@ -32,10 +32,9 @@
 #include <Vrui/Vrui.h>
 
 // boost
-#include <boost/graph/adjacency_list.hpp>
 #include <boost/graph/betweenness_centrality.hpp>
-#include <boost/graph/connected_components.hpp>
-#include <boost/graph/dijkstra_shortest_paths.hpp>
+#include <boost/graph/breadth_first_search.hpp>
+#include <boost/graph/compressed_sparse_row_graph.hpp>
 #include <boost/graph/prim_minimum_spanning_tree.hpp>
 #include <boost/foreach.hpp>
 #include <boost/regex.hpp>
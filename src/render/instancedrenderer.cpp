@@ -0,0 +1,498 @@
+/*
+ * Mycelia immersive 3d network visualization tool.
+ * Copyright (C) 2008-2010 Sean Whalen.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <cmath>
+#include <iostream>
+
+#include <GL/GLExtensionManager.h>
+#include <render/instancedrenderer.hpp>
+
+using namespace std;
+
+// shared by both programs, one light with the fixed function light state
+static const char* fragmentSource =
+    "#version 120\n"
+    "varying vec3 normal;\n"
+    "varying vec3 position;\n"
+    "varying vec4 diffuse;\n"
+    "void main()\n"
+    "{\n"
+    "    vec3 n = normalize(gl_FrontFacing ? normal : -normal);\n"
+    "    vec3 light = normalize(gl_LightSource[0].position.xyz - position * gl_LightSource[0].position.w);\n"
+    "    float lambert = max(dot(n, light), 0.0);\n"
+    "    vec3 ambient = gl_LightModel.ambient.rgb + gl_LightSource[0].ambient.rgb;\n"
+    "    gl_FragColor = vec4(diffuse.rgb * (ambient + lambert * gl_LightSource[0].diffuse.rgb), diffuse.a);\n"
+    "}\n";
+
+static const char* sphereSource =
+    "#version 120\n"
+    "attribute vec3 mesh;\n"
+    "attribute vec4 center;\n"
+    "attribute vec4 color;\n"
+    "varying vec3 normal;\n"
+    "varying vec3 position;\n"
+    "varying vec4 diffuse;\n"
+    "void main()\n"
+    "{\n"
+    "    vec4 p = gl_ModelViewMatrix * vec4(center.xyz + mesh * center.w, 1.0);\n"
+    "    position = p.xyz;\n"
+    "    normal = gl_NormalMatrix * mesh;\n"
+    "    diffuse = color;\n"
+    "    gl_Position = gl_ProjectionMatrix * p;\n"
+    "}\n";
+
+// mesh is (cos, sin, t) around and along the unit frustum
+static const char* segmentSource =
+    "#version 120\n"
+    "attribute vec3 mesh;\n"
+    "attribute vec4 source;\n"
+    "attribute vec4 target;\n"
+    "attribute vec4 color;\n"
+    "varying vec3 normal;\n"
+    "varying vec3 position;\n"
+    "varying vec4 diffuse;\n"
+    "void main()\n"
+    "{\n"
+    "    vec3 axis = target.xyz - source.xyz;\n"
+    "    float len = length(axis);\n"
+    "    vec3 w = len > 0.0 ? axis / len : vec3(0.0, 0.0, 1.0);\n"
+    "    vec3 helper = abs(w.z) < 0.9 ? vec3(0.0, 0.0, 1.0) : vec3(1.0, 0.0, 0.0);\n"
+    "    vec3 u = normalize(cross(helper, w));\n"
+    "    vec3 v = cross(w, u);\n"
+    "    vec3 radial = u * mesh.x + v * mesh.y;\n"
+    "    float radius = mix(source.w, target.w, mesh.z);\n"
+    "    vec4 p = gl_ModelViewMatrix * vec4(source.xyz + axis * mesh.z + radial * radius, 1.0);\n"
+    "    position = p.xyz;\n"
+    "    normal = gl_NormalMatrix * radial;\n"
+    "    diffuse = color;\n"
+    "    gl_Position = gl_ProjectionMatrix * p;\n"
+    "}\n";
+
+InstancedRenderer::InstancedRenderer()
+    : sphereProgram(0), segmentProgram(0),
+      pointBuffer(0), lineBuffer(0), pointCount(0), lineCount(0), pointSize(1),
+      initialized(false)
+{
+    for(int level = 0; level < RENDER_MESH_LEVELS; level++)
+    {
+        sphereVertices[level] = sphereIndices[level] = 0;
+        segmentVertices[level] = segmentIndices[level] = 0;
+        sphereIndexCount[level] = segmentIndexCount[level] = 0;
+        nodeBuffer[level] = segmentBuffer[level] = 0;
+        nodeCount[level] = segmentCount[level] = 0;
+    }
+}
+
+InstancedRenderer::~InstancedRenderer()
+{
+    if(!initialized) return;
+
+    for(int level = 0; level < RENDER_MESH_LEVELS; level++)
+    {
+        GLuint buffers[6] = {sphereVertices[level], sphereIndices[level], segmentVertices[level],
+                             segmentIndices[level], nodeBuffer[level], segmentBuffer[level]};
+        deleteBuffers(6, buffers);
+    }
+
+    deleteBuffers(1, &pointBuffer);
+    deleteBuffers(1, &lineBuffer);
+    deleteObject(sphereProgram);
+    deleteObject(segmentProgram);
+}
+
+bool InstancedRenderer::isSupported()
+{
+    return GLExtensionManager::isExtensionSupported("GL_ARB_vertex_buffer_object") &&
+           GLExtensionManager::isExtensionSupported("GL_ARB_shader_objects") &&
+           GLExtensionManager::isExtensionSupported("GL_ARB_vertex_shader") &&
+           GLExtensionManager::isExtensionSupported("GL_ARB_fragment_shader") &&
+           GLExtensionManager::isExtensionSupported("GL_ARB_instanced_arrays") &&
+           GLExtensionManager::isExtensionSupported("GL_ARB_draw_instanced");
+}
+
+bool InstancedRenderer::init()
+{
+    genBuffers = GLExtensionManager::getFunction<PFNGLGENBUFFERSARBPROC>("glGenBuffersARB");
+    deleteBuffers = GLExtensionManager::getFunction<PFNGLDELETEBUFFERSARBPROC>("glDeleteBuffersARB");
+    bindBuffer = GLExtensionManager::getFunction<PFNGLBINDBUFFERARBPROC>("glBindBufferARB");
+    bufferData = GLExtensionManager::getFunction<PFNGLBUFFERDATAARBPROC>("glBufferDataARB");
+    bufferSubData = GLExtensionManager::getFunction<PFNGLBUFFERSUBDATAARBPROC>("glBufferSubDataARB");
+    createShader = GLExtensionManager::getFunction<PFNGLCREATESHADEROBJECTARBPROC>("glCreateShaderObjectARB");
+    shaderSource = GLExtensionManager::getFunction<PFNGLSHADERSOURCEARBPROC>("glShaderSourceARB");
+    compileShader = GLExtensionManager::getFunction<PFNGLCOMPILESHADERARBPROC>("glCompileShaderARB");
+    createProgram = GLExtensionManager::getFunction<PFNGLCREATEPROGRAMOBJECTARBPROC>("glCreateProgramObjectARB");
+    attachObject = GLExtensionManager::getFunction<PFNGLATTACHOBJECTARBPROC>("glAttachObjectARB");
+    bindAttribLocation = GLExtensionManager::getFunction<PFNGLBINDATTRIBLOCATIONARBPROC>("glBindAttribLocationARB");
+    linkProgram = GLExtensionManager::getFunction<PFNGLLINKPROGRAMARBPROC>("glLinkProgramARB");
+    getObjectParameteriv = GLExtensionManager::getFunction<PFNGLGETOBJECTPARAMETERIVARBPROC>("glGetObjectParameterivARB");
+    getInfoLog = GLExtensionManager::getFunction<PFNGLGETINFOLOGARBPROC>("glGetInfoLogARB");
+    useProgram = GLExtensionManager::getFunction<PFNGLUSEPROGRAMOBJECTARBPROC>("glUseProgramObjectARB");
+    deleteObject = GLExtensionManager::getFunction<PFNGLDELETEOBJECTARBPROC>("glDeleteObjectARB");
+    vertexAttribPointer = GLExtensionManager::getFunction<PFNGLVERTEXATTRIBPOINTERARBPROC>("glVertexAttribPointerARB");
+    enableVertexAttribArray = GLExtensionManager::getFunction<PFNGLENABLEVERTEXATTRIBARRAYARBPROC>("glEnableVertexAttribArrayARB");
+    disableVertexAttribArray = GLExtensionManager::getFunction<PFNGLDISABLEVERTEXATTRIBARRAYARBPROC>("glDisableVertexAttribArrayARB");
+    vertexAttribDivisor = GLExtensionManager::getFunction<PFNGLVERTEXATTRIBDIVISORARBPROC>("glVertexAttribDivisorARB");
+    drawElementsInstanced = GLExtensionManager::getFunction<PFNGLDRAWELEMENTSINSTANCEDARBPROC>("glDrawElementsInstancedARB");
+
+    // attribute locations match the instance layouts, the mesh is always 0
+    const char* sphereAttributes[] = {"mesh", "center", "color"};
+    const char* segmentAttributes[] = {"mesh", "source", "target", "color"};
+    sphereProgram = compileProgram(sphereSource, fragmentSource, sphereAttributes, 3);
+    segmentProgram = compileProgram(segmentSource, fragmentSource, segmentAttributes, 4);
+
+    if(sphereProgram == 0 || segmentProgram == 0)
+    {
+        if(sphereProgram != 0) deleteObject(sphereProgram);
+        if(segmentProgram != 0) deleteObject(segmentProgram);
+        return false;
+    }
+
+    for(int level = 0; level < RENDER_MESH_LEVELS; level++)
+    {
+        genBuffers(1, &sphereVertices[level]);
+        genBuffers(1, &sphereIndices[level]);
+        genBuffers(1, &segmentVertices[level]);
+        genBuffers(1, &segmentIndices[level]);
+        genBuffers(1, &nodeBuffer[level]);
+        genBuffers(1, &segmentBuffer[level]);
+    }
+
+    genBuffers(1, &pointBuffer);
+    genBuffers(1, &lineBuffer);
+
+    buildSphere(0, RENDER_SPHERE_SLICES, RENDER_SPHERE_STACKS);
+    buildSphere(1, RENDER_LOW_SPHERE_SLICES, RENDER_LOW_SPHERE_STACKS);
+    buildSegment(0, RENDER_SEGMENT_SLICES);
+    buildSegment(1, RENDER_LOW_SEGMENT_SLICES);
+
+    initialized = true;
+    return true;
+}
+
+bool InstancedRenderer::isInitialized() const
+{
+    return initialized;
+}
+
+GLhandleARB InstancedRenderer::compileProgram(const char* vertexSource, const char* fragmentSource,
+                                              const char** attributes, int attributeCount)
+{
+    const char* sources[2] = {vertexSource, fragmentSource};
+    GLenum types[2] = {GL_VERTEX_SHADER_ARB, GL_FRAGMENT_SHADER_ARB};
+    GLhandleARB program = createProgram();
+    GLint status;
+    char log[1024];
+
+    for(int i = 0; i < 2; i++)
+    {
+        GLhandleARB shader = createShader(types[i]);
+        shaderSource(shader, 1, &sources[i], 0);
+        compileShader(shader);
+        getObjectParameteriv(shader, GL_OBJECT_COMPILE_STATUS_ARB, &status);
+
+        if(!status)
+        {
+            getInfoLog(shader, sizeof(log), 0, log);
+            cerr << "Failed to compile instanced renderer shader: " << log << endl;
+            deleteObject(shader);
+            deleteObject(program);
+            return 0;
+        }
+
+        // flagged for deletion, freed with the program
+        attachObject(program, shader);
+        deleteObject(shader);
+    }
+
+    for(int i = 0; i < attributeCount; i++)
+    {
+        bindAttribLocation(program, i, attributes[i]);
+    }
+
+    linkProgram(program);
+    getObjectParameteriv(program, GL_OBJECT_LINK_STATUS_ARB, &status);
+
+    if(!status)
+    {
+        getInfoLog(program, sizeof(log), 0, log);
+        cerr << "Failed to link instanced renderer shaders: " << log << endl;
+        deleteObject(program);
+        return 0;
+    }
+
+    return program;
+}
+
+void InstancedRenderer::buildSphere(int level, int slices, int stacks)
+{
+    vector<GLfloat> vertices;
+    vector<GLushort> indices;
+
+    // unit sphere, positions double as normals; counter-clockwise from outside
+    for(int stack = 0; stack <= stacks; stack++)
+    {
+        double phi = M_PI * stack / stacks;
+
+        for(int slice = 0; slice <= slices; slice++)
+        {
+            double theta = 2 * M_PI * slice / slices;
+            vertices.push_back(sin(phi) * cos(theta));
+            vertices.push_back(sin(phi) * sin(theta));
+            vertices.push_back(cos(phi));
+        }
+    }
+
+    for(int stack = 0; stack < stacks; stack++)
+    {
+        for(int slice = 0; slice < slices; slice++)
+        {
+            GLushort a = stack * (slices + 1) + slice;
+            GLushort b = a + slices + 1;
+            indices.push_back(a);
+            indices.push_back(b);
+            indices.push_back(a + 1);
+            indices.push_back(a + 1);
+            indices.push_back(b);
+            indices.push_back(b + 1);
+        }
+    }
+
+    upload(sphereVertices[level], vertices.size() * sizeof(GLfloat), &vertices[0]);
+    bindBuffer(GL_ELEMENT_ARRAY_BUFFER_ARB, sphereIndices[level]);
+    bufferData(GL_ELEMENT_ARRAY_BUFFER_ARB, indices.size() * sizeof(GLushort), &indices[0], GL_STATIC_DRAW_ARB);
+    bindBuffer(GL_ELEMENT_ARRAY_BUFFER_ARB, 0);
+    sphereIndexCount[level] = indices.size();
+}
+
+void InstancedRenderer::buildSegment(int level, int slices)
+{
+    vector<GLfloat> vertices;
+    vector<GLushort> indices;
+
+    // open unit frustum from t = 0 to t = 1, like gluCylinder
+    for(int slice = 0; slice <= slices; slice++)
+    {
+        double theta = 2 * M_PI * slice / slices;
+
+        for(int t = 0; t < 2; t++)
+        {
+            vertices.push_back(cos(theta));
+            vertices.push_back(sin(theta));
+            vertices.push_back(t);
+        }
+    }
+
+    for(int slice = 0; slice < slices; slice++)
+    {
+        GLushort a = 2 * slice;
+        indices.push_back(a);
+        indices.push_back(a + 2);
+        indices.push_back(a + 1);
+        indices.push_back(a + 1);
+        indices.push_back(a + 2);
+        indices.push_back(a + 3);
+    }
+
+    upload(segmentVertices[level], vertices.size() * sizeof(GLfloat), &vertices[0]);
+    bindBuffer(GL_ELEMENT_ARRAY_BUFFER_ARB, segmentIndices[level]);
+    bufferData(GL_ELEMENT_ARRAY_BUFFER_ARB, indices.size() * sizeof(GLushort), &indices[0], GL_STATIC_DRAW_ARB);
+    bindBuffer(GL_ELEMENT_ARRAY_BUFFER_ARB, 0);
+    segmentIndexCount[level] = indices.size();
+}
+
+void InstancedRenderer::upload(GLuint buffer, GLsizeiptrARB size, const GLvoid* data)
+{
+    bindBuffer(GL_ARRAY_BUFFER_ARB, buffer);
+    bufferData(GL_ARRAY_BUFFER_ARB, size, size ? data : 0, GL_DYNAMIC_DRAW_ARB);
+    bindBuffer(GL_ARRAY_BUFFER_ARB, 0);
+}
+
+void InstancedRenderer::uploadRange(GLuint buffer, GLintptrARB offset, GLsizeiptrARB size, const GLvoid* data)
+{
+    bindBuffer(GL_ARRAY_BUFFER_ARB, buffer);
+    bufferSubData(GL_ARRAY_BUFFER_ARB, offset, size, data);
+    bindBuffer(GL_ARRAY_BUFFER_ARB, 0);
+}
+
+void InstancedRenderer::setNodes(int level, const vector<NodeInstance>& nodes)
+{
+    nodeCount[level] = nodes.size();
+    upload(nodeBuffer[level], nodes.size() * sizeof(NodeInstance), nodes.empty() ? 0 : &nodes[0]);
+}
+
+void InstancedRenderer::setSegments(int level, const vector<SegmentInstance>& segments)
+{
+    segmentCount[level] = segments.size();
+    upload(segmentBuffer[level], segments.size() * sizeof(SegmentInstance), segments.empty() ? 0 : &segments[0]);
+}
+
+void InstancedRenderer::setPoints(const vector<PointVertex>& points)
+{
+    pointCount = points.size();
+    upload(pointBuffer, points.size() * sizeof(PointVertex), points.empty() ? 0 : &points[0]);
+}
+
+void InstancedRenderer::setLines(const vector<PointVertex>& lines)
+{
+    lineCount = lines.size();
+    upload(lineBuffer, lines.size() * sizeof(PointVertex), lines.empty() ? 0 : &lines[0]);
+}
+
+void InstancedRenderer::setPointSize(GLfloat size)
+{
+    pointSize = size;
+}
+
+void InstancedRenderer::updateNodes(int level, int first, int count, const NodeInstance* nodes)
+{
+    uploadRange(nodeBuffer[level], first * sizeof(NodeInstance), count * sizeof(NodeInstance), nodes);
+}
+
+void InstancedRenderer::updateSegments(int level, int first, int count, const SegmentInstance* segments)
+{
+    uploadRange(segmentBuffer[level], first * sizeof(SegmentInstance), count * sizeof(SegmentInstance), segments);
+}
+
+void InstancedRenderer::updatePoints(int first, int count, const PointVertex* points)
+{
+    uploadRange(pointBuffer, first * sizeof(PointVertex), count * sizeof(PointVertex), points);
+}
+
+void InstancedRenderer::updateLines(int first, int count, const PointVertex* lines)
+{
+    uploadRange(lineBuffer, first * sizeof(PointVertex), count * sizeof(PointVertex), lines);
+}
+
+/*
+ * Instanced draws of a mesh, one per range. Instance attributes are
+ * consecutive vec4s at locations 1 .. vectorCount, advancing once per
+ * instance; without a base instance each range re-points them at its
+ * first element.
+ */
+void InstancedRenderer::drawInstances(GLhandleARB program, GLuint meshVertices, GLuint meshIndices, GLsizei indexCount,
+                                      GLuint instances, const RangeList& ranges, int vectorCount, GLsizei stride) const
+{
+    if(ranges.empty()) return;
+
+    useProgram(program);
+
+    bindBuffer(GL_ARRAY_BUFFER_ARB, meshVertices);
+    enableVertexAttribArray(0);
+    vertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, 0);
+
+    bindBuffer(GL_ARRAY_BUFFER_ARB, instances);
+
+    for(int i = 0; i < vectorCount; i++)
+    {
+        enableVertexAttribArray(i + 1);
+        vertexAttribDivisor(i + 1, 1);
+    }
+
+    bindBuffer(GL_ELEMENT_ARRAY_BUFFER_ARB, meshIndices);
+
+    for(int r = 0; r < (int)ranges.size(); r++)
+    {
+        const char* first = (const char*)0 + ranges[r].first * stride;
+
+        for(int i = 0; i < vectorCount; i++)
+        {
+            vertexAttribPointer(i + 1, 4, GL_FLOAT, GL_FALSE, stride, first + i * 4 * sizeof(GLfloat));
+        }
+
+        drawElementsInstanced(GL_TRIANGLES, indexCount, GL_UNSIGNED_SHORT, 0, ranges[r].second);
+    }
+
+    for(int i = 0; i < vectorCount; i++)
+    {
+        vertexAttribDivisor(i + 1, 0);
+        disableVertexAttribArray(i + 1);
+    }
+    disableVertexAttribArray(0);
+
+    bindBuffer(GL_ELEMENT_ARRAY_BUFFER_ARB, 0);
+    bindBuffer(GL_ARRAY_BUFFER_ARB, 0);
+    useProgram(0);
+}
+
+/*
+ * Unlit, fixed function draw of colored vertices.
+ */
+void InstancedRenderer::drawVertices(GLenum mode, GLuint buffer, const RangeList& ranges) const
+{
+    if(ranges.empty()) return;
+
+    bindBuffer(GL_ARRAY_BUFFER_ARB, buffer);
+    glVertexPointer(3, GL_FLOAT, sizeof(PointVertex), 0);
+    glColorPointer(4, GL_FLOAT, sizeof(PointVertex), (const GLvoid*)(3 * sizeof(GLfloat)));
+
+    for(int r = 0; r < (int)ranges.size(); r++)
+    {
+        glDrawArrays(mode, ranges[r].first, ranges[r].second);
+    }
+
+    bindBuffer(GL_ARRAY_BUFFER_ARB, 0);
+}
+
+static void addWholeRange(InstancedRenderer::RangeList& ranges, GLsizei count)
+{
+    if(count > 0)
+    {
+        ranges.push_back(make_pair(0, (int)count));
+    }
+}
+
+void InstancedRenderer::draw() const
+{
+    Ranges ranges;
+
+    for(int level = 0; level < RENDER_MESH_LEVELS; level++)
+    {
+        addWholeRange(ranges.nodes[level], nodeCount[level]);
+        addWholeRange(ranges.segments[level], segmentCount[level]);
+    }
+    addWholeRange(ranges.points, pointCount);
+    addWholeRange(ranges.lines, lineCount);
+
+    draw(ranges);
+}
+
+void InstancedRenderer::draw(const Ranges& ranges) const
+{
+    for(int level = 0; level < RENDER_MESH_LEVELS; level++)
+    {
+        drawInstances(sphereProgram, sphereVertices[level], sphereIndices[level], sphereIndexCount[level],
+                      nodeBuffer[level], ranges.nodes[level], 2, sizeof(NodeInstance));
+        drawInstances(segmentProgram, segmentVertices[level], segmentIndices[level], segmentIndexCount[level],
+                      segmentBuffer[level], ranges.segments[level], 3, sizeof(SegmentInstance));
+    }
+
+    if(ranges.points.empty() && ranges.lines.empty()) return;
+
+    glPushAttrib(GL_ENABLE_BIT | GL_POINT_BIT | GL_CURRENT_BIT);
+    glPushClientAttrib(GL_CLIENT_VERTEX_ARRAY_BIT);
+    glDisable(GL_LIGHTING);
+    glPointSize(pointSize);
+    glEnableClientState(GL_VERTEX_ARRAY);
+    glEnableClientState(GL_COLOR_ARRAY);
+
+    drawVertices(GL_POINTS, pointBuffer, ranges.points);
+    drawVertices(GL_LINES, lineBuffer, ranges.lines);
+
+    glPopClientAttrib();
+    glPopAttrib();
+}
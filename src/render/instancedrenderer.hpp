@@ -0,0 +1,169 @@
+/*
+ * Mycelia immersive 3d network visualization tool.
+ * Copyright (C) 2008-2010 Sean Whalen.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __INSTANCEDRENDERER_HPP
+#define __INSTANCEDRENDERER_HPP
+
+#include <GL/gl.h>
+#include <GL/glext.h>
+#include <utility>
+#include <vector>
+
+#define RENDER_MESH_LEVELS 2 // full and low detail meshes
+#define RENDER_SPHERE_SLICES 20 // matches the gluSphere of the display list path
+#define RENDER_SPHERE_STACKS 20
+#define RENDER_SEGMENT_SLICES 10
+#define RENDER_LOW_SPHERE_SLICES 8
+#define RENDER_LOW_SPHERE_STACKS 6
+#define RENDER_LOW_SEGMENT_SLICES 4
+
+/*
+ * Draws nodes and edges as instances of two shared meshes, a unit sphere
+ * and a unit frustum, with per-instance data kept in vertex buffers. Edges
+ * and arrow heads are both frustums between two points, with a radius at
+ * each end. Each mesh comes in RENDER_MESH_LEVELS levels of detail, and
+ * far away geometry can be given as unlit points and lines instead. Needs
+ * vertex buffers, GLSL 1.20 and ARB instancing; one renderer exists per GL
+ * context.
+ */
+class InstancedRenderer
+{
+public:
+    struct NodeInstance
+    {
+        GLfloat center[4]; // xyz, radius
+        GLfloat color[4];
+    };
+
+    struct SegmentInstance
+    {
+        GLfloat source[4]; // xyz, radius at the source end
+        GLfloat target[4]; // xyz, radius at the target end
+        GLfloat color[4];
+    };
+
+    struct PointVertex
+    {
+        GLfloat position[3];
+        GLfloat color[4];
+    };
+
+    typedef std::vector<std::pair<int, int> > RangeList; // (first, count)
+
+    // parts of each buffer to draw, e.g. what survived culling
+    struct Ranges
+    {
+        RangeList nodes[RENDER_MESH_LEVELS];
+        RangeList segments[RENDER_MESH_LEVELS];
+        RangeList points;
+        RangeList lines; // in vertices
+
+        void clear()
+        {
+            for(int level = 0; level < RENDER_MESH_LEVELS; level++)
+            {
+                nodes[level].clear();
+                segments[level].clear();
+            }
+            points.clear();
+            lines.clear();
+        }
+    };
+
+private:
+    // entry points resolved through GLExtensionManager
+    PFNGLGENBUFFERSARBPROC genBuffers;
+    PFNGLDELETEBUFFERSARBPROC deleteBuffers;
+    PFNGLBINDBUFFERARBPROC bindBuffer;
+    PFNGLBUFFERDATAARBPROC bufferData;
+    PFNGLBUFFERSUBDATAARBPROC bufferSubData;
+    PFNGLCREATESHADEROBJECTARBPROC createShader;
+    PFNGLSHADERSOURCEARBPROC shaderSource;
+    PFNGLCOMPILESHADERARBPROC compileShader;
+    PFNGLCREATEPROGRAMOBJECTARBPROC createProgram;
+    PFNGLATTACHOBJECTARBPROC attachObject;
+    PFNGLBINDATTRIBLOCATIONARBPROC bindAttribLocation;
+    PFNGLLINKPROGRAMARBPROC linkProgram;
+    PFNGLGETOBJECTPARAMETERIVARBPROC getObjectParameteriv;
+    PFNGLGETINFOLOGARBPROC getInfoLog;
+    PFNGLUSEPROGRAMOBJECTARBPROC useProgram;
+    PFNGLDELETEOBJECTARBPROC deleteObject;
+    PFNGLVERTEXATTRIBPOINTERARBPROC vertexAttribPointer;
+    PFNGLENABLEVERTEXATTRIBARRAYARBPROC enableVertexAttribArray;
+    PFNGLDISABLEVERTEXATTRIBARRAYARBPROC disableVertexAttribArray;
+    PFNGLVERTEXATTRIBDIVISORARBPROC vertexAttribDivisor;
+    PFNGLDRAWELEMENTSINSTANCEDARBPROC drawElementsInstanced;
+
+    GLhandleARB sphereProgram;
+    GLhandleARB segmentProgram;
+
+    // shared meshes, one per level of detail
+    GLuint sphereVertices[RENDER_MESH_LEVELS], sphereIndices[RENDER_MESH_LEVELS];
+    GLuint segmentVertices[RENDER_MESH_LEVELS], segmentIndices[RENDER_MESH_LEVELS];
+    GLsizei sphereIndexCount[RENDER_MESH_LEVELS];
+    GLsizei segmentIndexCount[RENDER_MESH_LEVELS];
+
+    // instance data
+    GLuint nodeBuffer[RENDER_MESH_LEVELS];
+    GLuint segmentBuffer[RENDER_MESH_LEVELS];
+    GLsizei nodeCount[RENDER_MESH_LEVELS];
+    GLsizei segmentCount[RENDER_MESH_LEVELS];
+
+    // far away nodes and edges
+    GLuint pointBuffer;
+    GLuint lineBuffer;
+    GLsizei pointCount;
+    GLsizei lineCount;
+    GLfloat pointSize;
+
+    bool initialized;
+
+    GLhandleARB compileProgram(const char*, const char*, const char**, int);
+    void buildSphere(int, int, int);
+    void buildSegment(int, int);
+    void drawInstances(GLhandleARB, GLuint, GLuint, GLsizei, GLuint, const RangeList&, int, GLsizei) const;
+    void drawVertices(GLenum, GLuint, const RangeList&) const;
+    void upload(GLuint, GLsizeiptrARB, const GLvoid*);
+    void uploadRange(GLuint, GLintptrARB, GLsizeiptrARB, const GLvoid*);
+
+public:
+    InstancedRenderer();
+    ~InstancedRenderer();
+
+    static bool isSupported();
+
+    bool init(); // call with the context current, false if shaders fail
+    bool isInitialized() const;
+
+    void setNodes(int, const std::vector<NodeInstance>&); // by mesh level
+    void setSegments(int, const std::vector<SegmentInstance>&);
+    void setPoints(const std::vector<PointVertex>&);
+    void setLines(const std::vector<PointVertex>&); // two vertices per line
+    void setPointSize(GLfloat);
+
+    // rewrite count elements from first on, leaving the rest of the buffer alone
+    void updateNodes(int, int, int, const NodeInstance*);
+    void updateSegments(int, int, int, const SegmentInstance*);
+    void updatePoints(int, int, const PointVertex*);
+    void updateLines(int, int, const PointVertex*);
+
+    void draw() const;
+    void draw(const Ranges&) const;
+};
+
+#endif
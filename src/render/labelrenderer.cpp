@@ -0,0 +1,360 @@
+/*
+ * Mycelia immersive 3d network visualization tool.
+ * Copyright (C) 2008-2010 Sean Whalen.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <ft2build.h>
+#include FT_FREETYPE_H
+
+#include <algorithm>
+#include <cstring>
+
+#include <render/labelrenderer.hpp>
+
+using namespace std;
+
+LabelRenderer::LabelRenderer()
+    : texture(0), unitsPerEm(1), initialized(false),
+      minPixels(LABEL_MIN_PIXELS), cellPixels(LABEL_CELL_PIXELS), cellCapacity(LABEL_CELL_CAPACITY)
+{
+    memset(glyphs, 0, sizeof(glyphs));
+}
+
+LabelRenderer::~LabelRenderer()
+{
+    if(initialized)
+    {
+        glDeleteTextures(1, &texture);
+    }
+}
+
+/*
+ * Renders the printable ascii glyphs of a font into the atlas texture. Glyph
+ * metrics are kept in font units of faceSize per em, so labels come out the
+ * same size as FTGL text rendered at that face size.
+ */
+bool LabelRenderer::init(const char* fontPath, float faceSize)
+{
+    FT_Library library;
+    FT_Face face;
+
+    if(FT_Init_FreeType(&library))
+    {
+        return false;
+    }
+
+    if(FT_New_Face(library, fontPath, 0, &face))
+    {
+        cerr << "Failed to load label font: " << fontPath << endl;
+        FT_Done_FreeType(library);
+        return false;
+    }
+
+    FT_Set_Pixel_Sizes(face, 0, LABEL_GLYPH_SIZE);
+
+    unitsPerEm = faceSize;
+    float unit = faceSize / LABEL_GLYPH_SIZE; // font units per atlas pixel
+    vector<GLubyte> atlas(LABEL_ATLAS_SIZE * LABEL_ATLAS_SIZE, 0);
+    int x = LABEL_GLYPH_PADDING;
+    int y = LABEL_GLYPH_PADDING;
+    int rowHeight = 0;
+    bool fits = true;
+
+    for(int c = LABEL_FIRST_GLYPH; c <= LABEL_LAST_GLYPH && fits; c++)
+    {
+        if(FT_Load_Char(face, c, FT_LOAD_RENDER))
+        {
+            continue;
+        }
+
+        FT_GlyphSlot slot = face->glyph;
+        const FT_Bitmap& bitmap = slot->bitmap;
+        int w = bitmap.width;
+        int h = bitmap.rows;
+
+        // next shelf
+        if(x + w + LABEL_GLYPH_PADDING > LABEL_ATLAS_SIZE)
+        {
+            x = LABEL_GLYPH_PADDING;
+            y += rowHeight + LABEL_GLYPH_PADDING;
+            rowHeight = 0;
+        }
+
+        if(y + h + LABEL_GLYPH_PADDING > LABEL_ATLAS_SIZE)
+        {
+            fits = false;
+            break;
+        }
+
+        for(int row = 0; row < h; row++)
+        {
+            memcpy(&atlas[(y + row) * LABEL_ATLAS_SIZE + x], bitmap.buffer + row * bitmap.pitch, w);
+        }
+
+        // atlas rows run top down, so v0 is the top of the glyph
+        Glyph& glyph = glyphs[c - LABEL_FIRST_GLYPH];
+        glyph.advance = slot->advance.x / 64.0 * unit;
+        glyph.left = slot->bitmap_left * unit;
+        glyph.right = (slot->bitmap_left + w) * unit;
+        glyph.top = slot->bitmap_top * unit;
+        glyph.bottom = (slot->bitmap_top - h) * unit;
+        glyph.u0 = (float)x / LABEL_ATLAS_SIZE;
+        glyph.v0 = (float)y / LABEL_ATLAS_SIZE;
+        glyph.u1 = (float)(x + w) / LABEL_ATLAS_SIZE;
+        glyph.v1 = (float)(y + h) / LABEL_ATLAS_SIZE;
+
+        x += w + LABEL_GLYPH_PADDING;
+        rowHeight = max(rowHeight, h);
+    }
+
+    FT_Done_Face(face);
+    FT_Done_FreeType(library);
+
+    if(!fits)
+    {
+        cerr << "Label atlas too small for font: " << fontPath << endl;
+        return false;
+    }
+
+    glGenTextures(1, &texture);
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glPushClientAttrib(GL_CLIENT_PIXEL_STORE_BIT);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    gluBuild2DMipmaps(GL_TEXTURE_2D, GL_ALPHA, LABEL_ATLAS_SIZE, LABEL_ATLAS_SIZE, GL_ALPHA, GL_UNSIGNED_BYTE, &atlas[0]);
+    glPopClientAttrib();
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    initialized = true;
+    return true;
+}
+
+bool LabelRenderer::isInitialized() const
+{
+    return initialized;
+}
+
+void LabelRenderer::setCulling(double minPixels, int cellPixels, int cellCapacity)
+{
+    this->minPixels = minPixels;
+    this->cellPixels = max(cellPixels, 1);
+    this->cellCapacity = cellCapacity;
+}
+
+const LabelRenderer::Layout& LabelRenderer::getLayout(const string& text)
+{
+    tr1::unordered_map<string, Layout>::iterator it = layouts.find(text);
+
+    if(it != layouts.end())
+    {
+        return it->second;
+    }
+
+    Layout& layout = layouts[text];
+    float pen = 0;
+
+    for(int i = 0; i < (int)text.size(); i++)
+    {
+        // anything outside the atlas advances like a space
+        int c = (unsigned char)text[i];
+        if(c < LABEL_FIRST_GLYPH || c > LABEL_LAST_GLYPH) c = ' ';
+
+        const Glyph& glyph = glyphs[c - LABEL_FIRST_GLYPH];
+
+        if(glyph.right > glyph.left)
+        {
+            float quad[8] = {pen + glyph.left, glyph.bottom, pen + glyph.right, glyph.top,
+                             glyph.u0, glyph.v0, glyph.u1, glyph.v1};
+            layout.quads.insert(layout.quads.end(), quad, quad + 8);
+        }
+
+        pen += glyph.advance;
+    }
+
+    return layout;
+}
+
+// starts a new frame of labels
+void LabelRenderer::clear()
+{
+    candidates.clear();
+
+    // layouts are only dropped between frames, candidates point into them
+    if((int)layouts.size() >= LABEL_CACHE_SIZE)
+    {
+        layouts.clear();
+    }
+}
+
+void LabelRenderer::add(const Vrui::Point& anchor, const string& text, bool shadow)
+{
+    if(!initialized || text.empty()) return;
+
+    Candidate candidate;
+    candidate.anchor = anchor;
+    candidate.layout = &getLayout(text);
+    candidate.shadow = shadow;
+    candidates.push_back(candidate);
+}
+
+void LabelRenderer::addQuads(const Candidate& candidate, const Vrui::Vector& right, const Vrui::Vector& up,
+                             const Vrui::Vector& offset, bool shadow)
+{
+    const vector<float>& quads = candidate.layout->quads;
+    const float color = shadow ? 0 : 1;
+
+    for(int q = 0; q < (int)quads.size(); q += 8)
+    {
+        // counter-clockwise from the bottom left corner
+        const float corners[4][4] = {{quads[q], quads[q + 1], quads[q + 4], quads[q + 7]},
+                                     {quads[q + 2], quads[q + 1], quads[q + 6], quads[q + 7]},
+                                     {quads[q + 2], quads[q + 3], quads[q + 6], quads[q + 5]},
+                                     {quads[q], quads[q + 3], quads[q + 4], quads[q + 5]}};
+
+        for(int i = 0; i < 4; i++)
+        {
+            Vrui::Point p = candidate.anchor + right * corners[i][0] + up * corners[i][1] + offset;
+            GLfloat vertex[9] = {(GLfloat)p[0], (GLfloat)p[1], (GLfloat)p[2], corners[i][2], corners[i][3], color, color, color, 1};
+            vertices.insert(vertices.end(), vertex, vertex + 9);
+        }
+    }
+}
+
+/*
+ * Culls the labels queued since clear() and draws the rest facing along the
+ * given orientation, at scale world units per font unit.
+ */
+void LabelRenderer::draw(const Vrui::Rotation& orientation, Vrui::Scalar scale)
+{
+    if(!initialized || candidates.empty()) return;
+
+    GLdouble modelview[16];
+    GLdouble projection[16];
+    GLint viewport[4];
+    glGetDoublev(GL_MODELVIEW_MATRIX, modelview);
+    glGetDoublev(GL_PROJECTION_MATRIX, projection);
+    glGetIntegerv(GL_VIEWPORT, viewport);
+
+    // column major clip = projection * modelview
+    double clip[16];
+    for(int column = 0; column < 4; column++)
+    {
+        for(int row = 0; row < 4; row++)
+        {
+            clip[column * 4 + row] = 0;
+            for(int k = 0; k < 4; k++)
+            {
+                clip[column * 4 + row] += projection[k * 4 + row] * modelview[column * 4 + k];
+            }
+        }
+    }
+
+    // on-screen em height is emPixels / w
+    double emPixels = scale * unitsPerEm * projection[5] * viewport[3] / 2;
+    int visible = 0;
+
+    for(int i = 0; i < (int)candidates.size(); i++)
+    {
+        Candidate& candidate = candidates[i];
+        const Vrui::Point& p = candidate.anchor;
+        double x = clip[0] * p[0] + clip[4] * p[1] + clip[8] * p[2] + clip[12];
+        double y = clip[1] * p[0] + clip[5] * p[1] + clip[9] * p[2] + clip[13];
+        double z = clip[2] * p[0] + clip[6] * p[1] + clip[10] * p[2] + clip[14];
+        double w = clip[3] * p[0] + clip[7] * p[1] + clip[11] * p[2] + clip[15];
+
+        // labels run right and up from the anchor, so allow some slack on those sides
+        if(w <= 0 || x < -1.5 * w || x > w || y < -1.5 * w || y > w || z < -w || z > w)
+        {
+            continue;
+        }
+
+        if(emPixels < minPixels * w)
+        {
+            continue;
+        }
+
+        candidate.depth = w;
+        candidate.x = x / w;
+        candidate.y = y / w;
+        candidates[visible++] = candidate;
+    }
+
+    candidates.resize(visible);
+
+    // nearest labels claim their screen cells first
+    sort(candidates.begin(), candidates.end());
+
+    int columns = viewport[2] / cellPixels + 1;
+    int rows = viewport[3] / cellPixels + 1;
+    cells.assign(columns * rows, 0);
+    vertices.clear();
+
+    Vrui::Vector right = orientation.transform(Vrui::Vector(1, 0, 0)) * scale;
+    Vrui::Vector up = orientation.transform(Vrui::Vector(0, 1, 0)) * scale;
+    Vrui::Vector out = orientation.transform(Vrui::Vector(0, 0, 1)) * scale;
+    Vrui::Vector noOffset(0, 0, 0);
+    Vrui::Vector shadowOffset = right - out; // one unit right and behind, as before
+
+    for(int i = 0; i < (int)candidates.size(); i++)
+    {
+        const Candidate& candidate = candidates[i];
+        int column = max(0, min(columns - 1, (int)((candidate.x + 1) / 2 * viewport[2] / cellPixels)));
+        int row = max(0, min(rows - 1, (int)((candidate.y + 1) / 2 * viewport[3] / cellPixels)));
+        char& cell = cells[row * columns + column];
+
+        if(cell >= cellCapacity)
+        {
+            continue;
+        }
+        cell++;
+
+        if(candidate.shadow)
+        {
+            addQuads(candidate, right, up, shadowOffset, true);
+        }
+        addQuads(candidate, right, up, noOffset, false);
+    }
+
+    if(!vertices.empty())
+    {
+        glPushAttrib(GL_ENABLE_BIT | GL_TEXTURE_BIT | GL_COLOR_BUFFER_BIT | GL_CURRENT_BIT);
+        glPushClientAttrib(GL_CLIENT_VERTEX_ARRAY_BIT);
+
+        glDisable(GL_LIGHTING);
+        glDisable(GL_CULL_FACE);
+        glEnable(GL_TEXTURE_2D);
+        glBindTexture(GL_TEXTURE_2D, texture);
+        glTexEnvi(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_MODULATE);
+        glEnable(GL_BLEND);
+        glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+
+        glEnableClientState(GL_VERTEX_ARRAY);
+        glEnableClientState(GL_TEXTURE_COORD_ARRAY);
+        glEnableClientState(GL_COLOR_ARRAY);
+        glVertexPointer(3, GL_FLOAT, 9 * sizeof(GLfloat), &vertices[0]);
+        glTexCoordPointer(2, GL_FLOAT, 9 * sizeof(GLfloat), &vertices[3]);
+        glColorPointer(4, GL_FLOAT, 9 * sizeof(GLfloat), &vertices[5]);
+        glDrawArrays(GL_QUADS, 0, vertices.size() / 9);
+
+        glPopClientAttrib();
+        glPopAttrib();
+    }
+
+    candidates.clear();
+}
@@ -0,0 +1,103 @@
+/*
+ * Mycelia immersive 3d network visualization tool.
+ * Copyright (C) 2008-2010 Sean Whalen.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __LABELRENDERER_HPP
+#define __LABELRENDERER_HPP
+
+#include <precompiled.hpp>
+
+#define LABEL_GLYPH_SIZE 48 // atlas pixels per em
+#define LABEL_ATLAS_SIZE 512
+#define LABEL_GLYPH_PADDING 4 // atlas pixels between glyphs, keeps mipmaps from bleeding
+#define LABEL_FIRST_GLYPH 32 // printable ascii
+#define LABEL_LAST_GLYPH 126
+#define LABEL_CACHE_SIZE 65536 // laid out labels kept before the cache starts over
+#define LABEL_MIN_PIXELS 6.0 // defaults for the culling settings, see etc/mycelia.cfg
+#define LABEL_CELL_PIXELS 32
+#define LABEL_CELL_CAPACITY 1
+
+/*
+ * Draws text labels from a single glyph atlas rendered once per GL context
+ * with FreeType. Each distinct string is laid out into glyph quads once and
+ * cached; every frame, queued labels are culled against the view frustum,
+ * dropped when smaller than a minimum on-screen height, thinned so that no
+ * screen cell holds more than a few of the nearest labels, and whatever
+ * survives goes out in one draw call.
+ */
+class LabelRenderer
+{
+private:
+    class Glyph
+    {
+    public:
+        float advance;
+        float left, bottom, right, top; // quad in font units from the pen
+        float u0, v0, u1, v1;
+    };
+
+    class Layout
+    {
+    public:
+        std::vector<float> quads; // left, bottom, right, top, u0, v0, u1, v1 per glyph
+    };
+
+    class Candidate
+    {
+    public:
+        double depth; // clip w, larger is farther
+        double x, y; // normalized device coordinates
+        Vrui::Point anchor;
+        const Layout* layout;
+        bool shadow;
+
+        bool operator<(const Candidate& c) const { return depth < c.depth; }
+    };
+
+    GLuint texture;
+    Glyph glyphs[LABEL_LAST_GLYPH - LABEL_FIRST_GLYPH + 1];
+    float unitsPerEm;
+    bool initialized;
+
+    std::tr1::unordered_map<std::string, Layout> layouts;
+    std::vector<Candidate> candidates;
+    std::vector<char> cells;
+    std::vector<GLfloat> vertices; // x, y, z, u, v, r, g, b, a
+
+    double minPixels;
+    int cellPixels;
+    int cellCapacity;
+
+    const Layout& getLayout(const std::string&);
+    void addQuads(const Candidate&, const Vrui::Vector&, const Vrui::Vector&, const Vrui::Vector&, bool);
+
+public:
+    LabelRenderer();
+    ~LabelRenderer();
+
+    // call with the context current; units per em match FTGL's face size
+    bool init(const char*, float);
+    bool isInitialized() const;
+
+    void setCulling(double, int, int);
+
+    void clear();
+    void add(const Vrui::Point&, const std::string&, bool shadow=true);
+    void draw(const Vrui::Rotation&, Vrui::Scalar);
+};
+
+#endif
@@ -0,0 +1,402 @@
+/*
+ * Mycelia immersive 3d network visualization tool.
+ * Copyright (C) 2008-2010 Sean Whalen.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <render/nodegrid.hpp>
+
+using namespace std;
+
+NodeGrid::NodeGrid()
+{
+    clear();
+}
+
+void NodeGrid::clear()
+{
+    origin = Vrui::Point::origin;
+    cellSize = 1;
+    dims[0] = dims[1] = dims[2] = 0;
+    cells.clear();
+    nodeCells.clear();
+    nodeSlots.clear();
+}
+
+/*
+ * Sizes the cells for about GRID_NODES_PER_CELL nodes each over the padded
+ * bounds of the nodes, then bins every node.
+ */
+void NodeGrid::build(const Vrui::Point* positions, int count, int stride, const GridBox& bounds)
+{
+    Vrui::Scalar maxSide = 0;
+    for(int i = 0; i < 3; i++)
+    {
+        maxSide = max(maxSide, bounds.max[i] - bounds.min[i]);
+    }
+
+    // padding keeps the grid from being rebuilt as soon as the layout expands
+    Vrui::Scalar padding = maxSide > 0 ? GRID_PADDING * maxSide : 1;
+    Vrui::Scalar sides[3];
+    Vrui::Scalar volume = 1;
+
+    for(int i = 0; i < 3; i++)
+    {
+        origin[i] = bounds.min[i] - padding;
+        sides[i] = bounds.max[i] - bounds.min[i] + 2 * padding;
+        volume *= sides[i];
+    }
+
+    int targetCells = max(1, min(count / GRID_NODES_PER_CELL, GRID_MAX_CELLS));
+    cellSize = Math::pow(volume / targetCells, 1.0 / 3.0);
+
+    while(true)
+    {
+        long cellCount = 1;
+        for(int i = 0; i < 3; i++)
+        {
+            dims[i] = max(1, (int)ceil(sides[i] / cellSize));
+            cellCount *= dims[i];
+        }
+
+        if(cellCount <= GRID_MAX_CELLS) break;
+        cellSize *= 1.25;
+    }
+
+    cells.assign(dims[0] * dims[1] * dims[2], vector<int>());
+    nodeCells.resize(count);
+    nodeSlots.resize(count);
+
+    for(int index = 0; index < count; index++)
+    {
+        insert(index, getCell(positions[index * stride]));
+    }
+}
+
+bool NodeGrid::update(const vector<Vrui::Point>& positions)
+{
+    return update(positions.empty() ? 0 : &positions[0], positions.size());
+}
+
+/*
+ * Brings the bins up to date with new positions. Only nodes that strayed
+ * out of their cell's loose bounds move, unless the grid no longer fits.
+ */
+bool NodeGrid::update(const Vrui::Point* positions, int count, int stride)
+{
+    if(count == 0)
+    {
+        clear();
+        return true;
+    }
+
+    GridBox bounds;
+    for(int index = 0; index < count; index++)
+    {
+        bounds.add(positions[index * stride]);
+    }
+
+    bool rebuild = count != (int)nodeCells.size() || cells.empty();
+
+    if(!rebuild)
+    {
+        GridBox grid;
+        Vrui::Scalar gridSide = 0;
+        Vrui::Scalar boundsSide = 0;
+
+        for(int i = 0; i < 3; i++)
+        {
+            grid.min[i] = origin[i] - GRID_LOOSENESS * cellSize;
+            grid.max[i] = origin[i] + (dims[i] + GRID_LOOSENESS) * cellSize;
+            gridSide = max(gridSide, dims[i] * cellSize);
+            boundsSide = max(boundsSide, bounds.max[i] - bounds.min[i]);
+        }
+
+        // a converged layout should not be left in a handful of huge cells
+        rebuild = !grid.contains(bounds.min) || !grid.contains(bounds.max) || boundsSide < GRID_PADDING * gridSide;
+    }
+
+    if(rebuild)
+    {
+        build(positions, count, stride, bounds);
+        return true;
+    }
+
+    for(int index = 0; index < count; index++)
+    {
+        const Vrui::Point& p = positions[index * stride];
+
+        if(!getCellBounds(nodeCells[index]).contains(p))
+        {
+            remove(index);
+            insert(index, getCell(p));
+        }
+    }
+
+    return false;
+}
+
+int NodeGrid::getCell(const Vrui::Point& p) const
+{
+    int c[3];
+    for(int i = 0; i < 3; i++)
+    {
+        c[i] = max(0, min(dims[i] - 1, (int)floor((p[i] - origin[i]) / cellSize)));
+    }
+
+    return (c[2] * dims[1] + c[1]) * dims[0] + c[0];
+}
+
+void NodeGrid::insert(int index, int cell)
+{
+    nodeCells[index] = cell;
+    nodeSlots[index] = cells[cell].size();
+    cells[cell].push_back(index);
+}
+
+void NodeGrid::remove(int index)
+{
+    vector<int>& nodes = cells[nodeCells[index]];
+    int last = nodes.back();
+    nodes[nodeSlots[index]] = last;
+    nodeSlots[last] = nodeSlots[index];
+    nodes.pop_back();
+}
+
+GridBox NodeGrid::getCellBounds(int cell) const
+{
+    int c[3] = { cell % dims[0], (cell / dims[0]) % dims[1], cell / (dims[0] * dims[1]) };
+    GridBox b;
+
+    for(int i = 0; i < 3; i++)
+    {
+        b.min[i] = origin[i] + (c[i] - GRID_LOOSENESS) * cellSize;
+        b.max[i] = origin[i] + (c[i] + 1 + GRID_LOOSENESS) * cellSize;
+    }
+
+    return b;
+}
+
+GridBox NodeGrid::getBounds() const
+{
+    GridBox b;
+
+    if(!cells.empty())
+    {
+        for(int i = 0; i < 3; i++)
+        {
+            b.min[i] = origin[i] - GRID_LOOSENESS * cellSize;
+            b.max[i] = origin[i] + (dims[i] + GRID_LOOSENESS) * cellSize;
+        }
+    }
+
+    return b;
+}
+
+void NodeGrid::getCells(const GridBox& box, vector<int>& result) const
+{
+    result.clear();
+
+    if(cells.empty() || box.isEmpty()) return;
+
+    int low[3], high[3];
+    for(int i = 0; i < 3; i++)
+    {
+        low[i] = max(0, (int)floor((box.min[i] - origin[i]) / cellSize - GRID_LOOSENESS));
+        high[i] = min(dims[i] - 1, (int)floor((box.max[i] - origin[i]) / cellSize + GRID_LOOSENESS));
+    }
+
+    for(int z = low[2]; z <= high[2]; z++)
+    {
+        for(int y = low[1]; y <= high[1]; y++)
+        {
+            for(int x = low[0]; x <= high[0]; x++)
+            {
+                result.push_back((z * dims[1] + y) * dims[0] + x);
+            }
+        }
+    }
+}
+
+/*
+ * Walks the ray through the grid in slabs one cell deep. During the slab
+ * [s0, s1] along the ray, nodes inside the cone lie within t * s1 of the
+ * ray, so only cells meeting that box are searched, each one once. Once a
+ * slab leaves a best node no farther than its end, nodes in later slabs
+ * can only be farther along the ray.
+ */
+int NodeGrid::pickRay(const vector<Vrui::Point>& positions, const Vrui::Ray& ray, Vrui::Scalar tan2) const
+{
+    // also rejects a NaN cone
+    if(cells.empty() || (int)positions.size() != getNodeCount() || !(tan2 >= 0))
+    {
+        return -1;
+    }
+
+    Vrui::Vector direction = ray.getDirection();
+    direction.normalize();
+    const Vrui::Point& rayOrigin = ray.getOrigin();
+    Vrui::Scalar tangent = Math::sqrt(tan2);
+
+    // range along the ray of the grid's corners, nodes lie within
+    GridBox bounds = getBounds();
+    Vrui::Scalar first = numeric_limits<Vrui::Scalar>::max();
+    Vrui::Scalar last = -numeric_limits<Vrui::Scalar>::max();
+
+    for(int corner = 0; corner < 8; corner++)
+    {
+        Vrui::Point p;
+        for(int i = 0; i < 3; i++)
+        {
+            p[i] = (corner >> i) & 1 ? bounds.max[i] : bounds.min[i];
+        }
+
+        Vrui::Scalar along = (p - rayOrigin) * direction;
+        first = min(first, along);
+        last = max(last, along);
+    }
+
+    first = max(first, Vrui::Scalar(0));
+
+    int best = -1;
+    Vrui::Scalar bestAlong = numeric_limits<Vrui::Scalar>::max();
+    vector<bool> visited(cells.size(), false);
+    vector<int> found;
+
+    for(Vrui::Scalar s0 = first; s0 <= last; s0 += cellSize)
+    {
+        Vrui::Scalar s1 = s0 + cellSize;
+        Vrui::Scalar radius = tangent * s1;
+        GridBox slab;
+        slab.add(rayOrigin + direction * s0, radius);
+        slab.add(rayOrigin + direction * s1, radius);
+
+        getCells(slab, found);
+
+        for(int i = 0; i < (int)found.size(); i++)
+        {
+            if(visited[found[i]]) continue;
+            visited[found[i]] = true;
+
+            const vector<int>& nodes = cells[found[i]];
+
+            for(int j = 0; j < (int)nodes.size(); j++)
+            {
+                Vrui::Vector sp = positions[nodes[j]] - rayOrigin;
+                Vrui::Scalar along = sp * direction;
+
+                if(along > 0 && along < bestAlong && Geometry::sqr(Geometry::cross(sp, direction)) <= tan2 * along * along)
+                {
+                    best = nodes[j];
+                    bestAlong = along;
+                }
+            }
+        }
+
+        if(best >= 0 && bestAlong <= s1)
+        {
+            break;
+        }
+    }
+
+    return best;
+}
+
+/*
+ * Searches shells of cells around the query's cell, one cell thicker each
+ * time, keeping the k best in a heap. The search ends when the k-th best
+ * is nearer than any cell outside the shells can reach, or the shells
+ * cover the grid.
+ */
+void NodeGrid::getNearest(const vector<Vrui::Point>& positions, const Vrui::Point& p, int k,
+                          vector<pair<Vrui::Scalar, int> >& result) const
+{
+    result.clear();
+
+    if(cells.empty() || (int)positions.size() != getNodeCount() || k <= 0)
+    {
+        return;
+    }
+
+    int center = getCell(p);
+    int c[3] = { center % dims[0], (center / dims[0]) % dims[1], center / (dims[0] * dims[1]) };
+    int maxRing = max(max(dims[0], dims[1]), dims[2]);
+
+    // result doubles as a max heap on the squared distance
+    for(int ring = 0; ring <= maxRing; ring++)
+    {
+        int low[3], high[3];
+        for(int i = 0; i < 3; i++)
+        {
+            low[i] = max(0, c[i] - ring);
+            high[i] = min(dims[i] - 1, c[i] + ring);
+        }
+
+        for(int z = low[2]; z <= high[2]; z++)
+        {
+            for(int y = low[1]; y <= high[1]; y++)
+            {
+                for(int x = low[0]; x <= high[0]; x++)
+                {
+                    // only the shell, inner cells were searched before
+                    if(max(max(abs(x - c[0]), abs(y - c[1])), abs(z - c[2])) != ring) continue;
+
+                    const vector<int>& nodes = cells[(z * dims[1] + y) * dims[0] + x];
+
+                    for(int j = 0; j < (int)nodes.size(); j++)
+                    {
+                        Vrui::Scalar dist2 = Geometry::sqrDist(p, positions[nodes[j]]);
+
+                        if((int)result.size() < k)
+                        {
+                            result.push_back(make_pair(dist2, nodes[j]));
+                            push_heap(result.begin(), result.end());
+                        }
+                        else if(dist2 < result.front().first)
+                        {
+                            pop_heap(result.begin(), result.end());
+                            result.back() = make_pair(dist2, nodes[j]);
+                            push_heap(result.begin(), result.end());
+                        }
+                    }
+                }
+            }
+        }
+
+        if((int)result.size() < k) continue;
+
+        // nearest any unsearched cell's loose bounds can come
+        Vrui::Scalar reach = numeric_limits<Vrui::Scalar>::max();
+        for(int i = 0; i < 3; i++)
+        {
+            if(c[i] - ring > 0)
+            {
+                reach = min(reach, max(Vrui::Scalar(0), p[i] - (origin[i] + (c[i] - ring + GRID_LOOSENESS) * cellSize)));
+            }
+
+            if(c[i] + ring < dims[i] - 1)
+            {
+                reach = min(reach, max(Vrui::Scalar(0), origin[i] + (c[i] + ring + 1 - GRID_LOOSENESS) * cellSize - p[i]));
+            }
+        }
+
+        if(reach == numeric_limits<Vrui::Scalar>::max() || result.front().first <= reach * reach)
+        {
+            break;
+        }
+    }
+
+    sort_heap(result.begin(), result.end());
+}
@@ -0,0 +1,140 @@
+/*
+ * Mycelia immersive 3d network visualization tool.
+ * Copyright (C) 2008-2010 Sean Whalen.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __NODEGRID_HPP
+#define __NODEGRID_HPP
+
+#include <precompiled.hpp>
+
+#define GRID_NODES_PER_CELL 16 // target occupancy when the grid is sized
+#define GRID_MAX_CELLS 262144
+#define GRID_LOOSENESS 0.5 // of a cell a node may stray outside it before moving
+#define GRID_PADDING 0.25 // of the extent added around the nodes on a rebuild
+
+/*
+ * Axis aligned box, empty until something is added.
+ */
+class GridBox
+{
+public:
+    Vrui::Point min;
+    Vrui::Point max;
+
+    GridBox()
+    {
+        clear();
+    }
+
+    void clear()
+    {
+        for(int i = 0; i < 3; i++)
+        {
+            min[i] = std::numeric_limits<Vrui::Scalar>::max();
+            max[i] = -std::numeric_limits<Vrui::Scalar>::max();
+        }
+    }
+
+    bool isEmpty() const { return min[0] > max[0]; }
+
+    void add(const Vrui::Point& p, Vrui::Scalar radius = 0)
+    {
+        for(int i = 0; i < 3; i++)
+        {
+            min[i] = std::min(min[i], p[i] - radius);
+            max[i] = std::max(max[i], p[i] + radius);
+        }
+    }
+
+    void add(const GridBox& b)
+    {
+        if(b.isEmpty()) return;
+        add(b.min);
+        add(b.max);
+    }
+
+    bool contains(const Vrui::Point& p) const
+    {
+        for(int i = 0; i < 3; i++)
+        {
+            if(p[i] < min[i] || p[i] > max[i]) return false;
+        }
+        return true;
+    }
+
+    bool intersects(const GridBox& b) const
+    {
+        for(int i = 0; i < 3; i++)
+        {
+            if(b.max[i] < min[i] || b.min[i] > max[i]) return false;
+        }
+        return true;
+    }
+};
+
+/*
+ * Loose uniform grid over node positions by dense index. Nodes are binned
+ * by position, then stay in their cell until they stray more than
+ * GRID_LOOSENESS of a cell outside it, so layout steps mostly leave the
+ * bins alone. The grid is rebuilt when the node count changes, a node
+ * leaves the grid, or the nodes have shrunk to a fraction of it. Besides
+ * culling, it answers ray and nearest node picks by visiting cells outward
+ * from the query until no unvisited cell can hold a better node.
+ */
+class NodeGrid
+{
+private:
+    Vrui::Point origin;
+    Vrui::Scalar cellSize;
+    int dims[3];
+
+    std::vector<std::vector<int> > cells; // dense node indices
+    std::vector<int> nodeCells;
+    std::vector<int> nodeSlots; // position within the cell
+
+    void build(const Vrui::Point*, int, int, const GridBox&);
+    int getCell(const Vrui::Point&) const;
+    void insert(int, int);
+    void remove(int);
+
+public:
+    NodeGrid();
+
+    void clear();
+    bool update(const std::vector<Vrui::Point>&); // true if rebuilt
+    bool update(const Vrui::Point*, int, int stride=1); // count points, stride apart
+
+    int getCellCount() const { return cells.size(); }
+    const std::vector<int>& getCellNodes(int cell) const { return cells[cell]; }
+    int getNodeCell(int index) const { return nodeCells[index]; }
+    int getNodeCount() const { return nodeCells.size(); }
+    Vrui::Scalar getCellSize() const { return cellSize; }
+
+    GridBox getCellBounds(int) const; // loose, holds every node binned there
+    GridBox getBounds() const; // loose, holds every node
+    void getCells(const GridBox&, std::vector<int>&) const; // cells whose loose bounds meet the box
+
+    // picking, over the positions the grid was last updated with: the node
+    // nearest the ray origin, along the ray, whose squared tangent of the
+    // angle off the ray is at most tan2, or -1; and the k nearest nodes to a
+    // point as (squared distance, index), nearest first
+    int pickRay(const std::vector<Vrui::Point>&, const Vrui::Ray&, Vrui::Scalar tan2) const;
+    void getNearest(const std::vector<Vrui::Point>&, const Vrui::Point&, int k,
+                    std::vector<std::pair<Vrui::Scalar, int> >&) const;
+};
+
+#endif
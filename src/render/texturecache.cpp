@@ -0,0 +1,307 @@
+/*
+ * Mycelia immersive 3d network visualization tool.
+ * Copyright (C) 2008-2010 Sean Whalen.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <render/texturecache.hpp>
+
+using namespace std;
+
+TextureCache::TextureCache(int megabytes, int maxSize, bool mipmaps, int uploadsPerFrame)
+    : shutdown(false),
+      bytes(0),
+      budget((size_t)megabytes * 1024 * 1024),
+      maxSize(maxSize),
+      mipmaps(mipmaps),
+      uploadsPerFrame(uploadsPerFrame),
+      frame(0)
+{
+    // grey and half transparent while the image loads
+    const GLubyte texel[4] = { 128, 128, 128, 128 };
+    glGenTextures(1, &placeholder);
+    glBindTexture(GL_TEXTURE_2D, placeholder);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, texel);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    thread = new Threads::Thread();
+    thread->start(this, &TextureCache::decode);
+}
+
+TextureCache::~TextureCache()
+{
+    mutex.lock();
+    shutdown = true;
+    requestCond.signal();
+    mutex.unlock();
+
+    thread->join();
+    delete thread;
+
+    tr1::unordered_map<string, Entry>::iterator it;
+    for(it = entries.begin(); it != entries.end(); ++it)
+    {
+        if(it->second.id != 0)
+        {
+            glDeleteTextures(1, &it->second.id);
+        }
+    }
+    glDeleteTextures(1, &placeholder);
+}
+
+void* TextureCache::decode()
+{
+    while(true)
+    {
+        mutex.lock();
+        while(requests.empty() && !shutdown)
+        {
+            requestCond.wait(mutex);
+        }
+
+        if(shutdown)
+        {
+            mutex.unlock();
+            return 0;
+        }
+
+        Decoded image;
+        image.path = requests.front();
+        requests.pop_front();
+        mutex.unlock();
+
+        image.width = image.height = 0;
+        image.failed = false;
+
+        try
+        {
+            Images::RGBAImage file = Images::readTransparentImageFile(image.path.c_str());
+            image.width = file.getWidth();
+            image.height = file.getHeight();
+            image.size = SizePair(image.width, image.height);
+
+            const GLubyte* pixels = reinterpret_cast<const GLubyte*>(file.getPixels());
+            image.pixels.assign(pixels, pixels + image.width * image.height * 4);
+        }
+        catch (...)
+        {
+            cerr << "Failed to load image: " << image.path << endl;
+            image.failed = true;
+        }
+
+        if(!image.failed)
+        {
+            downsample(image);
+        }
+
+        // hand the pixels over without copying them
+        mutex.lock();
+        decoded.push_back(Decoded());
+        decoded.back().path = image.path;
+        decoded.back().width = image.width;
+        decoded.back().height = image.height;
+        decoded.back().size = image.size;
+        decoded.back().pixels.swap(image.pixels);
+        decoded.back().failed = image.failed;
+        mutex.unlock();
+    }
+}
+
+/*
+ * Halves the image with a box filter until both sides fit in maxSize.
+ */
+void TextureCache::downsample(Decoded& image) const
+{
+    while(image.width > maxSize || image.height > maxSize)
+    {
+        int width = max(1, image.width / 2);
+        int height = max(1, image.height / 2);
+        vector<GLubyte> pixels(width * height * 4);
+
+        for(int y = 0; y < height; y++)
+        {
+            // odd sides fold their last row or column into the previous one
+            int y0 = min(2 * y, image.height - 1);
+            int y1 = min(2 * y + 1, image.height - 1);
+
+            for(int x = 0; x < width; x++)
+            {
+                int x0 = min(2 * x, image.width - 1);
+                int x1 = min(2 * x + 1, image.width - 1);
+
+                for(int c = 0; c < 4; c++)
+                {
+                    int sum = image.pixels[(y0 * image.width + x0) * 4 + c] +
+                              image.pixels[(y0 * image.width + x1) * 4 + c] +
+                              image.pixels[(y1 * image.width + x0) * 4 + c] +
+                              image.pixels[(y1 * image.width + x1) * 4 + c];
+                    pixels[(y * width + x) * 4 + c] = (sum + 2) / 4;
+                }
+            }
+        }
+
+        image.width = width;
+        image.height = height;
+        image.pixels.swap(pixels);
+    }
+}
+
+TextureCache::Entry& TextureCache::request(const string& path)
+{
+    tr1::unordered_map<string, Entry>::iterator it = entries.find(path);
+
+    if(it != entries.end())
+    {
+        return it->second;
+    }
+
+    Entry& entry = entries[path];
+    entry.id = 0;
+    entry.size = SizePair(1, 1);
+    entry.bytes = 0;
+    entry.failed = false;
+    entry.lastUsed = frame;
+    entry.position = lru.end();
+
+    mutex.lock();
+    requests.push_back(path);
+    requestCond.signal();
+    mutex.unlock();
+
+    return entry;
+}
+
+TextureCache::TexturePair TextureCache::getTexture(const string& path)
+{
+    if(path == "")
+    {
+        return TexturePair(0, SizePair(0, 0));
+    }
+
+    Entry& entry = request(path);
+    entry.lastUsed = frame;
+
+    if(entry.failed)
+    {
+        return TexturePair(0, SizePair(0, 0));
+    }
+
+    if(entry.id == 0)
+    {
+        return TexturePair(placeholder, entry.size);
+    }
+
+    lru.splice(lru.begin(), lru, entry.position);
+    return TexturePair(entry.id, entry.size);
+}
+
+bool TextureCache::isUsable(const string& path)
+{
+    return path != "" && !request(path).failed;
+}
+
+void TextureCache::upload(Entry& entry, const Decoded& image)
+{
+    glGenTextures(1, &entry.id);
+    glBindTexture(GL_TEXTURE_2D, entry.id);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+    if(mipmaps)
+    {
+        // far away image nodes sample the smaller levels
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+        gluBuild2DMipmaps(GL_TEXTURE_2D, GL_RGBA, image.width, image.height, GL_RGBA, GL_UNSIGNED_BYTE, &image.pixels[0]);
+        entry.bytes = image.pixels.size() * 4 / 3;
+    }
+    else
+    {
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, image.width, image.height, 0, GL_RGBA, GL_UNSIGNED_BYTE, &image.pixels[0]);
+        entry.bytes = image.pixels.size();
+    }
+
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    entry.size = image.size;
+    bytes += entry.bytes;
+    lru.push_front(image.path);
+    entry.position = lru.begin();
+}
+
+/*
+ * Drops least recently used textures until the budget holds, stopping at
+ * the first one drawn this frame so visible images never flicker.
+ */
+void TextureCache::evict()
+{
+    while(bytes > budget && !lru.empty())
+    {
+        tr1::unordered_map<string, Entry>::iterator it = entries.find(lru.back());
+
+        if(it->second.lastUsed == frame)
+        {
+            break;
+        }
+
+        glDeleteTextures(1, &it->second.id);
+        bytes -= it->second.bytes;
+        lru.pop_back();
+        entries.erase(it); // loaded again on the next use
+    }
+}
+
+bool TextureCache::update()
+{
+    list<Decoded> ready;
+
+    mutex.lock();
+    list<Decoded>::iterator end = decoded.begin();
+    for(int i = 0; i < uploadsPerFrame && end != decoded.end(); i++)
+    {
+        ++end;
+    }
+    ready.splice(ready.end(), decoded, decoded.begin(), end);
+    mutex.unlock();
+
+    bool failed = false;
+
+    for(list<Decoded>::const_iterator image = ready.begin(); image != ready.end(); ++image)
+    {
+        tr1::unordered_map<string, Entry>::iterator it = entries.find(image->path);
+
+        // nobody is waiting for this one any more
+        if(it == entries.end() || it->second.id != 0)
+        {
+            continue;
+        }
+
+        if(image->failed)
+        {
+            it->second.failed = true;
+            failed = true;
+        }
+        else
+        {
+            upload(it->second, *image);
+        }
+    }
+
+    evict();
+    frame++;
+
+    return failed;
+}
@@ -0,0 +1,108 @@
+/*
+ * Mycelia immersive 3d network visualization tool.
+ * Copyright (C) 2008-2010 Sean Whalen.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __TEXTURECACHE_HPP
+#define __TEXTURECACHE_HPP
+
+#include <precompiled.hpp>
+
+#include <deque>
+
+#define TEXTURE_CACHE_MEGABYTES 256 // defaults for the settings, see etc/mycelia.cfg
+#define TEXTURE_MAX_SIZE 1024 // images are halved on decode until both sides fit
+#define TEXTURE_UPLOADS_PER_FRAME 4
+
+/*
+ * Textures for image nodes, one cache per GL context. Images are decoded
+ * and downsampled by a worker thread; until a texture is uploaded a small
+ * placeholder is handed out instead. Uploaded textures are kept in least
+ * recently used order and evicted once they exceed the memory budget,
+ * except those drawn in the current frame.
+ */
+class TextureCache
+{
+public:
+    typedef std::pair<int, int> SizePair;
+    typedef std::pair<GLuint, SizePair> TexturePair;
+
+private:
+    // handed from the worker to the context thread
+    class Decoded
+    {
+    public:
+        std::string path;
+        int width; // as stored, after downsampling
+        int height;
+        SizePair size; // of the image file, for the aspect ratio
+        std::vector<GLubyte> pixels; // rgba
+        bool failed;
+    };
+
+    class Entry
+    {
+    public:
+        GLuint id; // 0 until uploaded
+        SizePair size;
+        size_t bytes;
+        bool failed;
+        int lastUsed; // frame
+        std::list<std::string>::iterator position; // in lru, once uploaded
+    };
+
+    // decode worker
+    Threads::Thread* thread;
+    Threads::Mutex mutex;
+    Threads::Cond requestCond;
+    std::deque<std::string> requests;
+    std::list<Decoded> decoded;
+    bool shutdown;
+
+    void* decode();
+    void downsample(Decoded&) const; // maxSize never changes, so no lock is needed
+
+    // context side
+    std::tr1::unordered_map<std::string, Entry> entries;
+    std::list<std::string> lru; // most recently used first
+    size_t bytes;
+    size_t budget;
+    int maxSize;
+    bool mipmaps;
+    int uploadsPerFrame;
+    int frame;
+    GLuint placeholder;
+
+    Entry& request(const std::string&);
+    void upload(Entry&, const Decoded&);
+    void evict();
+
+public:
+    TextureCache(int megabytes=TEXTURE_CACHE_MEGABYTES, int maxSize=TEXTURE_MAX_SIZE,
+                 bool mipmaps=true, int uploadsPerFrame=TEXTURE_UPLOADS_PER_FRAME); // with the context current
+    ~TextureCache();
+
+    // the texture to draw now, the placeholder while loading, or id 0 if
+    // the path is empty or the image failed to load
+    TexturePair getTexture(const std::string&);
+    bool isUsable(const std::string&); // false only once loading failed, does not count as a use
+
+    // once per frame: uploads what the worker finished and evicts; true if
+    // an image failed since the last call, so offsets built around it are stale
+    bool update();
+};
+
+#endif
@@ -0,0 +1,86 @@
+/*
+ * Mycelia immersive 3d network visualization tool.
+ * Copyright (C) 2008-2010 Sean Whalen.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __VIEWFRUSTUM_HPP
+#define __VIEWFRUSTUM_HPP
+
+#include <render/nodegrid.hpp>
+
+/*
+ * Clip planes of the current GL projection and modelview, in the
+ * modelview's object coordinates. Load once per eye, after the navigation
+ * transformation is set up.
+ */
+class ViewFrustum
+{
+private:
+    double planes[6][4]; // inward normal and offset
+
+public:
+    void load()
+    {
+        GLdouble projection[16], modelview[16], clip[16];
+        glGetDoublev(GL_PROJECTION_MATRIX, projection);
+        glGetDoublev(GL_MODELVIEW_MATRIX, modelview);
+
+        // column major clip = projection * modelview
+        for(int column = 0; column < 4; column++)
+        {
+            for(int row = 0; row < 4; row++)
+            {
+                clip[column * 4 + row] = 0;
+                for(int k = 0; k < 4; k++)
+                {
+                    clip[column * 4 + row] += projection[k * 4 + row] * modelview[column * 4 + k];
+                }
+            }
+        }
+
+        // left, right, bottom, top, near, far: w +- x, y, z
+        for(int i = 0; i < 6; i++)
+        {
+            double sign = i % 2 == 0 ? 1 : -1;
+            for(int column = 0; column < 4; column++)
+            {
+                planes[i][column] = clip[column * 4 + 3] + sign * clip[column * 4 + i / 2];
+            }
+        }
+    }
+
+    // conservative: boxes near a frustum corner may pass
+    bool intersects(const GridBox& box) const
+    {
+        if(box.isEmpty()) return false;
+
+        for(int i = 0; i < 6; i++)
+        {
+            // the box corner furthest along the plane normal
+            double d = planes[i][3];
+            for(int j = 0; j < 3; j++)
+            {
+                d += planes[i][j] * (planes[i][j] >= 0 ? box.max[j] : box.min[j]);
+            }
+
+            if(d < 0) return false;
+        }
+
+        return true;
+    }
+};
+
+#endif
@@ -18,69 +18,348 @@
 
 #include <rpcserver.hpp>
 
+#include <unistd.h>
+
 using namespace std;
 
-RpcServer::RpcServer(Mycelia* app) : app(app)
+RpcServer::RpcServer(Mycelia* app, int connections) : app(app), connections(connections)
 {
     port = 9876;
+    subscriptionThread = 0;
+    subscriptionPeriod = 0;
+
+    eventThread = new Threads::Thread();
+    eventThread->start(this, &RpcServer::sendEvents);
     serverThread = new Threads::Thread();
     serverThread->start(this, &RpcServer::run);
+
+    streamServer = new StreamServer(app);
 }
 
 void* RpcServer::run()
 {
     xmlrpc_c::registry r;
 
-    r.addMethod("center", new Center(app));
-    r.addMethod("clear", new Clear(app));
-    r.addMethod("clear_edges", new ClearEdges(app));
-    r.addMethod("clear_velocities", new ClearVelocities(app));
-    r.addMethod("delete_edge", new DeleteEdge(app));
-    r.addMethod("delete_node", new DeleteNode(app));
-    r.addMethod("draw", new Draw(app));
-    r.addMethod("layout", new Layout(app));
-    r.addMethod("add_edge", new AddEdge(app));
-    r.addMethod("add_node", new AddNode(app));
-    r.addMethod("add_node_at", new AddNodeAt(app));
-    r.addMethod("open_file", new OpenFile(app));
-    r.addMethod("randomize_positions", new RandomizePositions(app));
-    r.addMethod("resume_layout", new ResumeLayout(app));
-    r.addMethod("set_callback", new SetCallback(app, this));
-    r.addMethod("set_edge_color", new SetEdgeColor(app));
-    r.addMethod("set_edge_label", new SetEdgeLabel(app));
-    r.addMethod("set_edge_weight", new SetEdgeWeight(app));
-    r.addMethod("set_layout_type", new SetLayoutType(app));
-    r.addMethod("set_node_attribute", new SetNodeAttribute(app));
-    r.addMethod("set_node_color", new SetNodeColor(app));
-    r.addMethod("set_node_label", new SetNodeLabel(app));
-    r.addMethod("set_node_size", new SetNodeSize(app));
-    r.addMethod("set_node_type", new SetNodeType(app));
-    r.addMethod("set_node_image_path", new SetNodeImagePath(app));
-    r.addMethod("set_node_image_scale", new SetNodeImageScale(app));    
-    r.addMethod("set_status", new SetStatus(app));
-    r.addMethod("set_texture_node_mode", new SetTextureNodeMode(app));
-    r.addMethod("start_layout", new StartLayout(app));
-    r.addMethod("stop_layout", new StopLayout(app));
-
-    xmlrpc_c::serverAbyss s(r, port);
+    addMethod(r, "center", new Center(app));
+    addMethod(r, "clear", new Clear(app));
+    addMethod(r, "clear_edges", new ClearEdges(app));
+    addMethod(r, "clear_velocities", new ClearVelocities(app));
+    addMethod(r, "compute_centrality", new ComputeCentrality(app));
+    addMethod(r, "delete_edge", new DeleteEdge(app));
+    addMethod(r, "delete_edges", new DeleteEdges(app));
+    addMethod(r, "delete_node", new DeleteNode(app));
+    addMethod(r, "delete_nodes", new DeleteNodes(app));
+    addMethod(r, "draw", new Draw(app));
+    addMethod(r, "generate", new Generate(app));
+    addMethod(r, "get_centrality", new GetCentrality(app));
+    addMethod(r, "get_changes_since", new GetChangesSince(app));
+    addMethod(r, "get_layout_energy", new GetLayoutEnergy(app));
+    addMethod(r, "get_nodes", new GetNodes(app));
+    addMethod(r, "get_positions", new GetPositions(app));
+    addMethod(r, "get_stats", new GetStats(app));
+    addMethod(r, "get_version", new GetVersion(app));
+    addMethod(r, "layout", new Layout(app));
+    addMethod(r, "load_snapshot", new LoadSnapshot(app));
+    addMethod(r, "add_edge", new AddEdge(app));
+    addMethod(r, "add_edges", new AddEdges(app));
+    addMethod(r, "add_node", new AddNode(app));
+    addMethod(r, "add_nodes", new AddNodes(app));
+    addMethod(r, "add_node_at", new AddNodeAt(app));
+    addMethod(r, "open_file", new OpenFile(app));
+    addMethod(r, "randomize_positions", new RandomizePositions(app));
+    addMethod(r, "resume_layout", new ResumeLayout(app));
+    addMethod(r, "save_snapshot", new SaveSnapshot(app));
+    addMethod(r, "set_callback", new SetCallback(app, this));
+    addMethod(r, "set_edge_color", new SetEdgeColor(app), true);
+    addMethod(r, "set_edge_colors", new SetEdgeColors(app));
+    addMethod(r, "set_edge_label", new SetEdgeLabel(app), true);
+    addMethod(r, "set_edge_weight", new SetEdgeWeight(app), true);
+    addMethod(r, "set_edge_weights", new SetEdgeWeights(app));
+    addMethod(r, "set_event_callback", new SetEventCallback(app, this));
+    addMethod(r, "set_layout_incremental", new SetLayoutIncremental(app));
+    addMethod(r, "set_layout_threads", new SetLayoutThreads(app));
+    addMethod(r, "set_layout_type", new SetLayoutType(app));
+    addMethod(r, "set_node_attribute", new SetNodeAttribute(app), true);
+    addMethod(r, "set_node_color", new SetNodeColor(app), true);
+    addMethod(r, "set_node_colors", new SetNodeColors(app));
+    addMethod(r, "set_node_label", new SetNodeLabel(app), true);
+    addMethod(r, "set_node_positions", new SetNodePositions(app));
+    addMethod(r, "set_node_size", new SetNodeSize(app), true);
+    addMethod(r, "set_node_sizes", new SetNodeSizes(app));
+    addMethod(r, "set_node_type", new SetNodeType(app), true);
+    addMethod(r, "set_node_image_path", new SetNodeImagePath(app), true);
+    addMethod(r, "set_node_image_scale", new SetNodeImageScale(app), true);
+    addMethod(r, "set_status", new SetStatus(app));
+    addMethod(r, "set_texture_node_mode", new SetTextureNodeMode(app), true);
+    addMethod(r, "start_layout", new StartLayout(app));
+    addMethod(r, "stop_layout", new StopLayout(app));
+    addMethod(r, "subscribe_positions", new SubscribePositions(app, this));
+
+    // abyss serves each connection on its own thread; element setters only
+    // queue commands, which the next frame or the next other call applies
+    xmlrpc_c::serverAbyss s(xmlrpc_c::serverAbyss::constrOpt()
+                            .registryP(&r)
+                            .portNumber(port)
+                            .maxConn(max(connections, 1)));
     s.run();
 
     return 0;
 }
 
-void RpcServer::callback(int node)
+// every method is timed into the application's stats, see get_stats
+void RpcServer::addMethod(xmlrpc_c::registry& r, const string& name, xmlrpc_c::method* method, bool queued)
+{
+    r.addMethod(name, new TimedMethod(app, name, method, queued));
+}
+
+/*
+ * Queues an event for the sender thread. A queued event of the same type,
+ * not yet sent, is replaced instead, so that e.g. a drag across the scene
+ * sends only the latest node once the client catches up.
+ */
+void RpcServer::postEvent(const string& type, int node)
 {
-    if(!Vrui::isMaster() || callbackUrl.size() == 0 || callbackMethod.size() == 0) return;
+    if(!Vrui::isMaster()) return;
 
-    xmlrpc_c::value callbackResult;
-    xmlrpc_c::paramList params;
-    params.add(xmlrpc_c::value_int(node));
+    eventMutex.lock();
 
-    callbackClient.call(callbackUrl, callbackMethod, params, &callbackResult);
+    deque<RpcEvent>::iterator it = events.begin();
+    while(it != events.end() && it->type != type) it++;
+
+    if(it != events.end())
+    {
+        it->node = node;
+    }
+    else
+    {
+        if((int)events.size() >= EVENT_QUEUE_SIZE)
+        {
+            events.pop_front();
+        }
+
+        RpcEvent event;
+        event.type = type;
+        event.node = node;
+        events.push_back(event);
+    }
+
+    eventCond.signal();
+    eventMutex.unlock();
 }
 
 void RpcServer::setCallback(const string& url, const string& method)
 {
+    eventMutex.lock();
     callbackUrl = url;
     callbackMethod = method;
+    eventMutex.unlock();
+}
+
+void RpcServer::setEventCallback(const string& url, const string& method)
+{
+    eventMutex.lock();
+    eventUrl = url;
+    eventMethod = method;
+    eventMutex.unlock();
+}
+
+void* RpcServer::sendEvents()
+{
+    while(true)
+    {
+        eventMutex.lock();
+        while(events.empty())
+        {
+            eventCond.wait(eventMutex);
+        }
+
+        RpcEvent event = events.front();
+        events.pop_front();
+        string url = callbackUrl;
+        string method = callbackMethod;
+        string allUrl = eventUrl;
+        string allMethod = eventMethod;
+        eventMutex.unlock();
+
+        if(event.type == "select" && url.size() > 0 && method.size() > 0)
+        {
+            xmlrpc_c::paramList params;
+            params.add(xmlrpc_c::value_int(event.node));
+            sendEvent(url, method, params);
+        }
+
+        if(allUrl.size() > 0 && allMethod.size() > 0)
+        {
+            xmlrpc_c::paramList params;
+            params.add(xmlrpc_c::value_string(event.type));
+            params.add(xmlrpc_c::value_int(event.node));
+            sendEvent(allUrl, allMethod, params);
+        }
+    }
+
+    return 0;
+}
+
+// gives up after EVENT_TIMEOUT_MS; the event is lost but later ones still go out
+void RpcServer::sendEvent(const string& url, const string& method, const xmlrpc_c::paramList& params)
+{
+    try
+    {
+        xmlrpc_c::clientXmlTransport_curl transport(
+            xmlrpc_c::clientXmlTransport_curl::constrOpt().timeout(EVENT_TIMEOUT_MS));
+        xmlrpc_c::client_xml client(&transport);
+        xmlrpc_c::carriageParm_curl0 carriage(url);
+        xmlrpc_c::rpcPtr rpc(method, params);
+
+        rpc->call(&client, &carriage);
+    }
+    catch(const exception& e)
+    {
+        cout << "event " << method << " to " << url << " failed: " << e.what() << endl;
+    }
+}
+
+// an empty url ends the subscription
+void RpcServer::subscribe(const string& url, const string& method, double period)
+{
+    subscriptionMutex.lock();
+    subscriptionUrl = url;
+    subscriptionMethod = method;
+    subscriptionPeriod = max(period, 0.01);
+    subscriptionMutex.unlock();
+
+    if(subscriptionThread == 0 && url.size() > 0)
+    {
+        subscriptionThread = new Threads::Thread();
+        subscriptionThread->start(this, &RpcServer::publish);
+    }
+}
+
+/*
+ * Calls the subscribed method with the result of get_positions whenever the
+ * positions changed since the last call, checking every period seconds.
+ */
+void* RpcServer::publish()
+{
+    xmlrpc_c::clientSimple client;
+    int publishedVersion = -1;
+
+    while(true)
+    {
+        subscriptionMutex.lock();
+        string url = subscriptionUrl;
+        string method = subscriptionMethod;
+        double period = subscriptionPeriod;
+        subscriptionMutex.unlock();
+
+        usleep((useconds_t)(period * 1e6));
+
+        if(!Vrui::isMaster() || url.size() == 0 || app->g->getPositionVersion() == publishedVersion)
+        {
+            continue;
+        }
+
+        map<string, xmlrpc_c::value> positions = getPositions(app->g);
+        publishedVersion = xmlrpc_c::value_int(positions["position_version"]);
+
+        xmlrpc_c::paramList params;
+        params.add(xmlrpc_c::value_struct(positions));
+        xmlrpc_c::value result;
+
+        try
+        {
+            client.call(url, method, params, &result);
+        }
+        catch(const exception& e)
+        {
+            // keep trying, the client may come back
+            cout << "subscription to " << url << " failed: " << e.what() << endl;
+        }
+    }
+
+    return 0;
+}
+
+vector<int> RpcServer::getInts(const xmlrpc_c::paramList& params, int i)
+{
+    vector<xmlrpc_c::value> array = params.getArray(i);
+    vector<int> result(array.size());
+
+    for(int j = 0; j < (int)array.size(); j++)
+    {
+        result[j] = xmlrpc_c::value_int(array[j]);
+    }
+
+    return result;
+}
+
+// whole numbers may arrive as integers, e.g. from python
+vector<double> RpcServer::getDoubles(const xmlrpc_c::paramList& params, int i)
+{
+    vector<xmlrpc_c::value> array = params.getArray(i);
+    vector<double> result(array.size());
+
+    for(int j = 0; j < (int)array.size(); j++)
+    {
+        if(array[j].type() == xmlrpc_c::value::TYPE_INT)
+        {
+            result[j] = xmlrpc_c::value_int(array[j]);
+        }
+        else
+        {
+            result[j] = xmlrpc_c::value_double(array[j]);
+        }
+    }
+
+    return result;
+}
+
+xmlrpc_c::value_bytestring RpcServer::packInts(const vector<int>& values)
+{
+    const unsigned char* bytes = (const unsigned char*)(values.empty() ? 0 : &values[0]);
+    return xmlrpc_c::value_bytestring(vector<unsigned char>(bytes, bytes + values.size() * sizeof(int)));
+}
+
+xmlrpc_c::value_bytestring RpcServer::packDoubles(const vector<double>& values)
+{
+    const unsigned char* bytes = (const unsigned char*)(values.empty() ? 0 : &values[0]);
+    return xmlrpc_c::value_bytestring(vector<unsigned char>(bytes, bytes + values.size() * sizeof(double)));
+}
+
+// of packed arrays, "little" or "big"
+xmlrpc_c::value_string RpcServer::getByteOrder()
+{
+    const int one = 1;
+    return xmlrpc_c::value_string(*(const char*)&one ? "little" : "big");
+}
+
+/*
+ * Every node id and position as packed int32 and double arrays in id order
+ * of the dense storage, with the versions they belong to. byte_order tells
+ * clients how to unpack them.
+ */
+map<string, xmlrpc_c::value> RpcServer::getPositions(Graph* g)
+{
+    map<string, xmlrpc_c::value> result;
+    vector<double> xyz;
+
+    g->lock();
+    const vector<Vrui::Point>& positions = g->getPositions();
+    xyz.reserve(3 * positions.size());
+    for(int i = 0; i < (int)positions.size(); i++)
+    {
+        xyz.push_back(positions[i][0]);
+        xyz.push_back(positions[i][1]);
+        xyz.push_back(positions[i][2]);
+    }
+    result["ids"] = packInts(g->getIndexNodes());
+    result["version"] = xmlrpc_c::value_int(g->getVersion());
+    result["position_version"] = xmlrpc_c::value_int(g->getPositionVersion());
+    g->unlock();
+
+    result["byte_order"] = getByteOrder();
+    result["changed"] = xmlrpc_c::value_boolean(true);
+    result["xyz"] = packDoubles(xyz);
+
+    return result;
 }
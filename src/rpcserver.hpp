@@ -19,30 +19,126 @@
 #ifndef __RPCSERVER_HPP
 #define __RPCSERVER_HPP
 
+#include <centrality.hpp>
+#include <commandqueue.hpp>
 #include <graph.hpp>
 #include <mycelia.hpp>
+#include <generators/randomgraph.hpp>
+#include <layout/arflayout.hpp>
+#include <streamserver.hpp>
 
 #include <xmlrpc-c/base.hpp>
+#include <xmlrpc-c/client.hpp>
 #include <xmlrpc-c/client_simple.hpp>
+#include <xmlrpc-c/client_transport.hpp>
 #include <xmlrpc-c/registry.hpp>
 #include <xmlrpc-c/server_abyss.hpp>
 
+#define EVENT_QUEUE_SIZE 256 // oldest events are dropped beyond this
+#define EVENT_TIMEOUT_MS 1000 // for delivering one event to a client
+
+// something clients are told about, e.g. a "select" of node
+struct RpcEvent
+{
+    std::string type;
+    int node;
+};
+
 class RpcServer
 {
 private:
     Mycelia* app;
     Threads::Thread* serverThread;
-    std::string callbackUrl;
-    std::string callbackMethod;
-    xmlrpc_c::clientSimple callbackClient;
     int port;
+    int connections;
+
+    // events go out from their own thread, so a slow or unreachable client
+    // never holds up the caller; queued events of the same type coalesce
+    std::deque<RpcEvent> events;
+    Threads::Mutex eventMutex;
+    Threads::Cond eventCond;
+    Threads::Thread* eventThread;
+    std::string callbackUrl; // selections only, as node
+    std::string callbackMethod;
+    std::string eventUrl; // every event, as type and node
+    std::string eventMethod;
+
+    void* sendEvents();
+    void sendEvent(const std::string&, const std::string&, const xmlrpc_c::paramList&);
+    StreamServer* streamServer; // binary bulk transfers on STREAM_PORT
+
+    // positions pushed to a client whenever they changed, every period seconds
+    Threads::Thread* subscriptionThread;
+    Threads::Mutex subscriptionMutex;
+    std::string subscriptionUrl;
+    std::string subscriptionMethod;
+    double subscriptionPeriod;
+
+    void* publish();
 
 public:
-    RpcServer(Mycelia*);
+    RpcServer(Mycelia*, int = RPC_CONNECTIONS);
 
     void* run();
-    void callback(int);
+    void addMethod(xmlrpc_c::registry&, const std::string&, xmlrpc_c::method*, bool queued=false);
+    void postEvent(const std::string&, int);
     void setCallback(const std::string&, const std::string&);
+    void setEventCallback(const std::string&, const std::string&);
+    void subscribe(const std::string&, const std::string&, double);
+
+    // array parameters of the bulk methods
+    static std::vector<int> getInts(const xmlrpc_c::paramList&, int);
+    static std::vector<double> getDoubles(const xmlrpc_c::paramList&, int);
+
+    // packed arrays in the server's byte order, see get_positions
+    static xmlrpc_c::value_bytestring packInts(const std::vector<int>&);
+    static xmlrpc_c::value_bytestring packDoubles(const std::vector<double>&);
+    static xmlrpc_c::value_string getByteOrder();
+    static std::map<std::string, xmlrpc_c::value> getPositions(Graph*);
+};
+
+/*
+ * Forwards to a method, adding its calls and seconds to the application's
+ * stats under the method's name, failed calls included. Methods that do
+ * not just queue a command apply the queued ones first, so they see, and
+ * come after, every setter sent before them.
+ */
+class TimedMethod : public xmlrpc_c::method
+{
+    Mycelia* app;
+    std::string name;
+    xmlrpc_c::method* inner;
+    bool queued;
+
+public:
+    TimedMethod(Mycelia* app, const std::string& name, xmlrpc_c::method* inner, bool queued)
+        : app(app), name(name), inner(inner), queued(queued)
+    {
+        _signature = inner->_signature;
+        _help = inner->_help;
+    }
+
+    void execute(const xmlrpc_c::paramList& params, xmlrpc_c::value* retval)
+    {
+        double start = Stats::now();
+
+        try
+        {
+            if(!queued)
+            {
+                app->applyCommands();
+            }
+
+            inner->execute(params, retval);
+        }
+        catch(...)
+        {
+            app->stats.addCall(name, Stats::now() - start);
+            throw;
+        }
+
+        app->stats.addCall(name, Stats::now() - start);
+    }
 };
 
 class AddEdge : public xmlrpc_c::method
@@ -64,6 +160,32 @@ public:
     }
 };
 
+class AddEdges : public xmlrpc_c::method
+{
+    Mycelia* app;
+
+public:
+    AddEdges(Mycelia* app) : app(app) {}
+
+    void execute(const xmlrpc_c::paramList& params, xmlrpc_c::value* retval)
+    {
+        std::vector<int> endpoints = RpcServer::getInts(params, 0);
+        params.verifyEnd(1);
+
+        std::vector<int> edges;
+        app->g->addEdges(endpoints, edges);
+
+        std::vector<xmlrpc_c::value> result;
+        result.reserve(edges.size());
+        for(int i = 0; i < (int)edges.size(); i++)
+        {
+            result.push_back(xmlrpc_c::value_int(edges[i]));
+        }
+
+        *retval = xmlrpc_c::value_array(result);
+    }
+};
+
 class AddNode : public xmlrpc_c::method
 {
     Mycelia* app;
@@ -100,6 +222,21 @@ public:
     }
 };
 
+class AddNodes : public xmlrpc_c::method
+{
+    Mycelia* app;
+
+public:
+    AddNodes(Mycelia* app) : app(app) {}
+
+    void execute(const xmlrpc_c::paramList& params, xmlrpc_c::value* retval)
+    {
+        int count = params.getInt(0, 0);
+        params.verifyEnd(1);
+
+        *retval = xmlrpc_c::value_int(app->g->addNodes(count));
+    }
+};
 
 class Center : public xmlrpc_c::method
 {
@@ -161,6 +298,25 @@ public:
     }
 };
 
+// starts betweenness centrality in the background, from samples sources or
+// every node for 0; returns false if a run is already in progress
+class ComputeCentrality : public xmlrpc_c::method
+{
+    Mycelia* app;
+
+public:
+    ComputeCentrality(Mycelia* app) : app(app) {}
+
+    void execute(const xmlrpc_c::paramList& params, xmlrpc_c::value* retval)
+    {
+        int samples = params.getInt(0);
+        bool apply = params.getBoolean(1);
+        params.verifyEnd(2);
+
+        *retval = xmlrpc_c::value_boolean(app->getCentrality()->start(samples, apply));
+    }
+};
+
 class Draw : public xmlrpc_c::method
 {
     Mycelia* app;
@@ -193,6 +349,22 @@ public:
     }
 };
 
+class DeleteEdges : public xmlrpc_c::method
+{
+    Mycelia* app;
+
+public:
+    DeleteEdges(Mycelia* app) : app(app) {}
+
+    void execute(const xmlrpc_c::paramList& params, xmlrpc_c::value* retval)
+    {
+        std::vector<int> edges = RpcServer::getInts(params, 0);
+        params.verifyEnd(1);
+
+        *retval = xmlrpc_c::value_int(app->g->deleteEdges(edges));
+    }
+};
+
 class DeleteNode : public xmlrpc_c::method
 {
     Mycelia* app;
@@ -209,6 +381,282 @@ public:
     }
 };
 
+class DeleteNodes : public xmlrpc_c::method
+{
+    Mycelia* app;
+
+public:
+    DeleteNodes(Mycelia* app) : app(app) {}
+
+    void execute(const xmlrpc_c::paramList& params, xmlrpc_c::value* retval)
+    {
+        std::vector<int> nodes = RpcServer::getInts(params, 0);
+        params.verifyEnd(1);
+
+        *retval = xmlrpc_c::value_int(app->g->deleteNodes(nodes));
+    }
+};
+
+// replaces the graph with a random one, see RandomGraph::generate
+class Generate : public xmlrpc_c::method
+{
+    Mycelia* app;
+
+public:
+    Generate(Mycelia* app) : app(app) {}
+
+    void execute(const xmlrpc_c::paramList& params, xmlrpc_c::value* retval)
+    {
+        std::string model = params.getString(0);
+        int nodeCount = params.getInt(1, 0);
+        int k = params.getInt(2);
+        double p = params.getDouble(3);
+        int seed = params.getInt(4);
+        params.verifyEnd(5);
+
+        int edges = RandomGraph(seed).generate(app->g, model, nodeCount, k, p);
+
+        if(edges != -1)
+        {
+            app->resetNavigationCallback(0);
+            app->resetLayoutCallback(0);
+        }
+
+        *retval = xmlrpc_c::value_int(edges);
+    }
+};
+
+// the last finished centrality run by node, its error bound and the graph
+// version it was computed on, with the progress of a run in progress
+class GetCentrality : public xmlrpc_c::method
+{
+    Mycelia* app;
+
+public:
+    GetCentrality(Mycelia* app) : app(app) {}
+
+    void execute(const xmlrpc_c::paramList& params, xmlrpc_c::value* retval)
+    {
+        params.verifyEnd(0);
+
+        Centrality* centrality = app->getCentrality();
+        std::vector<int> nodes;
+        std::vector<double> values;
+        double bound;
+        int samples;
+        int version = centrality->getResult(nodes, values, bound, samples);
+
+        std::map<std::string, xmlrpc_c::value> result;
+        result["byte_order"] = RpcServer::getByteOrder();
+        result["ids"] = RpcServer::packInts(nodes);
+        result["centrality"] = RpcServer::packDoubles(values);
+        result["bound"] = xmlrpc_c::value_double(bound);
+        result["samples"] = xmlrpc_c::value_int(samples);
+        result["version"] = xmlrpc_c::value_int(version);
+        result["running"] = xmlrpc_c::value_boolean(centrality->isRunning());
+        result["progress"] = xmlrpc_c::value_double(centrality->getProgress());
+
+        *retval = xmlrpc_c::value_struct(result);
+    }
+};
+
+class GetLayoutEnergy : public xmlrpc_c::method
+{
+    Mycelia* app;
+
+public:
+    GetLayoutEnergy(Mycelia* app) : app(app) {}
+
+    void execute(const xmlrpc_c::paramList& params, xmlrpc_c::value* retval)
+    {
+        params.verifyEnd(0);
+
+        ArfLayout* layout = app->getDynamicLayout();
+        std::map<std::string, xmlrpc_c::value> energy;
+        energy["kinetic"] = xmlrpc_c::value_double(layout->getKineticEnergy());
+        energy["spring"] = xmlrpc_c::value_double(layout->getSpringEnergy());
+        energy["total"] = xmlrpc_c::value_double(layout->getKineticEnergy() + layout->getSpringEnergy());
+        energy["time_step"] = xmlrpc_c::value_double(layout->getStepTime());
+        energy["active"] = xmlrpc_c::value_int(layout->getActiveCount());
+        energy["asleep"] = xmlrpc_c::value_boolean(layout->isAsleep());
+
+        *retval = xmlrpc_c::value_struct(energy);
+    }
+};
+
+class GetChangesSince : public xmlrpc_c::method
+{
+    Mycelia* app;
+
+public:
+    GetChangesSince(Mycelia* app) : app(app) {}
+
+    void execute(const xmlrpc_c::paramList& params, xmlrpc_c::value* retval)
+    {
+        int since = params.getInt(0);
+        params.verifyEnd(1);
+
+        std::vector<GraphChange> changes;
+        std::map<std::string, xmlrpc_c::value> result;
+
+        app->g->lock();
+        bool logged = app->g->getChanges(since, changes);
+        result["version"] = xmlrpc_c::value_int(app->g->getVersion());
+        result["position_version"] = xmlrpc_c::value_int(app->g->getPositionVersion());
+        app->g->unlock();
+
+        // nodes and edges whose attributes changed, each listed once
+        std::set<int> nodes;
+        std::set<int> edges;
+        for(int i = 0; i < (int)changes.size(); i++)
+        {
+            (changes[i].edge ? edges : nodes).insert(changes[i].id);
+        }
+
+        // without a log entry for every change the client has to reread everything
+        result["full"] = xmlrpc_c::value_boolean(!logged);
+        result["byte_order"] = RpcServer::getByteOrder();
+        result["nodes"] = RpcServer::packInts(std::vector<int>(nodes.begin(), nodes.end()));
+        result["edges"] = RpcServer::packInts(std::vector<int>(edges.begin(), edges.end()));
+
+        *retval = xmlrpc_c::value_struct(result);
+    }
+};
+
+class GetNodes : public xmlrpc_c::method
+{
+    Mycelia* app;
+
+public:
+    GetNodes(Mycelia* app) : app(app) {}
+
+    void execute(const xmlrpc_c::paramList& params, xmlrpc_c::value* retval)
+    {
+        params.verifyEnd(0);
+
+        Graph* g = app->g;
+        std::map<std::string, xmlrpc_c::value> result;
+
+        g->lock();
+        const std::vector<int>& ids = g->getIndexNodes();
+        std::vector<int> degrees(ids.size());
+        std::vector<int> components(ids.size());
+        for(int i = 0; i < (int)ids.size(); i++)
+        {
+            degrees[i] = g->getNodeDegree(ids[i]);
+            components[i] = g->getNodeComponent(ids[i]);
+        }
+        result["version"] = xmlrpc_c::value_int(g->getVersion());
+        result["ids"] = RpcServer::packInts(ids);
+        g->unlock();
+
+        result["byte_order"] = RpcServer::getByteOrder();
+        result["degrees"] = RpcServer::packInts(degrees);
+        result["components"] = RpcServer::packInts(components);
+
+        *retval = xmlrpc_c::value_struct(result);
+    }
+};
+
+class GetPositions : public xmlrpc_c::method
+{
+    Mycelia* app;
+
+public:
+    GetPositions(Mycelia* app) : app(app) {}
+
+    void execute(const xmlrpc_c::paramList& params, xmlrpc_c::value* retval)
+    {
+        int since = -1;
+
+        // optional position version the client already has
+        if(params.size() > 0)
+        {
+            since = params.getInt(0);
+            params.verifyEnd(1);
+        }
+
+        if(since != -1 && since == app->g->getPositionVersion())
+        {
+            std::map<std::string, xmlrpc_c::value> result;
+            result["position_version"] = xmlrpc_c::value_int(since);
+            result["changed"] = xmlrpc_c::value_boolean(false);
+
+            *retval = xmlrpc_c::value_struct(result);
+            return;
+        }
+
+        *retval = xmlrpc_c::value_struct(RpcServer::getPositions(app->g));
+    }
+};
+
+class GetStats : public xmlrpc_c::method
+{
+    Mycelia* app;
+
+public:
+    GetStats(Mycelia* app) : app(app) {}
+
+    void execute(const xmlrpc_c::paramList& params, xmlrpc_c::value* retval)
+    {
+        params.verifyEnd(0);
+
+        double counts[STAT_COUNT];
+        double seconds[STAT_COUNT];
+        double rates[STAT_COUNT];
+        double loads[STAT_COUNT];
+        app->stats.getTotals(counts, seconds);
+        double window = app->stats.getRates(rates, loads);
+
+        // totals since startup, rates and loads per second over the window
+        std::map<std::string, xmlrpc_c::value> result;
+        for(int stat = 0; stat < STAT_COUNT; stat++)
+        {
+            std::map<std::string, xmlrpc_c::value> entry;
+            entry["count"] = xmlrpc_c::value_double(counts[stat]);
+            entry["seconds"] = xmlrpc_c::value_double(seconds[stat]);
+            entry["rate"] = xmlrpc_c::value_double(rates[stat]);
+            entry["load"] = xmlrpc_c::value_double(loads[stat]);
+            entry["mean"] = xmlrpc_c::value_double(counts[stat] > 0 ? seconds[stat] / counts[stat] : 0);
+            result[Stats::getName(stat)] = xmlrpc_c::value_struct(entry);
+        }
+
+        std::map<std::string, std::pair<double, double> > calls = app->stats.getCalls();
+        std::map<std::string, xmlrpc_c::value> methods;
+        for(std::map<std::string, std::pair<double, double> >::const_iterator call = calls.begin(); call != calls.end(); call++)
+        {
+            std::map<std::string, xmlrpc_c::value> entry;
+            entry["count"] = xmlrpc_c::value_double(call->second.first);
+            entry["seconds"] = xmlrpc_c::value_double(call->second.second);
+            methods[call->first] = xmlrpc_c::value_struct(entry);
+        }
+
+        result["methods"] = xmlrpc_c::value_struct(methods);
+        result["window"] = xmlrpc_c::value_double(window);
+
+        *retval = xmlrpc_c::value_struct(result);
+    }
+};
+
+class GetVersion : public xmlrpc_c::method
+{
+    Mycelia* app;
+
+public:
+    GetVersion(Mycelia* app) : app(app) {}
+
+    void execute(const xmlrpc_c::paramList& params, xmlrpc_c::value* retval)
+    {
+        params.verifyEnd(0);
+
+        std::map<std::string, xmlrpc_c::value> result;
+        result["version"] = xmlrpc_c::value_int(app->g->getVersion());
+        result["position_version"] = xmlrpc_c::value_int(app->g->getPositionVersion());
+
+        *retval = xmlrpc_c::value_struct(result);
+    }
+};
+
 class Layout : public xmlrpc_c::method
 {
     Mycelia* app;
@@ -226,6 +674,32 @@ public:
     }
 };
 
+// replaces the graph with a snapshot; returns its node count, -1 if unreadable
+class LoadSnapshot : public xmlrpc_c::method
+{
+    Mycelia* app;
+
+public:
+    LoadSnapshot(Mycelia* app) : app(app) {}
+
+    void execute(const xmlrpc_c::paramList& params, xmlrpc_c::value* retval)
+    {
+        std::string filepath = params.getString(0);
+        params.verifyEnd(1);
+
+        bool loaded = app->g->readSnapshot(filepath);
+
+        if(loaded)
+        {
+            app->setSkipLayout(true);
+            app->resetNavigationCallback(0);
+            app->resetLayoutCallback(0);
+        }
+
+        *retval = xmlrpc_c::value_int(loaded ? app->g->getNodeCount() : -1);
+    }
+};
+
 class OpenFile : public xmlrpc_c::method
 {
     Mycelia* app;
@@ -277,6 +751,22 @@ public:
     }
 };
 
+class SaveSnapshot : public xmlrpc_c::method
+{
+    Mycelia* app;
+
+public:
+    SaveSnapshot(Mycelia* app) : app(app) {}
+
+    void execute(const xmlrpc_c::paramList& params, xmlrpc_c::value* retval)
+    {
+        std::string filepath = params.getString(0);
+        params.verifyEnd(1);
+
+        *retval = xmlrpc_c::value_int(app->g->writeSnapshot(filepath) ? 0 : -1);
+    }
+};
+
 class SetCallback : public xmlrpc_c::method
 {
     Mycelia* app;
@@ -294,6 +784,23 @@ public:
     }
 };
 
+class SetEventCallback : public xmlrpc_c::method
+{
+    Mycelia* app;
+    RpcServer* server;
+
+public:
+    SetEventCallback(Mycelia* app, RpcServer* server) : app(app), server(server) {}
+
+    void execute(const xmlrpc_c::paramList& params, xmlrpc_c::value* retval)
+    {
+        server->setEventCallback(params.getString(0), params.getString(1));
+        params.verifyEnd(2);
+
+        *retval = xmlrpc_c::value_int(0);
+    }
+};
+
 class SetEdgeColor : public xmlrpc_c::method
 {
     Mycelia* app;
@@ -310,12 +817,34 @@ public:
         double a = params.getDouble(4);
         params.verifyEnd(5);
 
-        app->g->setEdgeColor(edge, r, g, b, a);
+        GraphCommand* command = new GraphCommand(COMMAND_EDGE_COLOR, edge);
+        command->values[0] = r;
+        command->values[1] = g;
+        command->values[2] = b;
+        command->values[3] = a;
+        app->postCommand(command);
 
         *retval = xmlrpc_c::value_int(0);
     }
 };
 
+class SetEdgeColors : public xmlrpc_c::method
+{
+    Mycelia* app;
+
+public:
+    SetEdgeColors(Mycelia* app) : app(app) {}
+
+    void execute(const xmlrpc_c::paramList& params, xmlrpc_c::value* retval)
+    {
+        std::vector<int> edges = RpcServer::getInts(params, 0);
+        std::vector<double> values = RpcServer::getDoubles(params, 1);
+        params.verifyEnd(2);
+
+        *retval = xmlrpc_c::value_int(app->g->setEdgeColors(edges, values));
+    }
+};
+
 class SetEdgeLabel : public xmlrpc_c::method
 {
     Mycelia* app;
@@ -329,7 +858,9 @@ public:
         std::string label = params.getString(1);
         params.verifyEnd(2);
 
-        app->g->setEdgeLabel(edge, label);
+        GraphCommand* command = new GraphCommand(COMMAND_EDGE_LABEL, edge);
+        command->text = label;
+        app->postCommand(command);
 
         *retval = xmlrpc_c::value_int(0);
     }
@@ -348,12 +879,31 @@ public:
         double weight = params.getDouble(1);
         params.verifyEnd(2);
 
-        app->g->setEdgeWeight(edge, weight);
+        GraphCommand* command = new GraphCommand(COMMAND_EDGE_WEIGHT, edge);
+        command->values[0] = weight;
+        app->postCommand(command);
 
         *retval = xmlrpc_c::value_int(0);
     }
 };
 
+class SetEdgeWeights : public xmlrpc_c::method
+{
+    Mycelia* app;
+
+public:
+    SetEdgeWeights(Mycelia* app) : app(app) {}
+
+    void execute(const xmlrpc_c::paramList& params, xmlrpc_c::value* retval)
+    {
+        std::vector<int> edges = RpcServer::getInts(params, 0);
+        std::vector<double> values = RpcServer::getDoubles(params, 1);
+        params.verifyEnd(2);
+
+        *retval = xmlrpc_c::value_int(app->g->setEdgeWeights(edges, values));
+    }
+};
+
 class SetLayoutType : public xmlrpc_c::method
 {
     Mycelia* app;
@@ -364,14 +914,72 @@ public:
     void execute(const xmlrpc_c::paramList& params, xmlrpc_c::value* retval)
     {
         int layout = params.getInt(0);
-        params.verifyEnd(1);
+        double theta = -1;
+
+        // optional barnes-hut opening angle for the static layout
+        if(params.size() > 1)
+        {
+            theta = params.getDouble(1);
+            params.verifyEnd(2);
+        }
+        else
+        {
+            params.verifyEnd(1);
+        }
+
+        app->setLayoutType(layout, theta);
+
+        *retval = xmlrpc_c::value_int(0);
+    }
+};
+
+class SetLayoutIncremental : public xmlrpc_c::method
+{
+    Mycelia* app;
+
+public:
+    SetLayoutIncremental(Mycelia* app) : app(app) {}
 
-        app->setLayoutType(layout);
+    void execute(const xmlrpc_c::paramList& params, xmlrpc_c::value* retval)
+    {
+        bool incremental = params.getBoolean(0);
+        int hops = -1;
+
+        // optional neighborhood radius around touched nodes
+        if(params.size() > 1)
+        {
+            hops = params.getInt(1, 0);
+            params.verifyEnd(2);
+        }
+        else
+        {
+            params.verifyEnd(1);
+        }
+
+        app->getDynamicLayout()->setIncremental(incremental, hops);
 
         *retval = xmlrpc_c::value_int(0);
     }
 };
 
+class SetLayoutThreads : public xmlrpc_c::method
+{
+    Mycelia* app;
+
+public:
+    SetLayoutThreads(Mycelia* app) : app(app) {}
+
+    void execute(const xmlrpc_c::paramList& params, xmlrpc_c::value* retval)
+    {
+        int threads = params.getInt(0);
+        params.verifyEnd(1);
+
+        app->getDynamicLayout()->setThreadCount(threads);
+
+        *retval = xmlrpc_c::value_int(app->getDynamicLayout()->getThreadCount());
+    }
+};
+
 class SetNodeAttribute : public xmlrpc_c::method
 {
     Mycelia* app;
@@ -386,7 +994,10 @@ public:
         std::string val = params.getString(2);
         params.verifyEnd(3);
 
-        app->g->setNodeAttribute(node, key, val);
+        GraphCommand* command = new GraphCommand(COMMAND_NODE_ATTRIBUTE, node);
+        command->key = key;
+        command->text = val;
+        app->postCommand(command);
 
         *retval = xmlrpc_c::value_int(0);
     }
@@ -408,12 +1019,34 @@ public:
         double a = params.getDouble(4);
         params.verifyEnd(5);
 
-        app->g->setNodeColor(node, r, g, b, a);
+        GraphCommand* command = new GraphCommand(COMMAND_NODE_COLOR, node);
+        command->values[0] = r;
+        command->values[1] = g;
+        command->values[2] = b;
+        command->values[3] = a;
+        app->postCommand(command);
 
         *retval = xmlrpc_c::value_int(0);
     }
 };
 
+class SetNodeColors : public xmlrpc_c::method
+{
+    Mycelia* app;
+
+public:
+    SetNodeColors(Mycelia* app) : app(app) {}
+
+    void execute(const xmlrpc_c::paramList& params, xmlrpc_c::value* retval)
+    {
+        std::vector<int> nodes = RpcServer::getInts(params, 0);
+        std::vector<double> values = RpcServer::getDoubles(params, 1);
+        params.verifyEnd(2);
+
+        *retval = xmlrpc_c::value_int(app->g->setNodeColors(nodes, values));
+    }
+};
+
 class SetNodeLabel : public xmlrpc_c::method
 {
     Mycelia* app;
@@ -427,12 +1060,31 @@ public:
         std::string label = params.getString(1);
         params.verifyEnd(2);
 
-        app->g->setNodeLabel(node, label);
+        GraphCommand* command = new GraphCommand(COMMAND_NODE_LABEL, node);
+        command->text = label;
+        app->postCommand(command);
 
         *retval = xmlrpc_c::value_int(0);
     }
 };
 
+class SetNodePositions : public xmlrpc_c::method
+{
+    Mycelia* app;
+
+public:
+    SetNodePositions(Mycelia* app) : app(app) {}
+
+    void execute(const xmlrpc_c::paramList& params, xmlrpc_c::value* retval)
+    {
+        std::vector<int> nodes = RpcServer::getInts(params, 0);
+        std::vector<double> values = RpcServer::getDoubles(params, 1);
+        params.verifyEnd(2);
+
+        *retval = xmlrpc_c::value_int(app->g->setNodePositions(nodes, values));
+    }
+};
+
 class SetNodeSize : public xmlrpc_c::method
 {
     Mycelia* app;
@@ -446,12 +1098,31 @@ public:
         double size = params.getDouble(1);
         params.verifyEnd(2);
 
-        app->g->setNodeSize(node, size);
+        GraphCommand* command = new GraphCommand(COMMAND_NODE_SIZE, node);
+        command->values[0] = size;
+        app->postCommand(command);
 
         *retval = xmlrpc_c::value_int(0);
     }
 };
 
+class SetNodeSizes : public xmlrpc_c::method
+{
+    Mycelia* app;
+
+public:
+    SetNodeSizes(Mycelia* app) : app(app) {}
+
+    void execute(const xmlrpc_c::paramList& params, xmlrpc_c::value* retval)
+    {
+        std::vector<int> nodes = RpcServer::getInts(params, 0);
+        std::vector<double> values = RpcServer::getDoubles(params, 1);
+        params.verifyEnd(2);
+
+        *retval = xmlrpc_c::value_int(app->g->setNodeSizes(nodes, values));
+    }
+};
+
 class SetNodeType : public xmlrpc_c::method
 {
     Mycelia* app;
@@ -465,7 +1136,9 @@ public:
         std::string type = params.getString(1);
         params.verifyEnd(2);
 
-        app->g->setNodeType(node, type);
+        GraphCommand* command = new GraphCommand(COMMAND_NODE_TYPE, node);
+        command->text = type;
+        app->postCommand(command);
 
         *retval = xmlrpc_c::value_int(0);
     }
@@ -485,7 +1158,9 @@ public:
         std::string image_path = params.getString(1);
         params.verifyEnd(2);
 
-        app->g->setNodeImagePath(node, image_path);
+        GraphCommand* command = new GraphCommand(COMMAND_NODE_IMAGE_PATH, node);
+        command->text = image_path;
+        app->postCommand(command);
 
         *retval = xmlrpc_c::value_int(0);
     }
@@ -504,7 +1179,9 @@ public:
         double scale = params.getDouble(1);
         params.verifyEnd(2);
 
-        app->g->setNodeImageScale(node, scale);
+        GraphCommand* command = new GraphCommand(COMMAND_NODE_IMAGE_SCALE, node);
+        command->values[0] = scale;
+        app->postCommand(command);
 
         *retval = xmlrpc_c::value_int(0);
     }
@@ -522,7 +1199,9 @@ public:
         std::string mode = params.getString(0);
         params.verifyEnd(1);
 
-        app->g->setTextureNodeMode(mode);
+        GraphCommand* command = new GraphCommand(COMMAND_TEXTURE_NODE_MODE);
+        command->text = mode;
+        app->postCommand(command);
         *retval = xmlrpc_c::value_int(0);
     }
 };
@@ -545,6 +1224,27 @@ public:
     }
 };
 
+class SubscribePositions : public xmlrpc_c::method
+{
+    Mycelia* app;
+    RpcServer* server;
+
+public:
+    SubscribePositions(Mycelia* app, RpcServer* server) : app(app), server(server) {}
+
+    void execute(const xmlrpc_c::paramList& params, xmlrpc_c::value* retval)
+    {
+        std::string url = params.getString(0);
+        std::string method = params.getString(1);
+        double period = params.getDouble(2);
+        params.verifyEnd(3);
+
+        server->subscribe(url, method, period);
+
+        *retval = xmlrpc_c::value_int(0);
+    }
+};
+
 class StartLayout  : public xmlrpc_c::method
 {
     Mycelia* app;
@@ -0,0 +1,159 @@
+/*
+ * Mycelia immersive 3d network visualization tool.
+ * Copyright (C) 2008-2010 Sean Whalen.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stats.hpp>
+
+#include <time.h>
+
+using namespace std;
+
+static const char* statNames[STAT_COUNT] =
+{
+    "frame",
+    "display",
+    "graph_list",
+    "instances",
+    "graph_copy",
+    "textures",
+    "layout_step",
+    "bundle_step",
+    "rpc",
+    "lock_wait"
+};
+
+Stats::Stats()
+    : sampleCount(0),
+      nextSample(0)
+{
+    totals.time = now();
+
+    for(int stat = 0; stat < STAT_COUNT; stat++)
+    {
+        totals.counts[stat] = 0;
+        totals.seconds[stat] = 0;
+    }
+}
+
+// seconds on a monotonic clock
+double Stats::now()
+{
+    timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+const char* Stats::getName(int stat)
+{
+    return stat >= 0 && stat < STAT_COUNT ? statNames[stat] : "";
+}
+
+void Stats::sample(double time)
+{
+    int newest = (nextSample + STATS_SAMPLES - 1) % STATS_SAMPLES;
+
+    if(sampleCount > 0 && time - samples[newest].time < STATS_WINDOW / STATS_SAMPLES)
+    {
+        return;
+    }
+
+    samples[nextSample] = totals;
+    samples[nextSample].time = time;
+    nextSample = (nextSample + 1) % STATS_SAMPLES;
+    sampleCount = min(sampleCount + 1, STATS_SAMPLES);
+}
+
+void Stats::add(int stat, double seconds)
+{
+    double time = now();
+
+    mutex.lock();
+    sample(time);
+    totals.counts[stat]++;
+    totals.seconds[stat] += seconds;
+    mutex.unlock();
+}
+
+void Stats::addCall(const string& method, double seconds)
+{
+    mutex.lock();
+    pair<double, double>& call = calls[method];
+    call.first++;
+    call.second += seconds;
+    mutex.unlock();
+
+    add(STAT_RPC, seconds);
+}
+
+double Stats::getRates(double* rates, double* loads)
+{
+    double time = now();
+
+    mutex.lock();
+    sample(time);
+
+    // the newest sample at least a window old, else the start with no events
+    const Sample* oldest = 0;
+
+    for(int i = 0; i < sampleCount; i++)
+    {
+        const Sample& s = samples[(nextSample + STATS_SAMPLES - sampleCount + i) % STATS_SAMPLES];
+
+        if(time - s.time < STATS_WINDOW)
+        {
+            break;
+        }
+
+        oldest = &s;
+    }
+
+    double span = time - (oldest ? oldest->time : totals.time);
+
+    for(int stat = 0; stat < STAT_COUNT; stat++)
+    {
+        double count = totals.counts[stat] - (oldest ? oldest->counts[stat] : 0);
+        double seconds = totals.seconds[stat] - (oldest ? oldest->seconds[stat] : 0);
+        rates[stat] = span > 0 ? count / span : 0;
+        loads[stat] = span > 0 ? seconds / span : 0;
+    }
+
+    mutex.unlock();
+
+    return span;
+}
+
+void Stats::getTotals(double* counts, double* seconds) const
+{
+    mutex.lock();
+
+    for(int stat = 0; stat < STAT_COUNT; stat++)
+    {
+        counts[stat] = totals.counts[stat];
+        seconds[stat] = totals.seconds[stat];
+    }
+
+    mutex.unlock();
+}
+
+map<string, pair<double, double> > Stats::getCalls() const
+{
+    mutex.lock();
+    map<string, pair<double, double> > result = calls;
+    mutex.unlock();
+
+    return result;
+}
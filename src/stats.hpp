@@ -0,0 +1,101 @@
+/*
+ * Mycelia immersive 3d network visualization tool.
+ * Copyright (C) 2008-2010 Sean Whalen.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __STATS_HPP
+#define __STATS_HPP
+
+#include <Threads/Mutex.h>
+
+#include <map>
+#include <string>
+
+#define STAT_FRAME 0 // Mycelia::frame
+#define STAT_DISPLAY 1 // Mycelia::display, once per window and eye
+#define STAT_GRAPH_LIST 2 // display list rebuilds
+#define STAT_INSTANCES 3 // instance buffer rebuilds
+#define STAT_GRAPH_COPY 4 // whole graph copies for the renderer
+#define STAT_TEXTURES 5 // texture uploads and evictions
+#define STAT_LAYOUT_STEP 6 // steps of any layout
+#define STAT_BUNDLE_STEP 7 // edge bundling iterations
+#define STAT_RPC 8 // rpc calls of any method
+#define STAT_LOCK_WAIT 9 // Graph::lock() calls that found the graph locked
+#define STAT_COUNT 10
+
+#define STATS_WINDOW 5.0 // seconds covered by the rolling rates
+#define STATS_SAMPLES 10 // totals kept over the window
+
+/*
+ * Counts and accumulated seconds of the hot paths, updated by any thread.
+ * Rolling rates compare the current totals with those up to STATS_WINDOW
+ * seconds ago, sampled as events arrive, so nothing needs to poll.
+ */
+class Stats
+{
+private:
+    class Sample
+    {
+    public:
+        double time;
+        double counts[STAT_COUNT];
+        double seconds[STAT_COUNT];
+    };
+
+    mutable Threads::Mutex mutex;
+    Sample totals; // time is the start
+    Sample samples[STATS_SAMPLES];
+    int sampleCount;
+    int nextSample;
+
+    // per rpc method name: calls and seconds
+    std::map<std::string, std::pair<double, double> > calls;
+
+    void sample(double); // caller holds the mutex
+
+public:
+    Stats();
+
+    static double now();
+    static const char* getName(int);
+
+    void add(int, double);
+    void addCall(const std::string&, double);
+
+    // per stat over the rolling window: events and busy seconds per second;
+    // returns the seconds actually covered
+    double getRates(double*, double*);
+    void getTotals(double*, double*) const;
+    std::map<std::string, std::pair<double, double> > getCalls() const;
+};
+
+/*
+ * Adds the seconds from construction to destruction to a stat, e.g. for
+ * the body of a function.
+ */
+class StatTimer
+{
+private:
+    Stats& stats;
+    int stat;
+    double start;
+
+public:
+    StatTimer(Stats& stats, int stat) : stats(stats), stat(stat), start(Stats::now()) {}
+    ~StatTimer() { stats.add(stat, Stats::now() - start); }
+};
+
+#endif
@@ -0,0 +1,211 @@
+/*
+ * Mycelia immersive 3d network visualization tool.
+ * Copyright (C) 2008-2010 Sean Whalen.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <streamserver.hpp>
+
+#include <errno.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+using namespace std;
+
+static bool readFully(int fd, void* data, size_t size)
+{
+    char* p = (char*)data;
+
+    while(size > 0)
+    {
+        ssize_t n = recv(fd, p, size, 0);
+
+        if(n < 0 && errno == EINTR) continue;
+        if(n <= 0) return false;
+
+        p += n;
+        size -= n;
+    }
+
+    return true;
+}
+
+static bool writeFully(int fd, const void* data, size_t size)
+{
+    const char* p = (const char*)data;
+
+    while(size > 0)
+    {
+        ssize_t n = send(fd, p, size, MSG_NOSIGNAL);
+
+        if(n < 0 && errno == EINTR) continue;
+        if(n <= 0) return false;
+
+        p += n;
+        size -= n;
+    }
+
+    return true;
+}
+
+StreamServer::StreamServer(Mycelia* app, int port) : app(app), port(port)
+{
+    serverThread = new Threads::Thread();
+    serverThread->start(this, &StreamServer::run);
+}
+
+/*
+ * Serves one connection at a time, like a single simulation pushing
+ * positions; others wait in the listen backlog.
+ */
+void* StreamServer::run()
+{
+    int listener = socket(AF_INET, SOCK_STREAM, 0);
+    int on = 1;
+    setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+
+    sockaddr_in address;
+    memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_ANY);
+    address.sin_port = htons(port);
+
+    if(listener < 0 || bind(listener, (sockaddr*)&address, sizeof(address)) < 0 || listen(listener, 4) < 0)
+    {
+        cout << "stream server: cannot listen on port " << port << endl;
+        if(listener >= 0) close(listener);
+        return 0;
+    }
+
+    while(true)
+    {
+        int fd = accept(listener, 0, 0);
+        if(fd < 0) continue;
+
+        // replies are small and latency matters more than packet count
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+
+        uint32_t magic = 0;
+        if(readFully(fd, &magic, sizeof(magic)) && magic == STREAM_MAGIC)
+        {
+            StreamHeader header;
+            while(readFully(fd, &header, sizeof(header)) && handle(fd, header));
+        }
+        else
+        {
+            cout << "stream server: bad magic, mismatched byte order?" << endl;
+        }
+
+        close(fd);
+    }
+
+    return 0;
+}
+
+// false drops the connection
+bool StreamServer::handle(int fd, const StreamHeader& header)
+{
+    if(header.count > STREAM_MAX_COUNT)
+    {
+        cout << "stream server: message of " << header.count << " elements refused" << endl;
+        return false;
+    }
+
+    Graph* g = app->g;
+    int count = header.count;
+
+    switch(header.type)
+    {
+    case STREAM_ADD_NODES:
+    {
+        int32_t first = g->addNodes(count);
+        return reply(fd, header.type, count, &first, sizeof(first));
+    }
+
+    case STREAM_ADD_EDGES:
+    {
+        if(!readIds(fd, 2 * header.count)) return false;
+
+        g->addEdges(ids, results);
+        return reply(fd, header.type, results.size(), results.empty() ? 0 : &results[0], results.size() * sizeof(int32_t));
+    }
+
+    case STREAM_SET_NODE_POSITIONS:
+        if(!readIds(fd, header.count) || !readValues(fd, 3 * (size_t)count)) return false;
+        return reply(fd, header.type, g->setNodePositions(ids, values));
+
+    case STREAM_SET_NODE_COLORS:
+        if(!readIds(fd, header.count) || !readValues(fd, 4 * (size_t)count)) return false;
+        return reply(fd, header.type, g->setNodeColors(ids, values));
+
+    case STREAM_SET_NODE_SIZES:
+        if(!readIds(fd, header.count) || !readValues(fd, count)) return false;
+        return reply(fd, header.type, g->setNodeSizes(ids, values));
+
+    case STREAM_SET_EDGE_COLORS:
+        if(!readIds(fd, header.count) || !readValues(fd, 4 * (size_t)count)) return false;
+        return reply(fd, header.type, g->setEdgeColors(ids, values));
+
+    case STREAM_SET_EDGE_WEIGHTS:
+        if(!readIds(fd, header.count) || !readValues(fd, count)) return false;
+        return reply(fd, header.type, g->setEdgeWeights(ids, values));
+
+    case STREAM_GET_NODE_POSITIONS:
+    {
+        g->lock();
+        ids.assign(g->getIndexNodes().begin(), g->getIndexNodes().end());
+        const vector<Vrui::Point>& positions = g->getPositions();
+        values.resize(3 * positions.size());
+        for(int i = 0; i < (int)positions.size(); i++)
+        {
+            values[3 * i] = positions[i][0];
+            values[3 * i + 1] = positions[i][1];
+            values[3 * i + 2] = positions[i][2];
+        }
+        g->unlock();
+
+        return reply(fd, header.type, ids.size(), ids.empty() ? 0 : &ids[0], ids.size() * sizeof(int32_t)) &&
+            (values.empty() || writeFully(fd, &values[0], values.size() * sizeof(double)));
+    }
+
+    default:
+        cout << "stream server: unknown message type " << header.type << endl;
+        return false;
+    }
+}
+
+bool StreamServer::reply(int fd, uint32_t type, uint32_t count, const void* payload, size_t size)
+{
+    StreamHeader header;
+    header.type = type;
+    header.count = count;
+
+    return writeFully(fd, &header, sizeof(header)) && (size == 0 || writeFully(fd, payload, size));
+}
+
+// int is 32 bits on every platform the server builds on, so ids are read in place
+bool StreamServer::readIds(int fd, uint32_t count)
+{
+    ids.resize(count);
+    return count == 0 || readFully(fd, &ids[0], count * sizeof(int32_t));
+}
+
+bool StreamServer::readValues(int fd, size_t count)
+{
+    values.resize(count);
+    return count == 0 || readFully(fd, &values[0], count * sizeof(double));
+}
@@ -0,0 +1,79 @@
+/*
+ * Mycelia immersive 3d network visualization tool.
+ * Copyright (C) 2008-2010 Sean Whalen.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __STREAMSERVER_HPP
+#define __STREAMSERVER_HPP
+
+#include <graph.hpp>
+#include <mycelia.hpp>
+
+#include <stdint.h>
+
+#define STREAM_PORT 9877
+#define STREAM_MAGIC 0x3143594d // "MYC1" in the client's byte order
+#define STREAM_MAX_COUNT (1 << 24) // elements per message, larger ones drop the connection
+
+// message types, answered with a header of the same type
+#define STREAM_ADD_NODES 1 // count nodes; reply payload is the first new id
+#define STREAM_ADD_EDGES 2 // int32 source and target per edge; reply has an id per edge
+#define STREAM_SET_NODE_POSITIONS 3 // int32 ids, then 3 doubles per node
+#define STREAM_SET_NODE_COLORS 4 // int32 ids, then 4 doubles per node
+#define STREAM_SET_NODE_SIZES 5 // int32 ids, then a double per node
+#define STREAM_SET_EDGE_COLORS 6 // int32 ids, then 4 doubles per edge
+#define STREAM_SET_EDGE_WEIGHTS 7 // int32 ids, then a double per edge
+#define STREAM_GET_NODE_POSITIONS 8 // count 0; reply has every id, then 3 doubles per node
+
+/*
+ * Binary counterpart of the XML-RPC server for bulk transfers. A client
+ * connects, sends STREAM_MAGIC as a uint32 and then any number of messages,
+ * each a StreamHeader followed by its payload. All values are in the
+ * client's byte order, which must match the server's; a mismatched magic
+ * closes the connection. Payloads are read straight into the arrays handed
+ * to the bulk graph methods, and every message is answered with a header
+ * whose count is the number of elements added or changed.
+ */
+struct StreamHeader
+{
+    uint32_t type;
+    uint32_t count;
+};
+
+class StreamServer
+{
+private:
+    Mycelia* app;
+    Threads::Thread* serverThread;
+    int port;
+
+    // reused across messages
+    std::vector<int> ids;
+    std::vector<double> values;
+    std::vector<int> results;
+
+    bool handle(int, const StreamHeader&);
+    bool reply(int, uint32_t, uint32_t, const void* = 0, size_t = 0);
+    bool readIds(int, uint32_t);
+    bool readValues(int, size_t);
+
+public:
+    StreamServer(Mycelia*, int = STREAM_PORT);
+
+    void* run();
+};
+
+#endif
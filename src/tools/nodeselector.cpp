@@ -84,9 +84,10 @@ void NodeSelector::buttonCallback(int buttonIndex, Vrui::InputDevice::ButtonCall
             dragging = true;
         }
     }
-    else
+    else if(dragging)
     {
         dragging = false;
+        factory->application->postEvent("drop", factory->application->getSelectedNode());
     }
 }
 
@@ -99,6 +100,7 @@ void NodeSelector::frame()
         Vrui::ONTransform current(Vrui::getDeviceTransformation(device).getTranslation(), Vrui::getDeviceTransformation(device).getRotation());
         current *= initial; // 'subtracts' starting transform to find increment, adds to node start position
         factory->application->g->setNodePosition(factory->application->getSelectedNode(), current.getOrigin());
+        factory->application->postEvent("drag", factory->application->getSelectedNode());
     }
 
     // highlight the nearest node within one radius
@@ -18,6 +18,12 @@
 
 #include <vruihelp.hpp>
 
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
 using namespace std;
 
 namespace VruiHelp
@@ -110,6 +116,113 @@ string fileToString(string& filename)
     return stream.str();
 }
 
+/*
+ * Reads a decimal number from [p, end) after any blanks or commas, without
+ * crossing a newline or end; returns the position after it, or 0 if there
+ * is none before the end of the line.
+ */
+const char* readNumber(const char* p, const char* end, double& value)
+{
+    while(p < end && (*p == ' ' || *p == '\t' || *p == '\r' || *p == ',')) p++;
+
+    double sign = 1;
+
+    if(p < end && (*p == '-' || *p == '+'))
+    {
+        if(*p++ == '-') sign = -1;
+    }
+
+    double mantissa = 0;
+    int exponent = 0;
+    bool digits = false;
+
+    for(; p < end && isdigit((unsigned char)*p); p++, digits = true) mantissa = 10 * mantissa + (*p - '0');
+
+    if(p < end && *p == '.')
+    {
+        for(p++; p < end && isdigit((unsigned char)*p); p++, digits = true, exponent--) mantissa = 10 * mantissa + (*p - '0');
+    }
+
+    if(!digits)
+    {
+        return 0;
+    }
+
+    if(p + 1 < end && (*p == 'e' || *p == 'E') && (isdigit((unsigned char)p[1]) || p[1] == '-' || p[1] == '+'))
+    {
+        const char* q = p + 1;
+        int e = 0, eSign = 1;
+        if(*q == '-' || *q == '+') eSign = *q++ == '-' ? -1 : 1;
+        for(; q < end && isdigit((unsigned char)*q); q++) e = 10 * e + (*q - '0');
+        exponent += eSign * e;
+        p = q;
+    }
+
+    value = sign * (exponent >= 0 ? mantissa * pow(10.0, exponent) : mantissa / pow(10.0, -exponent));
+    return p;
+}
+
+/*
+ * Fills bounds with count + 1 positions that split [begin, end) into count
+ * chunks of about the same size, each but the first starting a line.
+ */
+void splitLines(const char* begin, const char* end, int count, vector<const char*>& bounds)
+{
+    bounds.assign(1, begin);
+
+    for(int i = 1; i < count; i++)
+    {
+        const char* p = max(bounds.back(), begin + (end - begin) * i / count);
+
+        if(p > begin && p < end && p[-1] != '\n')
+        {
+            const char* eol = (const char*)memchr(p, '\n', end - p);
+            p = eol ? eol + 1 : end;
+        }
+
+        bounds.push_back(p);
+    }
+
+    bounds.push_back(end);
+}
+
+MappedFile::MappedFile(const string& filename) : data(0), size(0), mapping(MAP_FAILED)
+{
+    int fd = open(filename.c_str(), O_RDONLY);
+    struct stat info;
+
+    if(fd >= 0 && fstat(fd, &info) == 0 && S_ISREG(info.st_mode) && info.st_size > 0)
+    {
+        size = info.st_size;
+        mapping = mmap(0, size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+        if(mapping != MAP_FAILED)
+        {
+            // pages are read once, front to back
+            madvise(mapping, size, MADV_SEQUENTIAL);
+            data = (const char*)mapping;
+        }
+    }
+
+    if(fd >= 0) close(fd);
+
+    if(data == 0)
+    {
+        string name(filename);
+        copy = fileToString(name);
+        size = copy.size();
+        data = copy.data();
+    }
+}
+
+MappedFile::~MappedFile()
+{
+    if(mapping != MAP_FAILED)
+    {
+        munmap(mapping, size);
+    }
+}
+
 float randomFloat()
 {
     float x = rand() / (float(RAND_MAX) + 1);
@@ -38,11 +38,31 @@ std::string longToString(long);
 float stringToFloat(std::string&);
 int stringToInt(std::string&);
 std::string fileToString(std::string&);
+const char* readNumber(const char*, const char*, double&);
+void splitLines(const char*, const char*, int, std::vector<const char*>&);
 float randomFloat();
 void show(GLMotif::Widget*);
 void show(GLMotif::Widget*, const GLMotif::Widget*);
 void hide(GLMotif::Widget*);
 ParamPair createParameter(const char*, float, float, float, GLMotif::Container*);
+
+// read-only view of a whole file, mapped instead of copied where possible
+class MappedFile
+{
+private:
+    const char* data;
+    size_t size;
+    void* mapping;
+    std::string copy; // for files that cannot be mapped
+
+public:
+    MappedFile(const std::string&);
+    ~MappedFile();
+
+    bool isOpen() const { return data != 0; }
+    const char* begin() const { return data; }
+    const char* end() const { return data + size; }
+};
 }
 
 #endif
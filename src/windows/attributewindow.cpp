@@ -65,7 +65,7 @@ void AttributeWindow::update(const Attributes& attributes) const
     
     for(Attributes::const_iterator entry = attributes.begin(); entry != attributes.end(); entry++)
     {
-        if(i > (int)labelVector.size()) return;
+        if(i >= (int)labelVector.size()) return;
         
         labelVector[i]->setString(entry->first.c_str());
         fieldVector[i]->setString(entry->second.c_str());
@@ -21,7 +21,7 @@
 using namespace std;
 
 ImageWindow::ImageWindow(Mycelia* application)
-    : Window(application)
+    : Window(application), pluginVersion(0)
 {
     window = new GLMotif::PopupWindow("ImageWindowPopup", Vrui::getWidgetManager(), "Plugin Output");
     
@@ -29,6 +29,18 @@ ImageWindow::ImageWindow(Mycelia* application)
     widget->manageChild();
 }
 
+// called every frame, the output image is read on the main thread
+void ImageWindow::update()
+{
+    int version = plugins.getVersion();
+
+    if(version != pluginVersion)
+    {
+        pluginVersion = version;
+        widget->load(PLUGIN_OUTPUT);
+    }
+}
+
 ImageWindow::ImageWidget::ImageWidget(GLMotif::Container* parent)
     : GLMotif::Widget("ImageWidget", parent, false)
 {
@@ -85,18 +97,12 @@ void ImageWindow::ImageWidget::initContext(GLContextData& contextData) const
     contextData.addDataItem(this, dataItem);
 }
 
-void ImageWindow::ImageWidget::load(string scriptFilename)
+void ImageWindow::ImageWidget::load(string imageFilename)
 {
-    string cmdline = string(PYTHON) + " " + scriptFilename;
-    int retval = system(cmdline.c_str());
+    image = Images::readImageFile(imageFilename.c_str());
+    width = image.getWidth() / image.getHeight() * Vrui::getDisplaySize();
+    height =  Vrui::getDisplaySize();
+    version++;
     
-    if(retval == 0)
-    {
-        image = Images::readImageFile("/tmp/output.png");
-        width = image.getWidth() / image.getHeight() * Vrui::getDisplaySize();
-        height =  Vrui::getDisplaySize();
-        version++;
-        
-        getParent()->requestResize(this, calcNaturalSize());
-    }
+    getParent()->requestResize(this, calcNaturalSize());
 }
\ No newline at end of file
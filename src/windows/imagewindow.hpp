@@ -20,6 +20,7 @@
 #define __IMAGEWINDOW_HPP
 
 #include <mycelia.hpp>
+#include <pluginhost.hpp>
 #include <vruihelp.hpp>
 #include <windows/window.hpp>
 
@@ -61,11 +62,16 @@ private:
     };
     
     ImageWidget* widget;
+    PluginHost plugins;
+    int pluginVersion; // of the output shown
     
 public:
     ImageWindow(Mycelia*);
     
-    void load(std::string scriptFilename) { widget->load(scriptFilename); }
+    // runs a plot script on the view last written to PLUGIN_VIEW, in the
+    // background; update() shows its output once it is done
+    void load(std::string scriptFilename) { plugins.run(scriptFilename); }
+    void update();
 };
 
 #endif
\ No newline at end of file